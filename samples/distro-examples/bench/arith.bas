@@ -0,0 +1,17 @@
+'
+' integer and real arithmetic with math functions
+'
+n = iff(command == "", 500000, val(command))
+
+a = 0
+x = 0.5
+for i = 1 to n
+  a = (a + i * 3) mod 1000003
+  b = a \ 7 + (i band 255)
+  x = x * 1.000001 + sqr(i) / (i + 1)
+  y = sin(x) * cos(x) + abs(b - a) ^ 0.5
+next
+if a < 0 or y = 0 then throw "arith"
+
+print "ops:"; n * 4
+print "rss:"; fre(-23)
@@ -0,0 +1,28 @@
+'
+' array creation, element access, APPEND and 2D indexing
+'
+n = iff(command == "", 500000, val(command))
+const w = 500
+
+dim a(n)
+for i = 0 to n
+  a(i) = i * 2
+next
+total = 0
+for i = 0 to n
+  total += a(i)
+next
+b = []
+for i = 1 to n / 5
+  append b, i
+next
+dim g(w, w)
+for y = 0 to w
+  for x = 0 to w
+    g(y, x) = x + y
+  next
+next
+if total == 0 or len(b) != n / 5 or g(w, w) != w * 2 then throw "arrays"
+
+print "ops:"; n * 2 + n / 5 + (w + 1) * (w + 1)
+print "rss:"; fre(-23)
@@ -0,0 +1,35 @@
+'
+' FUNC calls with LOCAL variables and SUB calls with BYREF parameters
+'
+n = iff(command == "", 200000, val(command))
+
+func sum_locals(n)
+  local a, b, c, i
+  a = 0
+  for i = 1 to n
+    b = i
+    c = b * 2
+    a += c
+  next
+  sum_locals = a
+end
+
+sub count_to(byref total, n)
+  local i
+  for i = 1 to n
+    total++
+  next
+end
+
+r = 0
+for i = 1 to n
+  r += sum_locals(3)
+next
+total = 0
+for i = 1 to n
+  count_to total, 1
+next
+if r != n * 12 or total != n then throw "calls"
+
+print "ops:"; n * 2
+print "rss:"; fre(-23)
@@ -0,0 +1,22 @@
+'
+' compile a generated program with many variables, SUBs and labels, the
+' number of variables is given on the command line, eg 1000, 10000 or 100000
+'
+n = iff(command == "", 20000, val(command))
+
+dim code
+for i = 1 to n
+  append code, "v" + i + " = " + i
+next
+for i = 1 to n / 10
+  append code, "sub p" + i + "(a)"
+  append code, "  local l" + i + " = a + v" + i
+  append code, "end"
+  append code, "label lab" + i
+  append code, "p" + i + "(" + i + ")"
+next
+chain code
+
+' the source lines compiled
+print "ops:"; len(code)
+print "rss:"; fre(-23)
@@ -0,0 +1,28 @@
+'
+' map field access by name and indexing with integer variables
+'
+n = iff(command == "", 200000, val(command))
+const w = 200
+
+p = {}
+p.x = 0: p.y = 0: p.vx = 1: p.vy = 2
+for i = 1 to n
+  p.x = p.x + p.vx
+  p.y = p.y + p.vy
+next
+dim g(w, w)
+for y = 0 to w
+  for x = 0 to w
+    g(y, x) = g(y, x) + x * y
+  next
+next
+total = 0
+for y = 0 to w
+  for x = 0 to w
+    total += g(x, y)
+  next
+next
+if p.x != n or p.y != n * 2 or total <= 0 then throw "fields"
+
+print "ops:"; n * 2 + (w + 1) * (w + 1) * 2
+print "rss:"; fre(-23)
@@ -0,0 +1,28 @@
+'
+' write and read text files with PRINT #, LINEINPUT, TSAVE and TLOAD
+'
+n = iff(command == "", 50000, val(command))
+f = "bench-fileio.tmp"
+
+open f for output as #1
+for i = 1 to n
+  print #1, "line "; i; " of the benchmark file"
+next
+close #1
+
+count = 0
+open f for input as #1
+while not eof(1) and count < n / 10
+  lineinput #1, s
+  count++
+wend
+close #1
+
+tload f, lines
+tsave f, lines
+tload f, lines
+kill f
+if count != n / 10 or len(lines) < n then throw "fileio"
+
+print "ops:"; n * 3 + n / 10
+print "rss:"; fre(-23)
@@ -0,0 +1,32 @@
+'
+' graphics primitives and images drawn offscreen
+'
+n = iff(command == "", 20000, val(command))
+const w = 200
+
+for i = 1 to n
+  line i mod 640, 0, 0, i mod 480
+  rect i mod 320, i mod 240, i mod 320 + 50, i mod 240 + 40 filled
+  circle i mod 640, i mod 480, 25
+  pset i mod 640, i mod 480
+next
+
+dim px(w - 1, w - 1)
+for y = 0 to w - 1
+  for x = 0 to w - 1
+    px(y, x) = rgb(x, y, (x + y) mod 256)
+  next
+next
+dim tpx(15, 15)
+img = image(px)
+tile = image(tpx)
+for i = 1 to 1000
+  img.paste(tile, i mod (w - 16), (i * 7) mod (w - 16))
+next
+func invert(c)
+  invert = -c
+end
+img.filter(use invert(x))
+
+print "ops:"; n * 4 + w * w * 2 + 1000
+print "rss:"; fre(-23)
@@ -0,0 +1,25 @@
+'
+' build maps and arrays, write them as JSON and parse them back
+'
+n = iff(command == "", 2000, val(command))
+
+for i = 1 to n
+  m = {}
+  m.id = i
+  m.name = "item " + i
+  m.tags = ["a", "b", "c", i]
+  m.pos = {x: i * 1.5, y: -i}
+  s = str(m)
+  p = array(s)
+  if p.id != i then throw "json"
+next
+doc = []
+for i = 1 to n * 5
+  append doc, {k: i, v: "v" + i}
+next
+s = str(doc)
+p = array(s)
+if len(p) != n * 5 then throw "json"
+
+print "ops:"; n * 2 + 2
+print "rss:"; fre(-23)
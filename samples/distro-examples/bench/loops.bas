@@ -0,0 +1,27 @@
+'
+' FOR, WHILE and REPEAT loops with integer counters
+'
+n = iff(command == "", 1000000, val(command))
+
+ops = 0
+for i = 1 to n
+  ops++
+next
+i = 0
+while i < n
+  i++
+  ops++
+wend
+i = 0
+repeat
+  i++
+  ops++
+until i == n
+for i = 1 to 1000
+  for j = 1 to n / 1000
+    ops++
+  next
+next
+
+print "ops:"; ops
+print "rss:"; fre(-23)
@@ -0,0 +1,28 @@
+'
+' map insert, lookup, update and lookup of missing keys, run with 1000,
+' 100000 (the default) or 1000000 keys given on the command line
+'
+n = iff(command == "", 100000, val(command))
+
+m = {}
+for i = 1 to n
+  m["k" + i] = i
+next
+total = 0
+for i = 1 to n
+  total += m["k" + i]
+next
+for i = 1 to n step 2
+  m["k" + i] = m["k" + i] * 2
+next
+found = 0
+for i = 1 to n * 2 step 3
+  if m["k" + i] > 0 then found++
+next
+for k in m
+  total += m[k]
+next
+if total <= 0 or found == 0 then throw "maps"
+
+print "ops:"; n * 3 + n / 2 + int(n * 2 / 3)
+print "rss:"; fre(-23)
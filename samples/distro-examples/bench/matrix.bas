@@ -0,0 +1,27 @@
+'
+' matrix multiply, INVERSE and DETERM of n x n matrices, where n is given
+' on the command line, eg 64, 512 or 2048
+'
+n = iff(command == "", 320, val(command))
+
+func make_matrix(n)
+  local m, i, j
+  dim m(n - 1, n - 1) as real
+  for i = 0 to n - 1
+    for j = 0 to n - 1
+      m(i, j) = ((i * 7 + j * 13) mod 17) / 17 + iff(i == j, n, 0)
+    next
+  next
+  make_matrix = m
+end
+
+a = make_matrix(n)
+b = make_matrix(n)
+c = a * b
+d = inverse(a)
+e = determ(a)
+if len(c) != n * n or len(d) != n * n or e == 0 then throw "matrix"
+
+' multiply-adds made by the product, the inverse and the determinant
+print "ops:"; n * n * n * 2 + int(n * n * n / 3)
+print "rss:"; fre(-23)
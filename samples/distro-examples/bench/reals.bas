@@ -0,0 +1,19 @@
+'
+' fill, SUM, scale and reduce DIM AS REAL arrays
+'
+n = iff(command == "", 500000, val(command))
+
+dim a(n - 1) as real
+for i = 0 to n - 1
+  a(i) = i * 0.5
+next
+total = sum(a)
+a = a * 2
+check = 0
+for i = 0 to n - 1
+  check += a(i)
+next
+if total != (n - 1) * n / 4 or check != total * 2 then throw "reals"
+
+print "ops:"; n * 4
+print "rss:"; fre(-23)
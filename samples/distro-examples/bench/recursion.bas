@@ -0,0 +1,26 @@
+'
+' recursive FUNC and SUB calls
+'
+func fib(n)
+  if n < 2 then
+    fib = n
+  else
+    fib = fib(n - 1) + fib(n - 2)
+  endif
+end
+
+sub hanoi(n, a, b, c)
+  if n > 0 then
+    hanoi(n - 1, a, c, b)
+    moves++
+    hanoi(n - 1, c, b, a)
+  endif
+end
+
+moves = 0
+if fib(24) != 46368 then throw "fib"
+hanoi(16, 1, 2, 3)
+
+' calls made by fib(24) plus those made by hanoi(16)
+print "ops:"; 150049 + 131071
+print "rss:"; fre(-23)
@@ -0,0 +1,22 @@
+'
+' SORT numbers and strings
+'
+n = iff(command == "", 200000, val(command))
+
+randomize 1
+dim a(n - 1)
+dim s(n / 4 - 1)
+for i = 0 to n - 1
+  a(i) = rnd * n
+next
+for i = 0 to n / 4 - 1
+  s(i) = hex(int(rnd * 1000000))
+next
+sort a
+sort s
+for i = 1 to n - 1
+  if a(i - 1) > a(i) then throw "sort"
+next
+
+print "ops:"; n + n / 4
+print "rss:"; fre(-23)
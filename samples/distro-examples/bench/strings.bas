@@ -0,0 +1,30 @@
+'
+' string building and searching, with n appends by s += x and s = s + x,
+' where n is given on the command line, eg 1000000
+'
+n = iff(command == "", 200000, val(command))
+
+s = ""
+for i = 1 to n
+  s += chr(65 + i mod 26)
+next
+r = ""
+for i = 1 to n
+  r = r + chr(65 + i mod 26)
+next
+t = ""
+k = min(10000, n / 20)
+for i = 1 to k
+  t += str(i) + ","
+next
+m = min(20000, n / 10)
+found = 0
+for i = 1 to m
+  if instr(s, mid(s, i, 8)) > 0 then found++
+  u = left(t, 10) + upper(right(s, 10)) + replace(mid(t, i, 12), ",", ";")
+next
+split t, ",", w
+if found != m or r != s or len(w) == 0 then throw "strings"
+
+print "ops:"; n * 2 + k + m * 4 + 1
+print "rss:"; fre(-23)
@@ -0,0 +1,19 @@
+'
+' load a large text file with TLOAD as lines, offsets and one string
+'
+n = iff(command == "", 50000, val(command))
+f = "bench-tload.tmp"
+
+dim a(n - 1)
+for i = 0 to n - 1
+  a(i) = "line " + i + " of the text file used to time loading with TLOAD"
+next
+tsave f, a
+tload f, a
+tload f, b, 3
+tload f, s, 1
+kill f
+if len(a) != n or len(s) == 0 then throw "tload"
+
+print "ops:"; n * 4
+print "rss:"; fre(-23)
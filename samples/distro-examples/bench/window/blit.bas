@@ -0,0 +1,44 @@
+#!/usr/bin/sbasic
+'
+' image drawing speed, tiles a 1920x1080 frame with a 256x256 image.
+' run with the SDL or Android version
+'
+
+const size = 256
+
+func make_image(alpha)
+  local a, x, y, c
+  dim a(size - 1, size - 1)
+  for y = 0 to size - 1
+    for x = 0 to size - 1
+      c = (x * 65536) + (y * 256) + ((x + y) band 255)
+      if alpha then
+        ' alpha varies across the image, fully clear and fully opaque at the edges
+        a(y, x) = (min(255, x * 2) * 16777216) + c
+      else
+        a(y, x) = -c
+      endif
+    next
+  next
+  make_image = image(a)
+end
+
+sub bench(name, img, opacity)
+  local f, x, y, st, frames
+  frames = 10
+  st = ticks
+  for f = 1 to frames
+    for y = 0 to 1079 step size
+      for x = 0 to 1919 step size
+        img.draw(x, y, opacity)
+      next
+    next
+  next
+  ? name; ": "; (ticks - st) / frames; " ms per frame"
+end
+
+opaque = make_image(false)
+alpha = make_image(true)
+bench("opaque", opaque, 0)
+bench("alpha", alpha, 0)
+bench("opacity", alpha, 50)
@@ -0,0 +1,47 @@
+#!/usr/bin/sbasic
+'
+' PAINT speed, run with the SDL or Android version and the window sized to
+' 3840x2160 to time fills on a 4K canvas. a grid of pixels is compared
+' before and after each fill, only pixels of the seed colour may change
+'
+
+const grid = 37
+
+sub bench(name, shapes)
+  local i, x, y, st, et, seed, fill, before, errors
+
+  cls
+  randomize 1
+  for i = 1 to shapes
+    circle rnd * xmax, rnd * ymax, 5 + rnd * ymax / 4 color 15
+    rect rnd * xmax, rnd * ymax step 10 + rnd * 200, 10 + rnd * 200 color 15
+  next
+
+  dim before(ymax / grid, xmax / grid)
+  for y = 0 to ymax / grid
+    for x = 0 to xmax / grid
+      before(y, x) = point(x * grid, y * grid)
+    next
+  next
+  seed = point(xmax / 2, ymax / 2)
+
+  st = ticks
+  paint xmax / 2, ymax / 2, 4
+  et = ticks
+  ? name; " "; xmax + 1; "x"; ymax + 1; ": "; (et - st); " ms"
+
+  fill = point(xmax / 2, ymax / 2)
+  errors = iff(fill == seed, 1, 0)
+  for y = 0 to ymax / grid
+    for x = 0 to xmax / grid
+      i = point(x * grid, y * grid)
+      if i != before(y, x) and (before(y, x) != seed or i != fill) then errors++
+      if shapes == 0 and i != fill then errors++
+    next
+  next
+  if errors then ? "ERROR: "; errors; " pixels filled wrongly"
+end
+
+bench("empty", 0)
+bench("shapes", 100)
+bench("maze", 2000)
@@ -438,3 +438,71 @@ redim a(10)    : if a != [0,1,2,3,4,5,6,7,8,9,10] then throw str(a)
 redim a(0 to 7): if a != [0,1,2,3,4,5,6,7] then throw str(a)
 redim a(0 to 1): if a != [0,1] then throw str(a)
 
+
+'
+' numeric arrays held as packed storage
+'
+dim pi(3) as integer
+pi(0) = 2.7
+pi(1) = 3
+if pi != [2,3,0,0] then throw str(pi)
+dim pr(2) as real
+pr(0) = 3: pr(1) = 0.5
+if pr != [3,0.5,0] then throw str(pr)
+if pr * pr != [9,0.25,0] then throw str(pr * pr)
+' the declared type is a storage hint, other values unpack the array
+dim pt(3) as integer
+pt(0) = 2.7
+pt(2) = "x"
+pt(1) = 2.7
+if pt != [2,2.7,"x",0] then throw str(pt)
+dim pu(1) as real
+pu(1).x = 5
+pu(0) = 7
+if pu(0) != 7 or pu(1).x != 5 then throw str(pu)
+dim pd(3)
+pd(1) += 5
+pd(2) = "two"
+if pd != [0,5,"two",0] then throw str(pd)
+dim pc(2)
+pc2 = pc
+pc2(0) = 1
+if pc != [0,0,0] or pc2 != [1,0,0] then throw str(pc) + str(pc2)
+dim pm(1)
+pm(0).y = 100
+pm(0).y += 1
+if pm(0).y != 101 then throw "not 101 !!!"
+ps = seq(0, 1, 3)
+append ps, 2
+delete ps, 0
+if ps != [0.5,1,2] then throw str(ps)
+
+'
+' subscripts read directly from an integer variable or constant
+'
+dim q(2 to 4, -1 to 1, 3)
+n = 0
+for i = 2 to 4
+  for j = -1 to 1
+    for k = 0 to 3
+      q(i, j, k) = n
+      n++
+    next
+  next
+next
+if q(2, -1, 0) != 0 or q(2, 0, 1) != 5 or q(4, 1, 3) != 35 then throw str(q)
+i = 3: j = 0: k = 2
+if q(i, j, k) != 18 or q(3, 0, 2) != 18 or q(i, j + 1, k - 1) != 21 then throw "q(i, j, k)"
+i = 3.0
+if q(i, j, k) != 18 then throw "real subscript"
+dim q(2, 1)
+q(1, 1) = "r"
+i = 1
+if q(i, i) != "r" or q(i * 2, 0) != 0 then throw str(q)
+try
+  i = 3
+  x = q(i, 0)
+  throw "q(3, 0) was valid"
+catch e
+  if instr(e, "out of range") == 0 then throw e
+end try
@@ -0,0 +1,83 @@
+rem
+rem arrays and maps assigned from another variable share their data
+rem until one side is modified
+rem
+
+a = [1, 2, 3]
+b = a
+b[0] = 99
+? a, b
+
+sub modify(x)
+  x[1] = "changed"
+  append x, 4
+end
+modify(a)
+? a
+
+c = a
+append c, 5
+? a, c
+
+d = [3, 1, 2]
+e = d
+sort e
+? d, e
+
+f = [1, 2, 3, 4]
+g = f
+delete g, 1
+insert g, 0, 0
+? f, g
+
+rem nested arrays
+h = [[1, 2], [3, 4]]
+i = h[1]
+i[0] = 30
+h[0][1] = 20
+? h, i
+
+rem self assignment
+j = [1, 2]
+j[1] = j
+? j
+
+func clobber(k)
+  j[0] = "clobbered"
+  clobber = len(k)
+end
+j = [1, 2, 3]
+j[2] = clobber(j)
+? j
+
+rem maps
+m = {}
+m.x = 1
+m.list = [1, 2]
+n = m
+n.x = 2
+n.list[0] = 10
+n.y = 3
+? m.x, m.list, m.y, n.x, n.list, n.y
+
+func Counter()
+  sub inc()
+    self.count = self.count + 1
+  end
+  local result = {}
+  result.count = 0
+  result.inc = @inc
+  Counter = result
+end
+p = Counter()
+q = p
+q.inc()
+q.inc()
+? p.count, q.count
+
+rem read access does not copy
+r = [[1, 2], [3, 4]]
+s = r
+? s[1][0] + r[0][1]
+s[1][0] = 7
+? r, s
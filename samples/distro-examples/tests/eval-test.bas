@@ -370,6 +370,22 @@ moves_called = false
 for i in s.moves()
 next i  
 
+rem constant expressions are folded by the compiler
+if (2 * 3 + 1 != 7 or 2 * 3.5 != 7 or 7 \ 2 != 3 or -7 mod 3 != -1) then throw "fold arithmetic"
+if (2 ^ 10 != 1024 or -(2) != -2 or (5 xor 3) != 6 or (6 band 3) != 2) then throw "fold operators"
+if ("a" + "b" + "c" != "abc" or ("b" > "a") != 1 or (1 < 2) != 1) then throw "fold string"
+div_err = false
+try
+  ff = 1 / 0
+catch e
+  div_err = true
+end try
+if (!div_err) then throw "fold division by zero"
+ff = 1: ff = ff + 1: ff = ff - 0.5
+if (ff != 1.5) then throw "let increment"
+ff = "3"
+if (ff * 2 != 6 or 2 * ff != 6 or ff ^ 2 != 9) then throw "numeric string operands"
+
 gg = 99
 gosub plus1
 if (gg != 100) then throw "err"
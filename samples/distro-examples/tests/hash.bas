@@ -80,3 +80,34 @@ if (a.stringT <> "true") then throw "not true"
 if (a.stringF <> "false") then throw "not false"
 if (a.booleanT <> 1) then throw "not true"
 if (a.booleanF <> 0) then throw "not false"
+
+'
+' str() of a map parses back to the same map, both from a string and from a file
+'
+m = {"name":"fred", "list":[1,2,"x"], "child":{"n":-3, "r":1.5}}
+a = array(str(m))
+if (str(a) <> str(m)) then throw "str/array round trip"
+s = str(m)
+tsave "tjson.txt", s
+tload "tjson.txt", b, 2
+if (str(b) <> str(m)) then throw "tload json"
+if (b.child.r <> 1.5 or b.list[2] <> "x") then throw "tload json fields"
+open "tjson.txt" for input as #1
+tload #1, b, 2
+close #1
+if (str(b) <> str(m)) then throw "tload #1 json"
+kill "tjson.txt"
+
+'
+' text after the top-level object or array is an error
+'
+for s in ["{" + chr(34) + "a" + chr(34) + ":1}{" + chr(34) + "b" + chr(34) + ":2}", "[1,2] x"]
+  try
+    a = array(s)
+    throw "no error for " + s
+  catch e
+    if (instr(e, "JSON decode error") == 0) then throw e
+  end try
+next
+a = array("{" + chr(34) + "a" + chr(34) + ":1}  ")
+if (a.a <> 1) then throw "trailing space"
@@ -159,3 +159,59 @@ local blah,
 local z,
 blah=1
 z=blah
+
+'
+' locals and parameters held in the call frame
+'
+func local_in_loop(n)
+  local i, total
+  for i = 1 to n
+    local x
+    if x != 0 then throw "local not reset: " + x
+    x = i
+    total += x
+  next
+  local_in_loop = total
+end
+x = "outer"
+if local_in_loop(3) != 6 then throw "local_in_loop"
+if x != "outer" then throw "local not restored: " + x
+
+func depth(n, s)
+  local t
+  t = s + n
+  if n > 0 then
+    if depth(n - 1, t) != 0 then throw "depth"
+  endif
+  if t != s + n then throw "local changed by recursion"
+  depth = 0
+end
+n = 100: s = 5
+if depth(250, 0) != 0 then throw "depth"
+if n != 100 or s != 5 then throw "params not restored"
+
+sub shadow(byref v, w)
+  v = v + w
+  local v
+  v = "hidden"
+end
+r = 1
+shadow r, 2
+if r != 3 then throw "shadow: " + r
+
+sub fails(byref v, w)
+  local x
+  x = "inner"
+  v = w
+  throw "fails"
+end
+x = "outer"
+r = 1
+try
+  fails r, 2
+catch e
+end try
+if x != "outer" then throw "not restored after throw: " + x
+if r != 2 then throw "byref after throw: " + r
+shadow r, 2
+if r != 4 then throw "after throw: " + r
@@ -0,0 +1,68 @@
+rem
+rem SORT and SEARCH
+rem
+
+a = [5, -3, 9, 0, -3, 1000000000000, -1000000000000, 7]
+sort a
+? a
+
+b = [2.5, -1.25, 0, 3.75, -0.5, 1e10, -1e-10]
+sort b
+? b
+
+c = ["pear", "apple", "Banana", "cherry", ""]
+sort c
+? c
+
+rem mixed types use the general comparison
+d = [3, "2", 1.5, "abc", 0]
+sort d
+? d
+
+rem USE comparators, equal elements keep their order
+func bylen(x, y)
+  bylen = len(x) - len(y)
+end
+e = ["ccc", "a", "bb", "b", "aaa", "c"]
+sort e use bylen(x, y)
+? e
+
+f = [[2, "b"], [1, "a"], [2, "a"], [1, "b"]]
+sort f use x[0] - y[0]
+? f
+
+x = "unchanged"
+y = 42
+g = [3, 1, 2]
+sort g use y - x
+? g, x, y
+
+rem large integer arrays
+dim h(10000)
+for i = 0 to 10000
+  h[i] = (i * 7919) mod 10007
+next
+sort h
+ok = 1
+for i = 1 to 10000
+  if h[i - 1] > h[i] then ok = 0
+next
+? ok
+
+rem SEARCH
+search a, 9, idx
+? idx
+search a, 42, idx
+? idx
+search a, -3, idx, 1
+? idx
+search a, 1000000000000, idx, 1
+? idx
+search a, 8, idx, 1
+? idx
+search c, "cherry", idx, 1
+? idx
+search e, "bb", idx, 1 use len(x) - len(y)
+? idx
+search h, 5000, idx, 1
+? idx, h[idx]
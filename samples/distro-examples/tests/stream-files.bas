@@ -65,3 +65,20 @@ input #2; v[0], "|", v[1], "|", v[2], "|", v[3], "|", &
           v[12],"|", v[13],"|", v[14],"|", v[15],"|"
 close #2
 if v != [1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16] then throw "invalid input"
+
+' TLOAD splits lines on LF and drops CR
+open "./output.dat" for output as #2
+print #2, "one" + chr(13) + chr(10) + "two" + chr(10) + chr(10) + "three";
+close #2
+tload "./output.dat", v
+if v != ["one", "two", "", "three"] then throw "invalid tload lines"
+tload "./output.dat", v, 3
+if v != [0, 5, 9, 10] then throw "invalid tload offsets"
+open "./output.dat" for input as #2
+seek #2, v[3]
+lineinput #2, s
+if s != "three" then throw "invalid tload offset seek"
+lineinput #2, s
+tload #2, v
+close #2
+if len(v) != 0 then throw "invalid tload at eof"
@@ -215,3 +215,41 @@ REM Bug: RTRIM trimed input string on the right side
 s1 = "   test   "
 s2 = rtrim(s1)
 if(s1 != "   test   ") then throw "err: RTRIM changed input string"
+
+REM appending in place
+s1 = "ab"
+s1 = s1 + "c"
+s1 += "d"
+s1 = s1 + s1
+if (s1 != "abcdabcd") then throw "err: append " + s1
+s2 = s1
+s1 = s1 + 1
+if (s1 != "abcdabcd1" or s2 != "abcdabcd") then throw "err: append copy " + s2
+s1 = "1"
+s1 = s1 + 2
+if (s1 != 3) then throw "err: append numeric string " + s1
+s1 = ""
+for i = 1 to 1000
+  s1 = s1 + chr(48 + i % 10)
+next
+if (len(s1) != 1000 or mid(s1, 991) != "1234567890") then throw "err: append loop"
+a1 = [1, 2]
+a1 = a1 + [3, 4]
+if (a1 != [4, 6]) then throw "err: append array"
+
+REM appending the result of a call which modifies the string
+func modify_s1()
+  s1 = "changed"
+  return "!"
+end
+m1 = {}
+m1.f = @modify_s1
+s1 = "orig"
+s1 = s1 + m1.f()
+if (s1 != "orig!") then throw "err: append method " + s1
+s1 = "orig"
+s1 += m1.f()
+if (s1 != "orig!") then throw "err: append += method " + s1
+s1 = "orig"
+s1 = s1 + modify_s1()
+if (s1 != "orig!") then throw "err: append func " + s1
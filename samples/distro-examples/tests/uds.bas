@@ -165,3 +165,30 @@ func Game()
 end
 g = Game()
 g.start()
+
+'
+' fields resolved through the same statement for different maps
+'
+func pt(x, y)
+  local r = {}
+  r.x = x
+  r.y = y
+  return r
+end
+pts = [pt(1, 2), pt(3, 4), {"y": 6, "x": 5}]
+total = 0
+for p in pts
+  total += p.x * 10 + p.y
+next
+if total != 12 + 34 + 56 then throw "total " + total
+p1 = pt(7, 8)
+p2 = p1
+for i = 1 to 3
+  p2.x = p2.x + 1
+next
+if p1.x != 7 or p2.x != 10 then throw str(p1) + str(p2)
+for i = 1 to 3
+  p1.z = i
+  if p1.z != i then throw str(p1)
+  p1 = pt(i, i)
+next
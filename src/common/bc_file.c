@@ -0,0 +1,422 @@
+// This file is part of SmallBASIC
+//
+// compiled bytecode files (.sbx/.sbu) and the compile cache
+//
+// Bytecode files are mapped read-only where supported, so the program is
+// executed in place and the pages are shared between processes running the
+// same file. Files are replaced by renaming a new file over the old one,
+// never rewritten, so a running program keeps its mapping.
+//
+// The cache directory (opt_cachepath) is shared by all programs. The
+// entry for a program is found in two steps: a hash of the source file,
+// its path and the compile options names a .dep file listing the units
+// and include files used by the source. Adding the contents of those
+// files to the hash gives the name of the .sbx file. Entries are touched
+// when found, and the least recently used are removed once the directory
+// holds more than BC_CACHE_FILES of them.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith
+
+#include "config.h"
+
+#include "common/sys.h"
+#include "common/smbas.h"
+#include "common/units.h"
+#include "common/bc_file.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#if defined(_UnixOS)
+#include <sys/mman.h>
+#include <utime.h>
+#endif
+
+#if defined(CPU_BIGENDIAN)
+#define BC_FILE_ENDIAN 1
+#else
+#define BC_FILE_ENDIAN 0
+#endif
+
+// FNV-1a
+#define BC_HASH_INIT  0xcbf29ce484222325ULL
+#define BC_HASH_PRIME 0x100000001b3ULL
+#define BC_HASH_BLOCK 65536
+
+// the .sbx and .dep files kept in the cache directory
+#define BC_CACHE_FILES 512
+
+typedef struct {
+  char *name;
+  time_t time;
+} bc_cache_file_t;
+
+static SB_TLS uint64_t cache_key;
+static SB_TLS char cache_source[OS_PATHNAME_SIZE + 1];
+static SB_TLS char **cache_deps;
+static SB_TLS int cache_dep_count;
+static SB_TLS int cache_recording;
+
+static uint64_t bc_hash(uint64_t hash, const void *data, size_t size) {
+  const byte *p = (const byte *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= BC_HASH_PRIME;
+  }
+  return hash;
+}
+
+static uint64_t bc_hash_str(uint64_t hash, const char *s) {
+  return bc_hash(hash, s, strlen(s) + 1);
+}
+
+// adds the contents of the file and its length, or -1 when not found
+static uint64_t bc_hash_file(uint64_t hash, const char *file) {
+  int64_t length = -1;
+  int h = open(file, O_RDONLY | O_BINARY);
+  if (h != -1) {
+    byte *buffer = malloc(BC_HASH_BLOCK);
+    if (buffer) {
+      int n;
+      length = 0;
+      while ((n = read(h, buffer, BC_HASH_BLOCK)) > 0) {
+        hash = bc_hash(hash, buffer, n);
+        length += n;
+      }
+      free(buffer);
+    }
+    close(h);
+  }
+  return bc_hash(hash, &length, sizeof(length));
+}
+
+static void bc_file_fullpath(const char *file, char *path) {
+#if defined(_UnixOS)
+  char buffer[PATH_MAX + 1];
+  if (realpath(file, buffer) != NULL) {
+    strlcpy(path, buffer, OS_PATHNAME_SIZE);
+  } else {
+    strlcpy(path, file, OS_PATHNAME_SIZE);
+  }
+#else
+  strlcpy(path, file, OS_PATHNAME_SIZE);
+#endif
+}
+
+static void bc_file_cache_name(char *file, uint64_t key, const char *ext) {
+  char name[32];
+  snprintf(name, sizeof(name), "%c%016llx%s", OS_DIRSEP, (unsigned long long)key, ext);
+  strlcpy(file, opt_cachepath, OS_PATHNAME_SIZE);
+  strlcat(file, name, OS_PATHNAME_SIZE);
+}
+
+// the number of bytes written by comp_save_bin()
+static uint32_t bc_file_size(const byte *bc) {
+  bc_head_t hdr;
+  memcpy(&hdr, bc, sizeof(bc_head_t));
+  return hdr.size + 4;
+}
+
+int bc_file_valid(const byte *bc, uint32_t size) {
+  uint64_t offset = 0;
+  bc_head_t hdr;
+
+  if (size >= sizeof(unit_file_t) && memcmp(bc, "SBUn", 4) == 0) {
+    unit_file_t uft;
+    memcpy(&uft, bc, sizeof(unit_file_t));
+    if (uft.version != SB_DWORD_VER || uft.sym_count < 0) {
+      return 0;
+    }
+    offset = sizeof(unit_file_t) + (uint64_t)uft.sym_count * sizeof(unit_sym_t);
+  }
+  if (offset + sizeof(bc_head_t) > size) {
+    return 0;
+  }
+  memcpy(&hdr, bc + offset, sizeof(bc_head_t));
+
+  // the tables and the code must fit within the file
+  uint64_t end = offset + sizeof(bc_head_t) +
+                 (uint64_t)hdr.lab_count * ADDRSZ +
+                 (uint64_t)hdr.lib_count * sizeof(bc_lib_rec_t) +
+                 (uint64_t)hdr.sym_count * sizeof(bc_symbol_rec_t) +
+                 hdr.bc_count;
+
+  return (memcmp(hdr.sign, "SBEx", 4) == 0 &&
+          hdr.ver == SB_BC_VER &&
+          hdr.sbver == SB_DWORD_VER &&
+          (hdr.flags & 1) == BC_FILE_ENDIAN &&
+          hdr.size <= size &&
+          end <= size);
+}
+
+byte *bc_file_load(const char *file, uint32_t *mapped) {
+  byte *result = NULL;
+  struct stat st;
+
+  *mapped = 0;
+  int h = open(file, O_RDONLY | O_BINARY);
+  if (h != -1) {
+    if (fstat(h, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size < UINT32_MAX) {
+      uint32_t size = st.st_size;
+#if defined(_UnixOS)
+      void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, h, 0);
+      if (map != MAP_FAILED) {
+        madvise(map, size, MADV_WILLNEED);
+        result = (byte *)map;
+        *mapped = size;
+      }
+#endif
+      if (result == NULL) {
+        result = malloc(size + 4);
+        if (result && read(h, result, size) != (int)size) {
+          free(result);
+          result = NULL;
+        }
+      }
+      if (result != NULL && !bc_file_valid(result, size)) {
+        bc_file_unload(result, *mapped);
+        result = NULL;
+        *mapped = 0;
+      }
+    }
+    close(h);
+  }
+  return result;
+}
+
+void bc_file_unload(byte *bc, uint32_t mapped) {
+#if defined(_UnixOS)
+  if (mapped) {
+    munmap(bc, mapped);
+    return;
+  }
+#endif
+  free(bc);
+}
+
+int bc_file_check(const char *file) {
+  uint32_t mapped;
+  byte *bc = bc_file_load(file, &mapped);
+  if (bc != NULL) {
+    bc_file_unload(bc, mapped);
+  }
+  return bc != NULL;
+}
+
+// creates the file written before it is renamed over the given file. the
+// name is unique to the writer, since threads of the web server may save
+// the same file at the same time
+static int bc_file_create_tmp(const char *file, char *tmp, size_t size) {
+#if defined(_UnixOS)
+  snprintf(tmp, size, "%s.XXXXXX", file);
+  int h = mkstemp(tmp);
+  if (h != -1) {
+    fchmod(h, 0660);
+  }
+  return h;
+#else
+  snprintf(tmp, size, "%s.tmp", file);
+  return open(tmp, O_BINARY | O_RDWR | O_TRUNC | O_CREAT, 0660);
+#endif
+}
+
+int bc_file_save(const char *file, const byte *bc, uint32_t size) {
+  char tmp[OS_PATHNAME_SIZE + 1];
+  int result = 0;
+
+  int h = bc_file_create_tmp(file, tmp, sizeof(tmp));
+  if (h != -1) {
+    result = (write(h, bc, size) == (int)size);
+    close(h);
+#if defined(_Win32)
+    remove(file);
+#endif
+    if (!result || rename(tmp, file) != 0) {
+      remove(tmp);
+      result = 0;
+    }
+  }
+  return result;
+}
+
+// whether the name is a key followed by an extension, including the
+// temporary files left by bc_file_save()
+static int bc_file_cache_entry(const char *name) {
+  int i = 0;
+  while (i < 16 && isxdigit((unsigned char)name[i])) {
+    i++;
+  }
+  return i == 16 && name[i] == '.';
+}
+
+static int bc_file_cache_cmp(const void *a, const void *b) {
+  time_t ta = ((const bc_cache_file_t *)a)->time;
+  time_t tb = ((const bc_cache_file_t *)b)->time;
+  return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+// once there are more than BC_CACHE_FILES entries, removes the least
+// recently used until a quarter of the space is free
+static void bc_file_cache_prune() {
+  DIR *dp = opendir(opt_cachepath);
+  if (dp == NULL) {
+    return;
+  }
+  bc_cache_file_t *files = NULL;
+  int count = 0;
+  int size = 0;
+  char sep[] = { OS_DIRSEP, '\0' };
+  struct dirent *e;
+  while ((e = readdir(dp)) != NULL) {
+    char path[OS_PATHNAME_SIZE + 1];
+    struct stat st;
+    if (!bc_file_cache_entry(e->d_name)) {
+      continue;
+    }
+    strlcpy(path, opt_cachepath, sizeof(path));
+    strlcat(path, sep, sizeof(path));
+    strlcat(path, e->d_name, sizeof(path));
+    if (stat(path, &st) != 0) {
+      continue;
+    }
+    if (count == size) {
+      size += 64;
+      files = realloc(files, sizeof(bc_cache_file_t) * size);
+    }
+    files[count].name = strdup(path);
+    files[count].time = st.st_mtime;
+    count++;
+  }
+  closedir(dp);
+
+  if (count > BC_CACHE_FILES) {
+    qsort(files, count, sizeof(bc_cache_file_t), bc_file_cache_cmp);
+    for (int i = 0; i < count - BC_CACHE_FILES * 3 / 4; i++) {
+      remove(files[i].name);
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    free(files[i].name);
+  }
+  free(files);
+}
+
+int bc_file_cache_find(const char *source, char *file) {
+  byte options[] = {
+    opt_optimise, opt_autolocal, opt_profile, sizeof(bcip_t)
+  };
+  uint32_t version[] = { SB_DWORD_VER, SB_BC_VER };
+  const char *sbasicpath = getenv("SBASICPATH");
+  int found = 0;
+
+  bc_file_cache_begin(source);
+  uint64_t key = bc_hash(BC_HASH_INIT, version, sizeof(version));
+  key = bc_hash(key, options, sizeof(options));
+  key = bc_hash_str(key, sbasicpath ? sbasicpath : "");
+  key = bc_hash_str(key, cache_source);
+  key = bc_hash_file(key, cache_source);
+  cache_key = key;
+
+  bc_file_cache_name(file, key, ".dep");
+  FILE *fp = fopen(file, "r");
+  if (fp != NULL) {
+    char dep[OS_PATHNAME_SIZE + 1];
+    while (fgets(dep, sizeof(dep), fp) != NULL) {
+      dep[strcspn(dep, "\r\n")] = '\0';
+      key = bc_hash_str(key, dep);
+      key = bc_hash_file(key, dep);
+    }
+    fclose(fp);
+    bc_file_cache_name(file, key, ".sbx");
+    found = bc_file_check(file);
+  }
+  if (found) {
+    cache_recording = 0;
+#if defined(_UnixOS)
+    // mark the entry as used for bc_file_cache_prune()
+    char dep_file[OS_PATHNAME_SIZE + 1];
+    bc_file_cache_name(dep_file, cache_key, ".dep");
+    utime(dep_file, NULL);
+    utime(file, NULL);
+#endif
+  }
+  return found;
+}
+
+void bc_file_cache_begin(const char *source) {
+  bc_file_cache_end();
+  bc_file_fullpath(source, cache_source);
+  cache_recording = 1;
+}
+
+const char **bc_file_cache_deps(int *count) {
+  *count = cache_dep_count;
+  return (const char **)cache_deps;
+}
+
+void bc_file_cache_dep(const char *file) {
+  if (cache_recording) {
+    char path[OS_PATHNAME_SIZE + 1];
+    bc_file_fullpath(file, path);
+    if (strcmp(path, cache_source) == 0) {
+      return;
+    }
+    for (int i = 0; i < cache_dep_count; i++) {
+      if (strcmp(path, cache_deps[i]) == 0) {
+        return;
+      }
+    }
+    cache_deps = realloc(cache_deps, sizeof(char *) * (cache_dep_count + 1));
+    cache_deps[cache_dep_count++] = strdup(path);
+  }
+}
+
+int bc_file_cache_save(const byte *bc, char *file) {
+  int result = 0;
+  if (cache_recording) {
+    uint64_t key = cache_key;
+    size_t length = 0;
+
+#if defined(_Win32) || defined(__MINGW32__)
+    mkdir(opt_cachepath);
+#else
+    mkdir(opt_cachepath, 0777);
+#endif
+    bc_file_cache_prune();
+    for (int i = 0; i < cache_dep_count; i++) {
+      key = bc_hash_str(key, cache_deps[i]);
+      key = bc_hash_file(key, cache_deps[i]);
+      length += strlen(cache_deps[i]) + 1;
+    }
+
+    // the program first, so a new .dep file always finds its .sbx
+    bc_file_cache_name(file, key, ".sbx");
+    result = bc_file_save(file, bc, bc_file_size(bc));
+    if (result) {
+      char *text = malloc(length + 1);
+      char dep_file[OS_PATHNAME_SIZE + 1];
+      text[0] = '\0';
+      for (int i = 0; i < cache_dep_count; i++) {
+        strcat(text, cache_deps[i]);
+        strcat(text, "\n");
+      }
+      bc_file_cache_name(dep_file, cache_key, ".dep");
+      result = bc_file_save(dep_file, (const byte *)text, length);
+      free(text);
+    }
+  }
+  return result;
+}
+
+void bc_file_cache_end() {
+  for (int i = 0; i < cache_dep_count; i++) {
+    free(cache_deps[i]);
+  }
+  free(cache_deps);
+  cache_deps = NULL;
+  cache_dep_count = 0;
+  cache_recording = 0;
+}
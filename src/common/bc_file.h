@@ -0,0 +1,130 @@
+// This file is part of SmallBASIC
+//
+// compiled bytecode files (.sbx/.sbu) and the compile cache
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith
+
+#if !defined(_sb_bc_file_h)
+#define _sb_bc_file_h
+
+#include "common/sys.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @ingroup exec
+ *
+ * loads the bytecode file, mapped read-only where supported, otherwise
+ * read into memory. returns NULL when the file cannot be read or was not
+ * created by this version. mapped receives the size of the mapping, or 0
+ *
+ * @param file the .sbx or .sbu file
+ * @param mapped receives the mapping size
+ * @return the bytecode
+ */
+byte *bc_file_load(const char *file, uint32_t *mapped);
+
+/**
+ * @ingroup exec
+ *
+ * releases bytecode returned from bc_file_load()
+ */
+void bc_file_unload(byte *bc, uint32_t mapped);
+
+/**
+ * @ingroup exec
+ *
+ * returns whether the bytecode has valid headers and tables for this version
+ *
+ * @param bc the bytecode
+ * @param size the number of bytes available
+ * @return non-zero when valid
+ */
+int bc_file_valid(const byte *bc, uint32_t size);
+
+/**
+ * @ingroup exec
+ *
+ * returns whether the file holds valid bytecode for this version
+ */
+int bc_file_check(const char *file);
+
+/**
+ * @ingroup exec
+ *
+ * writes the bytecode to a temporary file that then replaces the given
+ * file, so that programs that have mapped the old file are not affected
+ *
+ * @return non-zero on success
+ */
+int bc_file_save(const char *file, const byte *bc, uint32_t size);
+
+/**
+ * @ingroup exec
+ *
+ * looks up the compiled program in the cache directory opt_cachepath.
+ * entries are keyed by a hash of the source, the compile options and the
+ * contents of the units and include files used by the source. when not
+ * found, the files loaded until bc_file_cache_end() are recorded as the
+ * dependencies of the entry
+ *
+ * @param source the .bas file
+ * @param file receives the cached .sbx file
+ * @return non-zero when found
+ */
+int bc_file_cache_find(const char *source, char *file);
+
+/**
+ * @ingroup exec
+ *
+ * starts recording the units and include files loaded while compiling
+ * the source, without using the cache directory
+ */
+void bc_file_cache_begin(const char *source);
+
+/**
+ * @ingroup exec
+ *
+ * returns the files recorded since bc_file_cache_begin()
+ *
+ * @param count receives the number of files
+ * @return the full path of each file
+ */
+const char **bc_file_cache_deps(int *count);
+
+/**
+ * @ingroup exec
+ *
+ * records a unit or include file loaded while compiling
+ */
+void bc_file_cache_dep(const char *file);
+
+/**
+ * @ingroup exec
+ *
+ * stores the program just compiled after bc_file_cache_find(). when the
+ * cache is full the least recently used entries are removed first
+ *
+ * @param bc the bytecode
+ * @param file receives the cached .sbx file
+ * @return non-zero on success
+ */
+int bc_file_cache_save(const byte *bc, char *file);
+
+/**
+ * @ingroup exec
+ *
+ * stops recording dependencies
+ */
+void bc_file_cache_end(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
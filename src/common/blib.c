@@ -12,6 +12,7 @@
 #include "common/fmt.h"
 #include "common/keymap.h"
 #include "common/messages.h"
+#include "common/profile.h"
 
 #define STR_INIT_SIZE 256
 #define PKG_INIT_SIZE 5
@@ -21,27 +22,48 @@
  * CONST v[(x)] = any
  */
 void cmd_let(int is_const) {
-  var_t *v_left = code_getvarptr();
+  bcip_t left_ip = prog_ip;
+  int mode = is_const ? 1 : FOR_WRITE_PACKED;
+  var_t *v_left = code_getvarptr_mode(0, mode);
   if (!prog_error) {
     if (v_left->const_flag) {
       err_const();
     } else {
+      // the element of a packed array is assigned by position
+      var_t *v_array = NULL;
+      uint32_t v_index = 0;
+      code_packed_ref(v_left, &v_array, &v_index);
       if (prog_source[prog_ip] == kwTYPE_CMPOPR &&
           prog_source[prog_ip + 1] == '=') {
         code_skipopr();
       }
+      uint32_t epoch = v_data_epoch;
       var_t v_right;
       v_init(&v_right);
       eval(&v_right);
-      v_move(v_left, &v_right);
-      v_left->const_flag = is_const;
+      if (epoch != v_data_epoch && !prog_error) {
+        // the expression moved array or map data, so resolve v_left again
+        bcip_t right_ip = prog_ip;
+        prog_ip = left_ip;
+        v_left = code_getvarptr_mode(0, mode);
+        prog_ip = right_ip;
+        if (!code_packed_ref(v_left, &v_array, &v_index)) {
+          v_array = NULL;
+        }
+      }
+      if (v_array != NULL) {
+        v_elem_move(v_array, v_index, &v_right);
+      } else {
+        v_move(v_left, &v_right);
+        v_left->const_flag = is_const;
+      }
       // no free after v_move
     }
   }
 }
 
 void cmd_let_opt() {
-  var_t *v_left = code_getvarptr();
+  var_t *v_left = code_getvarptr_mode(0, FOR_WRITE_PACKED);
   if (!prog_error) {
     // skip kwTYPE_CMPOPR + "="
     code_skipopr();
@@ -49,8 +71,109 @@ void cmd_let_opt() {
     // skip kwTYPE_VAR
     code_skipnext();
 
-    v_set(v_left, tvar[code_getaddr()]);
-    v_left->const_flag = 0;
+    var_t *v_array;
+    uint32_t v_index;
+    if (code_packed_ref(v_left, &v_array, &v_index)) {
+      var_t v_right;
+      v_init(&v_right);
+      v_set(&v_right, tvar[code_getaddr()]);
+      v_elem_move(v_array, v_index, &v_right);
+    } else {
+      v_set(v_left, tvar[code_getaddr()]);
+      v_left->const_flag = 0;
+    }
+  }
+}
+
+// s = s + expr, where the compiler has replaced the EVPOP ahead of the
+// final '+' with kwTYPE_EOC so that expr can be evaluated by itself
+void cmd_let_append() {
+  bcip_t left_ip = prog_ip;
+  var_t *v_left = code_getvarptr();
+  if (!prog_error) {
+    if (v_left->const_flag) {
+      err_const();
+      return;
+    }
+    // skip kwTYPE_CMPOPR + "=", kwTYPE_VAR and kwTYPE_EVPUSH
+    code_skipopr();
+    code_skipnext();
+    code_getaddr();
+    code_skipnext();
+
+    uint32_t epoch = v_data_epoch;
+    var_t v_right;
+    v_init(&v_right);
+    eval(&v_right);
+
+    // skip kwTYPE_EOC + kwTYPE_ADDOPR + "+"
+    prog_ip += 3;
+    if (!prog_error) {
+      if (epoch != v_data_epoch) {
+        bcip_t right_ip = prog_ip;
+        prog_ip = left_ip;
+        v_left = code_getvarptr();
+        prog_ip = right_ip;
+      }
+      if (v_left->type == V_STR && v_right.type == V_STR) {
+        v_strcatn(v_left, v_right.v.p.ptr, v_strlen(&v_right));
+        v_free(&v_right);
+      } else {
+        eval_add_var(&v_right, v_left, '+');
+        if (!prog_error) {
+          v_move(v_left, &v_right);
+        } else {
+          v_free(&v_right);
+        }
+      }
+      v_left->const_flag = 0;
+    } else {
+      v_free(&v_right);
+    }
+  }
+}
+
+// v = v + n or v = v - n, where n is a numeric literal. the compiler has
+// replaced kwLET, the code is otherwise unchanged
+void cmd_let_inc() {
+  var_t *v_left = code_getvarptr();
+  if (!prog_error) {
+    if (v_left->const_flag) {
+      err_const();
+      return;
+    }
+    // skip kwTYPE_CMPOPR + "=", kwTYPE_VAR and kwTYPE_EVPUSH
+    code_skipopr();
+    code_skipnext();
+    code_getaddr();
+    code_skipnext();
+
+    var_t v_right;
+    if (code_getnext() == kwTYPE_INT) {
+      v_right.type = V_INT;
+      v_right.v.i = code_getint();
+    } else {
+      v_right.type = V_NUM;
+      v_right.v.n = code_getreal();
+    }
+
+    // skip kwTYPE_EVPOP + kwTYPE_ADDOPR
+    code_skipnext16();
+    byte op = code_getnext();
+
+    if (v_left->type == V_INT && v_right.type == V_INT) {
+      v_left->v.i = op == '+' ? v_left->v.i + v_right.v.i : v_left->v.i - v_right.v.i;
+    } else if (v_left->type == V_NUM) {
+      var_num_t n = v_right.type == V_INT ? v_right.v.i : v_right.v.n;
+      v_left->v.n = op == '+' ? v_left->v.n + n : v_left->v.n - n;
+    } else {
+      eval_add_var(&v_right, v_left, op);
+      if (!prog_error) {
+        v_move(v_left, &v_right);
+      } else {
+        v_free(&v_right);
+      }
+    }
   }
 }
 
@@ -87,7 +210,7 @@ void cmd_packed_let() {
     v_init(&v_right_eval);
     if (code_isvar()) {
       // avoid memory allocation
-      v_right = code_getvarptr();
+      v_right = code_getvarptr_read();
     } else {
       eval(&v_right_eval);
       v_right = &v_right_eval;
@@ -101,7 +224,8 @@ void cmd_packed_let() {
           v_set(vars[0], v_right);
         } else {
           for (int i = 0; i < count; i++) {
-            v_set(vars[i], v_elem(v_right, i));
+            var_t tmp;
+            v_set(vars[i], v_elem_read(v_right, i, &tmp));
           }
         }
       } else if (arrayCount > count) {
@@ -172,7 +296,7 @@ uint8_t get_dimensions(int32_t **lbound, int32_t **ubound) {
 }
 
 /**
- *  DIM var([lower TO] uppper [, ...])
+ *  DIM var([lower TO] uppper [, ...]) [AS INTEGER|REAL]
  */
 void cmd_dim(int preserve) {
   do {
@@ -196,6 +320,24 @@ void cmd_dim(int preserve) {
     int32_t *lbound = NULL;
     int32_t *ubound = NULL;
     uint8_t dimensions = get_dimensions(&lbound, &ubound);
+
+    // the elements are zero, so the array starts as packed integers
+    int packed = V_PACK_INT;
+    if (!prog_error && code_peek() == kwAS) {
+      // DIM a(n) AS INTEGER|REAL
+      code_skipnext();
+      switch (par_getint()) {
+      case V_INT:
+        packed = V_PACK_INT | V_PACK_TYPED;
+        break;
+      case V_NUM:
+        packed = V_PACK_NUM | V_PACK_TYPED;
+        break;
+      default:
+        err_typemismatch();
+        break;
+      }
+    }
     if (!prog_error) {
       if (!preserve || var_p->type != V_ARRAY) {
         v_free(var_p);
@@ -209,7 +351,7 @@ void cmd_dim(int preserve) {
         size = size * (ABS(ubound[i] - lbound[i]) + 1);
       }
       if (!preserve || var_p->type != V_ARRAY) {
-        v_new_array(var_p, size);
+        v_new_packed(var_p, size, packed);
       } else {
         // preserve previous array contents
         v_resize_array(var_p, size);
@@ -261,14 +403,25 @@ void cmd_append() {
     if (var_p->type != V_ARRAY) {
       v_toarray1(var_p, 1);
       elem_p = v_elem(var_p, 0);
+    } else if (v_packed(var_p)) {
+      elem_p = NULL;
     } else {
       v_resize_array(var_p, v_asize(var_p) + 1);
       elem_p = v_elem(var_p, v_asize(var_p) - 1);
     }
 
     // set the value onto the element
-    v_init(elem_p);
-    eval(elem_p);
+    if (elem_p != NULL) {
+      v_init_elem(elem_p);
+      eval(elem_p);
+    } else {
+      // the packed storage is kept when the value has the same type
+      var_t value;
+      v_init(&value);
+      eval(&value);
+      v_resize_array(var_p, v_asize(var_p) + 1);
+      v_elem_move(var_p, v_asize(var_p) - 1, &value);
+    }
 
     // next parameter
     if (code_peek() != kwTYPE_SEP) {
@@ -298,6 +451,8 @@ void cmd_lins() {
   // convert to array
   if (var_p->type != V_ARRAY) {
     v_toarray1(var_p, 0);
+  } else {
+    v_unpack(var_p);
   }
 
   // get 'index'
@@ -416,35 +571,20 @@ void cmd_ldel() {
     return;
   }
 
-  if (idx + count == size) {
-    // pop elements from a stack
-    v_resize_array(var_p, size - count);
-  } else if (idx == 0) {
-    // pop element from a queue
-    // for better performance create a queue in the language
-    for (int i = 0; i < size - count; i++) {
-      v_set(v_elem(var_p, i), v_elem(var_p, i + count));
-    }
-    v_resize_array(var_p, size - count);
-  } else {
-    var_t *arg_p = v_clone(var_p);
-    v_resize_array(var_p, size - count);
-
-    // first part
-    for (int i = 0; i < idx; i++) {
-      // A(i) = OLD(i)
-      v_set(v_elem(var_p, i), v_elem(arg_p, i));
-    }
-    // second part
-    for (int i = idx + count, j = idx; i < size; i++, j++) {
-      // A(j) = OLD(i)
-      v_set(v_elem(var_p, j), v_elem(arg_p, i));
+  v_unshare(var_p);
+  if (v_packed(var_p)) {
+    uint32_t elem_size = v_elem_size(var_p);
+    uint8_t *data = (uint8_t *)v_data(var_p);
+    memmove(data + idx * elem_size, data + (idx + count) * elem_size, (size - idx - count) * elem_size);
+  } else if (idx + count < size) {
+    // close the gap by moving the following elements down
+    for (int i = idx; i + count < size; i++) {
+      var_t *elem_p = v_elem(var_p, i + count);
+      v_move(v_elem(var_p, i), elem_p);
+      v_init_elem(elem_p);
     }
-
-    // cleanup
-    v_free(arg_p);
-    v_detach(arg_p);
   }
+  v_resize_array(var_p, size - count);
 }
 
 /**
@@ -468,7 +608,6 @@ void cmd_erase() {
       v_toarray1(var_p, 0);
     } else {
       v_free(var_p);
-      v_init(var_p);
     }
 
     // next
@@ -1030,6 +1169,10 @@ bcip_t cmd_push_args(int cmd, bcip_t goto_addr, bcip_t rvid) {
   vcall->x.vcall.ret_ip = prog_ip;   // where to go after exit (caller's next address)
   vcall->x.vcall.rvid = rvid;        // return-variable ID
   vcall->x.vcall.task_id = -1;
+  code_push_frame(vcall);            // the locals of the call start here
+  if (opt_profile) {
+    prof_enter_udp(cmd == kwPROC ? PROF_PROC : PROF_FUNC, goto_addr, prog_stack_count - 1 - pcount);
+  }
 
   if (rvid != INVALID_ADDR) {
     // if we call a function
@@ -1136,6 +1279,11 @@ void cmd_call_unit_udp(int cmd, int udp_tid, bcip_t goto_addr, bcip_t rvid) {
   vcall->x.vcall.ret_ip = prog_ip;   // where to go after exit (caller's next address)
   vcall->x.vcall.rvid = rvid;        // return-variable ID
   vcall->x.vcall.task_id = my_tid;
+  code_push_frame(vcall);
+  if (opt_profile) {
+    prof_enter_udp(cmd == kwPROC ? PROF_PROC : PROF_FUNC, goto_addr + ADDRSZ + 3,
+                   prog_stack_count - 1 - pcount);
+  }
 
   if (rvid != INVALID_ADDR) {            // if we call a function
     vcall->x.vcall.retvar = tvar[rvid];  // store previous data of RVID
@@ -1153,17 +1301,9 @@ void cmd_crvar() {
   // number of variables to create
   int count = code_getnext();
   for (int i = 0; i < count; i++) {
-    // an ID on global-variable-table is used
-    bcip_t vid = code_getaddr();
-
-    // store previous variable to stack
-    // we will restore it at 'return'
-    stknode_t *node = code_push(kwTYPE_CRVAR);
-    node->x.vdvar.vid = vid;
-    node->x.vdvar.vptr = tvar[vid];
-
-    // create a new variable with the same ID
-    tvar[vid] = v_new();
+    // an ID on global-variable-table is used. the previous variable
+    // is restored when the frame is released at 'return'
+    code_push_local(code_getaddr(), 1);
   }
 }
 
@@ -1173,8 +1313,10 @@ void cmd_crvar() {
  * this code will be called by udp/f to check parameter nodes
  * stored in stack by the cmd_udp (call to udp/f)
  *
- * 'by value' parameters are stored as local variables in the stack (kwTYPE_CRVAR)
- * 'by reference' parameters are stored as local variables in the stack (kwTYPE_BYREF)
+ * the parameters are moved into the call frame and their nodes are
+ * removed, leaving the caller's info-node at the top of the stack.
+ * 'by value' parameters are copied into the frame slot variable,
+ * 'by reference' parameters replace the variable without a copy
  */
 void cmd_param() {
   // get caller's info-node
@@ -1193,46 +1335,48 @@ void cmd_param() {
     return;
   }
 
-  if (pcount) {
-    for (int i = 0; i < pcount; i++) {
-      // check parameters one-by-one
-      byte vattr = code_getnext();
-      bid_t vid = code_getaddr();
-      int stack_pos = (prog_stack_count - 1 - pcount) + i;
-      stknode_t *node = &prog_stack[stack_pos];
-      var_t *param_var = node->x.param.res;
-      int vcheck = node->x.param.vcheck;
-
-      if (node->type != kwTYPE_VAR) {
-        err_stackmess();
-        break;
-      }
-      else if ((vattr & 0x80) == 0) {
-        // UDP requires a 'by value' parameter
-        node->type = kwTYPE_CRVAR;
-        node->x.vdvar.vid = vid;
-        node->x.vdvar.vptr = tvar[vid];
-
-        // assign
-        if (vcheck == 1) {
-          // its already cloned by the CALL (expr)
-          tvar[vid] = param_var;
-        } else {
-          tvar[vid] = v_clone(param_var);
-        }
-      } else if (vcheck == 1) {
-        // error - the parameter can be used only 'by value'
-        err_parm_byref(i);
-        break;
+  int base = prog_stack_count - 1 - pcount;
+  int i;
+  for (i = 0; i < pcount; i++) {
+    // check parameters one-by-one
+    byte vattr = code_getnext();
+    bid_t vid = code_getaddr();
+    stknode_t *node = &prog_stack[base + i];
+    var_t *param_var = node->x.param.res;
+    int vcheck = node->x.param.vcheck;
+
+    if (node->type != kwTYPE_VAR) {
+      err_stackmess();
+      break;
+    } else if ((vattr & 0x80) == 0) {
+      // UDP requires a 'by value' parameter
+      var_t *local = code_push_local(vid, 0);
+      if (vcheck == 1) {
+        // its already evaluated by the CALL (expr)
+        v_move(local, param_var);
+        v_detach(param_var);
       } else {
-        // UDP requires 'by reference' parameter
-        node->type = kwBYREF;
-        node->x.vdvar.vid = vid;
-        node->x.vdvar.vptr = tvar[vid];
-        tvar[vid] = param_var;
+        v_set(local, param_var);
       }
+    } else if (vcheck == 1) {
+      // error - the parameter can be used only 'by value'
+      err_parm_byref(i);
+      break;
+    } else {
+      // UDP requires 'by reference' parameter
+      code_push_local(vid, 0);
+      tvar[vid] = param_var;
     }
   }
+
+  // remove the parameter nodes moved into the frame. after an error
+  // the remaining nodes are released with the call
+  if (i) {
+    int unused = pcount - i;
+    memmove(&prog_stack[base], &prog_stack[base + i], sizeof(stknode_t) * (unused + 1));
+    prog_stack_count -= i;
+    prog_stack[prog_stack_count - 1].x.vcall.pcount = unused;
+  }
 }
 
 /**
@@ -1242,14 +1386,6 @@ void cmd_udpret() {
   stknode_t ncall;
   code_pop(&ncall, 0);
 
-  // handle any values set with cmd_crvar()
-  while (ncall.type == kwTYPE_CRVAR) {
-    v_free(tvar[ncall.x.vdvar.vid]);
-    v_detach(tvar[ncall.x.vdvar.vid]);
-    tvar[ncall.x.vdvar.vid] = ncall.x.vdvar.vptr;
-    code_pop(&ncall, 0);
-  }
-
   // next node should be the call node
   if (ncall.type != kwPROC && ncall.type != kwFUNC) {
     rt_raise(ERR_SYNTAX);
@@ -1257,25 +1393,19 @@ void cmd_udpret() {
     return;
   }
 
-  // handle parameters
-  int i;
-  for (i = ncall.x.vcall.pcount; i > 0 && !prog_error; i--) {
-    stknode_t node;
-    code_pop(&node, 0);
+  if (opt_profile) {
+    prof_leave_udp(prog_stack_count - ncall.x.vcall.pcount);
+  }
 
-    // local variable - cleanup
-    if (node.type == kwTYPE_CRVAR) {
-      // free local variable data
-      v_free(tvar[node.x.vdvar.vid]);
-      v_detach(tvar[node.x.vdvar.vid]);
-      // restore ptr (replace to pre-call variable)
-      tvar[node.x.vdvar.vid] = node.x.vdvar.vptr;
-    } else if (node.type == kwBYREF) {
-      // variable 'by reference', restore ptr
-      tvar[node.x.vdvar.vid] = node.x.vdvar.vptr;
-    }
+  // handle any parameters not consumed by cmd_param()
+  for (int i = ncall.x.vcall.pcount; i > 0 && !prog_error; i--) {
+    code_pop_and_free();
   }
 
+  // release the locals and parameters
+  code_pop_frame(ncall.x.vcall.frame);
+  prog_frame_base = ncall.x.vcall.caller_frame;
+
   // restore return value
   if (ncall.x.vcall.rvid != (bid_t) INVALID_ADDR) {
     // it is a function store value to stack
@@ -1344,9 +1474,6 @@ int cmd_exit() {
       break;
     case kwPROC:
     case kwFUNC:
-    case kwTYPE_CRVAR:
-    case kwBYREF:
-    case kwTYPE_PARAM:
       if (code == 0 || code == kwPROCSEP || code == kwFUNCSEP) {
         stknode_t *stknode = code_push(node.type);
         *stknode = node;
@@ -1563,6 +1690,7 @@ void cmd_for_in(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
     node.x.vfor.step_expr_ip = 0;
 
     var_p_t var_elem_ptr = 0;
+    var_t elem;
     switch (array_p->type) {
     case V_MAP:
       var_elem_ptr = map_elem_key(array_p, 0);
@@ -1570,7 +1698,7 @@ void cmd_for_in(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
 
     case V_ARRAY:
       if (v_asize(array_p) > 0) {
-        var_elem_ptr = v_elem(array_p, 0);
+        var_elem_ptr = v_elem_read(array_p, 0, &elem);
       }
       break;
 
@@ -1793,6 +1921,7 @@ var_t *cmd_next_for_in_str(stknode_t *node) {
 void cmd_next_for_in(stknode_t *node, bcip_t next_ip) {
   var_t *array_p = node->x.vfor.arr_ptr;
   var_t *var_elem_ptr = NULL;
+  var_t elem;
 
   bcip_t jump_ip = node->x.vfor.jump_ip;
   var_t *var_p = node->x.vfor.var_ptr;
@@ -1808,7 +1937,7 @@ void cmd_next_for_in(stknode_t *node, bcip_t next_ip) {
 
   case V_ARRAY:
     if (v_asize(array_p) > (int) ++node->x.vfor.step_expr_ip) {
-      var_elem_ptr = v_elem(array_p, node->x.vfor.step_expr_ip);
+      var_elem_ptr = v_elem_read(array_p, node->x.vfor.step_expr_ip, &elem);
     }
     break;
 
@@ -2319,7 +2448,8 @@ void cmd_wjoin() {
   str->v.p.ptr[0] = '\0';
 
   for (i = 0; i < v_asize(var_p); i++) {
-    var_t *elem_p = v_elem(var_p, i);
+    var_t tmp;
+    var_t *elem_p = v_elem_read(var_p, i, &tmp);
     var_t e_str;
 
     v_init(&e_str);
@@ -2360,14 +2490,19 @@ void cmd_environ() {
   if (prog_error) {
     return;
   }
-  char *eq = strchr(str.v.p.ptr, '=');
+  const char *eq = strchr(str.v.p.ptr, '=');
   if (eq == NULL) {
     rt_raise(ERR_PUTENV);
   } else {
-    *eq = '\0';
-    if (dev_setenv(str.v.p.ptr, eq + 1) == -1) {
+    // the string may be a literal within the bytecode
+    int len = eq - str.v.p.ptr;
+    char *name = malloc(len + 1);
+    memcpy(name, str.v.p.ptr, len);
+    name[len] = '\0';
+    if (dev_setenv(name, eq + 1) == -1) {
       rt_raise(ERR_PUTENV);
     }
+    free(name);
   }
   v_free(&str);
 }
@@ -2487,37 +2622,214 @@ void cmd_timehms() {
   vs->v.i = s;
 }
 
-/**
- * SORT array [USE ...]
+// runs of up to this many elements are insertion sorted
+#define SORT_RUN 16
+
+typedef int (*sort_cmp_fn)(var_t *a, var_t *b, bcip_t use_ip);
+
+static int sort_cmp_any(var_t *a, var_t *b, bcip_t use_ip) {
+  return v_compare(a, b);
+}
+
+static int sort_cmp_str(var_t *a, var_t *b, bcip_t use_ip) {
+  return strcmp(a->v.p.ptr, b->v.p.ptr);
+}
+
+/*
+ * sets the USE argument from the element, strings are referenced rather than copied
  */
-int sb_qcmp(var_t *a, var_t *b, bcip_t use_ip) {
-  if (use_ip == INVALID_ADDR) {
-    return v_compare(a, b);
+static void sort_use_arg(var_t *dest, var_t *src) {
+  if (src->type == V_STR) {
+    v_free(dest);
+    dest->type = V_STR;
+    dest->const_flag = 0;
+    dest->v.p.ptr = src->v.p.ptr;
+    dest->v.p.length = src->v.p.length;
+    dest->v.p.owner = 0;
   } else {
-    var_t v1, v2;
-    int r;
+    v_set(dest, src);
+  }
+}
+
+static int sort_cmp_use(var_t *a, var_t *b, bcip_t use_ip) {
+  int result = 0;
+  if (!prog_error) {
+    var_t r;
+    v_init(&r);
+    sort_use_arg(tvar[SYSVAR_X], a);
+    sort_use_arg(tvar[SYSVAR_Y], b);
+    code_jump(use_ip);
+    eval(&r);
+    result = v_igetval(&r);
+    v_free(&r);
+  }
+  return result;
+}
 
-    v_init(&v1);
-    v_init(&v2);
+/*
+ * X and Y are saved once for the whole SORT or SEARCH rather than per comparison
+ */
+static void sort_use_begin(var_t **saved) {
+  saved[0] = v_clone(tvar[SYSVAR_X]);
+  saved[1] = v_clone(tvar[SYSVAR_Y]);
+}
 
-    v_set(&v1, a);
-    v_set(&v2, b);
-    exec_usefunc2(&v1, &v2, use_ip);
-    r = v_igetval(&v1);
-    v_free(&v1);
-    return r;
+static void sort_use_end(var_t **saved) {
+  v_set(tvar[SYSVAR_X], saved[0]);
+  v_set(tvar[SYSVAR_Y], saved[1]);
+  for (int i = 0; i < 2; i++) {
+    v_free(saved[i]);
+    v_detach(saved[i]);
   }
 }
 
-// using C's qsort()
-static bcip_t static_qsort_last_use_ip;
+/*
+ * stable merge sort of the element pointers
+ */
+static void sort_merge(var_t **list, var_t **tmp, uint32_t n, sort_cmp_fn cmp, bcip_t use_ip) {
+  if (n <= SORT_RUN) {
+    for (uint32_t i = 1; i < n; i++) {
+      var_t *v = list[i];
+      uint32_t j = i;
+      while (j > 0 && cmp(list[j - 1], v, use_ip) > 0) {
+        list[j] = list[j - 1];
+        j--;
+      }
+      list[j] = v;
+    }
+  } else {
+    uint32_t mid = n / 2;
+    sort_merge(list, tmp, mid, cmp, use_ip);
+    sort_merge(list + mid, tmp, n - mid, cmp, use_ip);
+    if (cmp(list[mid - 1], list[mid], use_ip) > 0) {
+      uint32_t i = 0, j = mid, k = 0;
+      memcpy(tmp, list, mid * sizeof(var_t *));
+      while (i < mid && j < n) {
+        list[k++] = cmp(list[j], tmp[i], use_ip) < 0 ? list[j++] : tmp[i++];
+      }
+      while (i < mid) {
+        list[k++] = tmp[i++];
+      }
+    }
+  }
+}
+
+static void sort_vars(var_t *var_p, sort_cmp_fn cmp, bcip_t use_ip) {
+  uint32_t size = v_asize(var_p);
+  var_t *data = v_data(var_p);
+  var_t **list = (var_t **)malloc(size * 2 * sizeof(var_t *));
+  for (uint32_t i = 0; i < size; i++) {
+    list[i] = &data[i];
+  }
+  sort_merge(list, list + size, size, cmp, use_ip);
+
+  // the USE expression may have resized the array
+  if (v_data(var_p) == data && v_asize(var_p) == size) {
+    var_t *sorted = (var_t *)malloc(size * sizeof(var_t));
+    for (uint32_t i = 0; i < size; i++) {
+      sorted[i] = *list[i];
+    }
+    memcpy(data, sorted, size * sizeof(var_t));
+    free(sorted);
+  }
+  free(list);
+}
 
-int qs_cmp(const void *a, const void *b) {
-  var_t *ea = (var_t *)a;
-  var_t *eb = (var_t *)b;
-  return sb_qcmp(ea, eb, static_qsort_last_use_ip);
+/*
+ * LSD radix sort, skipping the bytes which are the same in every key
+ */
+static uint64_t *sort_radix(uint64_t *keys, uint64_t *tmp, uint32_t n) {
+  for (int shift = 0; shift < 64; shift += 8) {
+    uint32_t count[256];
+    memset(count, 0, sizeof(count));
+    for (uint32_t i = 0; i < n; i++) {
+      count[(keys[i] >> shift) & 0xff]++;
+    }
+    if (count[(keys[0] >> shift) & 0xff] != n) {
+      uint32_t pos = 0;
+      for (int b = 0; b < 256; b++) {
+        uint32_t c = count[b];
+        count[b] = pos;
+        pos += c;
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        tmp[count[(keys[i] >> shift) & 0xff]++] = keys[i];
+      }
+      uint64_t *swap = keys;
+      keys = tmp;
+      tmp = swap;
+    }
+  }
+  return keys;
 }
 
+/*
+ * sorts an array holding only integers or only reals by mapping the values
+ * onto unsigned keys with the same ordering
+ */
+static void sort_numbers(var_t *var_p, int type) {
+  uint32_t size = v_asize(var_p);
+  var_t *data = v_data(var_p);
+  int packed = v_packed(var_p);
+  uint64_t *keys = (uint64_t *)malloc(size * 2 * sizeof(uint64_t));
+  const uint64_t sign = 1ULL << 63;
+
+  for (uint32_t i = 0; i < size; i++) {
+    uint64_t key;
+    if (type == V_INT) {
+      var_int_t value = packed ? v_ints(var_p)[i] : data[i].v.i;
+      key = (uint64_t)value ^ sign;
+    } else {
+      memcpy(&key, packed ? &v_nums(var_p)[i] : &data[i].v.n, sizeof(key));
+      key = (key & sign) ? ~key : (key | sign);
+    }
+    keys[i] = key;
+  }
+
+  uint64_t *sorted = sort_radix(keys, keys + size, size);
+  for (uint32_t i = 0; i < size; i++) {
+    uint64_t key = sorted[i];
+    if (type == V_INT) {
+      var_int_t value = (var_int_t)(key ^ sign);
+      if (packed) {
+        v_ints(var_p)[i] = value;
+      } else {
+        data[i].v.i = value;
+      }
+    } else {
+      key = (key & sign) ? (key & ~sign) : ~key;
+      memcpy(packed ? &v_nums(var_p)[i] : &data[i].v.n, &key, sizeof(key));
+    }
+  }
+  free(keys);
+}
+
+/*
+ * returns the type shared by every element, or -1 when the types are mixed
+ */
+static int sort_type(var_t *var_p) {
+  switch (v_packed(var_p)) {
+  case V_PACK_INT:
+    return V_INT;
+  case V_PACK_NUM:
+    return V_NUM;
+  default:
+    break;
+  }
+  uint32_t size = v_asize(var_p);
+  var_t *data = v_data(var_p);
+  int result = data[0].type;
+  for (uint32_t i = 1; i < size && result != -1; i++) {
+    if (data[i].type != result) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+/**
+ * SORT array [USE ...]
+ */
 void cmd_sort() {
   bcip_t use_ip, exit_ip;
   var_t *var_p;
@@ -2544,8 +2856,29 @@ void cmd_sort() {
   // sort
   if (!errf) {
     if (v_asize(var_p) > 1) {
-      static_qsort_last_use_ip = use_ip;
-      qsort(v_data(var_p), v_asize(var_p), sizeof(var_t), qs_cmp);
+      v_unshare(var_p);
+      if (use_ip != INVALID_ADDR) {
+        var_t *saved[2];
+        v_unpack(var_p);
+        sort_use_begin(saved);
+        sort_vars(var_p, sort_cmp_use, use_ip);
+        sort_use_end(saved);
+      } else {
+        switch (sort_type(var_p)) {
+        case V_INT:
+          sort_numbers(var_p, V_INT);
+          break;
+        case V_NUM:
+          sort_numbers(var_p, V_NUM);
+          break;
+        case V_STR:
+          sort_vars(var_p, sort_cmp_str, use_ip);
+          break;
+        default:
+          sort_vars(var_p, sort_cmp_any, use_ip);
+          break;
+        }
+      }
     }
   }
   // NO RTE anymore... there is no meaning on this because of empty
@@ -2556,13 +2889,14 @@ void cmd_sort() {
 }
 
 /**
- * SEARCH A(), key, BYREF ridx [USE ...]
+ * SEARCH A(), key, BYREF ridx [, sorted] [USE ...]
  */
 void cmd_search() {
   bcip_t use_ip, exit_ip;
   var_t *var_p, *rv_p;
   var_t vkey;
   int errf = 0;
+  int sorted = 0;
 
   // parameters 1: the array
   if (code_isvar()) {
@@ -2600,6 +2934,18 @@ void cmd_search() {
     return;
   }
 
+  // parameters 4: whether the array is sorted
+  if (code_peek() == kwTYPE_SEP) {
+    par_getcomma();
+    if (!prog_error) {
+      sorted = par_getint();
+    }
+    if (prog_error) {
+      v_free(&vkey);
+      return;
+    }
+  }
+
   // USE
   if (code_peek() == kwUSE) {
     code_skipnext();
@@ -2610,14 +2956,40 @@ void cmd_search() {
   }
   // search
   if (!errf) {
+    uint32_t size = v_asize(var_p);
+    sort_cmp_fn cmp = sort_cmp_any;
+    var_t *saved[2];
+    var_t tmp;
+    if (use_ip != INVALID_ADDR) {
+      cmp = sort_cmp_use;
+      sort_use_begin(saved);
+    }
     rv_p->v.i = v_lbound(var_p, 0) - 1;
-    for (int i = 0; i < v_asize(var_p); i++) {
-      var_t *elem_p = v_elem(var_p, i);
-      int bcmp = sb_qcmp(elem_p, &vkey, use_ip);
-      if (bcmp == 0) {
-        rv_p->v.i = i + v_lbound(var_p, 0);
-        break;
+    if (sorted) {
+      // binary search for the first matching element
+      uint32_t lo = 0;
+      uint32_t hi = size;
+      while (lo < hi && !prog_error) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (cmp(v_elem_read(var_p, mid, &tmp), &vkey, use_ip) < 0) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (lo < size && cmp(v_elem_read(var_p, lo, &tmp), &vkey, use_ip) == 0) {
+        rv_p->v.i = lo + v_lbound(var_p, 0);
       }
+    } else {
+      for (uint32_t i = 0; i < size && !prog_error; i++) {
+        if (cmp(v_elem_read(var_p, i, &tmp), &vkey, use_ip) == 0) {
+          rv_p->v.i = i + v_lbound(var_p, 0);
+          break;
+        }
+      }
+    }
+    if (use_ip != INVALID_ADDR) {
+      sort_use_end(saved);
     }
   }
   // NO RTE anymore... there is no meaning on this because of empty
@@ -15,11 +15,10 @@
 #include "common/blib.h"
 #include "common/messages.h"
 #include "common/fs_socket_client.h"
+#include "common/fs_stream.h"
 
 #include <dirent.h>
 
-#define LDLN_INC    256
-#define GROW_SIZE   1024
 #define BUFMAX      256
 #define CHK_ERR_CLEANUP(s) if (err_handle_error(s, &file_name)) return;
 #define CHK_ERR(s) if (err_handle_error(s, NULL)) return;
@@ -168,7 +167,8 @@ void write_encoded_var(int handle, var_t *var) {
 
     // write elements
     for (int i = 0; i < v_asize(var); i++) {
-      var_t *elem = v_elem(var, i);
+      var_t tmp;
+      var_t *elem = v_elem_read(var, i, &tmp);
       write_encoded_var(handle, elem);
     }
     break;
@@ -200,6 +200,8 @@ int read_encoded_var(int handle, var_t *var) {
   case V_STR:
     var->type = V_STR;
     var->v.p.ptr = malloc(fv.size + 1);
+    var->v.p.length = fv.size + 1;
+    var->v.p.owner = 1;
     dev_fread(handle, (byte *)var->v.p.ptr, fv.size);
     var->v.p.ptr[fv.size] = '\0';
     break;
@@ -216,7 +218,7 @@ int read_encoded_var(int handle, var_t *var) {
     // write elements
     for (int i = 0; i < v_asize(var); i++) {
       var_t *elem = v_elem(var, i);
-      v_init(elem);
+      v_init_elem(elem);
       read_encoded_var(handle, elem);
     }
     break;
@@ -347,6 +349,7 @@ void cmd_read_variable(int handle) {
 
       var_p->type = V_STR;
       var_p->v.p.ptr = malloc(size);
+      var_p->v.p.owner = 1;
 
       // READ IT
       while (!dev_feof(handle)) {
@@ -406,6 +409,7 @@ void cmd_flineinput() {
       v_free(var_p);
       var_p->type = V_STR;
       var_p->v.p.ptr = calloc(SB_TEXTLINE_SIZE + 1, 1);
+      var_p->v.p.owner = 1;
       dev_gets(var_p->v.p.ptr, SB_TEXTLINE_SIZE);
       var_p->v.p.length = strlen(var_p->v.p.ptr);
       dev_print("\n");
@@ -516,18 +520,139 @@ void cmd_mkdir() {
   v_free(&dir);
 }
 
+/*
+ * the unread text of a file, mapped into memory where possible
+ */
+typedef struct {
+  char *data;       // the unread text
+  uint32_t length;  // size of the unread text
+  uint32_t offset;  // file position of the unread text
+  char *map;        // the mapping, or NULL when data was read into a buffer
+  uint32_t map_size;
+} tload_text_t;
+
+static int tload_open_text(int handle, tload_text_t *text) {
+  dev_file_t *f = dev_getfileptr(handle);
+  uint32_t size = dev_feof(handle) ? 0 : dev_flength(handle);
+  text->data = NULL;
+  text->length = size;
+  text->offset = 0;
+  text->map = NULL;
+  text->map_size = 0;
+  if (f->type == ft_stream && size) {
+    text->offset = dev_ftell(handle);
+    text->length = size > text->offset ? size - text->offset : 0;
+    text->map = stream_map(f, size);
+    if (text->map) {
+      text->map_size = size;
+      text->data = text->map + text->offset;
+      dev_fseek(handle, size);
+    }
+  }
+  if (!text->map && text->length) {
+    text->data = malloc(text->length);
+    if (!text->data) {
+      err_memory();
+    } else {
+      dev_fread(handle, (byte *)text->data, text->length);
+    }
+  }
+  return !prog_error;
+}
+
+static void tload_close_text(tload_text_t *text) {
+  if (text->map) {
+    stream_unmap(text->map, text->map_size);
+  } else {
+    free(text->data);
+  }
+}
+
+/*
+ * stores a line without its carriage returns
+ */
+static void tload_line(var_t *var, const char *line, uint32_t len) {
+  v_init_str(var, len);
+  char *dst = var->v.p.ptr;
+  if (memchr(line, '\r', len) == NULL) {
+    memcpy(dst, line, len);
+    dst += len;
+  } else {
+    for (uint32_t i = 0; i < len; i++) {
+      if (line[i] != '\r') {
+        *dst++ = line[i];
+      }
+    }
+  }
+  *dst = '\0';
+  var->v.p.length = (dst - var->v.p.ptr) + 1;
+}
+
+/*
+ * TLOAD into an array of lines, or with offsets_only, into an array of
+ * the file position of each line for use with SEEK and LINEINPUT
+ */
+static void tload_lines(int handle, var_t *array_p, int offsets_only) {
+  tload_text_t text;
+  if (!tload_open_text(handle, &text)) {
+    tload_close_text(&text);
+    v_free(array_p);
+    return;
+  }
+
+  // size the array from the number of newlines
+  const char *end = text.data + text.length;
+  uint32_t lines = 0;
+  if (text.length) {
+    lines = 1;
+    for (const char *p = text.data; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+      lines++;
+    }
+  }
+
+  if (!lines) {
+    v_toarray1(array_p, 0);
+  } else if (offsets_only) {
+    v_free(array_p);
+    v_new_packed(array_p, lines, V_PACK_INT);
+    if (!prog_error) {
+      var_int_t *offsets = v_ints(array_p);
+      const char *line = text.data;
+      offsets[0] = text.offset;
+      for (uint32_t i = 1; i < lines; i++) {
+        line = (const char *)memchr(line, '\n', end - line) + 1;
+        offsets[i] = text.offset + (line - text.data);
+      }
+    }
+  } else {
+    v_toarray1(array_p, lines);
+    const char *line = text.data;
+    for (uint32_t i = 0; i < lines && !prog_error; i++) {
+      const char *eol = memchr(line, '\n', end - line);
+      if (eol == NULL) {
+        eol = end;
+      }
+      tload_line(v_elem(array_p, i), line, eol - line);
+      line = eol + 1;
+    }
+  }
+  tload_close_text(&text);
+}
+
 /*
  * load text-file to string or to array
  * Modified 2-May-2002 Chris Warren-Smith. Implemented buffered read
  *
  * TLOAD filename, variable [, type]
+ *
+ * type 0 = array of lines, 1 = string, 2 = JSON map or array,
+ * 3 = array of line offsets
  */
 void cmd_floadln() {
   var_t file_name, *array_p = NULL, *var_p = NULL;
   int flags = DEV_FILE_INPUT;
   int handle;
-  byte ch, type = 0;
-  char buf[BUFMAX];
+  byte type = 0;
 
   if (code_peek() == kwTYPE_SEP) {
     // "filename" is an already open file number
@@ -548,7 +673,18 @@ void cmd_floadln() {
 
     dev_file_t *f = dev_getfileptr(handle);
     if (f->type == ft_http_client) {
-      http_read(f, var_p);  // TLOAD #1, html_str
+      if (type == 2) {
+        // TLOAD #1, json_map, 2
+        var_t json;
+        v_init(&json);
+        http_read(f, &json);
+        if (!prog_error && json.type == V_STR) {
+          map_parse_str(json.v.p.ptr, v_strlen(&json), var_p);
+        }
+        v_free(&json);
+      } else {
+        http_read(f, var_p);  // TLOAD #1, html_str
+      }
       return;
     }
   } else {
@@ -581,81 +717,16 @@ void cmd_floadln() {
     CHK_ERR(FSERR_GENERIC);
   }
 
-  if (type == 0) {
-    // build array
-    int array_size = LDLN_INC;
-    int index = 0;
-    int bufIndex = 0;
-    int bufLen = 0;
-    int eof = dev_feof(handle);
-    uint32_t unreadBytes = eof ? 0 : dev_flength(handle);
-    v_toarray1(array_p, array_size);  // v_free() is here
-
-    while (!eof) {
-      // build var for line
-      var_p = v_elem(array_p, index);
-      int size = GROW_SIZE;
-      v_init_str(var_p, size);
-      index++;
-
-      // process the next line
-      int bcount = 0;
-      int eol = 0;
-      while (!eof && !eol) {
-        if (bufIndex == bufLen) { // read into empty buffer
-          if (dev_feof(handle) || unreadBytes == 0) {
-            eof = 1;
-            break;
-          }
-          bufLen = (unreadBytes > BUFMAX) ? BUFMAX : unreadBytes;
-          bufIndex = 0;
-          unreadBytes -= bufLen;
-
-          dev_fread(handle, (byte *)buf, bufLen);
-          if (prog_error) {
-            eof = 1;
-            break;
-          }
-        }
-
-        ch = buf[bufIndex++];
-        if (ch == '\n') {
-          eol = 1;
-          break;
-        } else if (ch != '\r') {  // store char
-          if (bcount >= (size - 1)) {
-            size += GROW_SIZE;
-            var_p->v.p.ptr = realloc(var_p->v.p.ptr, size);
-          }
-          var_p->v.p.ptr[bcount] = ch;
-          bcount++;
-        }
-      }                         // read line
-
-      if (prog_error) {
-        // clear & exit
-        v_free(array_p);
-        v_init(array_p);
-        break;
-      }
-
-      // store text-line
-      var_p->v.p.ptr[bcount] = '\0';
-      var_p->v.p.length = bcount + 1;
-      var_p->v.p.ptr = realloc(var_p->v.p.ptr, var_p->v.p.length);
-
-      // resize array
-      if (index >= (array_size - 1)) {
-        array_size += LDLN_INC;
-        v_resize_array(array_p, array_size);
-      }
-    }                           // read file
-
-    if (index) {
-      v_resize_array(array_p, index);
-    } else {
-      v_resize_array(array_p, 0); // v_free() is here
+  if (type == 2) {
+    // parse JSON from the current position
+    uint32_t length = dev_flength(handle);
+    if (dev_getfileptr(handle)->type == ft_stream) {
+      length -= dev_ftell(handle);
     }
+    map_read_json(var_p, handle, length);
+  } else if (type == 0 || type == 3) {
+    // build array of lines, or of line offsets
+    tload_lines(handle, array_p, type == 3);
   } else {
     // type == 1, build string
     v_free(var_p);
@@ -719,10 +790,11 @@ void cmd_fsaveln() {
   if (var_p->type == V_ARRAY) {
     // parameter is an array
     if(v_asize(array_p) > 0) {
-      var_p = v_elem(array_p, 0);
+      var_t tmp;
+      var_p = v_elem_read(array_p, 0, &tmp);
       fprint_var(handle, var_p);
       for (int i = 1; i < v_asize(array_p); i++) {
-        var_p = v_elem(array_p, i);
+        var_p = v_elem_read(array_p, i, &tmp);
         dev_fwrite(handle, (byte *)OS_LINESEPARATOR, OS_LINESEPARATOR_LEN);
         fprint_var(handle, var_p);        
       }
@@ -20,9 +20,13 @@
 #include "common/messages.h"
 #include "common/keymap.h"
 
+#if defined(_UnixOS)
+#include <sys/resource.h>
+#endif
+
 // relative coordinates (current x/y) from blib_graph
-extern int gra_x;
-extern int gra_y;
+extern SB_TLS int gra_x;
+extern SB_TLS int gra_y;
 
 // date
 static char *date_wd3_table[] = TABLE_WEEKDAYS_3C;
@@ -727,6 +731,35 @@ var_int_t cmd_fre(var_int_t arg) {
     close(memfd);
   }
 #endif
+  uint32_t live, peak, chunks;
+  switch (arg) {
+  case -20: // variables in use
+    v_pool_stats(&live, &peak, &chunks);
+    r = live;
+    break;
+  case -21: // most variables in use
+    v_pool_stats(&live, &peak, &chunks);
+    r = peak;
+    break;
+  case -22: // variable pool chunks
+    v_pool_stats(&live, &peak, &chunks);
+    r = chunks;
+    break;
+#if defined(_UnixOS)
+  case -23: // peak resident memory (KB)
+    {
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__MACH__)
+        r = usage.ru_maxrss / 1024;
+#else
+        r = usage.ru_maxrss;
+#endif
+      }
+    }
+    break;
+#endif
+  }
   return r;
 }
 
@@ -2361,8 +2394,9 @@ void cmd_genfunc(long funcCode, var_t *r) {
         if (v_asize(v) != 2) {
           err_argerr();
         } else {
-          x = v_getint(v_elem(v, 0));
-          y = v_getint(v_elem(v, 1));
+          var_t tmp;
+          x = v_getint(v_elem_read(v, 0, &tmp));
+          y = v_getint(v_elem_read(v, 1, &tmp));
           y_set = 1;
         }
       } else {
@@ -2559,7 +2593,8 @@ void cmd_genfunc(long funcCode, var_t *r) {
           if (!prog_error && basevar_p->type == V_ARRAY) {
             count = v_asize(basevar_p);
             for (int i = 0; i < count; i++) {
-              var_t *elem_p = v_elem(basevar_p, i);
+              var_t tmp;
+              var_t *elem_p = v_elem_read(basevar_p, i, &tmp);
               if (!prog_error) {
                 if (first) {
                   dar_first(funcCode, r, elem_p);
@@ -2631,7 +2666,8 @@ void cmd_genfunc(long funcCode, var_t *r) {
           if (!prog_error && basevar_p->type == V_ARRAY) {
             count = v_asize(basevar_p);
             for (int i = 0; i < count; i++) {
-              var_t *elem_p = v_elem(basevar_p, i);
+              var_t tmp;
+              var_t *elem_p = v_elem_read(basevar_p, i, &tmp);
               if (!prog_error) {
                 if (tcount >= len) {
                   len += BUF_LEN;
@@ -2789,6 +2825,7 @@ void cmd_genfunc(long funcCode, var_t *r) {
   case kwTRANSPOSE: {
     int32_t rows, cols, pos1, pos2;
     var_t *e;
+    var_t tmp;
 
     v_init(r);
     var_t *a = par_getvarray();  
@@ -2814,7 +2851,7 @@ void cmd_genfunc(long funcCode, var_t *r) {
       for (int32_t y = 0; y < rows; y++) {
         pos1 = y * cols + x;
         pos2 = x * rows + y;        
-        e = v_elem(a, pos1);
+        e = v_elem_read(a, pos1, &tmp);
         m[pos2] = v_getval(e);
       }
     }
@@ -2913,15 +2950,14 @@ void cmd_genfunc(long funcCode, var_t *r) {
     if (!prog_error) {
       // create the array
       if (count > 1) {
-        v_toarray1(r, count);
+        v_free(r);
+        v_new_packed(r, count, V_PACK_NUM);
         var_num_t dx = (xmax - xmin) / (count - 1);
         var_num_t x = xmin;
 
         // add the entries
-        for (int i = 0; i < count; i++, x += dx) {
-          var_t *elem_p = v_elem(r, i);
-          elem_p->type = V_NUM;
-          elem_p->v.n = x;
+        for (int i = 0; i < count && !prog_error; i++, x += dx) {
+          v_nums(r)[i] = x;
         }
       } else {
         v_toarray1(r, 0);
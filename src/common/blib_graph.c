@@ -11,8 +11,8 @@
 #include "common/messages.h"
 
 // graphics - relative coordinates
-int gra_x;
-int gra_y;
+SB_TLS int gra_x;
+SB_TLS int gra_y;
 
 void graph_reset() {
   gra_x = gra_y = 0;
@@ -1194,7 +1194,8 @@ void cmd_chart() {
   int count = v_asize(var_p);
   var_num_t *vals = (var_num_t *) malloc(sizeof(var_num_t) * count);
   for (int i = 0; i < count; i++) {
-    var_t *elem_p = v_elem(var_p, i);
+    var_t tmp;
+    var_t *elem_p = v_elem_read(var_p, i, &tmp);
     if (prog_error) {
       free(vals);
       return;
@@ -1232,6 +1233,9 @@ var_t *par_getm3() {
     err_typemismatch();
     return NULL;
   }
+  // the elements are updated in place
+  v_unshare(vp);
+  v_unpack(vp);
   return vp;
 }
 
@@ -1281,7 +1285,7 @@ void cmd_m3ident() {
   for (int i = 0; i < 3; i++) {
     for (int j = 0; j < 3; j++) {
       var_t *e = v_elem(m, (i * 3 + j));
-      v_init(e);
+      v_init_elem(e);
       e->type = V_NUM;
       e->v.n = (i == j) ? 1.0 : 0.0;
     }
@@ -1383,6 +1387,8 @@ void cmd_m3apply() {
   }
 
   int count = v_asize(p);
+  v_unshare(p);
+  v_unpack(p);
 
   // copy m to om
   for (int i = 0; i < 3; i++) {
@@ -1415,6 +1421,8 @@ void cmd_m3apply() {
         err_parsepoly(i, 11);
       }
       IF_PROG_ERR_RTN;
+      v_unshare(e);
+      v_unpack(e);
 
       x = v_getreal(v_elem(e, 0));
       y = v_getreal(v_elem(e, 1));
@@ -163,48 +163,30 @@ void mat_gauss_jordan(var_num_t *a, var_num_t *b, int n, double toler) {
 }
 
 /*
+ * Determinant of A, the product of the pivots of the LU decomposition
  */
-void mat_det2(var_num_t t, int m, int k, var_num_t *a, int *done, var_num_t *v, int n, double toler) {
-  if (k >= n) {
-    int s = -1;
-
-    if ((m % 2) == 0) {
-      s = 1;
-    }
-    *v += s * t;
-  } else {
-    if (ABS(t) > toler) {
-      int n2 = 0, j;
-
-      for (j = n - 1; j >= 0; j--) {
-        if (done[j]) {
-          n2++;
-        } else {
-          done[j] = 1;
-          mat_det2(t * a[k * n + j], m + n2, k + 1, a, done, v, n, toler);
-          done[j] = 0;
-        }
+var_num_t mat_determ(var_num_t *a, int n, double toler) {
+  var_num_t *lu = (var_num_t *)malloc(sizeof(var_num_t) * n * n);
+  int *pivot = (int *)malloc(sizeof(int) * n);
+  var_num_t v = 0;
+
+  memcpy(lu, a, sizeof(var_num_t) * n * n);
+  int swaps = mat_lu(lu, pivot, n);
+  if (swaps != -1) {
+    v = (swaps % 2) ? -1 : 1;
+    for (int i = 0; i < n; i++) {
+      var_num_t u = lu[i * n + i];
+      if (fabs(u) <= toler) {
+        // the pivot is below the acceptable value
+        v = 0;
+        break;
       }
+      v *= u;
     }
   }
-}
-
-/*
- * Determinant of A
- */
-var_num_t mat_determ(var_num_t *a, int n, double toler) {
-  int *done;
-  int i;
-  var_num_t v;
-
-  done = malloc(n * sizeof(int));
-  for (i = 0; i < n; i++) {
-    done[i] = 0;
-  }
-  v = 0;
-  mat_det2(1, 0, 0, a, done, &v, n, toler);
 
-  free(done);
+  free(pivot);
+  free(lu);
   return v;
 }
 
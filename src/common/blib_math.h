@@ -49,8 +49,31 @@ void mat_gauss_jordan(var_num_t *a, var_num_t *b, int n, double toler);
  */
 void mat_inverse(var_num_t *a, int n);
 
-void mat_det2(var_num_t t, int m, int k, var_num_t *a, int *done, var_num_t *v, int n, double toler)
-   ;
+/**
+ * @ingroup math
+ *
+ * multiplies two matrices, the product is calculated in cache sized blocks
+ *
+ * @param c the result, rows x cols
+ * @param a the left matrix, rows x inner
+ * @param b the right matrix, inner x cols
+ * @param rows the rows of a
+ * @param inner the cols of a and rows of b
+ * @param cols the cols of b
+ */
+void mat_product(var_num_t *c, const var_num_t *a, const var_num_t *b, int rows, int inner, int cols);
+
+/**
+ * @ingroup math
+ *
+ * in place LU decomposition with partial pivoting
+ *
+ * @param a is the matrix
+ * @param pivot receives the row permutation
+ * @param n is the number of rows/cols
+ * @return the number of row exchanges, or -1 when the matrix is singular
+ */
+int mat_lu(var_num_t *a, int *pivot, int n);
 
 /**
  * @ingroup math
@@ -25,15 +25,43 @@
 #include "common/device.h"
 #include "common/pproc.h"
 #include "common/keymap.h"
+#include "common/sbapp.h"
+#include "common/profile.h"
+#include "common/bc_file.h"
 
 int brun_create_task(const char *filename, byte *preloaded_bc, int libf);
 int exec_close_task();
 void sys_before_comp();
 
-static char fileName[OS_FILENAME_SIZE + 1];
-static stknode_t err_node;
+static SB_TLS char fileName[OS_FILENAME_SIZE + 1];
+static SB_TLS char execFile[OS_PATHNAME_SIZE + 1];
+static SB_TLS stknode_t err_node;
+static const sbasic_bc_cache_t *bc_cache;
+
+// event checking state, shared with the nested loops of FUNC calls
+static SB_TLS uint32_t evt_next_check;
+static SB_TLS uint32_t evt_budget = 1;
 
 #define EVT_CHECK_EVERY 50
+#define EVT_CHECK_BUDGET 32
+
+/*
+ * command handler endings for bc_loop(). with threaded dispatch the next
+ * handler is entered directly until the event budget is spent. commands
+ * which may block or take a while spend the budget, so the clock is read
+ * before the next command
+ */
+#define BC_LOOP_NEXT \
+  BC_GOTO(threaded && !prog_error && evt_budget > 1 && prog_ip < prog_length, \
+          (evt_budget--, code = prog_source[prog_ip++])); \
+  continue
+#define BC_LOOP_END \
+  if (!threaded || prog_error) { break; } \
+  bc_loop_end_cmd(); \
+  if (prog_error) { if (prog_error != errThrow) { return; } prog_error = errNone; } \
+  BC_LOOP_NEXT
+#define BC_LOOP_BLOCKING_NEXT evt_budget = 1; continue
+#define BC_LOOP_BLOCKING evt_budget = 1; break
 #define IF_ERR_BREAK if (prog_error) { \
   if (prog_error == errThrow)       \
       prog_error = errNone; else break;}
@@ -63,19 +91,6 @@ stknode_t *code_push(code_t type) {
 
 void free_node(stknode_t *node) {
   switch (node->type) {
-  case kwTYPE_CRVAR:
-    // free local variable data and retore ptr
-    if (node->x.vdvar.vptr != tvar[node->x.vdvar.vid]) {
-      v_free(tvar[node->x.vdvar.vid]);
-      v_detach(tvar[node->x.vdvar.vid]);
-      tvar[node->x.vdvar.vid] = node->x.vdvar.vptr;
-    }
-    break;
-
-  case kwBYREF:
-    tvar[node->x.vdvar.vid] = node->x.vdvar.vptr;
-    break;
-
   case kwTYPE_VAR:
     if ((node->x.param.vcheck == 1) || (node->x.param.vcheck == 0x81)) {
       v_free(node->x.param.res);
@@ -90,6 +105,11 @@ void free_node(stknode_t *node) {
 
   case kwFUNC:
   case kwPROC:
+    if (opt_profile) {
+      prof_leave_udp(prog_stack_count - node->x.vcall.pcount);
+    }
+    code_pop_frame(node->x.vcall.frame);
+    prog_frame_base = node->x.vcall.caller_frame;
     if (node->x.vcall.rvid != INVALID_ADDR) {
       v_detach(tvar[node->x.vcall.rvid]);
       tvar[node->x.vcall.rvid] = node->x.vcall.retvar;
@@ -139,11 +159,6 @@ void code_pop(stknode_t *node, int expected_type) {
         // a FUNC result was not previously consumed
         rt_raise(MSG_RETURN_NOT_ASSIGNED, node->line);
         break;
-      case kwTYPE_CRVAR:
-        // pop local variable and continue
-        free_node(node);
-        code_pop(node, expected_type);
-        break;
       default:
         break;
       }
@@ -181,6 +196,57 @@ stknode_t *code_stackpeek() {
   return NULL;
 }
 
+void code_push_frame(stknode_t *node) {
+  node->x.vcall.frame = prog_frame_sp;
+  node->x.vcall.caller_frame = prog_frame_base;
+  prog_frame_base = prog_frame_sp;
+}
+
+void code_pop_frame(uint32_t frame) {
+  // restore in reverse order, a variable may be hidden more than once
+  while (prog_frame_sp > frame) {
+    prog_frame_sp--;
+    var_slot_t *slot = code_frame_slot(prog_frame_sp);
+    v_free(&slot->var);
+    tvar[slot->vid] = slot->saved;
+  }
+}
+
+var_t *code_push_local(bid_t vid, int reuse) {
+  var_slot_t **frames = prog_frames;
+  uint32_t sp = prog_frame_sp;
+  var_slot_t *slot = NULL;
+  if (reuse) {
+    // LOCAL executed again within the same call, eg inside a loop
+    var_t *var = tvar[vid];
+    for (uint32_t i = sp; i > prog_frame_base; i--) {
+      var_slot_t *next = &frames[(i - 1) / SB_FRAME_CHUNK_SIZE][(i - 1) % SB_FRAME_CHUNK_SIZE];
+      if (&next->var == var) {
+        slot = next;
+        v_free(var);
+        break;
+      }
+    }
+  }
+  if (slot == NULL) {
+    uint32_t chunk = sp / SB_FRAME_CHUNK_SIZE;
+    if (chunk == prog_frame_chunks) {
+      frames = realloc(frames, sizeof(var_slot_t *) * (chunk + 1));
+      frames[chunk] = malloc(sizeof(var_slot_t) * SB_FRAME_CHUNK_SIZE);
+      prog_frames = frames;
+      prog_frame_chunks++;
+    }
+    slot = &frames[chunk][sp % SB_FRAME_CHUNK_SIZE];
+    slot->vid = vid;
+    slot->saved = tvar[vid];
+    slot->var.pooled = 0;
+    prog_frame_sp = sp + 1;
+  }
+  v_init(&slot->var);
+  tvar[vid] = &slot->var;
+  return &slot->var;
+}
+
 /**
  * sets the value of an system-variable with the given type
  */
@@ -363,22 +429,29 @@ void cmd_chain(void) {
       code = strdup(var.v.p.ptr);
     }
   } else if (var.type == V_ARRAY) {
+    // join the lines into a single buffer
     int len = 0;
     uint32_t size = v_asize(&var);
+    var_t tmp;
     for (int el = 0; el < size; el++) {
-      var_t *el_p = v_elem(&var, el);
+      var_t *el_p = v_elem_read(&var, el, &tmp);
       if (el_p->type == V_STR) {
-        int str_len = strlen(el_p->v.p.ptr) + 2;
-        if (len) {
-          code = realloc(code, len + str_len);
-          strcat(code, el_p->v.p.ptr);
-        } else {
-          code = malloc(str_len);
-          strcpy(code, el_p->v.p.ptr);
+        len += strlen(el_p->v.p.ptr) + 1;
+      }
+    }
+    if (len) {
+      code = malloc(len + 1);
+      len = 0;
+      for (int el = 0; el < size; el++) {
+        var_t *el_p = v_elem_read(&var, el, &tmp);
+        if (el_p->type == V_STR) {
+          int str_len = strlen(el_p->v.p.ptr);
+          memcpy(code + len, el_p->v.p.ptr, str_len);
+          code[len + str_len] = '\n';
+          len += str_len + 1;
         }
-        strcat(code, "\n");
-        len += str_len + 1;
       }
+      code[len] = '\0';
     }
   }
 
@@ -477,6 +550,7 @@ void cmd_options(void) {
 
 static inline void bc_loop_call_proc() {
   bcip_t pcode = code_getaddr();
+  int prof_token = opt_profile ? prof_enter(PROF_CALLP, pcode, NULL) : 0;
   switch (pcode) {
   case kwCLS:
     dev_cls();
@@ -668,6 +742,9 @@ static inline void bc_loop_call_proc() {
     err_pcode_err(pcode);
   }
 
+  if (opt_profile) {
+    prof_leave(prof_token);
+  }
   if (!prog_error && prog_source[prog_ip] == kwTYPE_LEVEL_END) {
     // allow redundant close bracket around function call
     prog_ip++;
@@ -682,11 +759,53 @@ static inline void bc_loop_call_extp() {
     if (gsb_last_error) {
       prog_error = gsb_last_error;
     }
+  } else if (opt_profile) {
+    int prof_token = prof_enter(PROF_PLUGIN, (lib << 17) | (1 << 16) | prog_symtable[idx].exp_idx,
+                                prog_symtable[idx].symbol);
+    plugin_procexec(lib, prog_symtable[idx].exp_idx);
+    prof_leave(prof_token);
   } else {
     plugin_procexec(lib, prog_symtable[idx].exp_idx);
   }
 }
 
+/**
+ * the line hook, shared by TRON and the profiler
+ */
+static inline void bc_loop_trace() {
+  if (opt_trace_on & TRACE_LINES) {
+    dev_trace_line(prog_line);
+  }
+  if (opt_trace_on & TRACE_PROFILE) {
+    prof_line(prog_line);
+  }
+}
+
+/**
+ * checks the end of a command, which is followed by kwTYPE_EOC or kwTYPE_LINE
+ */
+static inline void bc_loop_end_cmd() {
+  if (prog_ip < prog_length) {
+    byte code = prog_source[prog_ip++];
+    if (code == kwTYPE_LINE) {
+      prog_line = code_getaddr();
+      if (opt_trace_on) {
+        bc_loop_trace();
+      }
+    } else if (code != kwTYPE_EOC) {
+      if (!opt_quiet) {
+        hex_dump(prog_source, prog_length);
+      }
+      prog_ip--;
+      if (code == kwTYPE_SEP) {
+        rt_raise("COMMAND SEPARATOR '%c' FOUND", prog_source[prog_ip + 1]);
+      } else {
+        rt_raise("PARAM COUNT ERROR @%d=%X %d", prog_ip, prog_source[prog_ip], code);
+      }
+    }
+  }
+}
+
 static inline void bc_loop_end() {
   // end of program
   prog_error = errEnd;
@@ -718,201 +837,226 @@ void bc_loop(int isf) {
   int i;
   int proc_level = 0;
   byte code = 0;
+#if defined(BC_THREADED)
+  int threaded = !opt_switch_dispatch;
+#else
+  int threaded = 0;
+#endif
 
-  // setup event checker time = 50ms
-  uint32_t now = dev_get_millisecond_count();
-  uint32_t next_check = now + EVT_CHECK_EVERY;
+#if defined(BC_THREADED)
+  static const void *dispatch[256] = {
+    [0 ... 255] = &&L_kwDEFAULT,
+    BC_LABEL(kwLABEL), BC_LABEL(kwREM), BC_LABEL(kwTYPE_EOC), BC_LABEL(kwTYPE_LINE),
+    BC_LABEL(kwLET), BC_LABEL(kwLET_OPT), BC_LABEL(kwCONST), BC_LABEL(kwPACKED_LET),
+    BC_LABEL(kwGOTO), BC_LABEL(kwGOSUB), BC_LABEL(kwRETURN), BC_LABEL(kwONJMP),
+    BC_LABEL(kwPRINT), BC_LABEL(kwINPUT), BC_LABEL(kwIF), BC_LABEL(kwELIF),
+    BC_LABEL(kwELSE), BC_LABEL(kwENDIF), BC_LABEL(kwFOR), BC_LABEL(kwNEXT),
+    BC_LABEL(kwWHILE), BC_LABEL(kwWEND), BC_LABEL(kwREPEAT), BC_LABEL(kwUNTIL),
+    BC_LABEL(kwSELECT), BC_LABEL(kwCASE), BC_LABEL(kwCASE_ELSE), BC_LABEL(kwENDSELECT),
+    BC_LABEL(kwDIM), BC_LABEL(kwREDIM), BC_LABEL(kwAPPEND), BC_LABEL(kwINSERT),
+    BC_LABEL(kwDELETE), BC_LABEL(kwERASE), BC_LABEL(kwREAD), BC_LABEL(kwDATA),
+    BC_LABEL(kwRESTORE), BC_LABEL(kwOPTION), BC_LABEL(kwTYPE_CALLEXTP), BC_LABEL(kwTYPE_CALLP),
+    BC_LABEL(kwTYPE_CALL_UDP), BC_LABEL(kwTYPE_CALL_UDF), BC_LABEL(kwTYPE_RET), BC_LABEL(kwTYPE_CRVAR),
+    BC_LABEL(kwTYPE_PARAM), BC_LABEL(kwEXIT), BC_LABEL(kwLINE), BC_LABEL(kwCOLOR),
+    BC_LABEL(kwOPEN), BC_LABEL(kwCLOSE), BC_LABEL(kwFILEWRITE), BC_LABEL(kwFILEREAD),
+    BC_LABEL(kwLOGPRINT), BC_LABEL(kwFILEPRINT), BC_LABEL(kwSPRINT), BC_LABEL(kwLINEINPUT),
+    BC_LABEL(kwSINPUT), BC_LABEL(kwFILEINPUT), BC_LABEL(kwSEEK), BC_LABEL(kwTRON),
+    BC_LABEL(kwTROFF), BC_LABEL(kwSTOP), BC_LABEL(kwEND), BC_LABEL(kwCHAIN),
+    BC_LABEL(kwRUN), BC_LABEL(kwEXEC), BC_LABEL(kwTRY), BC_LABEL(kwCATCH),
+    BC_LABEL(kwENDTRY), BC_LABEL(kwLET_APPEND), BC_LABEL(kwLET_INC)
+  };
+#endif
 
   /**
    * For commands that change the IP use
    *
-   * case mycommand:
+   * BC_OP(mycommand):
    *   command();
-   *   if  ( prog_error )  break;
-   *   continue;
+   *   IF_ERR_BREAK;
+   *   BC_LOOP_NEXT;
    */
   if (isf == 2) {
     proc_level++;
   }
   while (prog_ip < prog_length) {
-    switch (code) {
-    case kwLABEL:
-    case kwREM:
-    case kwTYPE_EOC:
-    case kwTYPE_LINE:
-      break;
-    default:
-      now = dev_get_millisecond_count();
-      break;
-    }
-
-    // check events every ~50ms
-    if (now >= next_check) {
-      next_check = now + EVT_CHECK_EVERY;
-
-      switch (dev_events(0)) {
-      case -1:
-        // break event
-        break;
-      case -2:
-        prog_error = errBreak;
-        inf_break(prog_line);
-        break;
-      default:
-        if (prog_timer) {
-          timer_run(now);
-        }
-      };
+    // check events every ~50ms, the clock is only read once the
+    // budget is spent or after a command which may block
+    if (--evt_budget == 0) {
+      evt_budget = EVT_CHECK_BUDGET;
+      uint32_t now = dev_get_millisecond_count();
+      if (now >= evt_next_check) {
+        evt_next_check = now + EVT_CHECK_EVERY;
+
+        switch (dev_events(0)) {
+        case -1:
+          // break event
+          break;
+        case -2:
+          prog_error = errBreak;
+          inf_break(prog_line);
+          break;
+        default:
+          if (prog_timer) {
+            timer_run(now);
+          }
+        };
+      }
     }
 
     // proceed to the next command
     if (!prog_error) {
       code = prog_source[prog_ip++];
       switch (code) {
-      case kwLABEL:
-      case kwREM:
-      case kwTYPE_EOC:
-        continue;
-      case kwTYPE_LINE:
+      BC_OP(kwLABEL):
+      BC_OP(kwREM):
+      BC_OP(kwTYPE_EOC):
+        BC_LOOP_NEXT;
+      BC_OP(kwTYPE_LINE):
         prog_line = code_getaddr();
         if (opt_trace_on) {
-          dev_trace_line(prog_line);
+          bc_loop_trace();
         }
-        continue;
-      case kwLET:
+        BC_LOOP_NEXT;
+      BC_OP(kwLET):
         cmd_let(0);
-        break;
-      case kwLET_OPT:
+        BC_LOOP_END;
+      BC_OP(kwLET_OPT):
         cmd_let_opt();
-        break;
-      case kwCONST:
+        BC_LOOP_END;
+      BC_OP(kwLET_APPEND):
+        cmd_let_append();
+        BC_LOOP_END;
+      BC_OP(kwLET_INC):
+        cmd_let_inc();
+        BC_LOOP_END;
+      BC_OP(kwCONST):
         cmd_let(1);
-        break;
-      case kwPACKED_LET:
+        BC_LOOP_END;
+      BC_OP(kwPACKED_LET):
         cmd_packed_let();
-        break;
-      case kwGOTO:
+        BC_LOOP_END;
+      BC_OP(kwGOTO):
         bc_loop_goto();
-        continue;
-      case kwGOSUB:
+        BC_LOOP_NEXT;
+      BC_OP(kwGOSUB):
         cmd_gosub();
         IF_ERR_BREAK;
-        continue;
-      case kwRETURN:
+        BC_LOOP_NEXT;
+      BC_OP(kwRETURN):
         cmd_return();
         IF_ERR_BREAK;
-        continue;
-      case kwONJMP:
+        BC_LOOP_NEXT;
+      BC_OP(kwONJMP):
         cmd_on_go();
         IF_ERR_BREAK;
-        continue;
-      case kwPRINT:
+        BC_LOOP_NEXT;
+      BC_OP(kwPRINT):
         cmd_print(PV_CONSOLE);
-        break;
-      case kwINPUT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwINPUT):
         cmd_input(PV_CONSOLE);
-        break;
-      case kwIF:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwIF):
         cmd_if();
         IF_ERR_BREAK;
-        continue;
-      case kwELIF:
+        BC_LOOP_NEXT;
+      BC_OP(kwELIF):
         cmd_elif();
         IF_ERR_BREAK;
-        continue;
-      case kwELSE:
+        BC_LOOP_NEXT;
+      BC_OP(kwELSE):
         cmd_else();
         IF_ERR_BREAK;
-        continue;
-      case kwENDIF:
+        BC_LOOP_NEXT;
+      BC_OP(kwENDIF):
         cmd_endif();
         IF_ERR_BREAK;
-        continue;
-      case kwFOR:
+        BC_LOOP_NEXT;
+      BC_OP(kwFOR):
         cmd_for();
         IF_ERR_BREAK;
-        continue;
-      case kwNEXT:
+        BC_LOOP_NEXT;
+      BC_OP(kwNEXT):
         cmd_next();
         IF_ERR_BREAK;
-        continue;
-      case kwWHILE:
+        BC_LOOP_NEXT;
+      BC_OP(kwWHILE):
         cmd_while();
         IF_ERR_BREAK;
-        continue;
-      case kwWEND:
+        BC_LOOP_NEXT;
+      BC_OP(kwWEND):
         cmd_wend();
         IF_ERR_BREAK;
-        continue;
-      case kwREPEAT:
+        BC_LOOP_NEXT;
+      BC_OP(kwREPEAT):
         cmd_repeat();
         IF_ERR_BREAK;
-        continue;
-      case kwUNTIL:
+        BC_LOOP_NEXT;
+      BC_OP(kwUNTIL):
         cmd_until();
         IF_ERR_BREAK;
-        continue;
-      case kwSELECT:
+        BC_LOOP_NEXT;
+      BC_OP(kwSELECT):
         cmd_select();
         IF_ERR_BREAK;
-        continue;
-      case kwCASE:
+        BC_LOOP_NEXT;
+      BC_OP(kwCASE):
         cmd_case();
         IF_ERR_BREAK;
-        continue;
-      case kwCASE_ELSE:
+        BC_LOOP_NEXT;
+      BC_OP(kwCASE_ELSE):
         cmd_case_else();
         IF_ERR_BREAK;
-        continue;
-      case kwENDSELECT:
+        BC_LOOP_NEXT;
+      BC_OP(kwENDSELECT):
         cmd_end_select();
         IF_ERR_BREAK;
-        continue;
-      case kwDIM:
+        BC_LOOP_NEXT;
+      BC_OP(kwDIM):
         cmd_dim(0);
-        break;
-      case kwREDIM:
+        BC_LOOP_END;
+      BC_OP(kwREDIM):
         cmd_redim();
-        break;
-      case kwAPPEND:
+        BC_LOOP_END;
+      BC_OP(kwAPPEND):
         cmd_append();
-        break;
-      case kwINSERT:
+        BC_LOOP_END;
+      BC_OP(kwINSERT):
         cmd_lins();
-        break;
-      case kwDELETE:
+        BC_LOOP_END;
+      BC_OP(kwDELETE):
         cmd_ldel();
-        break;
-      case kwERASE:
+        BC_LOOP_END;
+      BC_OP(kwERASE):
         cmd_erase();
-        break;
-      case kwREAD:
+        BC_LOOP_END;
+      BC_OP(kwREAD):
         cmd_read();
-        break;
-      case kwDATA:
+        BC_LOOP_END;
+      BC_OP(kwDATA):
         cmd_data();
-        break;
-      case kwRESTORE:
+        BC_LOOP_END;
+      BC_OP(kwRESTORE):
         cmd_restore();
-        break;
-      case kwOPTION:
+        BC_LOOP_END;
+      BC_OP(kwOPTION):
         cmd_options();
-        break;
-      case kwTYPE_CALLEXTP:
+        BC_LOOP_END;
+      BC_OP(kwTYPE_CALLEXTP):
         bc_loop_call_extp();
         IF_ERR_BREAK;
-        continue;
-      case kwTYPE_CALLP:
+        BC_LOOP_BLOCKING_NEXT;
+      BC_OP(kwTYPE_CALLP):
         bc_loop_call_proc();
-        break;
-      case kwTYPE_CALL_UDP:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwTYPE_CALL_UDP):
         cmd_udp(kwPROC);
         if (isf) {
           proc_level++;
         }
         IF_ERR_BREAK;
-        continue;
-      case kwTYPE_CALL_UDF:
+        BC_LOOP_NEXT;
+      BC_OP(kwTYPE_CALL_UDF):
         if (isf) {
           cmd_udp(kwFUNC);
           proc_level++;
@@ -920,8 +1064,8 @@ void bc_loop(int isf) {
           err_syntax(kwTYPE_CALL_UDF, "%G");
         }
         IF_ERR_BREAK;
-        continue;
-      case kwTYPE_RET:
+        BC_LOOP_NEXT;
+      BC_OP(kwTYPE_RET):
         cmd_udpret();
         if (isf) {
           proc_level--;
@@ -930,14 +1074,14 @@ void bc_loop(int isf) {
           }
         }
         IF_ERR_BREAK;
-        continue;
-      case kwTYPE_CRVAR:
+        BC_LOOP_NEXT;
+      BC_OP(kwTYPE_CRVAR):
         cmd_crvar();
-        break;
-      case kwTYPE_PARAM:
+        BC_LOOP_END;
+      BC_OP(kwTYPE_PARAM):
         cmd_param();
-        break;
-      case kwEXIT:
+        BC_LOOP_END;
+      BC_OP(kwEXIT):
         pops = cmd_exit();
         if (isf && pops) {
           proc_level--;
@@ -946,77 +1090,77 @@ void bc_loop(int isf) {
           }
         }
         IF_ERR_BREAK;
-        continue;
-      case kwLINE:
+        BC_LOOP_NEXT;
+      BC_OP(kwLINE):
         cmd_line();
-        break;
-      case kwCOLOR:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwCOLOR):
         cmd_color();
-        break;
-      case kwOPEN:
+        BC_LOOP_END;
+      BC_OP(kwOPEN):
         cmd_fopen();
-        break;
-      case kwCLOSE:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwCLOSE):
         cmd_fclose();
-        break;
-      case kwFILEWRITE:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwFILEWRITE):
         cmd_fwrite();
-        break;
-      case kwFILEREAD:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwFILEREAD):
         cmd_fread();
-        break;
-      case kwLOGPRINT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwLOGPRINT):
         cmd_print(PV_LOG);
-        break;
-      case kwFILEPRINT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwFILEPRINT):
         cmd_print(PV_FILE);
-        break;
-      case kwSPRINT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwSPRINT):
         cmd_print(PV_STRING);
-        break;
-      case kwLINEINPUT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwLINEINPUT):
         cmd_flineinput();
-        break;
-      case kwSINPUT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwSINPUT):
         cmd_input(PV_STRING);
-        break;
-      case kwFILEINPUT:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwFILEINPUT):
         cmd_input(PV_FILE);
-        break;
-      case kwSEEK:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwSEEK):
         cmd_fseek();
-        break;
-      case kwTRON:
-        opt_trace_on = 1;
-        continue;
-      case kwTROFF:
-        opt_trace_on = 0;
-        continue;
-      case kwSTOP:
-      case kwEND:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwTRON):
+        opt_trace_on |= TRACE_LINES;
+        BC_LOOP_NEXT;
+      BC_OP(kwTROFF):
+        opt_trace_on &= ~TRACE_LINES;
+        BC_LOOP_NEXT;
+      BC_OP(kwSTOP):
+      BC_OP(kwEND):
         bc_loop_end();
-        break;
-      case kwCHAIN:
+        BC_LOOP_END;
+      BC_OP(kwCHAIN):
         cmd_chain();
-        break;
-      case kwRUN:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwRUN):
         cmd_run(1);
-        break;
-      case kwEXEC:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwEXEC):
         cmd_run(0);
-        break;
-      case kwTRY:
+        BC_LOOP_BLOCKING;
+      BC_OP(kwTRY):
         cmd_try();
         IF_ERR_BREAK;
-        continue;
-      case kwCATCH:
+        BC_LOOP_NEXT;
+      BC_OP(kwCATCH):
         cmd_catch();
         IF_ERR_BREAK;
-        continue;
-      case kwENDTRY:
+        BC_LOOP_NEXT;
+      BC_OP(kwENDTRY):
         cmd_end_try();
-        continue;
-      default:
+        BC_LOOP_NEXT;
+      BC_DEFAULT:
         log_printf("OUT OF ADDRESS SPACE\n");
         for (i = 0; keyword_table[i].name[0] != '\0'; i++) {
           if (prog_source[prog_ip] == keyword_table[i].code) {
@@ -1030,25 +1174,7 @@ void bc_loop(int isf) {
         rt_raise("SEG:CODE[%x]=%02x", prog_ip, prog_source[prog_ip]);
       }
     }
-    if (prog_ip < prog_length) {
-      code = prog_source[prog_ip++];
-      if (code == kwTYPE_LINE) {
-        prog_line = code_getaddr();
-        if (opt_trace_on) {
-          dev_trace_line(prog_line);
-        }
-      } else if (code != kwTYPE_EOC) {
-        if (!opt_quiet) {
-          hex_dump(prog_source, prog_length);
-        }
-        prog_ip--;
-        if (code == kwTYPE_SEP) {
-          rt_raise("COMMAND SEPARATOR '%c' FOUND", prog_source[prog_ip + 1]);
-        } else {
-          rt_raise("PARAM COUNT ERROR @%d=%X %d", prog_ip, prog_source[prog_ip], code);
-        }
-      }
-    }
+    bc_loop_end_cmd();
     // quit on error
     IF_ERR_BREAK;
   }
@@ -1166,6 +1292,7 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
   bc_head_t hdr;
   unit_file_t uft;
   byte *source;
+  uint32_t mapped = 0;
   char fname[OS_PATHNAME_SIZE + 1];
 
   if (preloaded_bc) {
@@ -1185,35 +1312,25 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
     } else {
       find_unit(filename, fname);
     }
-    // open & load
-    int h = open(fname, O_RDWR | O_BINARY);
-    if (h == -1) {
-      panic("File '%s' not found", fname);
-    }
     // look if it is already loaded
     if (search_task(fname) != -1) {
-      close(h);
       return search_task(fname);
     }
-    // load it
-    if (libf) {
-      read(h, &uft, sizeof(unit_file_t));
-      lseek(h, sizeof(unit_sym_t) * uft.sym_count, SEEK_CUR);
-    }
-    read(h, &hdr, sizeof(bc_head_t));
-    if (hdr.sbver != SB_DWORD_VER) {
+    // map or load it
+    source = bc_file_load(fname, &mapped);
+    if (source == NULL) {
+      if (access(fname, R_OK) != 0) {
+        panic("File '%s' not found", fname);
+      }
       panic("File '%s' version incorrect", fname);
     }
-    source = malloc(hdr.size + 4);
-    lseek(h, 0, SEEK_SET);
-    read(h, source, hdr.size);
-    close(h);
   }
 
   // create task
   int tid = create_task(fname); // create a task
   activate_task(tid);           // make it active
   ctask->bytecode = source;
+  ctask->bc_mapped = mapped;
   byte *cp = source;
 
   if (memcmp(source, "SBUn", 4) == 0) { // load a unit
@@ -1221,14 +1338,9 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
     cp += sizeof(unit_file_t);
     prog_expcount = uft.sym_count;
 
-    // copy export-symbols from BC
-    if (prog_expcount) {
-      prog_exptable = (unit_sym_t *)malloc(prog_expcount * sizeof(unit_sym_t));
-      for (int i = 0; i < prog_expcount; i++) {
-        memcpy(&prog_exptable[i], cp, sizeof(unit_sym_t));
-        cp += sizeof(unit_sym_t);
-      }
-    }
+    // export-symbols are used in place
+    prog_exptable = (unit_sym_t *)cp;
+    cp += prog_expcount * sizeof(unit_sym_t);
   } else if (memcmp(source, "SBEx", 4) == 0) {
     // load an executable
   } else {
@@ -1253,31 +1365,24 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
   for (int i = 0; i < prog_varcount; i++) {
     tvar[i] = v_new();
   }
-  // create label-table
-  if (prog_labcount) {
-    tlab = malloc(sizeof(lab_t) * prog_labcount);
-    for (int i = 0; i < prog_labcount; i++) {
-      // copy labels from BC
-      memcpy(&tlab[i].ip, cp, ADDRSZ);
-      cp += ADDRSZ;
-    }
-  }
-  // build import-lib table
+
+  // labels are used in place, the headers and tables are all multiples
+  // of four bytes so the table is aligned
+  tlab = (lab_t *)cp;
+  cp += prog_labcount * ADDRSZ;
+
+  // build import-lib table, updated when linked
   if (prog_libcount) {
     prog_libtable = (bc_lib_rec_t *)malloc(prog_libcount * sizeof(bc_lib_rec_t));
-    for (int i = 0; i < prog_libcount; i++) {
-      memcpy(&prog_libtable[i], cp, sizeof(bc_lib_rec_t));
-      cp += sizeof(bc_lib_rec_t);
-    }
+    memcpy(prog_libtable, cp, prog_libcount * sizeof(bc_lib_rec_t));
+    cp += prog_libcount * sizeof(bc_lib_rec_t);
   }
 
-  // build import-symbol table
+  // build import-symbol table, updated when linked
   if (prog_symcount) {
     prog_symtable = (bc_symbol_rec_t *)malloc(prog_symcount * sizeof(bc_symbol_rec_t));
-    for (int i = 0; i < prog_symcount; i++) {
-      memcpy(&prog_symtable[i], cp, sizeof(bc_symbol_rec_t));
-      cp += sizeof(bc_symbol_rec_t);
-    }
+    memcpy(prog_symtable, cp, prog_symcount * sizeof(bc_symbol_rec_t));
+    cp += prog_symcount * sizeof(bc_symbol_rec_t);
   }
 
   // create system stack
@@ -1286,6 +1391,12 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
   prog_stack_count = 0;
   prog_timer = NULL;
 
+  // create the call frames on demand
+  prog_frames = NULL;
+  prog_frame_chunks = 0;
+  prog_frame_sp = 0;
+  prog_frame_base = 0;
+
   // create eval's stack
   eval_size = SB_EVAL_STACK_SIZE;
   eval_stk = malloc(sizeof(var_t) * eval_size);
@@ -1326,6 +1437,14 @@ int exec_close_task() {
       code_pop_and_free();
     }
     free(prog_stack);
+
+    // clean up - any LOCAL variables outside of SUB or FUNC
+    code_pop_frame(0);
+    for (uint32_t i = 0; i < prog_frame_chunks; i++) {
+      free(prog_frames[i]);
+    }
+    free(prog_frames);
+
     // clean up - variables
     for (int i = 0; i < (int) prog_varcount; i++) {
       // do not free imported variables
@@ -1348,23 +1467,18 @@ int exec_close_task() {
     free(tvar);
     ctask->has_sysvars = 0;
 
-    // clean up - rest tables
-    if (prog_expcount) {
-      free(prog_exptable);
-    }
+    // clean up - rest tables, labels and exports are within the bytecode
     if (prog_libcount) {
       free(prog_libtable);
     }
     if (prog_symcount) {
       free(prog_symtable);
     }
-    if (prog_labcount) {
-      free(tlab);
-    }
 
     // clean up - the rest
-    free(ctask->bytecode);
+    bc_file_unload(ctask->bytecode, ctask->bc_mapped);
     ctask->bytecode = NULL;
+    ctask->bc_mapped = 0;
 
     // cleanup the keyboard map
     keymap_free();
@@ -1512,6 +1626,48 @@ int sbasic_recursive_exec(int tid) {
   return success;
 }
 
+/**
+ * compile the given file using the cache in opt_cachepath. the program
+ * is run from the cache file, or after compiling from memory
+ */
+static int sbasic_compile_cached(const char *file) {
+  int success = 1;
+
+  if (bc_file_cache_find(file, execFile)) {
+    ctask->bc_type = 1;
+    ctask->error = 0;
+  } else {
+    // compile-time options that also apply when running
+    byte graphics = opt_graphics;
+    byte antialias = opt_antialias;
+    byte profile = opt_profile;
+    byte show_page = opt_show_page;
+    int pref_width = opt_pref_width;
+    int pref_height = opt_pref_height;
+    char command[OPT_CMD_SZ];
+    strlcpy(command, opt_command, sizeof(command));
+
+    byte nosave = opt_nosave;
+    opt_nosave = 1;
+    execFile[0] = '\0';
+    sys_before_comp();
+    success = comp_compile(file);
+    opt_nosave = nosave;
+
+    // these would not be set when the program is next run from the cache
+    int predef = (graphics != opt_graphics || antialias != opt_antialias ||
+                  profile != opt_profile || show_page != opt_show_page ||
+                  pref_width != opt_pref_width || pref_height != opt_pref_height ||
+                  strcmp(command, opt_command) != 0);
+    if (success && !predef && ctask->bc_type == 1 && ctask->bytecode != NULL) {
+      char cached[OS_PATHNAME_SIZE + 1];
+      bc_file_cache_save(ctask->bytecode, cached);
+    }
+  }
+  bc_file_cache_end();
+  return success;
+}
+
 /**
  * compile the given file into bytecode
  */
@@ -1519,10 +1675,15 @@ int sbasic_compile(const char *file) {
   int comp_rq = 0;              // compilation required = 0
   int success = 1;
 
+  execFile[0] = '\0';
   if (strstr(file, ".sbx") == file + strlen(file) - 4) {
     return success;             // file is an executable
   }
 
+  if (opt_cachepath[0]) {
+    return sbasic_compile_cached(file);
+  }
+
   if (opt_nosave) {
     comp_rq = 1;
   } else {
@@ -1547,10 +1708,8 @@ int sbasic_compile(const char *file) {
       else if ((src_date = sys_filetime(file)) == 0L) {
         comp_rq = 1;
       }
-      if (bin_date >= src_date) {
-        // TODO: check binary version
-        ;
-      } else {
+      if (bin_date < src_date || !bc_file_check(exename)) {
+        // older than the source or created by another version
         comp_rq = 1;
       }
     } else {
@@ -1558,14 +1717,41 @@ int sbasic_compile(const char *file) {
     }
   }
 
+  if (comp_rq && bc_cache != NULL) {
+    // reuse a program previously compiled by the host
+    byte *bytecode = bc_cache->get(file);
+    if (bytecode != NULL) {
+      ctask->bytecode = bytecode;
+      ctask->bc_type = 1;
+      ctask->error = 0;
+      comp_rq = 0;
+    }
+  }
+
   // compile it
   if (comp_rq) {
     sys_before_comp();  // system specific preparations for compilation
+    if (bc_cache != NULL) {
+      bc_file_cache_begin(file);
+    }
     success = comp_compile(file);
+    if (success && bc_cache != NULL && ctask->bytecode != NULL && ctask->bc_type == 1) {
+      int dep_count;
+      const char **deps = bc_file_cache_deps(&dep_count);
+      bc_cache->put(file, ctask->bytecode, deps, dep_count);
+    }
+    bc_file_cache_end();
   }
   return success;
 }
 
+/**
+ * install the host cache used to skip compilation when opt_nosave is set
+ */
+void sbasic_set_bc_cache(const sbasic_bc_cache_t *cache) {
+  bc_cache = cache;
+}
+
 /**
  * initialize executor and run a binary
  */
@@ -1575,7 +1761,11 @@ int sbasic_exec_prepare(const char *filename) {
   v_init_pool();
 
   // load source
-  if (opt_nosave) {
+  if (execFile[0]) {
+    // run the cached program with the name of its source
+    taskId = brun_create_task(execFile, 0, 0);
+    strlcpy(taskinfo(taskId)->file, filename, sizeof(ctask->file));
+  } else if (opt_nosave || opt_cachepath[0]) {
     taskId = brun_create_task(filename, ctask->bytecode, 0);
   } else {
     taskId = brun_create_task(filename, 0, 0);
@@ -1664,7 +1854,13 @@ int sbasic_exec(const char *file) {
     srand(clock());             // randomize
 
     // run
+    if (opt_profile) {
+      prof_begin();
+    }
     sbasic_recursive_exec(exec_tid);
+    if (opt_profile) {
+      prof_end(file);
+    }
 
     // normal exit
     if (!opt_quiet) {
@@ -10,8 +10,8 @@
 #include "common/smbas.h"
 #include "common/bc.h"
 
-static bc_t *bc_in;
-static bc_t *bc_out;
+static SB_TLS bc_t *bc_in;
+static SB_TLS bc_t *bc_out;
 
 #define cev_add1(x)     bc_add_code(bc_out, (x))
 #define cev_add2(x, y)  { bc_add1(bc_out, (x)); bc_add1(bc_out, (y)); }
@@ -35,6 +35,309 @@ void cev_opr_err(void) {
   sc_raise("(EXPR): SYNTAX ERROR (%d)", CODE(IP));
 }
 
+/*
+ * constant folding (opt_optimise). once an operator has been added, any
+ * literal operands are replaced with the result, using the same rules
+ * as the operators in eval.c
+ */
+
+// reads the value of the literal from ip to end in bc_out
+static int cev_get_literal(bcip_t ip, bcip_t end, var_t *v) {
+  byte *p = bc_out->ptr + ip;
+  uint32_t len;
+  int result = 0;
+
+  switch (ip < end ? *p : kwTYPE_EOC) {
+  case kwTYPE_INT:
+    if (end - ip == 1 + OS_INTSZ) {
+      v->type = V_INT;
+      memcpy(&v->v.i, p + 1, OS_INTSZ);
+      result = 1;
+    }
+    break;
+  case kwTYPE_NUM:
+    if (end - ip == 1 + OS_REALSZ) {
+      v->type = V_NUM;
+      memcpy(&v->v.n, p + 1, OS_REALSZ);
+      result = 1;
+    }
+    break;
+  case kwTYPE_STR:
+    memcpy(&len, p + 1, OS_STRLEN);
+    if (end - ip == 1 + OS_STRLEN + len) {
+      // points into bc_out, never freed
+      v->type = V_STR;
+      v->v.p.ptr = (char *)p + 1 + OS_STRLEN;
+      v->v.p.length = len;
+      result = 1;
+    }
+    break;
+  default:
+    break;
+  }
+  return result;
+}
+
+static inline var_num_t cev_num(var_t *v) {
+  return v->type == V_INT ? v->v.i : v->v.n;
+}
+
+static inline var_int_t cev_int(var_t *v) {
+  return v->type == V_INT ? v->v.i : v->v.n;
+}
+
+// replaces the code from ip with the numeric literal r
+static void cev_set_literal(bcip_t ip, var_t *r) {
+  bc_out->count = ip;
+  if (r->type == V_INT) {
+    bc_add_cint(bc_out, r->v.i);
+  } else {
+    bc_add_creal(bc_out, r->v.n);
+  }
+}
+
+static int cev_fold_add(var_t *r, var_t *left, var_t *right, byte op) {
+  if (left->type == V_INT && right->type == V_INT) {
+    r->type = V_INT;
+    r->v.i = op == '+' ? left->v.i + right->v.i : left->v.i - right->v.i;
+  } else {
+    r->type = V_NUM;
+    r->v.n = op == '+' ? cev_num(left) + cev_num(right) : cev_num(left) - cev_num(right);
+  }
+  return 1;
+}
+
+static int cev_fold_mul(var_t *r, var_t *left, var_t *right, byte op) {
+  var_num_t lf = cev_num(left);
+  var_num_t rf = cev_num(right);
+  var_int_t li, ri;
+  int result = 1;
+
+  r->type = V_NUM;
+  switch (op) {
+  case '*':
+    r->v.n = lf * rf;
+    break;
+  case '/':
+    // leave division by zero to raise the error at runtime
+    result = ABS(rf) != 0;
+    if (result) {
+      r->v.n = lf / rf;
+    }
+    break;
+  case '\\':
+    li = lf;
+    ri = rf;
+    result = ri != 0;
+    if (result) {
+      r->type = V_INT;
+      r->v.i = li / ri;
+    }
+    break;
+  case '%':
+  case OPLOG_MOD:
+    result = (var_int_t)rf != 0;
+    if (result) {
+      ri = rf;
+      li = (lf < 0.0) ? -floor(-lf) : floor(lf);
+      r->type = V_INT;
+      r->v.i = li - ri * (li / ri);
+    }
+    break;
+  case OPLOG_MDL:
+    result = rf != 0;
+    if (result) {
+      r->v.n = fmod(lf, rf) + rf * (SGN(lf) != SGN(rf));
+    }
+    break;
+  default:
+    result = 0;
+    break;
+  }
+  return result;
+}
+
+static int cev_fold_cmp(var_t *r, var_t *left, var_t *right, byte op) {
+  int cmp;
+  int result = 1;
+
+  if (left->type == V_STR && right->type == V_STR) {
+    cmp = strcmp(left->v.p.ptr, right->v.p.ptr);
+  } else if (left->type != V_STR && right->type != V_STR) {
+    cmp = v_compare(left, right);
+  } else {
+    return 0;
+  }
+
+  r->type = V_INT;
+  switch (op) {
+  case OPLOG_EQ:
+    r->v.i = (cmp == 0);
+    break;
+  case OPLOG_GT:
+    r->v.i = (cmp > 0);
+    break;
+  case OPLOG_GE:
+    r->v.i = (cmp >= 0);
+    break;
+  case OPLOG_LT:
+    r->v.i = (cmp < 0);
+    break;
+  case OPLOG_LE:
+    r->v.i = (cmp <= 0);
+    break;
+  case OPLOG_NE:
+    r->v.i = (cmp != 0);
+    break;
+  default:
+    // IN and LIKE
+    result = 0;
+    break;
+  }
+  return result;
+}
+
+static int cev_fold_log(var_t *r, var_t *left, var_t *right, byte op) {
+  var_int_t li = cev_int(left);
+  var_int_t ri = cev_int(right);
+  int result = 1;
+
+  r->type = V_INT;
+  switch (op) {
+  case OPLOG_AND:
+    r->v.i = (li && ri) ? 1 : 0;
+    break;
+  case OPLOG_OR:
+    r->v.i = (li || ri) ? 1 : 0;
+    break;
+  case OPLOG_NAND:
+    r->v.i = ~(li & ri);
+    break;
+  case OPLOG_NOR:
+    r->v.i = ~(li | ri);
+    break;
+  case OPLOG_XNOR:
+    r->v.i = ~(li ^ ri);
+    break;
+  case OPLOG_BOR:
+    r->v.i = li | ri;
+    break;
+  case OPLOG_BAND:
+    r->v.i = li & ri;
+    break;
+  case OPLOG_XOR:
+    r->v.i = li ^ ri;
+    break;
+  case OPLOG_LSHIFT:
+  case OPLOG_RSHIFT:
+    result = (ri >= 0 && ri < (var_int_t)sizeof(var_int_t) * 8);
+    if (result) {
+      r->v.i = op == OPLOG_LSHIFT ? li << ri : li >> ri;
+    }
+    break;
+  default:
+    // EQV and IMP
+    result = 0;
+    break;
+  }
+  return result;
+}
+
+// string + string
+static void cev_fold_concat(bcip_t ip, var_t *left, var_t *right) {
+  uint32_t len_l = left->v.p.length - 1;
+  uint32_t len_r = right->v.p.length - 1;
+  char *str = malloc(len_l + len_r);
+  memcpy(str, left->v.p.ptr, len_l);
+  memcpy(str + len_l, right->v.p.ptr, len_r);
+  bc_out->count = ip;
+  bc_add_strn(bc_out, str, len_l + len_r);
+  free(str);
+}
+
+/*
+ * LEFT op R, where the code from left_ip is
+ * [left] kwTYPE_EVPUSH ... [right] kwTYPE_EVPOP [type] [op]
+ */
+static void cev_fold(bcip_t left_ip, bcip_t push_ip, bcip_t right_ip, byte type, byte op) {
+  var_t left;
+  var_t right;
+  var_t r;
+  bcip_t pop_ip = bc_out->count - 3;
+  int folded = 0;
+
+  if (!opt_optimise || comp_error ||
+      !cev_get_literal(left_ip, push_ip, &left) ||
+      !cev_get_literal(right_ip, pop_ip, &right)) {
+    return;
+  }
+
+  if (left.type == V_STR || right.type == V_STR) {
+    if (type == kwTYPE_ADDOPR && op == '+' && left.type == V_STR && right.type == V_STR) {
+      cev_fold_concat(left_ip, &left, &right);
+    } else if (type == kwTYPE_CMPOPR && cev_fold_cmp(&r, &left, &right, op)) {
+      cev_set_literal(left_ip, &r);
+    }
+    return;
+  }
+
+  switch (type) {
+  case kwTYPE_ADDOPR:
+    folded = cev_fold_add(&r, &left, &right, op);
+    break;
+  case kwTYPE_MULOPR:
+    folded = cev_fold_mul(&r, &left, &right, op);
+    break;
+  case kwTYPE_POWOPR:
+    r.type = V_NUM;
+    r.v.n = pow(cev_num(&left), cev_num(&right));
+    folded = 1;
+    break;
+  case kwTYPE_CMPOPR:
+    folded = cev_fold_cmp(&r, &left, &right, op);
+    break;
+  case kwTYPE_LOGOPR:
+    folded = cev_fold_log(&r, &left, &right, op);
+    break;
+  default:
+    break;
+  }
+  if (folded) {
+    cev_set_literal(left_ip, &r);
+  }
+}
+
+// op R, where the code from ip is [r] kwTYPE_UNROPR [op]
+static void cev_fold_unary(bcip_t ip, byte op) {
+  var_t v;
+  if (!opt_optimise || comp_error ||
+      !cev_get_literal(ip, bc_out->count - 2, &v) || v.type == V_STR) {
+    return;
+  }
+  switch (op) {
+  case '-':
+    if (v.type == V_INT) {
+      v.v.i = -v.v.i;
+    } else {
+      v.v.n = -v.v.n;
+    }
+    break;
+  case '+':
+    break;
+  case OPLOG_INV:
+    v.v.i = ~cev_int(&v);
+    v.type = V_INT;
+    break;
+  case OPLOG_NOT:
+    v.v.i = !cev_int(&v);
+    v.type = V_INT;
+    break;
+  default:
+    return;
+  }
+  cev_set_literal(ip, &v);
+}
+
 void cev_prim_str() {
   uint32_t len;
   memcpy(&len, bc_in->ptr + bc_in->cp, OS_STRLEN);
@@ -245,10 +548,12 @@ void cev_unary() {
   } else {
     op = 0;
   }
+  bcip_t ip = bc_out->count;
   cev_parenth();        // R = cev_parenth
   if (op) {
     cev_add1(kwTYPE_UNROPR);
     cev_add1(op);       // R = op R
+    cev_fold_unary(ip, op);
   }
 }
 
@@ -256,17 +561,20 @@ void cev_unary() {
  * pow
  */
 void cev_pow() {
+  bcip_t left_ip = bc_out->count;
   cev_unary();                  // R = cev_unary
 
   IF_ERR_RTN;
   while (CODE(IP) == kwTYPE_POWOPR) {
     IP += 2;
 
+    bcip_t push_ip = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
     cev_unary();                // R = cev_unary
     IF_ERR_RTN;
     cev_add1(kwTYPE_EVPOP);     // POP LEFT
     cev_add2(kwTYPE_POWOPR, '^'); // R = LEFT op R
+    cev_fold(left_ip, push_ip, push_ip + 1, kwTYPE_POWOPR, '^');
   }
 }
 
@@ -274,6 +582,7 @@ void cev_pow() {
  * mul | div | mod
  */
 void cev_mul() {
+  bcip_t left_ip = bc_out->count;
   cev_pow();                    // R = cev_pow()
 
   IF_ERR_RTN;
@@ -282,12 +591,14 @@ void cev_mul() {
 
     op = CODE(++IP);
     IP++;
+    bcip_t push_ip = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
 
     cev_pow();
     IF_ERR_RTN;
     cev_add1(kwTYPE_EVPOP);      // POP LEFT
     cev_add2(kwTYPE_MULOPR, op); // R = LEFT op R
+    cev_fold(left_ip, push_ip, push_ip + 1, kwTYPE_MULOPR, op);
   }
 }
 
@@ -295,6 +606,7 @@ void cev_mul() {
  * add | sub
  */
 void cev_add() {
+  bcip_t left_ip = bc_out->count;
   cev_mul();                    // R = cev_mul()
 
   IF_ERR_RTN;
@@ -304,6 +616,7 @@ void cev_add() {
     IP++;
     op = CODE(IP);
     IP++;
+    bcip_t push_ip = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
 
     cev_mul();                  // R = cev_mul
@@ -311,6 +624,7 @@ void cev_add() {
 
     cev_add1(kwTYPE_EVPOP);    // POP LEFT
     cev_add2(kwTYPE_ADDOPR, op); // R = LEFT op R
+    cev_fold(left_ip, push_ip, push_ip + 1, kwTYPE_ADDOPR, op);
   }
 }
 
@@ -318,6 +632,7 @@ void cev_add() {
  * compare
  */
 void cev_cmp() {
+  bcip_t left_ip = bc_out->count;
   cev_add();                    // R = cev_add()
 
   IF_ERR_RTN;
@@ -327,11 +642,13 @@ void cev_cmp() {
     IP++;
     op = CODE(IP);
     IP++;
+    bcip_t push_ip = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
     cev_add();                  // R = cev_add()
     IF_ERR_RTN;
     cev_add1(kwTYPE_EVPOP);         // POP LEFT
     cev_add2(kwTYPE_CMPOPR, op);    // R = LEFT op R
+    cev_fold(left_ip, push_ip, push_ip + 1, kwTYPE_CMPOPR, op);
   }
 }
 
@@ -339,6 +656,7 @@ void cev_cmp() {
  * logical
  */
 void cev_log(void) {
+  bcip_t left_ip = bc_out->count;
   cev_cmp();                    // R = cev_cmp()
   IF_ERR_RTN;
   while (CODE(IP) == kwTYPE_LOGOPR) {
@@ -350,6 +668,7 @@ void cev_log(void) {
     op = CODE(IP);
     IP++;
 
+    bcip_t push_ip = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R (push the left side result
     cev_add1(kwTYPE_EVAL_SC);
     cev_add2(kwTYPE_LOGOPR, op);
@@ -363,6 +682,7 @@ void cev_log(void) {
 
     shortcut_offs = bc_out->count - shortcut;
     memcpy(bc_out->ptr + shortcut, &shortcut_offs, ADDRSZ);
+    cev_fold(left_ip, push_ip, shortcut + ADDRSZ, kwTYPE_LOGOPR, op);
   }
 }
 
@@ -123,34 +123,34 @@ enum os_charset_codes {
 };
 
 #if !defined(DEVICE_MODULE)
-extern byte os_charset;
+extern SB_TLS byte os_charset;
 
 extern byte os_color;         // true if the output has real colors (256+ colors)
-extern byte os_graphics;      // non-zero if the driver supports graphics
-extern int os_graf_mx;        // graphic mode: maximum x
-extern int os_graf_my;        // graphic mode: maximum y
+extern SB_TLS byte os_graphics; // non-zero if the driver supports graphics
+extern SB_TLS int os_graf_mx; // graphic mode: maximum x
+extern SB_TLS int os_graf_my; // graphic mode: maximum y
 
 // graphics - viewport
-extern int32_t dev_Vx1;
-extern int32_t dev_Vy1;
-extern int32_t dev_Vx2;
-extern int32_t dev_Vy2;
+extern SB_TLS int32_t dev_Vx1;
+extern SB_TLS int32_t dev_Vy1;
+extern SB_TLS int32_t dev_Vx2;
+extern SB_TLS int32_t dev_Vy2;
 
-extern int32_t dev_Vdx;
-extern int32_t dev_Vdy;
+extern SB_TLS int32_t dev_Vdx;
+extern SB_TLS int32_t dev_Vdy;
 
 // graphics - window world coordinates
-extern int32_t dev_Wx1;
-extern int32_t dev_Wy1;
-extern int32_t dev_Wx2;
-extern int32_t dev_Wy2;
+extern SB_TLS int32_t dev_Wx1;
+extern SB_TLS int32_t dev_Wy1;
+extern SB_TLS int32_t dev_Wx2;
+extern SB_TLS int32_t dev_Wy2;
 
-extern int32_t dev_Wdx;
-extern int32_t dev_Wdy;
+extern SB_TLS int32_t dev_Wdx;
+extern SB_TLS int32_t dev_Wdy;
 
 // graphics - current colors
-extern long dev_fgcolor;
-extern long dev_bgcolor;
+extern SB_TLS long dev_fgcolor;
+extern SB_TLS long dev_bgcolor;
 
 #endif
 
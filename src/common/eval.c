@@ -15,6 +15,8 @@
 #include "common/device.h"
 #include "common/plugins.h"
 #include "common/var_eval.h"
+#include "common/blib_math.h"
+#include "common/profile.h"
 
 #define IP           prog_ip
 #define CODE(x)      prog_source[(x)]
@@ -33,21 +35,20 @@
   }
 
 //
-// matrix: convert var_t to double[r][c]
+// matrix: the dimensions of v, returns the number of elements or -1 when v is not a matrix
 //
-var_num_t *mat_toc(var_t *v, int32_t *rows, int32_t *cols) {
-  var_num_t *m = NULL;
+static int mat_size(var_t *v, int32_t *rows, int32_t *cols) {
   *rows = *cols = 0;
 
   if (!v) {
     // uninitialised variable
-    return NULL;
+    return -1;
   }
 
   if (v_maxdim(v) > 2) {
     // too many dimensions
     err_matdim();
-    return NULL;
+    return -1;
   }
   *rows = ABS(v_lbound(v, 0) - v_ubound(v, 0)) + 1;
 
@@ -58,34 +59,89 @@ var_num_t *mat_toc(var_t *v, int32_t *rows, int32_t *cols) {
     *rows = 1;
   }
 
-  m = (var_num_t *)malloc(((*rows) * (*cols)) * sizeof(var_num_t));
-  for (int i = 0; i < *rows; i++) {
-    for (int j = 0; j < *cols; j++) {
-      int pos = i * (*cols) + j;
-      var_t *e = v_elem(v, pos);
-      m[pos] = v_getval(e);
+  int size = (*rows) * (*cols);
+  if (size > v_asize(v)) {
+    // the bounds don't match the elements, eg an empty array
+    err_matdim();
+    return -1;
+  }
+  return size;
+}
+
+//
+// matrix: the elements of v as double[r][c]. packed reals are used in place,
+// otherwise the elements are converted into *copy which the caller frees
+//
+static var_num_t *mat_get(var_t *v, int32_t *rows, int32_t *cols, var_num_t **copy) {
+  var_num_t *m = NULL;
+  *copy = NULL;
+
+  int size = mat_size(v, rows, cols);
+  if (size == -1) {
+    return NULL;
+  }
+
+  switch (v_packed(v)) {
+  case V_PACK_NUM:
+    m = v_nums(v);
+    break;
+  case V_PACK_INT:
+    m = *copy = (var_num_t *)malloc(size * sizeof(var_num_t));
+    for (int pos = 0; pos < size; pos++) {
+      m[pos] = v_ints(v)[pos];
     }
+    break;
+  default:
+    m = *copy = (var_num_t *)malloc(size * sizeof(var_num_t));
+    for (int pos = 0; pos < size; pos++) {
+      m[pos] = v_getval(v_elem(v, pos));
+    }
+    break;
   }
 
   return m;
 }
 
 //
-// matrix: conv. double[nr][nc] to var_t
+// matrix: convert var_t to double[r][c]
 //
-void mat_tov(var_t *v, var_num_t *m, int32_t rows, int32_t cols, int protect_col1) {
+var_num_t *mat_toc(var_t *v, int32_t *rows, int32_t *cols) {
+  var_num_t *copy;
+  var_num_t *m = mat_get(v, rows, cols, &copy);
+  if (m != NULL && copy == NULL) {
+    int size = (*rows) * (*cols);
+    copy = (var_num_t *)malloc(size * sizeof(var_num_t));
+    memcpy(copy, m, size * sizeof(var_num_t));
+  }
+  return copy;
+}
+
+//
+// matrix: creates v as packed double[nr][nc], returns the elements
+//
+static var_num_t *mat_new(var_t *v, int32_t rows, int32_t cols, int protect_col1) {
+  if (rows < 1 || cols < 1) {
+    v_toarray1(v, 0);
+    return NULL;
+  }
+  v_free(v);
+  v_new_packed(v, rows * cols, V_PACK_NUM);
   if (cols > 1 || protect_col1) {
-    v_tomatrix(v, rows, cols);
-  } else {
-    v_toarray1(v, rows);
+    v_maxdim(v) = 2;
+    v_lbound(v, 1) = opt_base;
+    v_ubound(v, 0) = opt_base + (rows - 1);
+    v_ubound(v, 1) = opt_base + (cols - 1);
   }
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      int pos = i * cols + j;
-      var_t *e = v_elem(v, pos);
-      e->type = V_NUM;
-      e->v.n = m[pos];
-    }
+  return prog_error ? NULL : v_nums(v);
+}
+
+//
+// matrix: conv. double[nr][nc] to var_t
+//
+void mat_tov(var_t *v, var_num_t *m, int32_t rows, int32_t cols, int protect_col1) {
+  var_num_t *data = mat_new(v, rows, cols, protect_col1);
+  if (data != NULL) {
+    memcpy(data, m, rows * cols * sizeof(var_num_t));
   }
 }
 
@@ -94,33 +150,35 @@ void mat_tov(var_t *v, var_num_t *m, int32_t rows, int32_t cols, int protect_col
 //
 void mat_op1(var_t *l, int op, var_num_t n) {
   int32_t lr, lc;
+  var_num_t *copy;
 
-  var_num_t *m1 = mat_toc(l, &lr, &lc);
+  var_num_t *m1 = mat_get(l, &lr, &lc, &copy);
   if (m1) {
-    var_num_t *m = (var_num_t *)malloc(sizeof(var_num_t) * lr * lc);
-    for (int i = 0; i < lr; i++) {
-      for (int j = 0; j < lc; j++) {
-        int pos = i * lc + j;
-        switch (op) {
-        case '*':
-          m[pos] = m1[pos] * n;
-          break;
-        case 'A':
-          m[pos] = -m1[pos];
-          break;
-        default:
-          m[pos] = 0;
-          break;
-        }
-      }
-    }
+    // l may hold m1, so build the result separately
+    var_t result;
+    v_init(&result);
+    var_num_t *m;
     if (v_maxdim(l) == 1) {
-      mat_tov(l, m, lc, 1, 0);
+      m = mat_new(&result, lc, 1, 0);
     } else {
-      mat_tov(l, m, lr, lc, 1);
+      m = mat_new(&result, lr, lc, 1);
     }
-    free(m1);
-    free(m);
+    int size = lr * lc;
+    for (int pos = 0; m != NULL && pos < size; pos++) {
+      switch (op) {
+      case '*':
+        m[pos] = m1[pos] * n;
+        break;
+      case 'A':
+        m[pos] = -m1[pos];
+        break;
+      default:
+        m[pos] = 0;
+        break;
+      }
+    }
+    v_move(l, &result);
+    free(copy);
   }
 }
 
@@ -143,42 +201,41 @@ void mat_mulN(var_t *v, var_num_t N) {
 //
 void mat_op2(var_t *l, var_t *r, int op) {
   int32_t lr, lc, rr, rc;
+  var_num_t *copy1, *copy2;
 
-  var_num_t *m1 = mat_toc(l, &lr, &lc);
+  var_num_t *m1 = mat_get(l, &lr, &lc, &copy1);
   if (m1) {
-    var_num_t *m2 = mat_toc(r, &rr, &rc);
+    var_num_t *m2 = mat_get(r, &rr, &rc, &copy2);
     if (m2) {
-      var_num_t *m = NULL;
       if (rc != lc || lr != rr) {
         err_matdim();
       } else {
-        m = (var_num_t *)malloc(sizeof(var_num_t) * lr * lc);
-        for (int i = 0; i < lr; i++) {
-          for (int j = 0; j < lc; j++) {
-            int pos = i * lc + j;
-            if (op == '+') {
-              m[pos] = m1[pos] + m2[pos];
-            } else {
-              m[pos] = m2[pos] - m1[pos];
-            }
-            // array is reversed because of where to store
-          }
-        }
-      }
-
-      free(m1);
-      free(m2);
-      if (m) {
+        var_t result;
+        v_init(&result);
+        var_num_t *m;
         if (v_maxdim(r) == 1) {
-          mat_tov(l, m, lc, 1, 0);
+          m = mat_new(&result, lc, 1, 0);
         } else {
-          mat_tov(l, m, lr, lc, 1);
+          m = mat_new(&result, lr, lc, 1);
         }
-        free(m);
+        int size = lr * lc;
+        if (m == NULL) {
+          // error
+        } else if (op == '+') {
+          for (int pos = 0; pos < size; pos++) {
+            m[pos] = m1[pos] + m2[pos];
+          }
+        } else {
+          // array is reversed because of where to store
+          for (int pos = 0; pos < size; pos++) {
+            m[pos] = m2[pos] - m1[pos];
+          }
+        }
+        v_move(l, &result);
       }
-    } else {
-      free(m1);
+      free(copy2);
     }
+    free(copy1);
   }
 }
 
@@ -195,11 +252,20 @@ void mat_sub(var_t *l, var_t *r) {
 //
 void mat_mul_1d(var_t *l, var_t *r) {
   uint32_t size = v_asize(l);
+  var_t tmp;
+  v_unshare(r);
+  if (v_packed(r) != V_PACK_NUM) {
+    v_unpack(r);
+  }
   for (uint32_t i = 0; i < size; i++) {
-    var_t *elem = v_elem(r, i);
-    var_num_t v1 = v_getval(v_elem(l, i));
-    var_num_t v2 = v_getval(elem);
-    v_setreal(elem, (v1 * v2));
+    var_num_t v1 = v_getval(v_elem_read(l, i, &tmp));
+    if (v_packed(r)) {
+      v_nums(r)[i] *= v1;
+    } else {
+      var_t *elem = v_elem(r, i);
+      var_num_t v2 = v_getval(elem);
+      v_setreal(elem, (v1 * v2));
+    }
   }
 }
 
@@ -209,10 +275,19 @@ void mat_mul_1d(var_t *l, var_t *r) {
 void mat_dot(var_t *l, var_t *r) {
   var_num_t result = 0;
   uint32_t size = v_asize(l);
-  for (uint32_t i = 0; i < size; i++) {
-    var_num_t v1 = v_getval(v_elem(l, i));
-    var_num_t v2 = v_getval(v_elem(r, i));
-    result += (v1 * v2);
+  if (v_packed(l) == V_PACK_NUM && v_packed(r) == V_PACK_NUM && size <= v_asize(r)) {
+    const var_num_t *m1 = v_nums(l);
+    const var_num_t *m2 = v_nums(r);
+    for (uint32_t i = 0; i < size; i++) {
+      result += m1[i] * m2[i];
+    }
+  } else {
+    var_t tmp;
+    for (uint32_t i = 0; i < size; i++) {
+      var_num_t v1 = v_getval(v_elem_read(l, i, &tmp));
+      var_num_t v2 = v_getval(v_elem_read(r, i, &tmp));
+      result += (v1 * v2);
+    }
   }
   v_setreal(r, result);
 }
@@ -222,39 +297,27 @@ void mat_dot(var_t *l, var_t *r) {
 //
 void mat_mul(var_t *l, var_t *r) {
   int32_t lr, lc, rr, rc;
+  var_num_t *copy1, *copy2;
 
-  var_num_t *m1 = mat_toc(l, &lr, &lc);
+  var_num_t *m1 = mat_get(l, &lr, &lc, &copy1);
   if (m1) {
-    var_num_t *m2 = mat_toc(r, &rr, &rc);
+    var_num_t *m2 = mat_get(r, &rr, &rc, &copy2);
     if (m2) {
-      var_num_t *m = NULL;
-      int mr = 0;
-      int mc = 0;
       if (lc != rr) {
         err_matdim();
       } else {
-        mr = lr;
-        mc = rc;
-        m = (var_num_t *)malloc(sizeof(var_num_t) * mr * mc);
-        for (int i = 0; i < mr; i++) {
-          for (int j = 0; j < mc; j++) {
-            int pos = i * mc + j;
-            m[pos] = 0.0;
-            for (int k = 0; k < lc; k++) {
-              m[pos] = m[pos] + (m1[i * lc + k] * m2[k * rc + j]);
-            }
-          }
+        // r may hold m2, so build the result separately
+        var_t result;
+        v_init(&result);
+        var_num_t *m = mat_new(&result, lr, rc, 1);
+        if (m != NULL) {
+          mat_product(m, m1, m2, lr, lc, rc);
         }
+        v_move(r, &result);
       }
-      free(m1);
-      free(m2);
-      if (m) {
-        mat_tov(r, m, mr, mc, 1);
-        free(m);
-      }
-    } else {
-      free(m1);
+      free(copy2);
     }
+    free(copy1);
   }
 }
 
@@ -277,7 +340,8 @@ int v_wc_match(var_t *vwc, var_t *v) {
     int i;
     ri = 1;
     for (i = 0; i < v_asize(v); i++) {
-      var_t *elem_p = v_elem(v, i);
+      var_t tmp;
+      var_t *elem_p = v_elem_read(v, i, &tmp);
       if (v_wc_match(vwc, elem_p) == 0) {
         ri = 0;
         break;
@@ -297,9 +361,7 @@ int v_wc_match(var_t *vwc, var_t *v) {
   return ri;
 }
 
-static inline void oper_add(var_t *r, var_t *left) {
-  byte op = CODE(IP);
-  IP++;
+static inline void oper_add_op(var_t *r, var_t *left, byte op) {
   if (r->type == V_INT && v_is_type(left, V_INT)) {
     if (op == '+') {
       r->v.i += left->v.i;
@@ -362,6 +424,12 @@ static inline void oper_add(var_t *r, var_t *left) {
   }
 }
 
+static inline void oper_add(var_t *r, var_t *left) {
+  byte op = CODE(IP);
+  IP++;
+  oper_add_op(r, left, op);
+}
+
 static inline void oper_mul(var_t *r, var_t *left) {
   var_num_t lf;
   var_num_t rf;
@@ -635,7 +703,8 @@ static inline void oper_cmp(var_t *r, var_t *left) {
     if (r->type == V_ARRAY) {
       int i;
       for (i = 0; i < v_asize(r); i++) {
-        var_t *elem_p = v_elem(r, i);
+        var_t tmp;
+        var_t *elem_p = v_elem_read(r, i, &tmp);
         if (v_compare(left, elem_p) == 0) {
           ri = i + 1;
           break;
@@ -840,6 +909,11 @@ static inline void eval_extf(var_t *r) {
   V_FREE(r);
   if (lib & UID_UNIT_BIT) {
     unit_exec(lib & (~UID_UNIT_BIT), idx, r);
+  } else if (opt_profile) {
+    int prof_token = prof_enter(PROF_PLUGIN, (lib << 17) | prog_symtable[idx].exp_idx,
+                                prog_symtable[idx].symbol);
+    plugin_funcexec(lib, prog_symtable[idx].exp_idx, r);
+    prof_leave(prof_token);
   } else {
     plugin_funcexec(lib, prog_symtable[idx].exp_idx, r);
   }
@@ -1054,6 +1128,7 @@ static inline void eval_callf_free(var_t *r) {
 
 static inline void eval_callf(var_t *r) {
   long fcode = code_getaddr();
+  int prof_token = opt_profile ? prof_enter(PROF_CALLF, fcode, NULL) : 0;
   V_FREE(r);
 
   switch (fcode) {
@@ -1233,8 +1308,31 @@ static inline void eval_callf(var_t *r) {
   default:
     err_bfn_err(fcode);
   }
+  if (opt_profile) {
+    prof_leave(prof_token);
+  }
 }
 
+//
+// r = var_p op r, as for the '+' and '-' operators
+//
+void eval_add_var(var_t *r, var_t *var_p, byte op) {
+  var_t left;
+  v_init(&left);
+  eval_var(&left, var_p);
+  if (!prog_error) {
+    oper_add_op(r, &left, op);
+  }
+  v_free(&left);
+}
+
+//
+// continues with the handler of the next opcode
+//
+#define EVAL_NEXT \
+  BC_GOTO(threaded && !prog_error, code = prog_source[prog_ip]); \
+  break
+
 //
 // executes the expression (Code[IP]) and returns the result (r)
 //
@@ -1243,48 +1341,64 @@ void eval(var_t *r) {
   bcip_t eval_pos = eval_sp;
   byte level = 0;
 
+#if defined(BC_THREADED)
+  static const void *dispatch[256] = {
+    [0 ... 255] = &&L_kwDEFAULT,
+    BC_LABEL(kwTYPE_INT), BC_LABEL(kwTYPE_NUM), BC_LABEL(kwTYPE_ADDOPR), BC_LABEL(kwTYPE_MULOPR),
+    BC_LABEL(kwTYPE_VAR), BC_LABEL(kwTYPE_LEVEL_BEGIN), BC_LABEL(kwTYPE_LEVEL_END), BC_LABEL(kwTYPE_EVPUSH),
+    BC_LABEL(kwTYPE_EVPOP), BC_LABEL(kwTYPE_CALLF), BC_LABEL(kwTYPE_STR), BC_LABEL(kwTYPE_LOGOPR),
+    BC_LABEL(kwTYPE_CMPOPR), BC_LABEL(kwTYPE_POWOPR), BC_LABEL(kwTYPE_UNROPR), BC_LABEL(kwTYPE_EVAL_SC),
+    BC_LABEL(kwTYPE_CALL_UDF), BC_LABEL(kwTYPE_CALLEXTF), BC_LABEL(kwTYPE_PTR), BC_LABEL(kwBYREF)
+  };
+#endif
+
+  byte code;
+#if defined(BC_THREADED)
+  int threaded = !opt_switch_dispatch;
+#endif
+
   while (!prog_error) {
-    byte code = prog_source[prog_ip];
+    code = prog_source[prog_ip];
     switch (code) {
-    case kwTYPE_INT:
+    BC_OP(kwTYPE_INT):
       // integer - constant
       IP++;
       V_FREE(r);
       r->type = V_INT;
       r->v.i = code_getint();
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_NUM:
+    BC_OP(kwTYPE_NUM):
       // double - constant
       IP++;
       V_FREE(r);
       r->type = V_NUM;
       r->v.n = code_getreal();
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_ADDOPR:
+    BC_OP(kwTYPE_ADDOPR):
       IP++;
       oper_add(r, left);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_MULOPR:
+    BC_OP(kwTYPE_MULOPR):
       IP++;
       oper_mul(r, left);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_VAR:
+    BC_OP(kwTYPE_VAR):
       // variable
       V_FREE(r);
-      eval_var(r, code_getvarptr());
-      break;
+      eval_var(r, code_getvarptr_read());
+      EVAL_NEXT;
 
-    case kwTYPE_LEVEL_BEGIN:
+    BC_OP(kwTYPE_LEVEL_BEGIN):
       // left parenthesis
       IP++;
       level++;
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_LEVEL_END:
+    BC_OP(kwTYPE_LEVEL_END):
       // right parenthesis
       if (level == 0) {
         eval_sp = eval_pos;
@@ -1293,15 +1407,15 @@ void eval(var_t *r) {
       }
       level--;
       IP++;
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_EVPUSH:
+    BC_OP(kwTYPE_EVPUSH):
       // stack = push result
       IP++;
       eval_push(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_EVPOP:
+    BC_OP(kwTYPE_EVPOP):
       // pop left
       IP++;
       if (!eval_sp) {
@@ -1310,69 +1424,69 @@ void eval(var_t *r) {
       }
       eval_sp--;
       left = &eval_stk[eval_sp];
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_CALLF:
+    BC_OP(kwTYPE_CALLF):
       // built-in functions
       IP++;
       eval_callf(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_STR:
+    BC_OP(kwTYPE_STR):
       // string - constant
       IP++;
       V_FREE(r);
       v_eval_str(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_LOGOPR:
+    BC_OP(kwTYPE_LOGOPR):
       IP++;
       oper_log(r, left);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_CMPOPR:
+    BC_OP(kwTYPE_CMPOPR):
       IP++;
       oper_cmp(r, left);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_POWOPR:
+    BC_OP(kwTYPE_POWOPR):
       IP++;
       oper_powr(r, left);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_UNROPR:
+    BC_OP(kwTYPE_UNROPR):
       // unary
       IP++;
       oper_unary(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_EVAL_SC:
+    BC_OP(kwTYPE_EVAL_SC):
       IP++;
       eval_shortc(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_CALL_UDF:
+    BC_OP(kwTYPE_CALL_UDF):
       eval_call_udf(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_CALLEXTF:
+    BC_OP(kwTYPE_CALLEXTF):
       // [lib][index] external functions
       IP++;
       eval_extf(r);
-      break;
+      EVAL_NEXT;
 
-    case kwTYPE_PTR:
+    BC_OP(kwTYPE_PTR):
       // UDF pointer - constant
       IP++;
       eval_ptr(r);
-      break;
+      EVAL_NEXT;
 
-    case kwBYREF:
+    BC_OP(kwBYREF):
       // unexpected code
       err_evsyntax();
       return;
 
-    default: {
+    BC_DEFAULT: {
       if (code == kwTYPE_LINE ||
           code == kwTYPE_SEP ||
           code == kwTO ||
@@ -1,7 +1,7 @@
 // This file is part of SmallBASIC
 //
-// FloodFill - Source code is based on:
-//   "Programmer's guide to PC & PS/2 Video Systems"
+// FloodFill - scanline fill using a stack of seeds and a bitmap of
+// filled pixels
 //
 // This program is distributed under the terms of the GPL v2.0 or later
 // Download the GNU Public License (GPL) from www.gnu.org
@@ -10,395 +10,259 @@
 
 #include "common/sys.h"
 #include "common/device.h"
+#include "common/sberr.h"
+#include "include/osd.h"
 
-#define QUEUESIZE   2048
-#define UP          1
-#define DN          -1
-#define FILLED      1
-#define NOT_FILLED  0
 #define SCAN_UNTIL  0
 #define SCAN_WHILE  1
+#define SEED_INC    256
+#define EVENT_SPANS 1024
+
+typedef struct {
+  int x;
+  int y;
+} ff_seed_t;
+
+typedef struct {
+  int x1, y1;         // fill area (viewport)
+  int width, height;
+  long color;         // the border color, or with SCAN_WHILE the color to fill over
+  int scan_type;
+  uint8_t *closed;    // one bit per pixel, set once filled or known to be outside
+  uint8_t *loaded;    // rows read with osd_getrow(), NULL when reading pixels
+  long *row;
+  ff_seed_t *seeds;
+  int seed_count;
+  int seed_size;
+} ff_t;
+
+static inline int ff_match(ff_t *ff, long color) {
+  return ff->scan_type == SCAN_UNTIL ? color != ff->color : color == ff->color;
+}
 
-struct tagParams {
-  uint16_t xl;  // leftmost pixel in run
-  uint16_t xr;  // rightmost pixel in run
-  int16_t y;  // y-coordinate of run
-  byte f;  // TRUE if run is filled (blocked)
-};
-
-struct tagQUEUE {
-  struct tagQUEUE *pQ;  // pointer to opposite queue
-  int d;  // direction (UP or DN)
-  int n;  // number of unfilled runs in queue
-  int h;  // index of head of queue
-  int t;  // index of tail of queue
-  struct tagParams *run;
-};
-typedef struct tagQUEUE QUEUE;
-
-// Global variables of the module.
-static struct tagParams ff_buf1[QUEUESIZE];
-static struct tagParams ff_buf2[QUEUESIZE];
-static long ucBorder;
-static QUEUE Qup;
-static QUEUE Qdn;
-static int scan_type;
-
-uint16_t ff_scan_left(uint16_t, uint16_t, long, int);
-uint16_t ff_scan_right(uint16_t, uint16_t, long, int);
-uint16_t ff_next_branch(uint16_t, uint16_t, int);
-void ff_add_queue(QUEUE *, uint16_t, uint16_t, int, int);
-int ff_in_queue(QUEUE *, uint16_t, uint16_t, int);
-
-void dev_ffill(uint16_t x0, uint16_t y0, long fill_color, long border_color) {
-  int y = y0, qp;
-  int bChangeDirection;
-  uint16_t x, xl = x0, xr = x0, xln, xrn;
-  QUEUE *Q;
-  long pcolor;
+static inline uint32_t ff_index(ff_t *ff, int x, int y) {
+  return (uint32_t)(y - ff->y1) * ff->width + (x - ff->x1);
+}
 
-  // reset all globals
-  memset(ff_buf1, 0, sizeof(ff_buf1));
-  memset(ff_buf2, 0, sizeof(ff_buf2));
-  memset(&Qup, 0, sizeof(QUEUE));
-  memset(&Qdn, 0, sizeof(QUEUE));
-  ucBorder = 0;
-  scan_type = 0;
+static inline int ff_is_closed(ff_t *ff, uint32_t i) {
+  return ff->closed[i >> 3] & (1 << (i & 7));
+}
 
-  pcolor = dev_fgcolor;
-  dev_setcolor(fill_color);
+static inline void ff_set_closed(ff_t *ff, uint32_t i) {
+  ff->closed[i >> 3] |= (1 << (i & 7));
+}
 
-  // do nothing if the seed pixel is a border pixel
-  if (border_color == -1) {
-    border_color = dev_getpixel(x0, y0);
-    scan_type = SCAN_WHILE;
-  } else {
-    scan_type = SCAN_UNTIL;
-  }
-  if (scan_type == SCAN_UNTIL) {
-    if (dev_getpixel(x0, y0) == border_color) {
-      return;
+// reads the row once, closing the pixels that are outside the fill
+static void ff_load_row(ff_t *ff, int y) {
+  if (osd_getrow(ff->x1, y, ff->width, ff->row)) {
+    uint32_t i = ff_index(ff, ff->x1, y);
+    for (int x = 0; x < ff->width; x++, i++) {
+      if (!ff_match(ff, ff->row[x])) {
+        ff_set_closed(ff, i);
+      }
     }
+    ff->loaded[y - ff->y1] = 1;
   } else {
-    if (dev_getpixel(x0, y0) == fill_color) {
-      return;
-    }
+    // the driver cannot read rows after all
+    free(ff->loaded);
+    ff->loaded = NULL;
   }
+}
 
-  Qup.run = ff_buf1;
-  Qdn.run = ff_buf2;
-
-  // save the border and fill values in global variables
-  ucBorder = border_color;
-
-  // initialize the queues
-  Qup.pQ = &Qdn;  // pointer to opposite queue
-  Qup.d = UP;  // direction for queue
-  Qup.h = -1;
-  Qup.t = 0;
-
-  Qdn.pQ = &Qup;
-  Qdn.d = DN;
-  Qdn.h = -1;
-  Qdn.t = 0;
-
-  // put the seed run in the up queue
-  Q = &Qup;
-  ff_add_queue(Q, ff_scan_left(x0, y0, ucBorder, scan_type),
-               ff_scan_right(x0, y0, ucBorder, scan_type), y0, NOT_FILLED);
-
-  // main loop
-  for (;;) {
-    if (dev_events(0) < 0) {
-      break;
-    }
-
-    // if the queue is empty, switch queues
-    if (Q->n == 0) {
-      Q = Q->pQ;
-
-      // exit if the other queue is empty
-      if (Q->n == 0) {
-        break;
-      }
-    }
-
-    // get the first non-filled run from the head of the queue
-    qp = Q->h;
-    while (qp >= Q->t) {
-      if (!Q->run[qp].f) {
-        y = Q->run[qp].y;
-        xl = Q->run[qp].xl;
-        xr = Q->run[qp].xr;
+// returns whether the pixel is still to be filled
+static inline int ff_inside(ff_t *ff, int x, int y) {
+  uint32_t i = ff_index(ff, x, y);
+  int result;
+  if (ff_is_closed(ff, i)) {
+    result = 0;
+  } else if (ff->loaded) {
+    result = 1;
+  } else {
+    result = ff_match(ff, dev_getpixel(x, y));
+  }
+  return result;
+}
 
-        // fill the run
-        dev_line(xl, y, xr, y);
-        Q->run[qp].f = FILLED;
-        Q->n--;
+// returns the first x from x to x2 (inclusive) where ff_inside() is the
+// given value, or x2 + 1. once the row is loaded, the bitmap is scanned
+// a byte at a time where possible
+static int ff_find(ff_t *ff, int x, int x2, int y, int inside) {
+  if (ff->loaded && !ff->loaded[y - ff->y1]) {
+    ff_load_row(ff, y);
+  }
+  if (ff->loaded) {
+    uint32_t i = ff_index(ff, x, y);
+    uint32_t end = i + (x2 - x) + 1;
+    uint8_t skip = inside ? 0xff : 0;
+    while (i < end) {
+      if ((i & 7) == 0 && i + 8 <= end && ff->closed[i >> 3] == skip) {
+        i += 8;
+      } else if ((ff_is_closed(ff, i) == 0) == inside) {
         break;
       } else {
-        qp--;
+        i++;
       }
     }
-
-    // remove previously-filled runs from the current queue
-    if (Q->d == UP) {
-      while ((Q->h > qp) && (Q->run[Q->h].y < (y - 1))) {
-        Q->h--;
-      }
-    } else {
-      while ((Q->h > qp) && (Q->run[Q->h].y > (y + 1))) {
-        Q->h--;
-      }
-    }
-
-    // branch in the current direction
-    xln = ff_next_branch(xl, xr, y + Q->d);
-    while (xln != 0xFFFF) {
-      // determine the starting point for ScanRight
-      x = (xln > xl) ? xln : xl;
-
-      // add the new branch if it's not already in the queue
-      xrn = ff_scan_right(x, y + Q->d, ucBorder, scan_type);
-      if (!ff_in_queue(Q, xln, xrn, y + Q->d)) {
-        ff_add_queue(Q, xln, xrn, y + Q->d, NOT_FILLED);
-      }
-
-      // if the new branch does not extend beyond the current run,
-      // look for another branch
-      if (xrn > (xr - 2)) {
-        break;
-      }
-      else {
-        x = xrn + 2;
-        xln = ff_next_branch(x, xr, y + Q->d);
-      }
+    x += i - ff_index(ff, x, y);
+  } else {
+    while (x <= x2 && ff_inside(ff, x, y) != inside) {
+      x++;
     }
+  }
+  return x;
+}
 
-    // branch in the opposite direction
-    bChangeDirection = 0;
-    xln = ff_next_branch(xl, xr, y - Q->d);
-    while (xln != 0xFFFF) {
-      // determine the starting point for ScanRight
-      x = (xln > xl) ? xln : xl;
-
-      // add the new branch to the opposite queue if it is not
-      // already in the current queue
-      xrn = ff_scan_right(x, y - Q->d, ucBorder, scan_type);
-      if (!ff_in_queue(Q, xln, xrn, y - Q->d)) {
-        ff_add_queue(Q->pQ, xln, xrn, y - Q->d, NOT_FILLED);
-        bChangeDirection = 1;
-      }
-
-      // if the new branch does not extend beyond the current run,
-      // look for another branch
-      if (xrn > (xr - 2)) {
+// returns the leftmost x from x down to x1 where the pixels are all inside
+static int ff_find_left(ff_t *ff, int x, int x1, int y) {
+  if (ff->loaded) {
+    uint32_t i = ff_index(ff, x, y);
+    uint32_t start = i - (x - x1);
+    while (i > start) {
+      if ((i & 7) == 0 && i - 8 >= start && ff->closed[(i - 8) >> 3] == 0) {
+        i -= 8;
+      } else if (ff_is_closed(ff, i - 1)) {
         break;
-      }
-      else {
-        x = xrn + 2;
-        xln = ff_next_branch(x, xr, y - Q->d);
+      } else {
+        i--;
       }
     }
-
-    // change direction if any turns were detected
-    if (bChangeDirection) {
-      // select the opposite queue
-      Q = Q->pQ;
-
-      // copy the current run to the opposite queue
-      ff_add_queue(Q, xl, xr, y, FILLED);
+    x -= ff_index(ff, x, y) - i;
+  } else {
+    while (x > x1 && ff_inside(ff, x - 1, y)) {
+      x--;
     }
   }
-
-  // cleanup
-  dev_setcolor(pcolor);
+  return x;
 }
 
-uint16_t ff_scan_left(uint16_t xl, uint16_t y, long ucPixel, int f) {
-  long v;
+static void ff_close_span(ff_t *ff, int xl, int xr, int y) {
+  uint32_t i = ff_index(ff, xl, y);
+  uint32_t end = i + (xr - xl) + 1;
+  for (; i < end && (i & 7); i++) {
+    ff_set_closed(ff, i);
+  }
+  if (end - i >= 8) {
+    uint32_t bytes = (end - i) >> 3;
+    memset(ff->closed + (i >> 3), 0xff, bytes);
+    i += bytes << 3;
+  }
+  for (; i < end; i++) {
+    ff_set_closed(ff, i);
+  }
+}
 
-  if (f == SCAN_UNTIL) {
-    // return 0xFFFF if starting pixel is a border pixel
-    if (dev_getpixel(xl, y) == ucPixel) {
-      return 0xFFFF;
-    }
+static void ff_push(ff_t *ff, int x, int y) {
+  if (ff->seed_count == ff->seed_size) {
+    ff->seed_size += SEED_INC;
+    ff->seeds = realloc(ff->seeds, ff->seed_size * sizeof(ff_seed_t));
+  }
+  ff->seeds[ff->seed_count].x = x;
+  ff->seeds[ff->seed_count].y = y;
+  ff->seed_count++;
+}
 
-    do {
-      xl--;
-      // clip
-      if (xl == 0xFFFF || xl < dev_Vx1) {
-        break;
+// adds a seed for each run of unfilled pixels between x1 and x2
+static void ff_push_runs(ff_t *ff, int x1, int x2, int y) {
+  if (y >= ff->y1 && y < ff->y1 + ff->height) {
+    int x = ff_find(ff, x1, x2, y, 1);
+    while (x <= x2) {
+      ff_push(ff, x, y);
+      x = ff_find(ff, x, x2, y, 0);
+      if (x <= x2) {
+        x = ff_find(ff, x, x2, y, 1);
       }
-      v = dev_getpixel(xl, y);
-    } while (v != ucPixel);
-  } else {
-    // f == SCAN_WHILE
-    // return 0xFFFF if starting pixel is not a border pixel
-    if (dev_getpixel(xl, y) != ucPixel) {
-      return 0xFFFF;
     }
-
-    do {
-      xl--;
-      // clip
-      if (xl == 0xFFFF || xl < dev_Vx1) {
-        break;
-      }
-      v = dev_getpixel(xl, y);
-    } while (v == ucPixel);
   }
-  return ++xl;
 }
 
-uint16_t ff_scan_right(uint16_t xr, uint16_t y, long ucPixel, int f) {
-  long v;
-
-  if (f == SCAN_UNTIL) {
-    // return 0xFFFF if starting pixel is a border pixel
-    if (dev_getpixel(xr, y) == ucPixel) {
-      return 0xFFFF;
+static void ff_fill(ff_t *ff, int x0, int y0) {
+  int x2 = ff->x1 + ff->width - 1;
+  int spans = 0;
+
+  ff_push(ff, x0, y0);
+  while (ff->seed_count) {
+    ff->seed_count--;
+    int x = ff->seeds[ff->seed_count].x;
+    int y = ff->seeds[ff->seed_count].y;
+    if (ff_find(ff, x, x, y, 1) != x) {
+      continue;
     }
 
-    do {
-      xr++;
+    // extend the seed to the full span
+    int xl = ff_find_left(ff, x, ff->x1, y);
+    int xr = ff_find(ff, x, x2, y, 0) - 1;
+    ff_close_span(ff, xl, xr, y);
+    dev_line(xl, y, xr, y);
 
-      // clip
-      if (xr > dev_Vx2) {
-        break;
-      }
-      v = dev_getpixel(xr, y);
-    } while (v != ucPixel);
-  } else {
-    // f == SCAN_WHILE
-    // return 0xFFFF if starting pixel is not a border pixel
-    if (dev_getpixel(xr, y) != ucPixel) {
-      return 0xFFFF;
-    }
+    ff_push_runs(ff, xl, xr, y - 1);
+    ff_push_runs(ff, xl, xr, y + 1);
 
-    do {
-      xr++;
-      // clip
-      if (xr > dev_Vx2) {
+    if (++spans == EVENT_SPANS) {
+      spans = 0;
+      if (dev_events(0) < 0) {
         break;
       }
-      v = dev_getpixel(xr, y);
-    } while (v == ucPixel);
+    }
   }
-
-  return --xr;
 }
 
-uint16_t ff_next_branch(uint16_t xl, uint16_t xr, int y) {
-  uint16_t xln;
-
-  // clip y
-  if ((y < dev_Vy1) || (y > dev_Vy2)) {
-    return 0xFFFF;
-  }
-
-  // look for a branch adjacent to the first pixel in the run
-  xln = ff_scan_left(xl, y, ucBorder, scan_type);
+void dev_ffill(uint16_t x0, uint16_t y0, long fill_color, long border_color) {
+  ff_t ff;
+  int scan_type;
 
-  // if the adjacent pixel is on the border, scan for the
-  // first non-border pixel
-  if (xln == 0xFFFF) {
-    xln = ff_scan_right(xl, y, ucBorder, (scan_type == SCAN_WHILE) ? SCAN_UNTIL : SCAN_WHILE);
-    if (xln < xr) {
-      xln++;
-    } else {
-      xln = 0xFFFF;
-    }
+  if (x0 < dev_Vx1 || x0 > dev_Vx2 || y0 < dev_Vy1 || y0 > dev_Vy2) {
+    return;
   }
 
-  return xln;
-}
-
-void ff_add_queue(QUEUE *Q, uint16_t xl, uint16_t xr, int y, int f) {
-  int qp;
-  int i;
-
-  if (Q->d == UP) {
-    // find the last larger queue y-value
-    for (qp = Q->t; qp <= Q->h; qp++) {
-      if (Q->run[qp].y <= y) {
-        break;
-      }
+  // do nothing if the seed pixel is a border pixel
+  if (border_color == -1) {
+    border_color = dev_getpixel(x0, y0);
+    scan_type = SCAN_WHILE;
+    if (border_color == fill_color) {
+      return;
     }
   } else {
-    // find the last smaller queue y-value
-    for (qp = Q->t; qp <= Q->h; qp++) {
-      if (Q->run[qp].y >= y) {
-        break;
-      }
+    scan_type = SCAN_UNTIL;
+    if (dev_getpixel(x0, y0) == border_color) {
+      return;
     }
   }
 
-  // expand the queue if necessary
-  if (qp <= Q->h) {
-    // update the head pointer
-    Q->h++;
-
-    // expand up
-    for (i = Q->h; i > qp; --i) {
-      Q->run[i].xl = Q->run[i - 1].xl;
-      Q->run[i].xr = Q->run[i - 1].xr;
-      Q->run[i].y = Q->run[i - 1].y;
-      Q->run[i].f = Q->run[i - 1].f;
-    }
+  ff.x1 = dev_Vx1;
+  ff.y1 = dev_Vy1;
+  ff.width = dev_Vx2 - dev_Vx1 + 1;
+  ff.height = dev_Vy2 - dev_Vy1 + 1;
+  ff.color = border_color;
+  ff.scan_type = scan_type;
+  ff.closed = calloc(((size_t)ff.width * ff.height + 7) / 8, 1);
+  ff.seeds = NULL;
+  ff.seed_count = 0;
+  ff.seed_size = 0;
+
+  // read whole rows when pixels map directly to the screen
+  if (dev_Wx1 == dev_Vx1 && dev_Wy1 == dev_Vy1 && dev_Wdx == dev_Vdx && dev_Wdy == dev_Vdy) {
+    ff.loaded = calloc(ff.height, 1);
+    ff.row = malloc(sizeof(long) * ff.width);
   } else {
-    // can't insert in queue; add to head
-    Q->h++;
+    ff.loaded = NULL;
+    ff.row = NULL;
   }
-
-  // enter the data in the queue
-  Q->run[qp].xl = xl;
-  Q->run[qp].xr = xr;
-  Q->run[qp].y = y;
-  Q->run[qp].f = f;
-
-  // update the number of unfilled runs in the queue
-  if (!f) {
-    Q->n++;
-  }
-}
-
-int ff_in_queue(QUEUE *Q, uint16_t xl, uint16_t xr, int y) {
-  int qp;
-  int bRVal = 0;
-
-  if (Q->d == UP) {
-    // search from head to tail
-    for (qp = Q->h; qp >= 0; --qp) {
-      // quit searching if y is not in the ordered list
-      if (Q->run[qp].y > y) {
-        break;
-      }
-
-      // quit searching if the specified run is in the list
-      if ((Q->run[qp].y == y) && (Q->run[qp].xl == xl) && (Q->run[qp].xr == xr)) {
-        bRVal = 1;
-        break;
-      }
-    }
+  if (!ff.row) {
+    free(ff.loaded);
+    ff.loaded = NULL;
   }
 
-  else {
-    // search from head to tail
-    for (qp = Q->h; qp >= 0; --qp) {
-      // quit searching if y is not in the ordered list
-      if (Q->run[qp].y < y) {
-        break;
-      }
-
-      // quit searching if the specified run is in the list
-      if ((Q->run[qp].y == y) && (Q->run[qp].xl == xl) && (Q->run[qp].xr == xr)) {
-        bRVal = 1;
-        break;
-      }
-    }
+  if (!ff.closed) {
+    err_memory();
+  } else {
+    long pcolor = dev_fgcolor;
+    dev_setcolor(fill_color);
+    ff_fill(&ff, x0, y0);
+    dev_setcolor(pcolor);
   }
 
-  return bRVal;
+  free(ff.closed);
+  free(ff.loaded);
+  free(ff.row);
+  free(ff.seeds);
 }
-
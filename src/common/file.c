@@ -28,7 +28,7 @@
 #include "lib/match.h"
 
 // FILE TABLE
-static dev_file_t file_table[OS_FILEHANDLES];
+static SB_TLS dev_file_t file_table[OS_FILEHANDLES];
 
 /*
  * returns the last-modified time of the file
@@ -744,7 +744,7 @@ void dev_destroy_file_list(char_p_t *list, int count) {
  * BUG: no drivers supported
  */
 const char *dev_getcwd() {
-  static char retbuf[OS_PATHNAME_SIZE + 1];
+  static SB_TLS char retbuf[OS_PATHNAME_SIZE + 1];
   getcwd(retbuf, OS_PATHNAME_SIZE);
   int l = strlen(retbuf);
   if (retbuf[l - 1] != OS_DIRSEP) {
@@ -46,9 +46,9 @@ typedef struct {
   int type;     // 0 = string, 1 = numeric format, 2 = string format
 } fmt_node_t;
 
-static fmt_node_t fmt_stack[MAX_FMT_N]; // the list
-static int fmt_count;   // number of elements in the list
-static int fmt_cur;     // next format element to be used
+static SB_TLS fmt_node_t fmt_stack[MAX_FMT_N]; // the list
+static SB_TLS int fmt_count;   // number of elements in the list
+static SB_TLS int fmt_cur;     // next format element to be used
 
 /*
  * tables of powers :)
@@ -150,6 +150,7 @@ int http_read(dev_file_t *f, var_t *var_p) {
         var_p->v.p.ptr[var_p->v.p.length] = '\0';
       } else {
         var_p->v.p.ptr = realloc(var_p->v.p.ptr, var_p->v.p.length + bytes + 1);
+        var_p->v.p.owner = 1;
         memcpy(var_p->v.p.ptr + var_p->v.p.length, rxbuff, bytes);
         var_p->v.p.length += bytes;
         var_p->v.p.ptr[var_p->v.p.length] = '\0';
@@ -15,6 +15,7 @@
 
 #if defined(_UnixOS)
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 #include <dirent.h>
@@ -152,6 +153,33 @@ uint32_t stream_seek(dev_file_t *f, uint32_t offset) {
   return lseek(f->handle, offset, SEEK_SET);
 }
 
+/*
+ * maps the first length bytes of the file into memory for reading,
+ * returns NULL when the file cannot be mapped
+ */
+char *stream_map(dev_file_t *f, uint32_t length) {
+  char *result = NULL;
+#if defined(_UnixOS)
+  if (length) {
+    void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, f->handle, 0);
+    if (map != MAP_FAILED) {
+      madvise(map, length, MADV_SEQUENTIAL);
+      result = (char *)map;
+    }
+  }
+#endif
+  return result;
+}
+
+/*
+ * releases memory returned from stream_map()
+ */
+void stream_unmap(char *map, uint32_t length) {
+#if defined(_UnixOS)
+  munmap(map, length);
+#endif
+}
+
 /*
  */
 int stream_eof(dev_file_t *f) {
@@ -21,5 +21,7 @@ uint32_t stream_tell(dev_file_t *f);
 uint32_t stream_length(dev_file_t *f);
 uint32_t stream_seek(dev_file_t *f, uint32_t offset);
 int stream_eof(dev_file_t *f);
+char *stream_map(dev_file_t *f, uint32_t length);
+void stream_unmap(char *map, uint32_t length);
 
 #endif
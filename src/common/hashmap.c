@@ -14,48 +14,54 @@
 #include "common/smbas.h"
 #include "common/hashmap.h"
 
-#define MAP_SIZE 32
+// initial number of slots, always a power of 2
+#define MAP_SIZE 8
+
+// grow the slots beyond 75% occupancy
+#define MAP_LOAD(slots) ((slots) - ((slots) >> 2))
 
 /**
- * Our internal tree element node
+ * A key/value pair, held in insertion order
  */
-typedef struct Node {
-  var_p_t key;
+typedef struct Entry {
+  var_t key;
   var_p_t value;
-  struct Node *left, *right;
-} Node;
+  uint32_t hash;
+} Entry;
 
 /**
- * Returns a new tree node
+ * Open addressing slot, refers to an entry by position
  */
-Node *tree_create_node(var_p_t key) {
-  Node *node = (Node *)malloc(sizeof(Node));
-  node->key = key;
-  node->value = NULL;
-  node->left = NULL;
-  node->right = NULL;
-  return node;
-}
+typedef struct Slot {
+  uint32_t hash;
+  uint32_t index; /**< entry index + 1, zero when empty */
+} Slot;
 
 /**
- * cleanup the given element
+ * The table, shared between map variables until modified
  */
-void tree_delete_node(Node *node) {
-  // cleanup v_new
-  v_free(node->key);
-  v_detach(node->key);
+typedef struct Table {
+  uint32_t refs;
+  uint32_t serial; /**< distinguishes tables for hashmap_putc_ic() */
+  uint32_t count;
+  uint32_t capacity;
+  Entry *entries;
+  Slot slots[];
+} Table;
 
-  // cleanup v_new
-  if (node->value) {
-    v_free(node->value);
-    v_detach(node->value);
+/**
+ * case insensitive FNV-1a hash of the key
+ */
+static inline uint32_t hashmap_get_hash(const char *key, int length) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < length && key[i] != '\0'; i++) {
+    hash ^= (uint8_t)to_lower(key[i]);
+    hash *= 16777619u;
   }
-
-  // cleanup the node
-  free(node);
+  return hash;
 }
 
-static inline int tree_compare(const char *key, int length, var_p_t vkey) {
+static inline int hashmap_equals(const char *key, int length, const var_t *vkey) {
   int len1 = length;
   if (len1 && key[len1 - 1] == '\0') {
     len1--;
@@ -64,58 +70,115 @@ static inline int tree_compare(const char *key, int length, var_p_t vkey) {
   if (len2 && vkey->v.p.ptr[len2 - 1] == '\0') {
     len2--;
   }
-  return strcaselessn(key, len1, vkey->v.p.ptr, len2);
+  return len1 == len2 && strcaselessn(key, len1, vkey->v.p.ptr, len2) == 0;
 }
 
-void tree_destroy(Node *node) {
-  if (node->left != NULL) {
-    tree_destroy(node->left);
-  }
-  if (node->right != NULL) {
-    tree_destroy(node->right);
-  }
-  tree_delete_node(node);
+// the serial of the next table
+static SB_TLS uint32_t table_serial;
+
+static Table *hashmap_alloc(uint32_t slots) {
+  Table *table = calloc(1, sizeof(Table) + slots * sizeof(Slot));
+  table->refs = 1;
+  table->serial = ++table_serial;
+  return table;
 }
 
-Node *tree_search(Node **rootp, const char *key, int length) {
-  while (*rootp != NULL) {
-    int r = tree_compare(key, length, (*rootp)->key);
-    if (r == 0) {
-      return *rootp;
+/**
+ * robin hood insertion: displace any slot which is closer to its home
+ */
+static void hashmap_place(Table *table, uint32_t mask, uint32_t hash, uint32_t index) {
+  Slot next;
+  next.hash = hash;
+  next.index = index;
+  uint32_t pos = hash & mask;
+  for (uint32_t dist = 0;; dist++) {
+    Slot *slot = &table->slots[pos];
+    if (slot->index == 0) {
+      *slot = next;
+      break;
+    }
+    uint32_t slot_dist = (pos - slot->hash) & mask;
+    if (slot_dist < dist) {
+      Slot swap = *slot;
+      *slot = next;
+      next = swap;
+      dist = slot_dist;
     }
-    rootp = (r < 0) ? &(*rootp)->left : &(*rootp)->right;
+    pos = (pos + 1) & mask;
   }
-  Node *result = tree_create_node(NULL);
-  *rootp = result;
-  return result;
 }
 
-Node *tree_find(Node **rootp, const char *key, int length) {
-  while (*rootp != NULL) {
-    int r = tree_compare(key, length, (*rootp)->key);
-    if (r == 0) {
-      return *rootp;
+static Entry *hashmap_find(var_p_t map, uint32_t hash, const char *key, int length) {
+  Table *table = (Table *)map->v.m.map;
+  uint32_t mask = map->v.m.size - 1;
+  uint32_t pos = hash & mask;
+  for (uint32_t dist = 0;; dist++) {
+    Slot *slot = &table->slots[pos];
+    if (slot->index == 0 || ((pos - slot->hash) & mask) < dist) {
+      // the key would have displaced this slot
+      return NULL;
     }
-    rootp = (r < 0) ? &(*rootp)->left : &(*rootp)->right;
+    if (slot->hash == hash) {
+      Entry *entry = &table->entries[slot->index - 1];
+      if (hashmap_equals(key, length, &entry->key)) {
+        return entry;
+      }
+    }
+    pos = (pos + 1) & mask;
   }
-  return NULL;
 }
 
-int tree_foreach(const Node *nodep, hashmap_foreach_func func, hashmap_cb *data) {
-  if (nodep != NULL) {
-    if (nodep->left != NULL && !tree_foreach(nodep->left, func, data)) {
-      return 0;
-    }
+/**
+ * double the number of slots, the entries keep their hash so only the slots are rebuilt
+ */
+static void hashmap_grow(var_p_t map) {
+  Table *table = (Table *)map->v.m.map;
+  uint32_t slots = map->v.m.size * 2;
+  table = realloc(table, sizeof(Table) + slots * sizeof(Slot));
+  memset(table->slots, 0, slots * sizeof(Slot));
+  for (uint32_t i = 0; i < table->count; i++) {
+    hashmap_place(table, slots - 1, table->entries[i].hash, i + 1);
+  }
+  map->v.m.map = table;
+  map->v.m.size = slots;
+}
 
-    if (func(data, nodep->key, nodep->value)) {
-      return 0;
+/**
+ * returns the entry for the key, adding a new entry with an empty key when not found
+ */
+static Entry *hashmap_search(var_p_t map, const char *key, int length, int *found) {
+  if (hashmap_is_shared(map)) {
+    // the caller may modify the returned value
+    v_unshare(map);
+  }
+  uint32_t hash = hashmap_get_hash(key, length);
+  Entry *result = hashmap_find(map, hash, key, length);
+  if (result != NULL) {
+    *found = 1;
+  } else {
+    *found = 0;
+    Table *table = (Table *)map->v.m.map;
+    if (table->count == MAP_LOAD(map->v.m.size)) {
+      hashmap_grow(map);
+      table = (Table *)map->v.m.map;
     }
-
-    if (nodep->right != NULL && !tree_foreach(nodep->right, func, data)) {
-      return 0;
+    if (table->count == table->capacity) {
+      uint32_t capacity = table->capacity ? table->capacity * 2 : 4;
+      if (capacity > MAP_LOAD(map->v.m.size)) {
+        capacity = MAP_LOAD(map->v.m.size);
+      }
+      table->entries = realloc(table->entries, capacity * sizeof(Entry));
+      table->capacity = capacity;
     }
+    uint32_t index = table->count++;
+    result = &table->entries[index];
+    result->hash = hash;
+    result->value = v_new();
+    result->value->contained = 1;
+    hashmap_place(table, map->v.m.size - 1, hash, index + 1);
+    map->v.m.count = table->count;
   }
-  return 1;
+  return result;
 }
 
 /**
@@ -123,102 +186,104 @@ int tree_foreach(const Node *nodep, hashmap_foreach_func func, hashmap_cb *data)
  */
 void hashmap_create(var_p_t map, int size) {
   v_free(map);
+  uint32_t slots = MAP_SIZE;
+  while (MAP_LOAD(slots) < (uint32_t)size) {
+    slots <<= 1;
+  }
   map->type = V_MAP;
   map->v.m.count = 0;
   map->v.m.id = -1;
   map->v.m.lib_id = -1;
   map->v.m.cls_id = -1;
-  if (size == 0) {
-    map->v.m.size = MAP_SIZE;
-  } else {
-    map->v.m.size = (size * 100) / 75;
-  }
-  map->v.m.map = calloc(map->v.m.size, sizeof(Node *));
+  map->v.m.size = slots;
+  map->v.m.map = hashmap_alloc(slots);
 }
 
 int hashmap_destroy(var_p_t var_p) {
   if (var_p->type == V_MAP && var_p->v.m.map != NULL) {
-    Node **table = (Node **)var_p->v.m.map;
-    for (int i = 0; i < var_p->v.m.size; i++) {
-      if (table[i] != NULL) {
-        tree_destroy(table[i]);
+    Table *table = (Table *)var_p->v.m.map;
+    if (--table->refs == 0) {
+      for (uint32_t i = 0; i < table->count; i++) {
+        Entry *entry = &table->entries[i];
+        v_free(&entry->key);
+        v_free(entry->value);
+        v_detach(entry->value);
       }
+      free(table->entries);
+      free(table);
     }
-    free(var_p->v.m.map);
   }
   return 0;
 }
 
-int hashmap_get_hash(const char *key, int length) {
-  int hash = 1, i;
-  for (i = 0; i < length && key[i] != '\0'; i++) {
-    hash += to_lower(key[i]);
-    hash <<= 3;
-    hash ^= (hash >> 3);
+void hashmap_share(var_p_t dest, const var_p_t src) {
+  Table *table = (Table *)src->v.m.map;
+  if (table != NULL) {
+    table->refs++;
   }
-  return hash;
+  dest->type = V_MAP;
+  dest->v.m.map = table;
+  dest->v.m.count = src->v.m.count;
+  dest->v.m.size = src->v.m.size;
 }
 
-static inline Node *hashmap_search(var_p_t map, const char *key, int length) {
-  int index = hashmap_get_hash(key, length) % map->v.m.size;
-  Node **table = (Node **)map->v.m.map;
-  Node *result = table[index];
-  if (result == NULL) {
-    // new entry
-    result = table[index] = tree_create_node(NULL);
-  } else {
-    int r = tree_compare(key, length, result->key);
-    if (r < 0) {
-      result = tree_search(&result->left, key, length);
-    } else if (r > 0) {
-      result = tree_search(&result->right, key, length);
-    }
-  }
-  return result;
+int hashmap_is_shared(const var_p_t map) {
+  return map->v.m.map != NULL && ((Table *)map->v.m.map)->refs > 1;
 }
 
-static inline Node *hashmap_find(var_p_t map, const char *key) {
-  int length = strlen(key);
-  int index = hashmap_get_hash(key, length) % map->v.m.size;
-  Node **table = (Node **)map->v.m.map;
-  Node *result = table[index];
-  if (result != NULL) {
-    int r = tree_compare(key, length, result->key);
-    if (r < 0 && result->left != NULL) {
-      result = tree_find(&result->left, key, length);
-    } else if (r > 0 && result->right != NULL) {
-      result = tree_find(&result->right, key, length);
-    } else if (r != 0) {
-      result = NULL;
-    }
+var_p_t hashmap_put(var_p_t map, const char *key, int length) {
+  int found;
+  Entry *entry = hashmap_search(map, key, length, &found);
+  if (!found) {
+    v_init(&entry->key);
+    v_setstrn(&entry->key, key, length);
   }
-  return result;
+  return entry->value;
 }
 
-var_p_t hashmap_put(var_p_t map, const char *key, int length) {
-  Node *node = hashmap_search(map, key, length);
-  if (node->key == NULL) {
-    node->key = v_new();
-    node->value = v_new();
-    v_setstrn(node->key, key, length);
-    map->v.m.count++;
+/**
+ * returns the entry for the constant key, adding it when not found
+ */
+static Entry *hashmap_search_c(var_p_t map, const char *key, int length) {
+  int found;
+  Entry *entry = hashmap_search(map, key, length, &found);
+  if (!found) {
+    v_init(&entry->key);
+    entry->key.type = V_STR;
+    entry->key.v.p.length = length;
+    entry->key.v.p.ptr = (char *)key;
+    entry->key.v.p.owner = 0;
   }
-  return node->value;
+  return entry;
 }
 
 var_p_t hashmap_putc(var_p_t map, const char *key, int length) {
-  Node *node = hashmap_search(map, key, length);
-  if (node->key == NULL) {
-    var_t *var_key = v_new();
-    var_key->type = V_STR;
-    var_key->v.p.length = length;
-    var_key->v.p.ptr = (char *)key;
-    var_key->v.p.owner = 0;
-    node->key = var_key;
-    node->value = v_new();
-    map->v.m.count++;
+  return hashmap_search_c(map, key, length)->value;
+}
+
+var_p_t hashmap_putc_ic(var_p_t map, const char *key, int length, int for_write, hashmap_ic *ic) {
+  Table *table = (Table *)map->v.m.map;
+  if (ic->key == key && table != NULL && table->serial == ic->serial &&
+      ic->index < table->count && (!for_write || table->refs == 1)) {
+    // entries are never removed or reordered, so the same table holds the key at the same index
+    Entry *entry = &table->entries[ic->index];
+    if (entry->hash == ic->hash) {
+      return entry->value;
+    }
   }
-  return node->value;
+  Entry *entry = NULL;
+  if (!for_write && table != NULL) {
+    entry = hashmap_find(map, hashmap_get_hash(key, length), key, length);
+  }
+  if (entry == NULL) {
+    entry = hashmap_search_c(map, key, length);
+  }
+  table = (Table *)map->v.m.map;
+  ic->key = key;
+  ic->serial = table->serial;
+  ic->index = entry - table->entries;
+  ic->hash = entry->hash;
+  return entry->value;
 }
 
 var_p_t hashmap_putv(var_p_t map, const var_p_t key) {
@@ -228,24 +293,36 @@ var_p_t hashmap_putv(var_p_t map, const var_p_t key) {
     v_tostr(key);
   }
 
-  Node *node = hashmap_search(map, key->v.p.ptr, key->v.p.length);
-  if (node->key == NULL) {
-    node->key = key;
-    node->value = v_new();
-    map->v.m.count++;
+  int found;
+  Entry *entry = hashmap_search(map, key->v.p.ptr, key->v.p.length, &found);
+  if (!found) {
+    // move the string into the entry
+    v_init(&entry->key);
+    entry->key.type = V_STR;
+    entry->key.v.p = key->v.p;
+    v_init(key);
   } else {
     // discard unused key
     v_free(key);
-    v_detach(key);
   }
-  return node->value;
+  v_detach(key);
+  return entry->value;
 }
 
 var_p_t hashmap_get(var_p_t map, const char *key) {
+  return hashmap_getn(map, key, strlen(key));
+}
+
+var_p_t hashmap_getn(var_p_t map, const char *key, int length) {
+  Entry *entry = hashmap_find(map, hashmap_get_hash(key, length), key, length);
+  return entry != NULL ? entry->value : NULL;
+}
+
+var_p_t hashmap_key_at(var_p_t map, uint32_t index) {
   var_p_t result;
-  Node *node = hashmap_find(map, key);
-  if (node != NULL) {
-    result = node->value;
+  Table *table = (Table *)map->v.m.map;
+  if (table != NULL && index < table->count) {
+    result = &table->entries[index].key;
   } else {
     result = NULL;
   }
@@ -254,12 +331,11 @@ var_p_t hashmap_get(var_p_t map, const char *key) {
 
 void hashmap_foreach(var_p_t map, hashmap_foreach_func func, hashmap_cb *data) {
   if (map && map->type == V_MAP) {
-    Node **table = (Node **)map->v.m.map;
-    for (int i = 0; i < map->v.m.size; i++) {
-      if (table[i] != NULL) {
-        if (!tree_foreach(table[i], func, data)) {
-          break;
-        }
+    // the callback may add entries, moving the table
+    for (uint32_t i = 0; i < ((Table *)map->v.m.map)->count; i++) {
+      Entry *entry = &((Table *)map->v.m.map)->entries[i];
+      if (func(data, &entry->key, entry->value)) {
+        break;
       }
     }
   }
@@ -24,14 +24,29 @@ typedef struct hashmap_cb {
   int start;
 } hashmap_cb;
 
+/**
+ * Inline cache for a constant key, see hashmap_putc_ic
+ */
+typedef struct hashmap_ic {
+  const char *key;
+  uint32_t serial;
+  uint32_t index;
+  uint32_t hash;
+} hashmap_ic;
+
 typedef int (*hashmap_foreach_func)(hashmap_cb *cb, var_p_t k, var_p_t v);
 
 void hashmap_create(var_p_t map, int size);
 int  hashmap_destroy(var_p_t map);
+void hashmap_share(var_p_t dest, const var_p_t src);
+int  hashmap_is_shared(const var_p_t map);
 var_p_t hashmap_put(var_p_t map, const char *key, int length);
 var_p_t hashmap_putc(var_p_t map, const char *key, int length);
+var_p_t hashmap_putc_ic(var_p_t map, const char *key, int length, int for_write, hashmap_ic *ic);
 var_p_t hashmap_putv(var_p_t map, const var_p_t key);
 var_p_t hashmap_get(var_p_t map, const char *key);
+var_p_t hashmap_getn(var_p_t map, const char *key, int length);
+var_p_t hashmap_key_at(var_p_t map, uint32_t index);
 void hashmap_foreach(var_p_t map, hashmap_foreach_func func, hashmap_cb *data);
 
 #endif /* !_HASHMAP_H_ */
@@ -120,27 +120,28 @@ static inline var_int_t v_igetval(var_t *v) {
 /**
  * @ingroup exec
  *
- * variant of code_getvarptr() derefence until left parenthesis found
+ * resolves the next variable. when for_write is set any shared array or
+ * map containing the result is first given its own copy of the data
  *
  * R(var_t*) <- Code[IP]; IP += 2;
  *
  * @return the var_t*
  */
-static inline var_t *code_getvarptr_parens(int until_parens) {
+static inline var_t *code_getvarptr_mode(int until_parens, int for_write) {
   var_t *var_p = NULL;
 
   if (code_peek() == kwTYPE_VAR) {
     code_skipnext();
     var_p = tvar[code_getaddr()];
     if (code_peek() == kwTYPE_UDS_EL) {
-      var_p = code_resolve_map(var_p, until_parens);
+      var_p = code_resolve_map(var_p, until_parens, for_write);
     } else {
       switch (var_p->type) {
       case V_MAP:
-        var_p = code_resolve_map(var_p, until_parens);
+        var_p = code_resolve_map(var_p, until_parens, for_write);
         break;
       case V_ARRAY:
-        var_p = code_resolve_varptr(var_p, until_parens);
+        var_p = code_resolve_varptr(var_p, until_parens, for_write);
         break;
       default:
         if (!until_parens && code_peek() == kwTYPE_LEVEL_BEGIN) {
@@ -158,6 +159,17 @@ static inline var_t *code_getvarptr_parens(int until_parens) {
   return var_p;
 }
 
+/**
+ * @ingroup exec
+ *
+ * variant of code_getvarptr() derefence until left parenthesis found
+ *
+ * @return the var_t*
+ */
+static inline var_t *code_getvarptr_parens(int until_parens) {
+  return code_getvarptr_mode(until_parens, 1);
+}
+
 /**
  * @ingroup var
  *
@@ -168,9 +180,48 @@ static inline var_t *code_getvarptr_parens(int until_parens) {
 static inline void v_init(var_t *v) {
   v->type = V_INT;
   v->const_flag = 0;
+  v->contained = 0;
   v->v.i = 0;
 }
 
+/**
+ * @ingroup var
+ *
+ * initialise a variable held inside the data of an array
+ */
+static inline void v_init_elem(var_t *v) {
+  v_init(v);
+  v->pooled = 0;
+  v->contained = 1;
+}
+
+/**
+ * @ingroup var
+ *
+ * returns element i of the array for reading. the value of an element in
+ * packed storage is copied into tmp
+ *
+ * @param array the array
+ * @param i zero-based element index
+ * @param tmp holds the value of a packed element
+ * @return the element
+ */
+static inline var_t *v_elem_read(var_t *array, uint32_t i, var_t *tmp) {
+  switch (v_packed(array)) {
+  case V_PACK_INT:
+    v_init(tmp);
+    tmp->v.i = v_ints(array)[i];
+    return tmp;
+  case V_PACK_NUM:
+    v_init(tmp);
+    tmp->type = V_NUM;
+    tmp->v.n = v_nums(array)[i];
+    return tmp;
+  default:
+    return v_elem(array, i);
+  }
+}
+
 /**
  * @ingroup var
  *
@@ -194,10 +245,13 @@ static inline void v_detach(var_t *v) {
  * @param v the variable
  */
 static inline void v_free(var_t *v) {
+  uint8_t contained = v->contained;
   switch (v->type) {
   case V_STR:
     if (v->v.p.owner) {
       free(v->v.p.ptr);
+      // the capacity of the released buffer is no longer valid
+      v->v.p.owner = 1;
     }
     break;
   case V_ARRAY:
@@ -208,4 +262,5 @@ static inline void v_free(var_t *v) {
     break;
   }
   v_init(v);
+  v->contained = contained;
 }
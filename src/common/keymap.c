@@ -15,9 +15,9 @@
 #include "common/keymap.h"
 
 //  Keyboard buffer
-uint32_t keybuff[PCKBSIZE];
-int keyhead;
-int keytail;
+SB_TLS uint32_t keybuff[PCKBSIZE];
+SB_TLS int keyhead;
+SB_TLS int keytail;
 
 typedef struct key_map_s key_map_s;
 
@@ -30,7 +30,7 @@ struct key_map_s {
   int key;         // key definition
 };
 
-key_map_s *keymap = 0;
+SB_TLS key_map_s *keymap = 0;
 
 /**
  * Prepare task_t exec.keymap for keymap handling at program init
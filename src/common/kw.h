@@ -176,6 +176,8 @@ enum keyword {
   kwCATCH,
   kwENDTRY,
   kwFUNC_RETURN,
+  kwLET_APPEND,
+  kwLET_INC,
   kwNULL
 };
 
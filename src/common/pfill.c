@@ -32,8 +32,8 @@ void pf_xsort_AET(void);
 /* 
  *	Pointers to global edge table (GET) and active edge table (AET) 
  */
-static struct EdgeState *GETPtr;
-static struct EdgeState *AETPtr;
+static SB_TLS struct EdgeState *GETPtr;
+static SB_TLS struct EdgeState *AETPtr;
 
 /*
  *	FillPoly
@@ -27,16 +27,22 @@
 #define LIB_EXT ".so"
 #endif
 
+#define MAX_PARAM 16
+
+static void plugin_free_frames();
+
 #if defined(LNX_EXTLIB) || defined(WIN_EXTLIB) || defined(_MCU)
 #include "common/plugins.h"
 
 #define MAX_SLIBS 64
-#define MAX_PARAM 16
 #define TABLE_GROW_SIZE 16
 #define NAME_SIZE 256
 #define PATH_SIZE 1024
 
 typedef int (*sblib_exec_fn)(int, int, slib_par_t *, var_t *);
+typedef int (*sblib_fastcall_fn)(int, int, const slib_arg_t *, slib_arg_t *);
+typedef int (*sblib_batch_fn)(int, uint32_t, const slib_arg_t *, slib_arg_t *);
+typedef const char *(*sblib_signature_fn)(int);
 typedef int (*sblib_getname_fn) (int, char *);
 typedef int (*sblib_count_fn) (void);
 typedef int (*sblib_init_fn) (const char *);
@@ -50,6 +56,9 @@ typedef struct {
   sblib_exec_fn _sblib_proc_exec;
   sblib_exec_fn _sblib_func_exec;
   sblib_free_fn _sblib_free;
+  sblib_fastcall_fn _sblib_func_fastcall;
+  sblib_batch_fn _sblib_func_batch;
+  const char **_func_sig;
   ext_func_node_t *_func_list;
   ext_proc_node_t *_proc_list;
   uint32_t _id;
@@ -58,10 +67,13 @@ typedef struct {
   uint32_t _func_count;
   uint32_t _proc_list_size;
   uint32_t _func_list_size;
+  uint32_t _func_sig_count;
   uint8_t  _imported;
 } slib_t;
 
-static slib_t *plugins[MAX_SLIBS];
+static SB_TLS slib_t *plugins[MAX_SLIBS];
+static SB_TLS slib_arg_t *batch_args;
+static SB_TLS uint32_t batch_args_size;
 
 #if defined(_MCU)
 int slib_llopen(slib_t *lib) {
@@ -372,6 +384,27 @@ static void slib_import_routines(slib_t *lib, int comp) {
     }
   }
 
+  // fast-call signatures
+  sblib_signature_fn fsig = slib_getoptptr(lib, "sblib_func_signature");
+  lib->_sblib_func_fastcall = slib_getoptptr(lib, "sblib_func_fastcall");
+  lib->_sblib_func_batch = slib_getoptptr(lib, "sblib_func_batch");
+  if (fsig && lib->_sblib_func_fastcall && fcount && !lib->_func_sig) {
+    int count = fcount();
+    lib->_func_sig = (const char **)calloc(count, sizeof(const char *));
+    lib->_func_sig_count = lib->_func_sig ? count : 0;
+    for (int i = 0; i < lib->_func_sig_count; i++) {
+      const char *sig = fsig(i);
+      if (sig != NULL) {
+        int len = strlen(sig);
+        if (len > 0 && len <= MAX_PARAM && (int)strspn(sig, "in") == len) {
+          lib->_func_sig[i] = sig;
+        } else {
+          log_printf("LIB: module '%s' invalid signature '%s'\n", lib->_name, sig);
+        }
+      }
+    }
+  }
+
   if (!total) {
     log_printf("LIB: module '%s' has no exports\n", lib->_name);
   }
@@ -381,18 +414,10 @@ static void slib_import_routines(slib_t *lib, int comp) {
 // execute a function or procedure
 //
 static int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
-  slib_par_t *ptable;
   int pcount;
-  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
-    ptable = (slib_par_t *)malloc(sizeof(slib_par_t) * MAX_PARAM);
-    pcount = plugin_build_ptable(ptable, MAX_PARAM);
-  } else {
-    ptable = NULL;
-    pcount = 0;
-  }
+  slib_par_t *ptable = plugin_params_begin(MAX_PARAM, &pcount);
   if (prog_error) {
-    plugin_free_ptable(ptable, pcount);
-    free(ptable);
+    plugin_params_end(ptable, pcount);
     return 0;
   }
 
@@ -414,10 +439,7 @@ static int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
   }
 
   // clean-up
-  if (ptable) {
-    plugin_free_ptable(ptable, pcount);
-    free(ptable);
-  }
+  plugin_params_end(ptable, pcount);
 
   if (success && v_is_type(ret, V_MAP)) {
     map_set_lib_id(ret, lib->_id);
@@ -426,6 +448,156 @@ static int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
   return success;
 }
 
+//
+// returns the array elements as fast-call arguments of the given type
+//
+static const slib_arg_t *slib_batch_args(var_t *array, char type) {
+  uint32_t size = v_asize(array);
+  if (v_packed(array) == (type == 'i' ? V_PACK_INT : V_PACK_NUM)) {
+    // the packed elements have the same layout
+    return (const slib_arg_t *)v_data(array);
+  }
+  if (size > batch_args_size) {
+    slib_arg_t *args = (slib_arg_t *)realloc(batch_args, sizeof(slib_arg_t) * size);
+    if (args == NULL) {
+      err_memory();
+      return NULL;
+    }
+    batch_args = args;
+    batch_args_size = size;
+  }
+  for (uint32_t i = 0; i < size && !prog_error; i++) {
+    switch (v_packed(array)) {
+    case V_PACK_INT:
+      batch_args[i].n = v_ints(array)[i];
+      break;
+    case V_PACK_NUM:
+      batch_args[i].i = v_nums(array)[i];
+      break;
+    default:
+      if (type == 'i') {
+        batch_args[i].i = v_igetval(v_elem(array, i));
+      } else {
+        batch_args[i].n = v_getval(v_elem(array, i));
+      }
+      break;
+    }
+  }
+  return batch_args;
+}
+
+//
+// execute a fast-call function for each element of the array
+//
+static int slib_batch(slib_t *lib, var_t *ret, int index, const char *sig, var_t *array) {
+  uint32_t size = v_asize(array);
+  const slib_arg_t *args = slib_batch_args(array, sig[1]);
+  if (prog_error) {
+    return 0;
+  }
+
+  // the results have the same shape as the array
+  v_new_packed(ret, size, sig[0] == 'i' ? V_PACK_INT : V_PACK_NUM);
+  if (prog_error) {
+    return 0;
+  }
+  v_maxdim(ret) = v_maxdim(array);
+  for (int i = 0; i < v_maxdim(array); i++) {
+    v_ubound(ret, i) = v_ubound(array, i);
+    v_lbound(ret, i) = v_lbound(array, i);
+  }
+
+  int success = 1;
+  slib_arg_t *results = (slib_arg_t *)v_data(ret);
+  if (size && lib->_sblib_func_batch) {
+    success = lib->_sblib_func_batch(index, size, args, results);
+  } else {
+    for (uint32_t i = 0; i < size && success; i++) {
+      success = lib->_sblib_func_fastcall(index, 1, &args[i], &results[i]);
+    }
+  }
+  return success;
+}
+
+//
+// execute a function having a fast-call signature, the arguments are
+// evaluated directly into a slib_arg_t table
+//
+static int slib_fastcall(slib_t *lib, var_t *ret, int index, const char *sig) {
+  slib_arg_t args[MAX_PARAM];
+  slib_arg_t result;
+  var_t arg;
+  var_t array;
+  int expected = strlen(sig) - 1;
+  int pcount = 0;
+  int success = 0;
+
+  v_init(&array);
+  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
+    code_skipnext();
+    byte ready = 0;
+    do {
+      switch (code_peek()) {
+      case kwTYPE_EOC:
+        code_skipnext();
+        break;
+      case kwTYPE_SEP:
+        code_skipsep();
+        break;
+      case kwTYPE_LEVEL_END:
+        ready = 1;
+        break;
+      default:
+        if (pcount == expected) {
+          err_parm_num(pcount + 1, expected);
+          break;
+        }
+        v_init(&arg);
+        eval(&arg);
+        if (prog_error) {
+          // error
+        } else if (arg.type == V_ARRAY && expected == 1) {
+          // batch call, array takes the data
+          array = arg;
+          v_init(&arg);
+        } else if (sig[pcount + 1] == 'i') {
+          args[pcount].i = v_igetval(&arg);
+        } else {
+          args[pcount].n = v_getval(&arg);
+        }
+        v_free(&arg);
+        pcount++;
+        break;
+      }
+    } while (!ready && !prog_error);
+    if (!prog_error) {
+      // kwTYPE_LEVEL_END
+      code_skipnext();
+    }
+  }
+
+  if (!prog_error && pcount != expected) {
+    err_parm_num(pcount, expected);
+  }
+  if (!prog_error) {
+    if (array.type == V_ARRAY) {
+      success = slib_batch(lib, ret, index, sig, &array);
+    } else {
+      success = lib->_sblib_func_fastcall(index, pcount, args, &result);
+      if (success && sig[0] == 'i') {
+        v_setint(ret, result.i);
+      } else if (success) {
+        v_setreal(ret, result.n);
+      }
+    }
+    if (!success && !prog_error) {
+      err_throw("LIB:%s: Unspecified error calling FUNC\n", lib->_name);
+    }
+  }
+  v_free(&array);
+  return success;
+}
+
 void plugin_init() {
   for (int i = 0; i < MAX_SLIBS; i++) {
     plugins[i] = NULL;
@@ -542,7 +714,10 @@ int plugin_procexec(int lib_id, int index) {
 int plugin_funcexec(int lib_id, int index, var_t *ret) {
   int result;
   slib_t *lib = get_lib(lib_id);
-  if (lib && lib->_sblib_func_exec) {
+  if (lib && index >= 0 && index < lib->_func_sig_count && lib->_func_sig[index]) {
+    v_init(ret);
+    result = slib_fastcall(lib, ret, index, lib->_func_sig[index]);
+  } else if (lib && lib->_sblib_func_exec) {
     result = slib_exec(lib, ret, index, 0);
   } else {
     result = 0;
@@ -570,10 +745,15 @@ void plugin_close() {
       }
       free(lib->_proc_list);
       free(lib->_func_list);
+      free(lib->_func_sig);
       free(lib);
     }
     plugins[i] = NULL;
   }
+  free(batch_args);
+  batch_args = NULL;
+  batch_args_size = 0;
+  plugin_free_frames();
 }
 
 #else
@@ -586,10 +766,28 @@ void *plugin_get_func(const char *name) { return 0; }
 int plugin_procexec(int lib_id, int index) { return -1; }
 int plugin_funcexec(int lib_id, int index, var_t *ret) { return -1; }
 void plugin_free(int lib_id, int cls_id, int id) {}
-void plugin_close() {}
+void plugin_close() {
+  plugin_free_frames();
+}
 #endif
 
-int plugin_build_ptable(slib_par_t *ptable, int size) {
+//
+// modules read the array elements as var_t, so convert any packed storage
+//
+static void plugin_unpack(var_t *var) {
+  if (var->type == V_ARRAY) {
+    v_unpack(var);
+    for (uint32_t i = 0; i < v_asize(var); i++) {
+      plugin_unpack(v_elem(var, i));
+    }
+  }
+}
+
+//
+// builds the parameter table, by-value parameters are evaluated into args
+// when given, otherwise into new variables
+//
+static int plugin_build_params(slib_par_t *ptable, var_t *args, int size) {
   int pcount = 0;
   var_t *arg;
   bcip_t ofs;
@@ -616,6 +814,9 @@ int plugin_build_ptable(slib_par_t *ptable, int size) {
           // push parameter
           ptable[pcount].var_p = code_getvarptr();
           ptable[pcount].byref = 1;
+          // the module may write into the variable
+          v_unshare(ptable[pcount].var_p);
+          plugin_unpack(ptable[pcount].var_p);
           pcount++;
           break;
         }
@@ -625,16 +826,25 @@ int plugin_build_ptable(slib_par_t *ptable, int size) {
         // no 'break' here
       default:
         // default --- expression (BYVAL ONLY)
-        arg = v_new();
+        if (args != NULL) {
+          arg = &args[pcount];
+          v_init(arg);
+        } else {
+          arg = v_new();
+        }
         eval(arg);
         if (!prog_error) {
           // push parameter
           ptable[pcount].var_p = arg;
           ptable[pcount].byref = 0;
+          v_unshare(arg);
+          plugin_unpack(arg);
           pcount++;
         } else {
           v_free(arg);
-          v_detach(arg);
+          if (args == NULL) {
+            v_detach(arg);
+          }
           return pcount;
         }
       }
@@ -648,6 +858,10 @@ int plugin_build_ptable(slib_par_t *ptable, int size) {
   return pcount;
 }
 
+int plugin_build_ptable(slib_par_t *ptable, int size) {
+  return plugin_build_params(ptable, NULL, size);
+}
+
 void plugin_free_ptable(slib_par_t *ptable, int pcount) {
   for (int i = 0; i < pcount; i++) {
     if (ptable[i].byref == 0) {
@@ -656,3 +870,56 @@ void plugin_free_ptable(slib_par_t *ptable, int pcount) {
     }
   }
 }
+
+//
+// parameter tables are kept for reuse. Each call in progress holds a frame,
+// so a call made while evaluating the parameters of another has its own
+//
+typedef struct slib_frame_s {
+  slib_par_t ptable[MAX_PARAM];
+  var_t args[MAX_PARAM];
+  struct slib_frame_s *next;
+} slib_frame_t;
+
+static SB_TLS slib_frame_t *free_frames;
+
+slib_par_t *plugin_params_begin(int size, int *pcount) {
+  slib_frame_t *frame = NULL;
+  *pcount = 0;
+  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
+    frame = free_frames;
+    if (frame != NULL) {
+      free_frames = frame->next;
+    } else {
+      frame = (slib_frame_t *)malloc(sizeof(slib_frame_t));
+      if (frame == NULL) {
+        err_memory();
+        return NULL;
+      }
+    }
+    *pcount = plugin_build_params(frame->ptable, frame->args, size < MAX_PARAM ? size : MAX_PARAM);
+  }
+  return frame != NULL ? frame->ptable : NULL;
+}
+
+void plugin_params_end(slib_par_t *ptable, int pcount) {
+  if (ptable != NULL) {
+    // ptable is the first member of the frame
+    slib_frame_t *frame = (slib_frame_t *)ptable;
+    for (int i = 0; i < pcount; i++) {
+      if (ptable[i].byref == 0) {
+        v_free(ptable[i].var_p);
+      }
+    }
+    frame->next = free_frames;
+    free_frames = frame;
+  }
+}
+
+static void plugin_free_frames() {
+  while (free_frames != NULL) {
+    slib_frame_t *next = free_frames->next;
+    free(free_frames);
+    free_frames = next;
+  }
+}
@@ -86,6 +86,17 @@ int plugin_build_ptable(slib_par_t *ptable, int size);
 //
 void plugin_free_ptable(slib_par_t *ptable, int pcount);
 
+//
+// builds the parameter table for the call at the current IP using a table
+// reused between calls. returns NULL when there are no parameters
+//
+slib_par_t *plugin_params_begin(int size, int *pcount);
+
+//
+// frees the parameters and releases the table for reuse
+//
+void plugin_params_end(slib_par_t *ptable, int pcount);
+
 #if defined(__cplusplus)
 }
 #endif
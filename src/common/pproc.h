@@ -65,6 +65,16 @@ void bc_loop(int isf);
  */
 void eval(var_t *result);
 
+/**
+ * @ingroup exec
+ *
+ * adds the value of the variable to the left of 'result', as for the '+' operator
+ *
+ * @param result the right operand and the result.
+ * @param var_p the variable to add to.
+ */
+void eval_add_var(var_t *result, var_t *var_p, byte op);
+
 /**
  * @ingroup exec
  *
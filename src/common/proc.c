@@ -74,6 +74,7 @@ void pv_write_str(char *str, var_t *vp) {
     strcpy(vp->v.p.ptr, str);
   } else {
     vp->v.p.ptr = realloc(vp->v.p.ptr, vp->v.p.length + 1);
+    vp->v.p.owner = 1;
     strcat(vp->v.p.ptr, str);
   }
 }
@@ -466,6 +467,7 @@ void par_getsharp() {
 pt_t par_getpt() {
   pt_t pt;
   var_t *var;
+  var_t tmp;
   byte alloc = 0;
 
   pt.x = pt.y = 0;
@@ -485,8 +487,8 @@ pt_t par_getpt() {
       if (v_asize(var) != 2) {
         rt_raise(ERR_POLY_POINT);
       } else {
-        pt.x = v_getreal(v_elem(var, 0));
-        pt.y = v_getreal(v_elem(var, 1));
+        pt.x = v_getreal(v_elem_read(var, 0, &tmp));
+        pt.y = v_getreal(v_elem_read(var, 1, &tmp));
       }
     } else {
       // non-arrays
@@ -518,6 +520,7 @@ pt_t par_getpt() {
 ipt_t par_getipt() {
   ipt_t pt;
   var_t *var;
+  var_t tmp;
   byte alloc = 0;
 
   pt.x = pt.y = 0;
@@ -537,8 +540,8 @@ ipt_t par_getipt() {
       if (v_asize(var) != 2) {
         rt_raise(ERR_POLY_POINT);
       } else {
-        pt.x = v_getint(v_elem(var, 0));
-        pt.y = v_getint(v_elem(var, 1));
+        pt.x = v_getint(v_elem_read(var, 0, &tmp));
+        pt.y = v_getint(v_elem_read(var, 1, &tmp));
       }
     } else {
       // non-arrays
@@ -570,6 +573,7 @@ ipt_t par_getipt() {
 int par_getpoly(pt_t **poly_pp) {
   pt_t *poly = NULL;
   var_t *var, *el;
+  var_t tmp;
   int count = 0;
   byte style = 0, alloc = 0;
 
@@ -594,7 +598,7 @@ int par_getpoly(pt_t **poly_pp) {
     return 0;
   }
 
-  el = v_elem(var, 0);
+  el = v_elem_read(var, 0, &tmp);
   if (el->type == V_ARRAY) {
     style = 1;                  // nested --- [ [x1,y1], [x2,y2], ... ]
   }
@@ -644,8 +648,8 @@ int par_getpoly(pt_t **poly_pp) {
         break;
       }
       // store point
-      poly[i].x = v_getreal(v_elem(el, 0));
-      poly[i].y = v_getreal(v_elem(el, 1));
+      poly[i].x = v_getreal(v_elem_read(el, 0, &tmp));
+      poly[i].y = v_getreal(v_elem_read(el, 1, &tmp));
     }
   } else if (style == 0) {
     int i, j;
@@ -656,8 +660,8 @@ int par_getpoly(pt_t **poly_pp) {
         break;
       }
       // store point
-      poly[i].x = v_getreal(v_elem(var, j));
-      poly[i].y = v_getreal(v_elem(var, j + 1));
+      poly[i].x = v_getreal(v_elem_read(var, j, &tmp));
+      poly[i].y = v_getreal(v_elem_read(var, j + 1, &tmp));
     }
   }
   // clean-up
@@ -680,6 +684,7 @@ int par_getpoly(pt_t **poly_pp) {
 int par_getipoly(ipt_t **poly_pp) {
   ipt_t *poly = NULL;
   var_t *var, *el;
+  var_t tmp;
   int count = 0;
   byte style = 0, alloc = 0;
 
@@ -704,7 +709,7 @@ int par_getipoly(ipt_t **poly_pp) {
     return 0;
   }
   //
-  el = v_elem(var, 0);
+  el = v_elem_read(var, 0, &tmp);
   if (el && el->type == V_ARRAY) {
     style = 1;   // nested --- [ [x1,y1], [x2,y2], ... ]
   }
@@ -755,8 +760,8 @@ int par_getipoly(ipt_t **poly_pp) {
         break;
       }
       // store point
-      poly[i].x = v_getint(v_elem(el, 0));
-      poly[i].y = v_getint(v_elem(el, 1));
+      poly[i].x = v_getint(v_elem_read(el, 0, &tmp));
+      poly[i].y = v_getint(v_elem_read(el, 1, &tmp));
     }
   } else if (style == 0) {
     int i, j;
@@ -767,8 +772,8 @@ int par_getipoly(ipt_t **poly_pp) {
         break;
       }
       // store point
-      poly[i].x = v_getint(v_elem(var, j));
-      poly[i].y = v_getint(v_elem(var, j + 1));
+      poly[i].x = v_getint(v_elem_read(var, j, &tmp));
+      poly[i].y = v_getint(v_elem_read(var, j + 1, &tmp));
     }
   }
   // clean-up
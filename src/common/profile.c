@@ -0,0 +1,613 @@
+// This file is part of SmallBASIC
+//
+// execution profiler
+//
+// Time is measured at each event (new line, call, return) and charged to
+// the line and routine that were current since the previous event. The
+// report lists routines and lines by self time, with hit counts and the
+// cumulative (wall) time including everything called. The collapsed
+// stacks, one line per call path with its self time in microseconds, can
+// be passed to flamegraph.pl
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith
+
+#include "config.h"
+
+#include "common/sys.h"
+#include "common/smbas.h"
+#include "common/kw.h"
+#include "common/device.h"
+#include "common/profile.h"
+
+#include <ctype.h>
+#include <time.h>
+
+#define PROF_GROW_SIZE  64
+#define PROF_NAME_SIZE  64
+#define PROF_NONE       ((uint32_t)-1)
+#define PROF_CACHE_SIZE 256
+
+typedef struct prof_line_s {
+  uint64_t self;
+  uint64_t total;
+  uint32_t hits;
+  uint32_t active;
+} prof_line_t;
+
+typedef struct prof_file_s {
+  char *name;
+  char **source;
+  prof_line_t *lines;
+  uint32_t size;
+  uint32_t source_lines;
+} prof_file_t;
+
+typedef struct prof_rec_s {
+  char name[PROF_NAME_SIZE];
+  uint64_t self;
+  uint64_t total;
+  uint32_t calls;
+  uint32_t active;
+  uint32_t id;
+  uint32_t file;
+  int line;
+  int kind;
+} prof_rec_t;
+
+// call tree node, one per distinct call path
+typedef struct prof_node_s {
+  uint64_t self;
+  uint32_t rec;
+  uint32_t parent;
+  uint32_t child;
+  uint32_t next;
+} prof_node_t;
+
+// an active call
+typedef struct prof_frame_s {
+  uint64_t start;
+  uint64_t line_start;
+  void *task;
+  uint32_t file;
+  int line;
+  uint32_t rec;
+  uint32_t node;
+  uint32_t sp;
+  byte owns_line;
+} prof_frame_t;
+
+typedef struct prof_s {
+  prof_file_t *files;
+  prof_rec_t *recs;
+  prof_node_t *nodes;
+  prof_frame_t *frames;
+  void *task;
+  uint32_t file;
+  uint64_t start;
+  uint64_t last;
+  uint32_t file_count;
+  uint32_t rec_count;
+  uint32_t rec_size;
+  uint32_t node_count;
+  uint32_t node_size;
+  uint32_t frame_count;
+  uint32_t frame_size;
+  uint32_t cache[PROF_CACHE_SIZE];
+} prof_t;
+
+static SB_TLS prof_t prof;
+
+static inline uint64_t prof_clock() {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#else
+  return dev_get_millisecond_count() * 1000000;
+#endif
+}
+
+static void *prof_grow(void *ptr, uint32_t count, uint32_t *size, size_t elem_size) {
+  if (count == *size) {
+    *size += PROF_GROW_SIZE;
+    ptr = realloc(ptr, elem_size * (*size));
+  }
+  return ptr;
+}
+
+//
+// returns the index of the file, adding it when first seen
+//
+static uint32_t prof_get_file(const char *name) {
+  for (uint32_t i = 0; i < prof.file_count; i++) {
+    if (strcmp(prof.files[i].name, name) == 0) {
+      return i;
+    }
+  }
+  prof.files = realloc(prof.files, sizeof(prof_file_t) * (prof.file_count + 1));
+  prof_file_t *file = &prof.files[prof.file_count];
+  file->name = strdup(name);
+  file->source = NULL;
+  file->lines = NULL;
+  file->size = 0;
+  file->source_lines = 0;
+  return prof.file_count++;
+}
+
+//
+// returns the index of the current task's file
+//
+static inline uint32_t prof_task_file() {
+  if (ctask != prof.task) {
+    prof.task = ctask;
+    prof.file = prof_get_file(ctask->file);
+  }
+  return prof.file;
+}
+
+//
+// makes room for the line counters in the current task's file
+//
+static void prof_add_line(int line) {
+  uint32_t index = prof_task_file();
+  prof_file_t *file = &prof.files[index];
+  if ((uint32_t)line >= file->size) {
+    uint32_t size = line + PROF_GROW_SIZE;
+    file->lines = realloc(file->lines, sizeof(prof_line_t) * size);
+    memset(file->lines + file->size, 0, sizeof(prof_line_t) * (size - file->size));
+    file->size = size;
+  }
+}
+
+//
+// returns the counters for the frame's current line
+//
+static inline prof_line_t *prof_frame_line(prof_frame_t *frame) {
+  return frame->line < 0 ? NULL : &prof.files[frame->file].lines[frame->line];
+}
+
+//
+// returns the record for the routine, adding it when first seen
+//
+static uint32_t prof_get_rec(int kind, uint32_t id, uint32_t file) {
+  uint32_t *cached = &prof.cache[(id * 31 + kind + file) % PROF_CACHE_SIZE];
+  if (*cached) {
+    prof_rec_t *rec = &prof.recs[*cached - 1];
+    if (rec->id == id && rec->kind == kind && rec->file == file) {
+      return *cached - 1;
+    }
+  }
+  for (uint32_t i = 0; i < prof.rec_count; i++) {
+    prof_rec_t *rec = &prof.recs[i];
+    if (rec->id == id && rec->kind == kind && rec->file == file) {
+      *cached = i + 1;
+      return i;
+    }
+  }
+  *cached = prof.rec_count + 1;
+  prof.recs = prof_grow(prof.recs, prof.rec_count, &prof.rec_size, sizeof(prof_rec_t));
+  prof_rec_t *rec = &prof.recs[prof.rec_count];
+  memset(rec, 0, sizeof(prof_rec_t));
+  rec->kind = kind;
+  rec->id = id;
+  rec->file = file;
+  rec->line = -1;
+  return prof.rec_count++;
+}
+
+//
+// returns the call tree node for the routine below the given parent
+//
+static uint32_t prof_get_node(uint32_t parent, uint32_t rec) {
+  uint32_t first = parent == PROF_NONE ? PROF_NONE : prof.nodes[parent].child;
+  for (uint32_t i = first; i != PROF_NONE; i = prof.nodes[i].next) {
+    if (prof.nodes[i].rec == rec) {
+      return i;
+    }
+  }
+  prof.nodes = prof_grow(prof.nodes, prof.node_count, &prof.node_size, sizeof(prof_node_t));
+  prof_node_t *node = &prof.nodes[prof.node_count];
+  node->self = 0;
+  node->rec = rec;
+  node->parent = parent;
+  node->child = PROF_NONE;
+  node->next = first;
+  if (parent != PROF_NONE) {
+    prof.nodes[parent].child = prof.node_count;
+  }
+  return prof.node_count++;
+}
+
+//
+// charges the time since the last event to whatever was running
+//
+static inline uint64_t prof_charge() {
+  uint64_t now = prof_clock();
+  uint64_t elapsed = now - prof.last;
+  prof_frame_t *frame = &prof.frames[prof.frame_count - 1];
+  prof_line_t *line = prof_frame_line(frame);
+  if (line != NULL) {
+    line->self += elapsed;
+  }
+  prof.recs[frame->rec].self += elapsed;
+  prof.nodes[frame->node].self += elapsed;
+  prof.last = now;
+  return now;
+}
+
+static void prof_end_line(prof_frame_t *frame, uint64_t now) {
+  prof_line_t *line = prof_frame_line(frame);
+  if (frame->owns_line && line != NULL && --line->active == 0) {
+    line->total += now - frame->line_start;
+  }
+}
+
+static void prof_push(uint32_t rec, int owns_line, uint64_t now) {
+  prof.frames = prof_grow(prof.frames, prof.frame_count, &prof.frame_size, sizeof(prof_frame_t));
+  prof_frame_t *frame = &prof.frames[prof.frame_count++];
+  uint32_t parent = PROF_NONE;
+  frame->line = -1;
+  if (prof.frame_count > 1) {
+    // built-ins are charged to the caller's line
+    prof_frame_t *caller = frame - 1;
+    parent = caller->node;
+    if (!owns_line) {
+      frame->file = caller->file;
+      frame->line = caller->line;
+    }
+  }
+  frame->start = now;
+  frame->line_start = now;
+  frame->owns_line = owns_line;
+  frame->task = ctask;
+  frame->rec = rec;
+  frame->node = prof_get_node(parent, rec);
+  frame->sp = PROF_NONE;
+  prof.recs[rec].calls++;
+  prof.recs[rec].active++;
+}
+
+//
+// closes the frames above the given depth
+//
+static void prof_pop(uint32_t depth) {
+  if (depth < prof.frame_count) {
+    uint64_t now = prof_charge();
+    while (prof.frame_count > depth) {
+      prof_frame_t *frame = &prof.frames[--prof.frame_count];
+      prof_rec_t *rec = &prof.recs[frame->rec];
+      prof_end_line(frame, now);
+      if (--rec->active == 0) {
+        rec->total += now - frame->start;
+      }
+    }
+  }
+}
+
+void prof_line(int line) {
+  if (prof.frame_count && line >= 0) {
+    uint64_t now = prof_charge();
+    prof_frame_t *frame = &prof.frames[prof.frame_count - 1];
+    prof_end_line(frame, now);
+    prof_add_line(line);
+    frame->file = prof.file;
+    frame->line = line;
+    frame->line_start = now;
+    prof_line_t *next = prof_frame_line(frame);
+    next->hits++;
+    next->active++;
+    frame->owns_line = 1;
+  }
+}
+
+int prof_enter(int kind, uint32_t id, const char *name) {
+  int token = prof.frame_count;
+  if (token) {
+    uint64_t now = prof_charge();
+    uint32_t rec = prof_get_rec(kind, id, PROF_NONE);
+    if (name != NULL && !prof.recs[rec].name[0]) {
+      strlcpy(prof.recs[rec].name, name, PROF_NAME_SIZE);
+    }
+    prof_push(rec, 0, now);
+  }
+  return token;
+}
+
+void prof_leave(int token) {
+  prof_pop(token);
+}
+
+void prof_enter_udp(int kind, bcip_t addr, uint32_t sp) {
+  if (prof.frame_count) {
+    uint64_t now = prof_charge();
+    uint32_t file = prof_task_file();
+    uint32_t rec = prof_get_rec(kind, addr, file);
+    if (prof.recs[rec].line == -1) {
+      // the definition is compiled as [LINE][GOTO past the body][PROC|FUNC]
+      int pos = addr - (1 + ADDRSZ + 1) - (1 + ADDRSZ) - 1;
+      prof.recs[rec].line = 0;
+      if (pos >= 0 && prog_source[pos] == kwTYPE_LINE && prog_source[pos + 1 + ADDRSZ] == kwGOTO) {
+        prof.recs[rec].line = code_peekaddr(pos + 1);
+      }
+    }
+    prof_push(rec, 1, now);
+    prof.frames[prof.frame_count - 1].sp = sp;
+  }
+}
+
+void prof_leave_udp(uint32_t sp) {
+  // when the stack unwinds after an error the call may be below others,
+  // or already closed along with a built-in that called it
+  for (uint32_t i = prof.frame_count; i > 1; i--) {
+    prof_frame_t *frame = &prof.frames[i - 1];
+    if (frame->task == ctask && frame->sp == sp &&
+        (prof.recs[frame->rec].kind == PROF_PROC || prof.recs[frame->rec].kind == PROF_FUNC)) {
+      prof_pop(i - 1);
+      break;
+    }
+  }
+}
+
+void prof_begin() {
+  memset(&prof, 0, sizeof(prof));
+  prof.start = prof.last = prof_clock();
+  uint32_t rec = prof_get_rec(PROF_MAIN, 0, PROF_NONE);
+  strcpy(prof.recs[rec].name, "(main)");
+  prof_push(rec, 1, prof.start);
+  opt_trace_on |= TRACE_PROFILE;
+}
+
+//
+// loads the program text to show in the report
+//
+static void prof_load_source(prof_file_t *file) {
+  char path[OS_PATHNAME_SIZE + 1];
+  strlcpy(path, file->name, sizeof(path));
+  char *ext = strrchr(path, '.');
+  if (ext != NULL && strcasecmp(ext, ".sbu") == 0) {
+    // units are reported by their compiled name
+    strcpy(ext, ".bas");
+  }
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL && gsb_bas_dir[0]) {
+    const char *base = strrchr(file->name, OS_DIRSEP);
+    strlcpy(path, gsb_bas_dir, sizeof(path));
+    strlcat(path, base ? base + 1 : file->name, sizeof(path));
+    fp = fopen(path, "rb");
+  }
+  if (fp != NULL) {
+    char buffer[1024];
+    uint32_t size = 0;
+    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+      int len = strlen(buffer);
+      while (len && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r')) {
+        buffer[--len] = '\0';
+      }
+      if (file->source_lines == size) {
+        size += PROF_GROW_SIZE;
+        file->source = realloc(file->source, sizeof(char *) * size);
+      }
+      // line numbers start at 1
+      file->source[file->source_lines++] = strdup(buffer);
+    }
+    fclose(fp);
+  }
+}
+
+static const char *prof_source_line(prof_file_t *file, int line) {
+  const char *result = "";
+  if (line > 0 && (uint32_t)line <= file->source_lines) {
+    result = file->source[line - 1];
+    while (*result == ' ' || *result == '\t') {
+      result++;
+    }
+  }
+  return result;
+}
+
+//
+// names the routine for the report
+//
+static void prof_set_name(prof_rec_t *rec) {
+  char name[PROF_NAME_SIZE];
+  switch (rec->kind) {
+  case PROF_CALLP:
+    kw_getprocname(rec->id, rec->name);
+    break;
+  case PROF_CALLF:
+    if (rec->id == kwCODEARRAY) {
+      strcpy(rec->name, "[...]");
+    } else {
+      kw_getfuncname(rec->id, rec->name);
+    }
+    break;
+  case PROF_PROC:
+  case PROF_FUNC:
+    // the name follows SUB, FUNC or DEF on the definition line
+    name[0] = '\0';
+    if (rec->file != PROF_NONE) {
+      const char *p = prof_source_line(&prof.files[rec->file], rec->line);
+      while (*p && *p != ' ' && *p != '\t') {
+        p++;
+      }
+      while (*p == ' ' || *p == '\t') {
+        p++;
+      }
+      int len = 0;
+      while ((isalnum(p[len]) || p[len] == '_' || p[len] == '.' || p[len] == '$') &&
+             len < PROF_NAME_SIZE - 1) {
+        name[len] = p[len];
+        len++;
+      }
+      name[len] = '\0';
+    }
+    if (!name[0]) {
+      sprintf(name, "%s@%d", rec->kind == PROF_PROC ? "SUB" : "FUNC", rec->line);
+    }
+    strcpy(rec->name, name);
+    break;
+  default:
+    break;
+  }
+}
+
+static int prof_cmp_rec(const void *a, const void *b) {
+  const prof_rec_t *r1 = *(const prof_rec_t **)a;
+  const prof_rec_t *r2 = *(const prof_rec_t **)b;
+  return r1->self < r2->self ? 1 : r1->self > r2->self ? -1 : 0;
+}
+
+static int prof_cmp_line(const void *a, const void *b) {
+  const prof_line_t *l1 = *(const prof_line_t **)a;
+  const prof_line_t *l2 = *(const prof_line_t **)b;
+  return l1->self < l2->self ? 1 : l1->self > l2->self ? -1 : 0;
+}
+
+static const char *prof_kind_name(int kind) {
+  switch (kind) {
+  case PROF_PROC:
+    return "SUB ";
+  case PROF_FUNC:
+    return "FUNC ";
+  case PROF_CALLP:
+  case PROF_CALLF:
+    return "built-in ";
+  case PROF_PLUGIN:
+    return "plugin ";
+  default:
+    return "";
+  }
+}
+
+static void prof_write_report(FILE *fp, const char *file) {
+  uint64_t elapsed = prof.last - prof.start;
+  fprintf(fp, "SmallBASIC profile: %s\n", file);
+  fprintf(fp, "elapsed: %.3f ms\n\n", elapsed / 1e6);
+
+  prof_rec_t **recs = malloc(sizeof(prof_rec_t *) * prof.rec_count);
+  for (uint32_t i = 0; i < prof.rec_count; i++) {
+    recs[i] = &prof.recs[i];
+  }
+  qsort(recs, prof.rec_count, sizeof(prof_rec_t *), prof_cmp_rec);
+  fprintf(fp, "%10s %12s %12s %7s  %s\n", "calls", "total ms", "self ms", "self%", "routine");
+  for (uint32_t i = 0; i < prof.rec_count; i++) {
+    prof_rec_t *rec = recs[i];
+    fprintf(fp, "%10u %12.3f %12.3f %6.1f%%  %s%s", rec->calls, rec->total / 1e6, rec->self / 1e6,
+            elapsed ? 100.0 * rec->self / elapsed : 0, prof_kind_name(rec->kind), rec->name);
+    if (rec->file != PROF_NONE) {
+      fprintf(fp, " (%s:%d)", prof.files[rec->file].name, rec->line);
+    }
+    fprintf(fp, "\n");
+  }
+  free(recs);
+
+  uint32_t count = 0;
+  for (uint32_t f = 0; f < prof.file_count; f++) {
+    for (uint32_t i = 0; i < prof.files[f].size; i++) {
+      if (prof.files[f].lines[i].hits) {
+        count++;
+      }
+    }
+  }
+  prof_line_t **lines = malloc(sizeof(prof_line_t *) * (count + 1));
+  count = 0;
+  for (uint32_t f = 0; f < prof.file_count; f++) {
+    for (uint32_t i = 0; i < prof.files[f].size; i++) {
+      if (prof.files[f].lines[i].hits) {
+        lines[count++] = &prof.files[f].lines[i];
+      }
+    }
+  }
+  qsort(lines, count, sizeof(prof_line_t *), prof_cmp_line);
+  fprintf(fp, "\n%10s %12s %12s %7s  %s\n", "hits", "total ms", "self ms", "self%", "line");
+  for (uint32_t i = 0; i < count; i++) {
+    prof_line_t *line = lines[i];
+    prof_file_t *pf = prof.files;
+    while (line < pf->lines || line >= pf->lines + pf->size) {
+      pf++;
+    }
+    int line_no = line - pf->lines;
+    fprintf(fp, "%10u %12.3f %12.3f %6.1f%%  %s:%d  %s\n", line->hits, line->total / 1e6,
+            line->self / 1e6, elapsed ? 100.0 * line->self / elapsed : 0, pf->name, line_no,
+            prof_source_line(pf, line_no));
+  }
+  free(lines);
+}
+
+static void prof_write_stack(FILE *fp, uint32_t node) {
+  if (prof.nodes[node].parent != PROF_NONE) {
+    prof_write_stack(fp, prof.nodes[node].parent);
+    fputc(';', fp);
+  }
+  for (const char *p = prof.recs[prof.nodes[node].rec].name; *p; p++) {
+    fputc(*p == ' ' || *p == ';' ? '_' : *p, fp);
+  }
+}
+
+static void prof_write_folded(FILE *fp) {
+  for (uint32_t i = 0; i < prof.node_count; i++) {
+    uint64_t usec = prof.nodes[i].self / 1000;
+    if (usec) {
+      prof_write_stack(fp, i);
+      fprintf(fp, " %llu\n", (unsigned long long)usec);
+    }
+  }
+}
+
+static FILE *prof_open(const char *file, const char *ext) {
+  char path[OS_PATHNAME_SIZE + 1];
+  strlcpy(path, file, sizeof(path));
+  char *p = strrchr(path, '.');
+  if (p != NULL && strchr(p, OS_DIRSEP) == NULL) {
+    *p = '\0';
+  }
+  strlcat(path, ext, sizeof(path));
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    log_printf("PROFILE: failed to create %s\n", path);
+  }
+  return fp;
+}
+
+void prof_end(const char *file) {
+  opt_trace_on &= ~TRACE_PROFILE;
+  if (prof.frame_count) {
+    prof_pop(0);
+
+    for (uint32_t i = 0; i < prof.file_count; i++) {
+      prof_load_source(&prof.files[i]);
+    }
+    for (uint32_t i = 0; i < prof.rec_count; i++) {
+      prof_set_name(&prof.recs[i]);
+    }
+
+    FILE *fp = prof_open(file, ".prof");
+    if (fp != NULL) {
+      prof_write_report(fp, file);
+      fclose(fp);
+    }
+    fp = prof_open(file, ".folded");
+    if (fp != NULL) {
+      prof_write_folded(fp);
+      fclose(fp);
+    }
+  }
+
+  for (uint32_t i = 0; i < prof.file_count; i++) {
+    prof_file_t *pf = &prof.files[i];
+    for (uint32_t j = 0; j < pf->source_lines; j++) {
+      free(pf->source[j]);
+    }
+    free(pf->source);
+    free(pf->lines);
+    free(pf->name);
+  }
+  free(prof.files);
+  free(prof.recs);
+  free(prof.nodes);
+  free(prof.frames);
+  memset(&prof, 0, sizeof(prof));
+}
@@ -0,0 +1,94 @@
+// This file is part of SmallBASIC
+//
+// execution profiler
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith
+
+#if !defined(_sb_profile_h)
+#define _sb_profile_h
+
+#include "common/sys.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * the kinds of code a profile entry can describe
+ */
+#define PROF_MAIN     0   /**< program and unit initialisation code */
+#define PROF_PROC     1   /**< user-defined SUB                     */
+#define PROF_FUNC     2   /**< user-defined FUNC                    */
+#define PROF_CALLP    3   /**< built-in procedure                   */
+#define PROF_CALLF    4   /**< built-in function                    */
+#define PROF_PLUGIN   5   /**< plugin SUB or FUNC                   */
+
+/**
+ * @ingroup exec
+ *
+ * starts collecting, enabled with opt_profile
+ */
+void prof_begin(void);
+
+/**
+ * @ingroup exec
+ *
+ * stops collecting and writes the report (file.prof) and the
+ * collapsed stacks for flame graphs (file.folded)
+ *
+ * @param file the program file
+ */
+void prof_end(const char *file);
+
+/**
+ * @ingroup exec
+ *
+ * the executor reached a new line, called via the TRON line hook
+ */
+void prof_line(int line);
+
+/**
+ * @ingroup exec
+ *
+ * entering a built-in or plugin routine
+ *
+ * @param kind PROF_CALLP, PROF_CALLF or PROF_PLUGIN
+ * @param id the routine's code
+ * @param name the plugin symbol, NULL for built-ins
+ * @return the token to pass to prof_leave()
+ */
+int prof_enter(int kind, uint32_t id, const char *name);
+
+/**
+ * @ingroup exec
+ *
+ * leaving the routine entered with the given token
+ */
+void prof_leave(int token);
+
+/**
+ * @ingroup exec
+ *
+ * a SUB or FUNC starts, called once its call node is on the stack
+ *
+ * @param kind PROF_PROC or PROF_FUNC
+ * @param addr the UDP's address
+ * @param sp the stack position of the call's first node (parameter or call node)
+ */
+void prof_enter_udp(int kind, bcip_t addr, uint32_t sp);
+
+/**
+ * @ingroup exec
+ *
+ * the call that started at the given stack position was released,
+ * either by return or when the stack unwinds after an error
+ */
+void prof_leave_udp(uint32_t sp);
+
+#if defined(__cplusplus)
+}
+#endif
+#endif
@@ -15,7 +15,7 @@
 #include <stdint.h>
 #include <limits.h>
 
-static uint64_t state      = 0x4d595df4d0f33173;
+static SB_TLS uint64_t state      = 0x4d595df4d0f33173;
 static uint64_t multiplier = 6364136223846793005u;
 static uint64_t increment  = 1442695040888963407u;
 
@@ -22,7 +22,27 @@
 extern "C" {
 #endif
 
+/**
+ * host supplied cache of compiled programs, consulted when opt_nosave is set
+ *
+ * get: returns a malloc'd copy of the bytecode stored for file, or NULL
+ * put: receives the bytecode just compiled from file, along with the full
+ *      path of the units and include files it used. the host should copy
+ *      these and discard the bytecode when any of the files change
+ */
+typedef struct sbasic_bc_cache_t {
+  byte *(*get)(const char *file);
+  void (*put)(const char *file, const byte *bytecode, const char **deps, int dep_count);
+} sbasic_bc_cache_t;
+
+/**
+ * compile and run the given file. when built with SB_REENTRANT the
+ * interpreter state, including the opt_ settings, belongs to the calling
+ * thread, allowing separate programs to run concurrently. the cache is
+ * then shared between threads, so get and put must be thread safe
+ */
 int sbasic_main(const char *file);
+void sbasic_set_bc_cache(const sbasic_bc_cache_t *cache);
 
 #if defined(__cplusplus)
 }
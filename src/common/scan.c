@@ -16,6 +16,7 @@
 #include "common/smbas.h"
 #include "common/plugins.h"
 #include "common/units.h"
+#include "common/bc_file.h"
 #include "common/messages.h"
 #include "languages/keywords.en.c"
 
@@ -45,6 +46,8 @@ const int LEN_SHOWPAGE   = STRLEN(LCN_SHOWPAGE);
 const int LEN_ANTIALIAS  = STRLEN(LCN_ANTIALIAS);
 const int LEN_LDMODULES  = STRLEN(LCN_LOAD_MODULES);
 const int LEN_AUTOLOCAL  = STRLEN(LCN_AUTOLOCAL);
+const int LEN_PROFILE    = STRLEN(LCN_PROFILE);
+const int LEN_OPTIMISE   = STRLEN(LCN_OPTIMISE);
 const int LEN_AS_WRS     = STRLEN(LCN_AS_WRS);
 const int LEN_CONST      = STRLEN(LCN_CONST);
 
@@ -59,6 +62,7 @@ const int LEN_CONST      = STRLEN(LCN_CONST);
   (strncmp(p, (x), strlen((x))) == 0)
 
 #define GROWSIZE 128
+#define INDEX_SIZE 256
 #define MAX_PARAMS 256
 
 // the offset to a single byte stored in an 32 bit field
@@ -276,22 +280,102 @@ char *comp_prepare_name(char *dest, const char *source, int size) {
   return dest;
 }
 
+/*
+ * case insensitive FNV-1a hash of the name
+ */
+static uint32_t comp_index_hash(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const char *p = name; *p; p++) {
+    hash ^= (uint8_t)to_upper(*p);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void comp_index_init(comp_index_t *index) {
+  index->size = INDEX_SIZE;
+  index->count = 0;
+  index->slots = (comp_index_slot_t *)calloc(index->size, sizeof(comp_index_slot_t));
+}
+
+static void comp_index_free(comp_index_t *index) {
+  free(index->slots);
+  index->slots = NULL;
+  index->size = index->count = 0;
+}
+
+static void comp_index_place(comp_index_slot_t *slots, uint32_t mask, uint32_t hash, bid_t id) {
+  uint32_t pos = hash & mask;
+  while (slots[pos].id) {
+    pos = (pos + 1) & mask;
+  }
+  slots[pos].hash = hash;
+  slots[pos].id = id;
+}
+
+/*
+ * adds the table index of the name, doubling the slots beyond 75% occupancy
+ */
+static void comp_index_add(comp_index_t *index, const char *name, bid_t idx) {
+  if ((index->count + 1) * 4 > index->size * 3) {
+    uint32_t size = index->size * 2;
+    comp_index_slot_t *slots = (comp_index_slot_t *)calloc(size, sizeof(comp_index_slot_t));
+    for (uint32_t i = 0; i < index->size; i++) {
+      if (index->slots[i].id) {
+        comp_index_place(slots, size - 1, index->slots[i].hash, index->slots[i].id);
+      }
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->size = size;
+  }
+  comp_index_place(index->slots, index->size - 1, comp_index_hash(name), idx + 1);
+  index->count++;
+}
+
+/*
+ * returns the lowest table index holding the name or -1 when not found
+ */
+static bid_t comp_index_find(const comp_index_t *index, const char *name,
+                             const char *(*get_name)(bid_t), int nocase) {
+  uint32_t hash = comp_index_hash(name);
+  uint32_t mask = index->size - 1;
+  bid_t result = -1;
+  for (uint32_t pos = hash & mask; index->slots[pos].id; pos = (pos + 1) & mask) {
+    const comp_index_slot_t *slot = &index->slots[pos];
+    bid_t id = slot->id - 1;
+    if (slot->hash == hash && (result == -1 || id < result)) {
+      const char *key = get_name(id);
+      if ((nocase ? strcasecmp(key, name) : strcmp(key, name)) == 0) {
+        result = id;
+      }
+    }
+  }
+  return result;
+}
+
+static const char *comp_var_name(bid_t idx) {
+  return comp_vartable[idx].name;
+}
+
+static const char *comp_label_name(bid_t idx) {
+  return comp_labtable.elem[idx]->name;
+}
+
+static const char *comp_udp_name(bid_t idx) {
+  return comp_udptable[idx].name;
+}
+
 /*
  * returns the ID of the label. If there is no one, then it creates one
  */
 bid_t comp_label_getID(const char *label_name) {
-  bid_t idx = -1, i;
+  bid_t idx;
   char name[SB_KEYWORD_SIZE + 1];
 
   comp_prepare_name(name, label_name, SB_KEYWORD_SIZE);
 
-  for (i = 0; i < comp_labtable.count; i++) {
-    if (strcmp(comp_labtable.elem[i]->name, name) == 0) {
-      idx = i;
-      break;
-    }
-  }
-
+  idx = comp_index_find(&comp_labindex, name, comp_label_name, 0);
   if (idx == -1) {
     if (opt_verbose) {
       log_printf(MSG_NEW_LABEL, comp_line, name, comp_labcount);
@@ -313,6 +397,7 @@ bid_t comp_label_getID(const char *label_name) {
     comp_labtable.elem[comp_labtable.count] = label;
     idx = comp_labtable.count;
     comp_labtable.count++;
+    comp_index_add(&comp_labindex, name, idx);
   }
 
   return idx;
@@ -348,7 +433,7 @@ void comp_prepare_udp_name(char *dest, const char *basename) {
  * returns the ID of the UDP/UDF
  */
 bid_t comp_udp_id(const char *proc_name, int scan_tree) {
-  bid_t i;
+  bid_t idx;
   char *name = comp_bc_temp;
 
   if (scan_tree) {
@@ -371,11 +456,10 @@ bid_t comp_udp_id(const char *proc_name, int scan_tree) {
         strcpy(name, base);
       }
       // search on local
-      for (i = 0; i < comp_udpcount; i++) {
-        if (strcmp(comp_udptable[i].name, name) == 0) {
-          free(root);
-          return i;
-        }
+      idx = comp_index_find(&comp_udpindex, name, comp_udp_name, 0);
+      if (idx != -1) {
+        free(root);
+        return idx;
       }
     } while (len);
 
@@ -385,10 +469,9 @@ bid_t comp_udp_id(const char *proc_name, int scan_tree) {
     comp_prepare_udp_name(name, proc_name);
 
     // search on local
-    for (i = 0; i < comp_udpcount; i++) {
-      if (strcmp(comp_udptable[i].name, name) == 0) {
-        return i;
-      }
+    idx = comp_index_find(&comp_udpindex, name, comp_udp_name, 0);
+    if (idx != -1) {
+      return idx;
     }
   }
 
@@ -401,7 +484,7 @@ bid_t comp_udp_id(const char *proc_name, int scan_tree) {
  */
 bid_t comp_add_udp(const char *proc_name) {
   char *name = comp_bc_temp;
-  bid_t idx = -1, i;
+  bid_t idx;
   comp_prepare_udp_name(name, proc_name);
 
   /*
@@ -412,13 +495,7 @@ bid_t comp_add_udp(const char *proc_name) {
    */
 
   // search
-  for (i = 0; i < comp_udpcount; i++) {
-    if (strcmp(comp_udptable[i].name, name) == 0) {
-      idx = i;
-      break;
-    }
-  }
-
+  idx = comp_index_find(&comp_udpindex, name, comp_udp_name, 0);
   if (idx == -1) {
     if (comp_udpcount >= comp_udpsize) {
       comp_udpsize += GROWSIZE;
@@ -439,6 +516,7 @@ bid_t comp_add_udp(const char *proc_name) {
       strcpy(comp_udptable[comp_udpcount].name, name);
       idx = comp_udpcount;
       comp_udpcount++;
+      comp_index_add(&comp_udpindex, name, idx);
     }
   }
 
@@ -629,6 +707,7 @@ int comp_create_var(const char *name) {
     comp_vartable[comp_varcount].local_proc_level = 0;
     idx = comp_varcount;
     comp_varcount++;
+    comp_index_add(&comp_varindex, name, idx);
   }
   return idx;
 }
@@ -658,7 +737,7 @@ int comp_add_external_var(const char *name, int lib_id) {
  * the new variable created at local space otherwise at globale space
  */
 bid_t comp_var_getID(const char *var_name) {
-  bid_t idx = -1, i;
+  bid_t idx;
   char tmp[SB_KEYWORD_SIZE + 1];
   char *name = comp_bc_temp;
 
@@ -680,10 +759,9 @@ bid_t comp_var_getID(const char *var_name) {
   if (dot != NULL) {
     int module_type = comp_check_lib(tmp);
     if (module_type) {
-      for (i = 0; i < comp_varcount; i++) {
-        if (strcasecmp(comp_vartable[i].name, tmp) == 0) {
-          return i;
-        }
+      idx = comp_index_find(&comp_varindex, tmp, comp_var_name, 1);
+      if (idx != -1) {
+        return idx;
       }
       if (module_type == 2) {
         *dot = '\0';
@@ -702,23 +780,15 @@ bid_t comp_var_getID(const char *var_name) {
   //
   strcpy(name, tmp);
 
-  for (i = 0; i < comp_varcount; i++) {
-    if (strcmp(comp_vartable[i].name, name) == 0) {
-      idx = i;
-      break;
-    }
-
-    if (comp_vartable[i].dolar_sup) {
-      // system variables must be visible with or without '$' suffix
-      char *dollar_name = malloc(strlen(comp_vartable[i].name) + 2);
-      strcpy(dollar_name, comp_vartable[i].name);
-      strcat(dollar_name, "$");
-      if (strcmp(dollar_name, name) == 0) {
-        idx = i;
-        free(dollar_name);
-        break;
-      }
-      free(dollar_name);
+  idx = comp_index_find(&comp_varindex, name, comp_var_name, 0);
+  int len = strlen(name);
+  if (idx == -1 && len > 1 && name[len - 1] == '$') {
+    // system variables must be visible with or without '$' suffix
+    name[len - 1] = '\0';
+    bid_t sys_idx = comp_index_find(&comp_varindex, name, comp_var_name, 0);
+    name[len - 1] = '$';
+    if (sys_idx != -1 && comp_vartable[sys_idx].dolar_sup) {
+      idx = sys_idx;
     }
   }
 
@@ -2550,6 +2620,47 @@ void comp_text_line_ext_func() {
   }
 }
 
+/*
+ * DIM a(10) AS INTEGER, replaces the element type names with the V_INT or V_NUM
+ * value which selects the packed storage at run-time
+ */
+static void comp_dim_types(char *text) {
+  char *p = text;
+  char *out = text;
+  int level = 0;
+  int quotes = 0;
+
+  while (*p) {
+    if (*p == '\"') {
+      quotes = !quotes;
+    } else if (!quotes) {
+      if (*p == '(' || *p == '[' || *p == '{') {
+        level++;
+      } else if (*p == ')' || *p == ']' || *p == '}') {
+        level--;
+      } else if (level == 0 && p != text && strncmp(p, "AS ", 3) == 0 &&
+                 (p[-1] == ' ' || p[-1] == ')')) {
+        char name[SB_KEYWORD_SIZE + 1];
+        const char *next = comp_next_word(p + 3, name);
+        int type;
+        if (strcmp(name, "INTEGER") == 0) {
+          type = V_INT;
+        } else if (strcmp(name, "REAL") == 0) {
+          type = V_NUM;
+        } else {
+          sc_raise(MSG_DIM_TYPE_ERR, name);
+          break;
+        }
+        out += sprintf(out, "AS %d", type);
+        p = (char *)next;
+        continue;
+      }
+    }
+    *out++ = *p++;
+  }
+  *out = '\0';
+}
+
 int comp_text_line_command(bid_t idx, int decl, int sharp, char *last_cmd) {
   char_p_t pars[MAX_PARAMS];
   int index;
@@ -2825,6 +2936,13 @@ int comp_text_line_command(bid_t idx, int decl, int sharp, char *last_cmd) {
     }
     break;
 
+  case kwDIM:
+  case kwREDIM:
+    comp_dim_types(comp_bc_parm);
+    bc_add_code(&comp_prog, idx);
+    comp_expression(comp_bc_parm, 0);
+    break;
+
   case -1:
     comp_text_line_ext_func();
     break;
@@ -2839,8 +2957,11 @@ int comp_text_line_command(bid_t idx, int decl, int sharp, char *last_cmd) {
 }
 
 void add_line_no() {
-  if (comp_prog.line_position == 0 ||
-      comp_prog.line_position != (comp_prog.count - KW_TYPE_LINE_BYTES)) {
+  if (opt_optimise > 1 && !opt_profile) {
+    // line numbers are only needed for errors, separate the statements
+    bc_eoc(&comp_prog);
+  } else if (comp_prog.line_position == 0 ||
+             comp_prog.line_position != (comp_prog.count - KW_TYPE_LINE_BYTES)) {
     // not an adjoining kwTYPE_LINE
     if (!opt_autolocal && comp_prog.eoc_position == comp_prog.count - 1) {
       // overwrite any adjoining kwTYPE_EOC (can't do this with autolocal)
@@ -3747,8 +3868,118 @@ bcip_t comp_optimise_line_goto(bcip_t ip) {
   return ip;
 }
 
+// rewrite "v = v + expr" as an in-place append when expr has no calls which
+// may run code that modifies v after kwLET_APPEND has read it. this includes
+// map fields which may hold methods, module functions, and the built-in
+// functions which poll events and so may run DEFINEKEY handlers
+int comp_optimise_let_append(bcip_t ip) {
+  bcip_t var_ip = ip + 1;
+  bcip_t ip_next = var_ip + 1 + sizeof(bcip_t);
+  if (comp_prog.ptr[var_ip] != kwTYPE_VAR ||
+      ip_next + 2 + 1 + sizeof(bcip_t) >= comp_prog.count ||
+      comp_prog.ptr[ip_next] != kwTYPE_CMPOPR ||
+      comp_prog.ptr[ip_next + 1] != '=') {
+    return 0;
+  }
+  ip_next += 2;
+  if (comp_prog.ptr[ip_next] != kwTYPE_VAR ||
+      memcmp(comp_prog.ptr + ip_next + 1, comp_prog.ptr + var_ip + 1, sizeof(bcip_t)) != 0) {
+    return 0;
+  }
+  ip_next += 1 + sizeof(bcip_t);
+  if (ip_next >= comp_prog.count || comp_prog.ptr[ip_next] != kwTYPE_EVPUSH) {
+    return 0;
+  }
+  int level = 0;
+  while (ip_next < comp_prog.count) {
+    switch (comp_prog.ptr[ip_next]) {
+    case kwTYPE_EVPUSH:
+      level++;
+      break;
+    case kwTYPE_EVPOP:
+      if (--level == 0) {
+        if (ip_next + 3 < comp_prog.count &&
+            comp_prog.ptr[ip_next + 1] == kwTYPE_ADDOPR &&
+            comp_prog.ptr[ip_next + 2] == '+' &&
+            (comp_prog.ptr[ip_next + 3] == kwTYPE_EOC ||
+             comp_prog.ptr[ip_next + 3] == kwTYPE_LINE)) {
+          // the expression now ends at the former POP
+          comp_prog.ptr[ip] = kwLET_APPEND;
+          comp_prog.ptr[ip_next] = kwTYPE_EOC;
+          return 1;
+        }
+        return 0;
+      }
+      break;
+    case kwTYPE_CALLF: {
+      bid_t code;
+      memcpy(&code, comp_prog.ptr + ip_next + 1, CODESZ);
+      if (code == kwINKEY || code == kwPENF || code == kwINPUTF) {
+        return 0;
+      }
+      break;
+    }
+    case kwTYPE_CALL_UDF:
+    case kwTYPE_CALL_PTR:
+    case kwTYPE_CALL_VFUNC:
+    case kwTYPE_CALLEXTF:
+    case kwTYPE_UDS_EL:
+    case kwTYPE_EOC:
+    case kwTYPE_LINE:
+      return 0;
+    default:
+      break;
+    }
+    ip_next = comp_next_bc_cmd(&comp_prog, ip_next);
+  }
+  return 0;
+}
+
+// rewrite "v = v + n" and "v = v - n", where n is a numeric literal, as an increment
+int comp_optimise_let_inc(bcip_t ip) {
+  bcip_t var_ip = ip + 1;
+  bcip_t ip_next = var_ip + 1 + sizeof(bcip_t);
+  if (!opt_optimise ||
+      comp_prog.ptr[var_ip] != kwTYPE_VAR ||
+      ip_next + 2 + 1 + sizeof(bcip_t) + 1 >= comp_prog.count ||
+      comp_prog.ptr[ip_next] != kwTYPE_CMPOPR ||
+      comp_prog.ptr[ip_next + 1] != '=') {
+    return 0;
+  }
+  ip_next += 2;
+  if (comp_prog.ptr[ip_next] != kwTYPE_VAR ||
+      memcmp(comp_prog.ptr + ip_next + 1, comp_prog.ptr + var_ip + 1, sizeof(bcip_t)) != 0) {
+    return 0;
+  }
+  ip_next += 1 + sizeof(bcip_t);
+  if (comp_prog.ptr[ip_next] != kwTYPE_EVPUSH) {
+    return 0;
+  }
+  ip_next++;
+  if (comp_prog.ptr[ip_next] == kwTYPE_INT) {
+    ip_next += 1 + OS_INTSZ;
+  } else if (comp_prog.ptr[ip_next] == kwTYPE_NUM) {
+    ip_next += 1 + OS_REALSZ;
+  } else {
+    return 0;
+  }
+  if (ip_next + 3 < comp_prog.count &&
+      comp_prog.ptr[ip_next] == kwTYPE_EVPOP &&
+      comp_prog.ptr[ip_next + 1] == kwTYPE_ADDOPR &&
+      (comp_prog.ptr[ip_next + 2] == '+' || comp_prog.ptr[ip_next + 2] == '-') &&
+      (comp_prog.ptr[ip_next + 3] == kwTYPE_EOC ||
+       comp_prog.ptr[ip_next + 3] == kwTYPE_LINE)) {
+    comp_prog.ptr[ip] = kwLET_INC;
+    return 1;
+  }
+  return 0;
+}
+
 // use simpler LET where possible to avoid eval on the right term
 bcip_t comp_optimise_let(bcip_t ip) {
+  if (comp_optimise_let_inc(ip) || comp_optimise_let_append(ip)) {
+    return ip;
+  }
   bcip_t ip_next = ip + 1;
   if (comp_prog.ptr[ip_next] == kwTYPE_VAR) {
     ip_next += 1 + sizeof(bcip_t);
@@ -3772,6 +4003,15 @@ bcip_t comp_optimise_let(bcip_t ip) {
   return ip;
 }
 
+/*
+ * peephole optimisations made once addresses are resolved. the
+ * OPTION PREDEF OPTIMISE levels are:
+ *   0 - only the LINE/GOTO and LET rewrites
+ *   1 - also fold constant expressions (see ceval.c) and use kwLET_INC
+ *       for v = v +/- n
+ *   2 - also omit kwTYPE_LINE, so runtime errors, TRACE and PROGLINE no
+ *       longer report the line number
+ */
 void comp_optimise() {
   for (bcip_t ip = 0; !comp_error && ip < comp_prog.count;
        ip = comp_next_bc_cmd(&comp_prog, ip)) {
@@ -3847,6 +4087,10 @@ void comp_init() {
   comp_varsize = comp_udpsize = GROWSIZE;
   comp_varcount = comp_labcount = comp_sp = comp_udpcount = 0;
 
+  comp_index_init(&comp_varindex);
+  comp_index_init(&comp_labindex);
+  comp_index_init(&comp_udpindex);
+
   bc_create(&comp_prog);
   bc_create(&comp_data);
 
@@ -3891,6 +4135,10 @@ void comp_close() {
   }
   free(comp_labtable.elem);
 
+  comp_index_free(&comp_varindex);
+  comp_index_free(&comp_labindex);
+  comp_index_free(&comp_udpindex);
+
   for (i = 0; i < comp_exptable.count; i++) {
     free(comp_exptable.elem[i]);
   }
@@ -3929,6 +4177,7 @@ void comp_close() {
 char *comp_load(const char *file_name) {
   char *buf;
   strlcpy(comp_file_name, file_name, sizeof(comp_file_name));
+  bc_file_cache_dep(file_name);
 #if defined(IMPL_DEV_READ)
   buf = dev_read(file_name);
 #else
@@ -4436,6 +4685,13 @@ char *comp_preproc_options(char *p) {
     } else if (strncmp(LCN_AUTOLOCAL, p, LEN_AUTOLOCAL) == 0) {
       p += LEN_AUTOLOCAL;
       opt_autolocal = 1;
+    } else if (strncmp(LCN_PROFILE, p, LEN_PROFILE) == 0) {
+      p += LEN_PROFILE;
+      opt_profile = 1;
+    } else if (strncmp(LCN_OPTIMISE, p, LEN_OPTIMISE) == 0) {
+      p += LEN_OPTIMISE;
+      SKIP_SPACES(p);
+      opt_optimise = xstrtol(p);
     } else if (strncmp(LCN_COMMAND, p, LEN_COMMAND) == 0) {
       p += LEN_COMMAND;
       SKIP_SPACES(p);
@@ -4743,7 +4999,7 @@ int comp_pass1(const char *section, const char *text) {
  * setup export table
  */
 int comp_pass2_exports() {
-  int i, j;
+  int i;
 
   for (i = 0; i < comp_expcount; i++) {
     bid_t pid;
@@ -4760,18 +5016,11 @@ int comp_pass2_exports() {
       sym->vid = comp_udptable[pid].vid;
     } else {
       // look on variables
-      pid = -1;
-      for (j = 0; j < comp_varcount; j++) {
-        if (strcmp(comp_vartable[j].name, sym->symbol) == 0) {
-          pid = j;
-          break;
-        }
-      }
-
+      pid = comp_index_find(&comp_varindex, sym->symbol, comp_var_name, 0);
       if (pid != -1) {
         sym->type = stt_variable;
         sym->address = 0;
-        sym->vid = j;
+        sym->vid = pid;
       } else {
         sc_raise(MSG_EXP_SYM_NOT_FOUND, sym->symbol);
         return 0;
@@ -4831,7 +5080,7 @@ byte_code comp_create_bin() {
   }
 
   memcpy(&hdr.sign, "SBEx", 4);
-  hdr.ver = 2;
+  hdr.ver = SB_BC_VER;
   hdr.sbver = SB_DWORD_VER;
 #if defined(CPU_BIGENDIAN)
   hdr.flags = 1;
@@ -4959,10 +5208,7 @@ int comp_save_bin(byte_code bc) {
   }
   strcat(fname, comp_unit_flag ? ".sbu" : ".sbx");
 
-  int h = open(fname, O_BINARY | O_RDWR | O_TRUNC | O_CREAT, 0660);
-  if (h != -1) {
-    write(h, (char *)bc.code, bc.size);
-    close(h);
+  if (bc_file_save(fname, bc.code, bc.size)) {
     if (!opt_quiet) {
       log_printf(MSG_BC_FILE_CREATED, fname);
     }
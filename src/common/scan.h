@@ -160,6 +160,23 @@ struct comp_proc_s {
 
 typedef struct comp_proc_s comp_udp_t;
 
+/**
+ * @ingroup scan
+ * @typedef comp_index_t
+ *
+ * hash index over the names held in one of the compiler's tables
+ */
+typedef struct {
+  uint32_t hash; /**< hash of the name */
+  bid_t id; /**< table index + 1, zero when empty */
+} comp_index_slot_t;
+
+typedef struct {
+  comp_index_slot_t *slots;
+  uint32_t size; /**< number of slots, a power of 2 */
+  uint32_t count;
+} comp_index_t;
+
 /*
  * @ingroup scan
  * @typedef comp_pass_node_t
@@ -27,27 +27,27 @@
                             c |= ((y > dev_Vy2) << 3); }
 #define CLIPIN(c) ((c & 0xF) == 0)
 
-byte os_graphics = 0; // CONSOLE
-int os_graf_mx = 80;
-int os_graf_my = 25;
+SB_TLS byte os_graphics = 0; // CONSOLE
+SB_TLS int os_graf_mx = 80;
+SB_TLS int os_graf_my = 25;
 
 // graphics - viewport
-int32_t dev_Vx1;
-int32_t dev_Vy1;
-int32_t dev_Vx2;
-int32_t dev_Vy2;
-int32_t dev_Vdx;
-int32_t dev_Vdy;
+SB_TLS int32_t dev_Vx1;
+SB_TLS int32_t dev_Vy1;
+SB_TLS int32_t dev_Vx2;
+SB_TLS int32_t dev_Vy2;
+SB_TLS int32_t dev_Vdx;
+SB_TLS int32_t dev_Vdy;
 
 // graphics - window world coordinates
-int32_t dev_Wx1;
-int32_t dev_Wy1;
-int32_t dev_Wx2;
-int32_t dev_Wy2;
-int32_t dev_Wdx;
-int32_t dev_Wdy;
-long dev_fgcolor = 0;
-long dev_bgcolor = 15;
+SB_TLS int32_t dev_Wx1;
+SB_TLS int32_t dev_Wy1;
+SB_TLS int32_t dev_Wx2;
+SB_TLS int32_t dev_Wy2;
+SB_TLS int32_t dev_Wdx;
+SB_TLS int32_t dev_Wdy;
+SB_TLS long dev_fgcolor = 0;
+SB_TLS long dev_bgcolor = 15;
 
 //
 // Returns data from pointing-device
@@ -19,6 +19,8 @@
 extern "C" {
 #endif
 
+#define SB_BC_VER 3 /**< bc_head_t version */
+
 /**
  * @ingroup exec
  *
@@ -100,35 +102,63 @@ typedef struct {
 #define OPT_CMD_SZ  1024
 #define OPT_MOD_SZ  1024
 
-EXTERN byte opt_graphics; /**< command-line option: start in graphics mode   */
-EXTERN byte opt_quiet; /**< command-line option: quiet                       */
-EXTERN char opt_command[OPT_CMD_SZ]; /**< command-line parameters (COMMAND$) */
-EXTERN int opt_base; /**< OPTION BASE x                                      */
-EXTERN char opt_modpath[OPT_MOD_SZ]; /**< Modules path                       */
-EXTERN int opt_verbose; /**< print some additional infos                     */
-EXTERN int opt_ide; /**< 0=no IDE, 1=IDE is linked, 2=IDE is external exe)   */
-EXTERN byte os_charset; /**< use charset encoding                            */
-EXTERN int opt_pref_width; /**< prefered graphics mode width (0 = undefined) */
-EXTERN int opt_pref_height; /**< prefered graphics mode height               */
-EXTERN byte opt_nosave; /**< do not create .sbx files                        */
-EXTERN byte opt_usepcre; /**< OPTION PREDEF PCRE                             */
-EXTERN byte opt_file_permitted; /**< file system permission                  */
-EXTERN byte opt_show_page; /**< SHOWPAGE graphics flush mode                 */
-EXTERN byte opt_mute_audio; /**< whether to mute sounds                      */
-EXTERN byte opt_antialias; /**< OPTION ANTIALIAS OFF                         */
-EXTERN byte opt_autolocal; /**< OPTION AUTOLOCAL                             */
-EXTERN byte opt_trace_on; /**< initial value for the TRON command            */
+EXTERN SB_TLS byte opt_graphics; /**< command-line option: start in graphics mode   */
+EXTERN SB_TLS byte opt_quiet; /**< command-line option: quiet                       */
+EXTERN SB_TLS char opt_command[OPT_CMD_SZ]; /**< command-line parameters (COMMAND$) */
+EXTERN SB_TLS int opt_base; /**< OPTION BASE x                                      */
+EXTERN SB_TLS char opt_modpath[OPT_MOD_SZ]; /**< Modules path                       */
+EXTERN SB_TLS char opt_cachepath[OPT_MOD_SZ]; /**< compile cache, see bc_file.h     */
+EXTERN SB_TLS int opt_verbose; /**< print some additional infos                     */
+EXTERN SB_TLS int opt_ide; /**< 0=no IDE, 1=IDE is linked, 2=IDE is external exe)   */
+EXTERN SB_TLS byte os_charset; /**< use charset encoding                            */
+EXTERN SB_TLS int opt_pref_width; /**< prefered graphics mode width (0 = undefined) */
+EXTERN SB_TLS int opt_pref_height; /**< prefered graphics mode height               */
+EXTERN SB_TLS byte opt_nosave; /**< do not create .sbx files                        */
+EXTERN SB_TLS byte opt_usepcre; /**< OPTION PREDEF PCRE                             */
+EXTERN SB_TLS byte opt_file_permitted; /**< file system permission                  */
+EXTERN SB_TLS byte opt_show_page; /**< SHOWPAGE graphics flush mode                 */
+EXTERN SB_TLS byte opt_mute_audio; /**< whether to mute sounds                      */
+EXTERN SB_TLS byte opt_antialias; /**< OPTION ANTIALIAS OFF                         */
+EXTERN SB_TLS byte opt_autolocal; /**< OPTION AUTOLOCAL                             */
+EXTERN SB_TLS byte opt_trace_on; /**< line hook: TRACE_LINES and/or TRACE_PROFILE  */
+EXTERN SB_TLS byte opt_profile; /**< OPTION PREDEF PROFILE, see profile.h           */
+EXTERN SB_TLS byte opt_switch_dispatch; /**< use switch() instead of computed-goto  */
+EXTERN SB_TLS byte opt_optimise; /**< OPTION PREDEF OPTIMISE, see comp_optimise()  */
+
+/*
+ * opcode dispatch. the switch() selects the first handler, with GCC
+ * compatible compilers each handler then jumps directly to the handler of
+ * the next opcode via a table of label addresses (threaded code). the
+ * switch() alone is used with opt_switch_dispatch or other compilers
+ */
+#if defined(__GNUC__) && !defined(_MCU)
+#define BC_THREADED
+#define BC_OP(op)         case op: L_##op
+#define BC_DEFAULT        default: L_kwDEFAULT
+#define BC_LABEL(op)      [op] = &&L_##op
+#define BC_GOTO(cond, code) if (cond) { goto *dispatch[(code)]; }
+#else
+#define BC_OP(op)         case op
+#define BC_DEFAULT        default
+#define BC_GOTO(cond, code)
+#endif
+
+/*
+ * opt_trace_on bits, both share the one test made for each line
+ */
+#define TRACE_LINES     1       /**< TRON */
+#define TRACE_PROFILE   2       /**< the profiler is collecting */
 
 #define IDE_NONE        0
 #define IDE_INTERNAL    1
 #define IDE_EXTERNAL    2
 
 // globals
-EXTERN int gsb_last_line; /**< source code line of the last error            */
-EXTERN int gsb_last_error; /**< error code, 0 = no error,  < 0 = local messages (i.e. break), > 0 = error       */
-EXTERN char gsb_last_file[OS_PATHNAME_SIZE + 1]; /**< source code file-name of the last error     */
-EXTERN char gsb_bas_dir[OS_PATHNAME_SIZE + 1]; /**< source code home dir     */
-EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
+EXTERN SB_TLS int gsb_last_line; /**< source code line of the last error            */
+EXTERN SB_TLS int gsb_last_error; /**< error code, 0 = no error,  < 0 = local messages (i.e. break), > 0 = error       */
+EXTERN SB_TLS char gsb_last_file[OS_PATHNAME_SIZE + 1]; /**< source code file-name of the last error     */
+EXTERN SB_TLS char gsb_bas_dir[OS_PATHNAME_SIZE + 1]; /**< source code home dir     */
+EXTERN SB_TLS char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 
 #include "common/units.h"
 #include "common/tasks.h"
@@ -151,6 +181,10 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define prog_stack          ctask->sbe.exec.stack
 #define prog_stack_alloc    ctask->sbe.exec.stack_alloc
 #define prog_sp             ctask->sbe.exec.sp
+#define prog_frames         ctask->sbe.exec.frames
+#define prog_frame_chunks   ctask->sbe.exec.frame_chunks
+#define prog_frame_sp       ctask->sbe.exec.frame_sp
+#define prog_frame_base     ctask->sbe.exec.frame_base
 #define eval_stk            ctask->sbe.exec.eval_stk
 #define eval_stk_size       ctask->sbe.exec.eval_stk_size
 #define eval_sp             ctask->sbe.exec.eval_esp
@@ -174,6 +208,7 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define comp_vartable       ctask->sbe.comp.vartable
 #define comp_varcount       ctask->sbe.comp.varcount
 #define comp_varsize        ctask->sbe.comp.varsize
+#define comp_varindex       ctask->sbe.comp.varindex
 #define comp_imptable       ctask->sbe.comp.imptable
 #define comp_impcount       ctask->sbe.comp.imptable.count
 #define comp_exptable       ctask->sbe.comp.exptable
@@ -182,6 +217,7 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define comp_libcount       ctask->sbe.comp.libtable.count
 #define comp_labtable       ctask->sbe.comp.labtable
 #define comp_labcount       ctask->sbe.comp.labtable.count
+#define comp_labindex       ctask->sbe.comp.labindex
 #define comp_bc_sec         ctask->sbe.comp.bc_sec
 #define comp_block_level    ctask->sbe.comp.block_level
 #define comp_block_id       ctask->sbe.comp.block_id
@@ -196,6 +232,7 @@ EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 #define comp_udptable       ctask->sbe.comp.udptable
 #define comp_udpcount       ctask->sbe.comp.udpcount
 #define comp_udpsize        ctask->sbe.comp.udpsize
+#define comp_udpindex       ctask->sbe.comp.udpindex
 #define comp_use_global_vartable    ctask->sbe.comp.use_global_vartable
 #define comp_stack          ctask->sbe.comp.stack
 #define comp_sp             ctask->sbe.comp.stack.count
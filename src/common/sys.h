@@ -95,8 +95,21 @@ extern "C" {
 #define SB_TEXTLINE_SIZE    8192  // RTL
 #define SB_EXEC_STACK_SIZE  1024  // executor's stack size
 #define SB_EVAL_STACK_SIZE  16    // evaluation stack size
+#define SB_FRAME_CHUNK_SIZE 256   // local variables in each chunk of call frames
 #define SB_KW_NONE_STR "Nil"
 
+// storage class of the interpreter state, with SB_REENTRANT
+// each thread runs its own independent program
+#if defined(SB_REENTRANT)
+ #if defined(_MSC_VER)
+  #define SB_TLS __declspec(thread)
+ #else
+  #define SB_TLS __thread
+ #endif
+#else
+ #define SB_TLS
+#endif
+
 // STD MACROS
 #define ABS(x)    ( ((x) < 0) ? -(x) : (x) )            // absolute value
 #define SGN(a)    ( ((a)<0)? -1 : 1 )                   // sign
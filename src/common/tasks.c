@@ -10,9 +10,9 @@
 #include "common/smbas.h"
 #include "common/tasks.h"
 
-static task_t *tasks; /**< tasks table												@ingroup sys */
-static int task_count; /**< total number of tasks										@ingroup sys */
-static int task_index; /**< current task number										@ingroup sys */
+static SB_TLS task_t *tasks; /**< tasks table												@ingroup sys */
+static SB_TLS int task_count; /**< total number of tasks										@ingroup sys */
+static SB_TLS int task_index; /**< current task number										@ingroup sys */
 
 /**
  *	@ingroup sys
@@ -41,6 +41,10 @@ typedef struct {
   var_t *eval_stk; /**< eval's stack                                 */
   uint16_t eval_stk_size; /**< eval's stack size                     */
   uint16_t eval_esp; /**< Register ESP; eval's stack pointer          */
+  var_slot_t **frames; /**< LOCAL and parameter slots, in chunks    */
+  uint32_t frame_chunks; /**< number of allocated frame chunks       */
+  uint32_t frame_sp; /**< number of frame slots in use               */
+  uint32_t frame_base; /**< first slot of the current frame          */
 
   /*
    * Register R; no need
@@ -105,14 +109,17 @@ typedef struct {
   comp_var_t *vartable;
   bid_t varcount;
   bid_t varsize;
+  comp_index_t varindex;
 
   // label table
   comp_label_table_t labtable;
+  comp_index_t labindex;
 
   // user defined proc/func table
   comp_udp_t *udptable;
   bid_t udpcount;
   bid_t udpsize;
+  comp_index_t udpindex;
 
   // pass2 stack
   comp_pass_node_table_t stack;
@@ -136,6 +143,7 @@ typedef struct {
   char file[OS_PATHNAME_SIZE + 1];  /**< The program file name (task name) */
   byte *bytecode; /**< BC's memory handle                          */
   int bc_type; /**< BC type (1=executable, 2=unit)                 */
+  uint32_t bc_mapped; /**< size of the file mapping, 0 when allocated */
   int has_sysvars; /**< true if the task has system-variables      */
 
   // compiler/executor
@@ -145,7 +153,7 @@ typedef struct {
   } sbe;
 } task_t;
 
-EXTERN task_t *ctask; /**< current task pointer  */
+EXTERN SB_TLS task_t *ctask; /**< current task pointer  */
 
 /**
  *   @ingroup sys
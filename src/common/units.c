@@ -14,10 +14,11 @@
 #include "common/pproc.h"
 #include "common/scan.h"
 #include "common/units.h"
+#include "common/bc_file.h"
 
 // units table
-static unit_t *units;
-static int unit_count = 0;
+static SB_TLS unit_t *units;
+static SB_TLS int unit_count = 0;
 
 /**
  *   initialization
@@ -137,7 +138,12 @@ int open_unit(const char *file, const char *alias) {
         comp_rq = 1;
       }
     }
+    if (!comp_rq && !bc_file_check(unitname)) {
+      // created by another version - compile
+      comp_rq = 1;
+    }
   }
+  bc_file_cache_dep(bas_file);
 
   // compilation required
   if (comp_rq && !comp_compile(bas_file)) {
@@ -145,7 +151,7 @@ int open_unit(const char *file, const char *alias) {
   }
 
   // open unit
-  h = open(unitname, O_RDWR | O_BINARY);
+  h = open(unitname, O_RDONLY | O_BINARY);
   if (h == -1) {
     return -1;
   }
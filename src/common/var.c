@@ -12,26 +12,68 @@
 
 #define INT_STR_LEN 64
 
+// values of v.p.owner
+#define STR_OWNER 1
+#define STR_OWNER_GROWN 2
+
+// number of variables allocated together in each chunk
 #if defined(_MCU)
-#define VAR_POOL_SIZE 512
+#define VAR_POOL_CHUNK 128
 #else
-#define VAR_POOL_SIZE 8192
+#define VAR_POOL_CHUNK 1024
 #endif
 
-var_t var_pool[VAR_POOL_SIZE];
-var_t *var_pool_head;
+typedef struct var_chunk_t {
+  struct var_chunk_t *next;
+  var_t vars[VAR_POOL_CHUNK];
+} var_chunk_t;
 
-void v_init_pool() {
-  for (uint32_t i = 0; i < VAR_POOL_SIZE; i++) {
-    v_init(&var_pool[i]);
-    var_pool[i].pooled = 1;
-    if (i + 1 < VAR_POOL_SIZE) {
-      var_pool[i].v.pool_next = &var_pool[i + 1];
-    } else {
-      var_pool[i].v.pool_next = NULL;
+SB_TLS var_chunk_t *var_pool_chunks;
+SB_TLS var_t *var_pool_head;
+SB_TLS uint32_t var_pool_live;
+SB_TLS uint32_t var_pool_peak;
+SB_TLS uint32_t var_pool_count;
+SB_TLS uint32_t v_data_epoch;
+
+// reference count stored ahead of the array elements
+typedef union array_hdr_t {
+  uint32_t refs;
+  var_num_t align;
+} array_hdr_t;
+
+#define v_array_hdr(var) (((array_hdr_t *)v_data(var)) - 1)
+
+/*
+ * adds another chunk of variables to the free-list
+ */
+static var_t *v_pool_grow() {
+  var_chunk_t *chunk = (var_chunk_t *)malloc(sizeof(var_chunk_t));
+  if (chunk != NULL) {
+    chunk->next = var_pool_chunks;
+    var_pool_chunks = chunk;
+    var_pool_count++;
+    for (uint32_t i = 0; i < VAR_POOL_CHUNK; i++) {
+      chunk->vars[i].pooled = 1;
+      chunk->vars[i].v.pool_next = (i + 1 < VAR_POOL_CHUNK) ? &chunk->vars[i + 1] : NULL;
     }
+    var_pool_head = &chunk->vars[0];
+  }
+  return var_pool_head;
+}
+
+void v_init_pool() {
+  // release any chunks left over from a previous run
+  var_chunk_t *chunk = var_pool_chunks;
+  while (chunk != NULL) {
+    var_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
   }
-  var_pool_head = &var_pool[0];
+  var_pool_chunks = NULL;
+  var_pool_head = NULL;
+  var_pool_live = 0;
+  var_pool_peak = 0;
+  var_pool_count = 0;
 }
 
 /*
@@ -39,11 +81,17 @@ void v_init_pool() {
  */
 var_t *v_new() {
   var_t *result = var_pool_head;
+  if (result == NULL) {
+    result = v_pool_grow();
+  }
   if (result != NULL) {
     // remove an item from the free-list
     var_pool_head = result->v.pool_next;
+    if (++var_pool_live > var_pool_peak) {
+      var_pool_peak = var_pool_live;
+    }
   } else {
-    // pool exhausted
+    // out of memory, fall back to the heap
     result = (var_t *)malloc(sizeof(var_t));
     result->pooled = 0;
   }
@@ -55,6 +103,13 @@ void v_pool_free(var_t *var) {
   // insert back into the free list
   var->v.pool_next = var_pool_head;
   var_pool_head = var;
+  var_pool_live--;
+}
+
+void v_pool_stats(uint32_t *live, uint32_t *peak, uint32_t *chunks) {
+  *live = var_pool_live;
+  *peak = var_pool_peak;
+  *chunks = var_pool_count;
 }
 
 uint32_t v_get_capacity(uint32_t size) {
@@ -64,22 +119,46 @@ uint32_t v_get_capacity(uint32_t size) {
 // allocate capacity in the array container
 void v_alloc_capacity(var_t *var, uint32_t size) {
   uint32_t capacity = v_get_capacity(size);
+  array_hdr_t *hdr = (array_hdr_t *)malloc(sizeof(array_hdr_t) + sizeof(var_t) * capacity);
   v_capacity(var) = capacity;
   v_asize(var) = size;
-  v_data(var) = (var_t *)malloc(sizeof(var_t) * capacity);
-  if (!v_data(var)) {
+  var->packed = V_PACK_NONE;
+  if (!hdr) {
+    v_data(var) = NULL;
     err_memory();
   } else {
+    hdr->refs = 1;
+    v_data(var) = (var_t *)(hdr + 1);
     for (uint32_t i = 0; i < capacity; i++) {
-      var_t *e = v_elem(var, i);
-      e->pooled = 0;
-      v_init(e);
+      v_init_elem(v_elem(var, i));
     }
   }
 }
 
+// create an array of zeros in packed storage
+void v_new_packed(var_t *var, uint32_t size, uint8_t packed) {
+  // packed arrays are rarely appended to, so allocate only what is needed
+  uint32_t capacity = size ? size : 1;
+  var->type = V_ARRAY;
+  var->packed = packed;
+  array_hdr_t *hdr = (array_hdr_t *)calloc(1, sizeof(array_hdr_t) + v_elem_size(var) * capacity);
+  v_capacity(var) = capacity;
+  v_asize(var) = size;
+  v_maxdim(var) = 1;
+  v_lbound(var, 0) = opt_base;
+  v_ubound(var, 0) = opt_base + (size - 1);
+  if (!hdr) {
+    v_data(var) = NULL;
+    err_memory();
+  } else {
+    hdr->refs = 1;
+    v_data(var) = (var_t *)(hdr + 1);
+  }
+}
+
 // create an new empty array
 void v_init_array(var_t *var) {
+  var->packed = V_PACK_NONE;
   v_capacity(var) = 0;
   v_asize(var) = 0;
   v_data(var) = NULL;
@@ -102,7 +181,14 @@ void v_set_array1_size(var_t *var, uint32_t size) {
 
 void v_copy_array(var_t *dest, const var_t *src) {
   dest->type = V_ARRAY;
-  v_alloc_capacity(dest, v_asize(src));
+  if (v_packed(src)) {
+    v_new_packed(dest, v_asize(src), src->packed);
+    if (v_data(dest)) {
+      memcpy(v_data(dest), v_data(src), v_elem_size(src) * v_asize(src));
+    }
+  } else {
+    v_alloc_capacity(dest, v_asize(src));
+  }
 
   // copy dimensions
   v_maxdim(dest) = v_maxdim(src);
@@ -112,21 +198,96 @@ void v_copy_array(var_t *dest, const var_t *src) {
   }
 
   // copy each element
-  uint32_t v_size = v_asize(src);
+  uint32_t v_size = v_packed(src) ? 0 : v_asize(src);
   for (uint32_t i = 0; i < v_size; i++) {
-    var_t *dest_vp = v_elem(dest, i);
-    v_init(dest_vp);
-    v_set(dest_vp, v_elem(src, i));
+    v_set(v_elem(dest, i), v_elem(src, i));
   }
 }
 
 void v_array_free(var_t *var) {
   uint32_t v_size = v_capacity(var);
-  if (v_size && v_data(var)) {
-    for (uint32_t i = 0; i < v_size; i++) {
-      v_free(v_elem(var, i));
+  if (v_size && v_data(var) && --v_array_hdr(var)->refs == 0) {
+    if (!v_packed(var)) {
+      for (uint32_t i = 0; i < v_size; i++) {
+        v_free(v_elem(var, i));
+      }
+    }
+    free(v_array_hdr(var));
+  }
+}
+
+void v_unpack(var_t *var) {
+  if (var->type == V_ARRAY && v_packed(var)) {
+    var_t packed = *var;
+    uint32_t size = v_asize(&packed);
+    v_alloc_capacity(var, size);
+    if (v_data(var)) {
+      for (uint32_t i = 0; i < size; i++) {
+        var_t *elem = v_elem(var, i);
+        if (v_packed(&packed) == V_PACK_INT) {
+          elem->v.i = v_ints(&packed)[i];
+        } else {
+          elem->type = V_NUM;
+          elem->v.n = v_nums(&packed)[i];
+        }
+      }
+    }
+    v_array_free(&packed);
+    v_data_epoch++;
+  }
+}
+
+void v_elem_move(var_t *array, uint32_t index, var_t *value) {
+  if (array->type != V_ARRAY || index >= v_asize(array)) {
+    // the array was changed while the value was evaluated
+    err_arridx(index, array->type == V_ARRAY ? v_asize(array) : 0);
+    v_free(value);
+    return;
+  }
+  v_unshare(array);
+  int typed = (array->packed & V_PACK_TYPED);
+  switch (v_packed(array)) {
+  case V_PACK_INT:
+    if (value->type == V_INT || (typed && value->type == V_NUM)) {
+      v_ints(array)[index] = v_igetval(value);
+      return;
+    }
+    break;
+  case V_PACK_NUM:
+    if (value->type == V_NUM || (typed && value->type == V_INT)) {
+      v_nums(array)[index] = v_getval(value);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+  v_unpack(array);
+  if (!prog_error) {
+    var_t *elem = v_elem(array, index);
+    v_move(elem, value);
+  } else {
+    v_free(value);
+  }
+}
+
+void v_unshare(var_t *var) {
+  switch (var->type) {
+  case V_ARRAY:
+    if (v_capacity(var) && v_data(var) && v_array_hdr(var)->refs > 1) {
+      var_t shared = *var;
+      v_array_hdr(&shared)->refs--;
+      v_copy_array(var, &shared);
+      v_data_epoch++;
+    }
+    break;
+  case V_MAP:
+    if (map_unshare(var)) {
+      v_data_epoch++;
     }
-    free(var->v.a.data);
+    break;
+  default:
+    break;
   }
 }
 
@@ -211,10 +372,37 @@ int v_length(var_t *var) {
   return 0;
 }
 
+/*
+ * resize a packed array, any new elements are zero
+ */
+static void v_resize_packed(var_t *v, uint32_t size) {
+  uint32_t prev_size = v_asize(v);
+  size_t elem_size = v_elem_size(v);
+  if (size > v_capacity(v)) {
+    uint32_t capacity = v_get_capacity(size);
+    array_hdr_t *hdr = (array_hdr_t *)realloc(v_array_hdr(v), sizeof(array_hdr_t) + elem_size * capacity);
+    if (!hdr) {
+      err_memory();
+      return;
+    }
+    v_capacity(v) = capacity;
+    v_data(v) = (var_t *)(hdr + 1);
+    v_data_epoch++;
+  }
+  if (size > prev_size) {
+    memset((char *)v_data(v) + elem_size * prev_size, 0, elem_size * (size - prev_size));
+  }
+  v_set_array1_size(v, size);
+}
+
 /*
  * resize an existing array
  */
 void v_resize_array(var_t *v, uint32_t size) {
+  if (v->type == V_ARRAY && size && size != v_asize(v)) {
+    // other holders keep the original data
+    v_unshare(v);
+  }
   if (v->type != V_ARRAY) {
     err_varisnotarray();
   } else if ((int)size < 0) {
@@ -225,6 +413,8 @@ void v_resize_array(var_t *v, uint32_t size) {
     v_free(v);
     v_init_array(v);
     v->type = V_ARRAY;
+  } else if (v_packed(v)) {
+    v_resize_packed(v, size);
   } else if (size < v_asize(v)) {
     // resize down. free discarded elements
     uint32_t v_size = v_asize(v);
@@ -243,18 +433,18 @@ void v_resize_array(var_t *v, uint32_t size) {
     } else if (prev_size < size) {
       // resize & copy
       uint32_t capacity = v_get_capacity(size);
+      array_hdr_t *hdr = (array_hdr_t *)realloc(v_array_hdr(v), sizeof(array_hdr_t) + sizeof(var_t) * capacity);
       v_capacity(v) = capacity;
-      v_data(v) = (var_t *)realloc(v_data(v), sizeof(var_t) * capacity);
+      v_data(v) = (var_t *)(hdr + 1);
+      v_data_epoch++;
       for (uint32_t i = prev_size; i < capacity; i++) {
-        var_t *e = v_elem(v, i);
-        e->pooled = 0;
-        v_init(e);
+        v_init_elem(v_elem(v, i));
       }
     }
 
     // init vars
     for (uint32_t i = prev_size; i < size; i++) {
-      v_init(v_elem(v, i));
+      v_init_elem(v_elem(v, i));
     }
 
     v_set_array1_size(v, size);
@@ -382,8 +572,9 @@ int v_compare(var_t *a, var_t *b) {
     }
     // check every element
     for (uint32_t i = 0; i < v_asize(a); i++) {
-      var_t *ea = v_elem(a, i);
-      var_t *eb = v_elem(b, i);
+      var_t va, vb;
+      var_t *ea = v_elem_read(a, i, &va);
+      var_t *eb = v_elem_read(b, i, &vb);
       int ci = v_compare(ea, eb);
       if (ci != 0) {
         return ci;
@@ -414,10 +605,12 @@ void v_add(var_t *result, var_t *a, var_t *b) {
   char tmpsb[INT_STR_LEN];
 
   if (a->type == V_STR && b->type == V_STR) {
-    int length = strlen(a->v.p.ptr) + strlen(b->v.p.ptr);
-    v_init_str(result, length);
-    strcpy(result->v.p.ptr, a->v.p.ptr);
-    strcat(result->v.p.ptr, b->v.p.ptr);
+    int len_a = v_strlen(a);
+    int len_b = v_strlen(b);
+    v_init_str(result, len_a + len_b);
+    memcpy(result->v.p.ptr, a->v.p.ptr, len_a);
+    memcpy(result->v.p.ptr + len_a, b->v.p.ptr, len_b);
+    result->v.p.ptr[len_a + len_b] = '\0';
     return;
   } else if (a->type == V_INT && b->type == V_INT) {
     result->type = V_INT;
@@ -444,15 +637,16 @@ void v_add(var_t *result, var_t *a, var_t *b) {
         result->v.n = b->v.n + v_getval(a);
       }
     } else {
-      v_init_str(result, strlen(a->v.p.ptr) + INT_STR_LEN);
-      strcpy(result->v.p.ptr, a->v.p.ptr);
+      int len_a = v_strlen(a);
       if (b->type == V_INT) {
         ltostr(b->v.i, tmpsb);
       } else {
         ftostr(b->v.n, tmpsb);
       }
-      strcat(result->v.p.ptr, tmpsb);
-      result->v.p.length = strlen(result->v.p.ptr) + 1;
+      int len_b = strlen(tmpsb);
+      v_init_str(result, len_a + len_b);
+      memcpy(result->v.p.ptr, a->v.p.ptr, len_a);
+      memcpy(result->v.p.ptr + len_a, tmpsb, len_b + 1);
     }
   } else if ((a->type == V_INT || a->type == V_NUM) && b->type == V_STR) {
     if (is_number(b->v.p.ptr)) {
@@ -463,15 +657,17 @@ void v_add(var_t *result, var_t *a, var_t *b) {
         result->v.n = a->v.n + v_getval(b);
       }
     } else {
-      v_init_str(result, strlen(b->v.p.ptr) + INT_STR_LEN);
+      int len_b = v_strlen(b);
       if (a->type == V_INT) {
         ltostr(a->v.i, tmpsb);
       } else {
         ftostr(a->v.n, tmpsb);
       }
-      strcpy(result->v.p.ptr, tmpsb);
-      strcat(result->v.p.ptr, b->v.p.ptr);
-      result->v.p.length = strlen(result->v.p.ptr) + 1;
+      int len_a = strlen(tmpsb);
+      v_init_str(result, len_a + len_b);
+      memcpy(result->v.p.ptr, tmpsb, len_a);
+      memcpy(result->v.p.ptr + len_a, b->v.p.ptr, len_b);
+      result->v.p.ptr[len_a + len_b] = '\0';
     }
   } else if (b->type == V_MAP) {
     char *map = map_to_str(b);
@@ -485,6 +681,15 @@ void v_add(var_t *result, var_t *a, var_t *b) {
  * assign (dest = src)
  */
 void v_set(var_t *dest, const var_t *src) {
+  if (dest->contained && (src->type == V_ARRAY || src->type == V_MAP)) {
+    // hold onto src while releasing dest, which may be part of it
+    var_t value;
+    v_init(&value);
+    v_set(&value, src);
+    v_move(dest, &value);
+    return;
+  }
+
   v_free(dest);
   dest->const_flag = 0;
   dest->type = src->type;
@@ -509,10 +714,13 @@ void v_set(var_t *dest, const var_t *src) {
     }
     break;
   case V_ARRAY:
-    if (v_asize(src)) {
-      v_copy_array(dest, src);
-    } else {
+    if (!v_asize(src)) {
       v_init_array(dest);
+    } else {
+      memcpy(&dest->v.a, &src->v.a, sizeof(src->v.a));
+      v_maxdim(dest) = v_maxdim(src);
+      dest->packed = src->packed;
+      v_array_hdr(dest)->refs++;
     }
     break;
   case V_PTR:
@@ -522,7 +730,7 @@ void v_set(var_t *dest, const var_t *src) {
   case V_MAP:
     // reset type since not yet a map
     dest->type = 0;
-    map_set(dest, (const var_p_t)src);
+    map_share(dest, (const var_p_t)src);
     break;
   case V_REF:
     dest->v.ref = src->v.ref;
@@ -542,6 +750,14 @@ void v_set(var_t *dest, const var_t *src) {
  * assign (dest = src)
  */
 void v_move(var_t *dest, const var_t *src) {
+  var_t value;
+  if (dest->contained && (src->type == V_ARRAY || src->type == V_MAP)) {
+    // arrays and maps never hold shared data. copy it before releasing
+    // dest, which may be part of it
+    value = *src;
+    v_unshare(&value);
+    src = &value;
+  }
   v_free(dest);
   dest->const_flag = 0;
   dest->type = src->type;
@@ -557,10 +773,12 @@ void v_move(var_t *dest, const var_t *src) {
     dest->v.p.ptr = src->v.p.ptr;
     dest->v.p.length = src->v.p.length;
     dest->v.p.owner = src->v.p.owner;
+    dest->v.p.capacity = src->v.p.capacity;
     break;
   case V_ARRAY:
     memcpy(&dest->v.a, &src->v.a, sizeof(src->v.a));
     v_maxdim(dest) = v_maxdim(src);
+    dest->packed = src->packed;
     break;
   case V_PTR:
     dest->v.ap.p = src->v.ap.p;
@@ -589,7 +807,7 @@ void v_move(var_t *dest, const var_t *src) {
 }
 
 /*
- * return a full copy of the 'source'
+ * return a copy of the 'source'
  */
 var_t *v_clone(const var_t *source) {
   var_t *vnew = v_new();
@@ -710,22 +928,51 @@ void v_setstrn(var_t *var, const char *str, int len) {
  * adds a string to current string value
  */
 void v_strcat(var_t *var, const char *str) {
+  v_strcatn(var, str, strlen(str));
+}
+
+void v_strcatn(var_t *var, const char *str, int len) {
   if (var->type == V_INT || var->type == V_NUM) {
     v_tostr(var);
   }
   if (var->type == V_STR) {
-    if (var->v.p.owner) {
-      var->v.p.length = strlen(var->v.p.ptr) + strlen(str) + 1;
-      var->v.p.ptr = realloc(var->v.p.ptr, var->v.p.length);
-      strcat(var->v.p.ptr, str);
-    } else {
-      // mutate into owner string
-      char *p = var->v.p.ptr;
-      int len = var->v.p.length + strlen(str);
-      v_init_str(var, len);
-      strcpy(var->v.p.ptr, p);
-      strcat(var->v.p.ptr, str);
+    uint32_t cur = v_strlen(var);
+    uint32_t size = cur + len + 1;
+    uint32_t capacity;
+    switch (var->v.p.owner) {
+    case STR_OWNER_GROWN:
+      capacity = var->v.p.capacity;
+      break;
+    case STR_OWNER:
+      capacity = var->v.p.length;
+      break;
+    default:
+      capacity = 0;
+      break;
+    }
+    if (size > capacity) {
+      // grow by half again so that repeated appends only copy occasionally
+      capacity = size + (size >> 1);
+      char *ptr = var->v.p.ptr;
+      if (var->v.p.owner) {
+        // str may refer to the buffer being moved
+        int self = (str >= ptr && str < ptr + cur);
+        size_t offset = self ? (size_t)(str - ptr) : 0;
+        var->v.p.ptr = realloc(ptr, capacity);
+        if (self) {
+          str = var->v.p.ptr + offset;
+        }
+      } else {
+        // mutate into owner string
+        var->v.p.ptr = malloc(capacity);
+        memcpy(var->v.p.ptr, ptr, cur);
+      }
+      var->v.p.owner = STR_OWNER_GROWN;
+      var->v.p.capacity = capacity;
     }
+    memmove(var->v.p.ptr + cur, str, len);
+    var->v.p.ptr[cur + len] = '\0';
+    var->v.p.length = size;
   } else {
     err_typemismatch();
   }
@@ -153,15 +153,16 @@ typedef struct stknode_s {
       bcip_t ret_ip;   /**< return ip */
       bid_t rvid;      /**< return-variable ID */
       int task_id; /**< task_id or -1 (this task) */
+      uint32_t frame; /**< first frame slot of the call */
+      uint32_t caller_frame; /**< first frame slot of the caller */
       uint16_t pcount; /**< number of parameters */
     } vcall;
 
     /**
-     *  Create dynamic variable (LOCAL or PARAMETER)
+     *  FUNC result
      */
     struct {
-      var_t *vptr; /**< previous variable */
-      bid_t vid; /**< variable index in tvar */
+      var_t *vptr; /**< the result variable */
     } vdvar;
 
     /**
@@ -188,10 +189,22 @@ typedef struct stknode_s {
   code_t type; /**< type of node (keyword id, i.e. kwGOSUB, kwFOR, etc) */
 } stknode_t;
 
+/**
+ * @ingroup exec
+ * @typedef var_slot_t
+ *
+ * LOCAL or parameter variable held in the call frame
+ */
+typedef struct var_slot_s {
+  var_t var; /**< the local value, left empty for BYREF parameters */
+  var_t *saved; /**< the variable hidden by the local */
+  bid_t vid; /**< variable index in tvar */
+} var_slot_t;
+
 /**
  * @ingroup var
  *
- * intialises the var pool
+ * intialises the var pool, releasing any chunks from a previous run
  */
 void v_init_pool(void);
 
@@ -202,6 +215,22 @@ void v_init_pool(void);
  */
 void v_pool_free(var_t *var);
 
+/**
+ * @ingroup var
+ *
+ * returns the number of pooled variables in use, the most in use
+ * since v_init_pool() and the number of chunks holding them
+ */
+void v_pool_stats(uint32_t *live, uint32_t *peak, uint32_t *chunks);
+
+/**
+ * @ingroup var
+ *
+ * advanced whenever array or map data moves to a new address, which
+ * invalidates any element pointers resolved before the move
+ */
+extern SB_TLS uint32_t v_data_epoch;
+
 /**
  * < returns the integer value of variable v
  * @ingroup var
@@ -293,6 +322,43 @@ int code_pop_and_free();
  */
 stknode_t *code_stackpeek();
 
+/**
+ * @ingroup exec
+ *
+ * returns the frame slot at the given position
+ */
+#define code_frame_slot(i) (&prog_frames[(i) / SB_FRAME_CHUNK_SIZE][(i) % SB_FRAME_CHUNK_SIZE])
+
+/**
+ * @ingroup exec
+ *
+ * starts the frame for a SUB or FUNC call
+ *
+ * @param node the call node
+ */
+void code_push_frame(stknode_t *node);
+
+/**
+ * @ingroup exec
+ *
+ * releases the frame slots from the given position, restoring the hidden variables
+ *
+ * @param frame the first slot to release
+ */
+void code_pop_frame(uint32_t frame);
+
+/**
+ * @ingroup exec
+ *
+ * adds a slot for the variable to the current frame. the variable is
+ * replaced with the empty slot variable until the frame is released
+ *
+ * @param vid variable index in tvar
+ * @param reuse when non-zero, reuses any slot of the current frame holding the variable
+ * @return the slot variable
+ */
+var_t *code_push_local(bid_t vid, int reuse);
+
 /**
  * @ingroup var
  *
@@ -301,6 +367,15 @@ stknode_t *code_stackpeek();
  */
 #define code_getvarptr() code_getvarptr_parens(0)
 
+/**
+ * @ingroup var
+ *
+ * Returns the varptr of the next variable without preparing any shared
+ * array or map along the way for modification. only use where the
+ * result is read.
+ */
+#define code_getvarptr_read() code_getvarptr_mode(0, 0)
+
 #define code_peek()         prog_source[prog_ip]    /**< R(byte) <- Code[IP]          @ingroup exec */
 #define code_getnext()      prog_source[prog_ip++]  /**< R(byte) <- Code[IP]; IP ++;  @ingroup exec */
 
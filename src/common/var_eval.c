@@ -16,10 +16,16 @@
 #include "common/var_eval.h"
 #include "common/plugins.h"
 
+// holds the value of a packed array element along with its location
+static SB_TLS var_t packed_elem;
+static SB_TLS var_t *packed_array;
+static SB_TLS uint32_t packed_index;
+
 //
 // returns a temporary var that can exist in the calling scope
 //
 var_p_t v_get_tmp(var_p_t map) {
+  v_unshare(map);
   var_p_t result = map_get(map, MAP_TMP_FIELD);
   if (result == NULL) {
     result = map_add_var(map, MAP_TMP_FIELD, 0);
@@ -39,15 +45,8 @@ void v_eval_func(var_p_t self, var_p_t v_func, var_p_t result) {
     }
   } else {
     // module callback
-    slib_par_t *ptable;
     int pcount;
-    if (code_peek() == kwTYPE_LEVEL_BEGIN) {
-      ptable = (slib_par_t *)malloc(sizeof(slib_par_t) * MAX_PARAMS);
-      pcount = plugin_build_ptable(ptable, MAX_PARAMS);
-    } else {
-      ptable = NULL;
-      pcount = 0;
-    }
+    slib_par_t *ptable = plugin_params_begin(MAX_PARAMS, &pcount);
     if (!prog_error) {
       if (!v_func->v.fn.mcb(self, pcount, ptable, result)) {
         if (result->type == V_STR) {
@@ -57,11 +56,40 @@ void v_eval_func(var_p_t self, var_p_t v_func, var_p_t result) {
         }
       }
     }
-    if (ptable) {
-      plugin_free_ptable(ptable, pcount);
-      free(ptable);
+    plugin_params_end(ptable, pcount);
+  }
+}
+
+/**
+ * Returns the subscript when it is a lone integer variable or constant,
+ * which is then read without a call to eval()
+ */
+static inline int get_array_subscript(bcip_t *idim) {
+  bcip_t next;
+  var_int_t value;
+  var_t *var_p;
+  switch (code_peek()) {
+  case kwTYPE_VAR:
+    next = prog_ip + 1 + ADDRSZ;
+    var_p = tvar[code_peekaddr(prog_ip + 1)];
+    if (var_p->type != V_INT) {
+      return 0;
     }
+    value = var_p->v.i;
+    break;
+  case kwTYPE_INT:
+    next = prog_ip + 1 + sizeof(var_int_t);
+    memcpy(&value, prog_source + prog_ip + 1, sizeof(var_int_t));
+    break;
+  default:
+    return 0;
+  }
+  if (prog_source[next] != kwTYPE_LEVEL_END && prog_source[next] != kwTYPE_SEP) {
+    return 0;
   }
+  *idim = value;
+  prog_ip = next;
+  return 1;
 }
 
 /**
@@ -72,38 +100,38 @@ bcip_t get_array_idx(var_t *array) {
   bcip_t lev = 0;
 
   do {
-    var_t var;
-    v_init(&var);
-    eval(&var);
-
-    if (prog_error) {
-      break;
-    } else if (var.type == V_STR || array->type == V_MAP) {
-      err_varnotnum();
-      break;
-    } else {
-      bcip_t idim = v_getint(&var);
+    bcip_t idim;
+    if (array->type == V_MAP || !get_array_subscript(&idim)) {
+      var_t var;
+      v_init(&var);
+      eval(&var);
 
+      if (prog_error) {
+        break;
+      } else if (var.type == V_STR || array->type == V_MAP) {
+        err_varnotnum();
+        break;
+      }
+      idim = v_getint(&var);
       v_free(&var);
-      idim = idim - v_lbound(array, lev);
+    }
 
-      bcip_t m = idim;
-      for (bcip_t i = lev + 1; i < v_maxdim(array); i++) {
-        m = m * (ABS(v_ubound(array, i) - v_lbound(array, i)) + 1);
-      }
-      idx += m;
+    // row-major: scale the preceding subscripts by the size of this dimension
+    if (lev > 0 && lev < v_maxdim(array)) {
+      idx *= ABS(v_ubound(array, lev) - v_lbound(array, lev)) + 1;
+    }
+    idx += idim - v_lbound(array, lev);
 
-      // skip separator
-      byte code = code_peek();
-      if (code == kwTYPE_SEP) {
-        code_skipnext();
-        if (code_getnext() != ',') {
-          err_missing_comma();
-        }
+    // skip separator
+    byte code = code_peek();
+    if (code == kwTYPE_SEP) {
+      code_skipnext();
+      if (code_getnext() != ',') {
+        err_missing_comma();
       }
-      // next
-      lev++;
     }
+    // next
+    lev++;
   } while (!prog_error && code_peek() != kwTYPE_LEVEL_END);
 
   if (!prog_error) {
@@ -123,7 +151,7 @@ var_t *code_getvarptr_map(var_t **var_map) {
     code_skipnext();
     *var_map = tvar[code_getaddr()];
     if (code_peek() == kwTYPE_UDS_EL) {
-      var_p = map_resolve_fields(*var_map, var_map);
+      var_p = map_resolve_fields(*var_map, var_map, 1);
     }
   }
   return var_p;
@@ -147,7 +175,7 @@ var_t *v_set_self(var_t *map) {
 /**
  * Used by code_getvarptr() to retrieve an element ptr of an array
  */
-var_t *code_getvarptr_arridx(var_t *basevar_p) {
+var_t *code_getvarptr_arridx(var_t *basevar_p, int for_write) {
   var_t *var_p = NULL;
 
   if (code_peek() != kwTYPE_LEVEL_BEGIN) {
@@ -157,7 +185,20 @@ var_t *code_getvarptr_arridx(var_t *basevar_p) {
     bcip_t array_index = get_array_idx(basevar_p);
     if (!prog_error) {
       if ((int) array_index < v_asize(basevar_p) && (int) array_index >= 0) {
-        var_p = v_elem(basevar_p, array_index);
+        if (for_write) {
+          v_unshare(basevar_p);
+          if (for_write != FOR_WRITE_PACKED || prog_source[prog_ip + 1] == kwTYPE_UDS_EL) {
+            // the element itself is modified
+            v_unpack(basevar_p);
+          }
+        }
+        if (v_packed(basevar_p)) {
+          var_p = v_elem_read(basevar_p, array_index, &packed_elem);
+          packed_array = basevar_p;
+          packed_index = array_index;
+        } else {
+          var_p = v_elem(basevar_p, array_index);
+        }
         if (code_peek() == kwTYPE_LEVEL_END) {
           code_skipnext();
           if (code_peek() == kwTYPE_LEVEL_BEGIN) {
@@ -165,7 +206,7 @@ var_t *code_getvarptr_arridx(var_t *basevar_p) {
             if (var_p->type != V_ARRAY) {
               err_varisnotarray();
             } else {
-              return code_getvarptr_arridx(var_p);
+              return code_getvarptr_arridx(var_p, for_write);
             }
           }
         } else {
@@ -179,12 +220,26 @@ var_t *code_getvarptr_arridx(var_t *basevar_p) {
   return var_p;
 }
 
-var_t *code_get_map_element(var_t *map, var_t *field) {
+int code_packed_ref(var_t *var_p, var_t **array, uint32_t *index) {
+  int result;
+  if (var_p == &packed_elem) {
+    *array = packed_array;
+    *index = packed_index;
+    result = 1;
+  } else {
+    result = 0;
+  }
+  return result;
+}
+
+var_t *code_get_map_element(var_t *map, var_t *field, int for_write) {
   var_t *result = NULL;
 
   if (code_peek() != kwTYPE_LEVEL_BEGIN) {
     err_arrmis_lp();
   } else if (field->type == V_PTR) {
+    // the method may modify its owner
+    v_unshare(map);
     prog_ip = cmd_push_args(kwFUNC, field->v.ap.p, field->v.ap.v);
     var_t *self = v_set_self(map);
     bc_loop(2);
@@ -203,18 +258,20 @@ var_t *code_get_map_element(var_t *map, var_t *field) {
       }
     }
   } else if (field->type == V_ARRAY) {
-    result = code_getvarptr_arridx(field);
+    result = code_getvarptr_arridx(field, for_write);
   } else if (field->type == V_FUNC) {
+    // field may belong to the data being replaced by v_get_tmp()
+    var_t method = *field;
     result = v_get_tmp(map);
     v_init(result);
-    v_eval_func(map, field, result);
+    v_eval_func(map, &method, result);
   } else {
     code_skipnext();
     var_t var;
     v_init(&var);
     eval(&var);
     if (!prog_error) {
-      map_get_value(field, &var, &result);
+      map_get_value(field, &var, &result, for_write);
       if (code_peek() == kwTYPE_LEVEL_END) {
         code_skipnext();
       } else {
@@ -229,7 +286,7 @@ var_t *code_get_map_element(var_t *map, var_t *field) {
 /**
  * resolve a composite variable reference, eg: ar.ch(0).foo
  */
-var_t *code_resolve_varptr(var_t *var_p, int until_parens) {
+var_t *code_resolve_varptr(var_t *var_p, int until_parens, int for_write) {
   int deref = 1;
   while (deref && var_p != NULL) {
     switch (code_peek()) {
@@ -237,11 +294,11 @@ var_t *code_resolve_varptr(var_t *var_p, int until_parens) {
       if (until_parens) {
         deref = 0;
       } else {
-        var_p = code_getvarptr_arridx(var_p);
+        var_p = code_getvarptr_arridx(var_p, for_write);
       }
       break;
     case kwTYPE_UDS_EL:
-      var_p = map_resolve_fields(var_p, NULL);
+      var_p = map_resolve_fields(var_p, NULL, for_write);
       break;
     default:
       deref = 0;
@@ -253,7 +310,7 @@ var_t *code_resolve_varptr(var_t *var_p, int until_parens) {
 /**
  * resolve a composite variable reference, eg: ar.ch(0).foo
  */
-var_t *code_resolve_map(var_t *var_p, int until_parens) {
+var_t *code_resolve_map(var_t *var_p, int until_parens, int for_write) {
   int deref = 1;
   var_t *v_parent = var_p;
   while (deref && var_p != NULL) {
@@ -262,11 +319,11 @@ var_t *code_resolve_map(var_t *var_p, int until_parens) {
       if (until_parens) {
         deref = 0;
       } else {
-        var_p = code_get_map_element(v_parent, var_p);
+        var_p = code_get_map_element(v_parent, var_p, for_write);
       }
       break;
     case kwTYPE_UDS_EL:
-      var_p = map_resolve_fields(var_p, &v_parent);
+      var_p = map_resolve_fields(var_p, &v_parent, for_write);
       break;
     default:
       deref = 0;
@@ -282,11 +339,11 @@ var_t *resolve_var_ref(var_t *var_p, int *is_ptr) {
     if (var_p->type == V_PTR) {
       *is_ptr = 1;
     } else {
-      var_p = resolve_var_ref(code_getvarptr_arridx(var_p), is_ptr);
+      var_p = resolve_var_ref(code_getvarptr_arridx(var_p, 0), is_ptr);
     }
     break;
   case kwTYPE_UDS_EL:
-    var_p = resolve_var_ref(map_resolve_fields(var_p, NULL), is_ptr);
+    var_p = resolve_var_ref(map_resolve_fields(var_p, NULL, 0), is_ptr);
     break;
   }
   return var_p;
@@ -305,11 +362,11 @@ var_t *code_isvar_resolve_map(var_t *var_p, int *is_ptr) {
         *is_ptr = 1;
         deref = 0;
       } else {
-        var_p = code_get_map_element(v_parent, var_p);
+        var_p = code_get_map_element(v_parent, var_p, 0);
       }
       break;
     case kwTYPE_UDS_EL:
-      var_p = map_resolve_fields(var_p, NULL);
+      var_p = map_resolve_fields(var_p, NULL, 0);
       break;
     default:
       deref = 0;
@@ -342,7 +399,7 @@ int code_isvar() {
       }
       break;
     case V_ARRAY:
-      var_p = code_resolve_varptr(var_p, 0);
+      var_p = code_resolve_varptr(var_p, 0, 0);
       break;
     case V_REF:
       is_ptr = 0;
@@ -28,19 +28,33 @@ var_t *v_set_self(var_t *self);
  */
 var_t *code_getvarptr_map(var_t **map);
 
+// for_write mode where an element of a packed array is returned by value,
+// the caller then assigns the element with v_elem_move(), see code_packed_ref()
+#define FOR_WRITE_PACKED 2
+
+/**
+ * @ingroup var
+ *
+ * returns whether var_p is a packed array element returned by the
+ * FOR_WRITE_PACKED mode, along with the array and index to assign
+ */
+int code_packed_ref(var_t *var_p, var_t **array, uint32_t *index);
+
 /**
  * @ingroup var
  *
- * resolve map
+ * resolve map. when for_write is set, shared data along the path is
+ * copied before the result is returned
  */
-var_t *code_resolve_map(var_t *var_p, int until_parens);
+var_t *code_resolve_map(var_t *var_p, int until_parens, int for_write);
 
 /**
  * @ingroup var
  *
- * resolve var pointer
+ * resolve var pointer. when for_write is set, shared data along the path
+ * is copied before the result is returned
  */
-var_t *code_resolve_varptr(var_t *var_p, int until_parens);
+var_t *code_resolve_varptr(var_t *var_p, int until_parens, int for_write);
 
 /**
  * @ingroup var
@@ -14,21 +14,43 @@
 #include "common/plugins.h"
 #include "include/var_map.h"
 
-#define BUFFER_GROW_SIZE 64
-#define BUFFER_PADDING   10
-#define TOKEN_GROW_SIZE  16
-#define JSMN_STATIC
-
-#include "lib/jsmn/jsmn.h"
+#define JSON_WRITE_SIZE 4096
+#define JSON_READ_SIZE  4096
+#define JSON_TOKEN_SIZE 64
+#define JSON_END        -1
+#define JSON_NUM_SIZE   64
+#define FIELD_CACHE_SIZE 256
 
 //
-// Container for map_from_str
+// Output for map_to_str and map_write. The text is collected in the
+// buffer, or when a handle is given, written out each time the buffer fills
 //
-typedef struct JsonTokens {
-  const char *js;
-  jsmntok_t *tokens;
-  int num_tokens;
-} JsonTokens;
+typedef struct JsonWriter {
+  hashmap_cb cb;
+  char *buffer;
+  uint32_t length;
+  uint32_t size;
+  int stream;
+  int method;
+  intptr_t handle;
+} JsonWriter;
+
+//
+// Input for map_parse_str and map_read_json. The text is either held in
+// memory or read from the handle in chunks as it is consumed
+//
+typedef struct JsonReader {
+  const char *text;
+  uint32_t length;
+  uint32_t pos;
+  uint32_t offset;
+  int handle;
+  uint32_t unread;
+  char *token;
+  uint32_t token_len;
+  uint32_t token_size;
+  char *chunk;
+} JsonReader;
 
 struct ArrayNode;
 typedef struct ArrayNode {
@@ -43,10 +65,8 @@ typedef struct ArrayList {
   ArrayNode *tail;
 } ArrayList;
 
-//
-// Process the next token
-//
-int map_read_next_token(var_p_t dest, JsonTokens *json, int index);
+void json_write_var(JsonWriter *writer, var_p_t var, int quote);
+void json_read_value(JsonReader *reader, var_p_t dest);
 
 //
 // initialise the variable as a map
@@ -134,32 +154,13 @@ const char *map_get_str(var_p_t base, const char *name) {
   return result;
 }
 
-//
-// return the element at the nth position
-//
-int map_elem_cb(hashmap_cb *cb, var_p_t key, var_p_t value) {
-  int result;
-  if (cb->count++ == cb->index) {
-    cb->var = key;
-    result = 1;
-  } else {
-    result = 0;
-  }
-  return result;
-}
-
 //
 // return the element key at the nth position
 //
 var_p_t map_elem_key(const var_p_t var_p, int index) {
   var_p_t result;
   if (var_p->type == V_MAP) {
-    hashmap_cb cb;
-    cb.count = 0;
-    cb.index = index;
-    cb.var = NULL;
-    hashmap_foreach(var_p, map_elem_cb, &cb);
-    result = cb.var;
+    result = hashmap_key_at(var_p, index);
   } else {
     result = NULL;
   }
@@ -203,12 +204,22 @@ void map_set_lib_id(var_p_t var_p, int lib_id) {
   }
 }
 
+//
+// Field names are held in the bytecode, so the address of the name
+// identifies the place in the program where the field is resolved
+//
+static inline hashmap_ic *field_cache_at(const char *key) {
+  static SB_TLS hashmap_ic field_cache[FIELD_CACHE_SIZE];
+  return &field_cache[((uintptr_t)key >> 2) & (FIELD_CACHE_SIZE - 1)];
+}
+
 //
 // Returns the final element eg z in foo.x.y.z
 // Scan byte code for node kwTYPE_UDS_EL and attach as field elements
-// if they don't already exist.
+// if they don't already exist. Shared maps along the path are copied
+// unless resolving only for reading.
 //
-var_p_t map_resolve_fields(var_p_t base, var_p_t *parent) {
+var_p_t map_resolve_fields(var_p_t base, var_p_t *parent, int for_write) {
   var_p_t field = NULL;
   if (code_peek() == kwTYPE_UDS_EL) {
     code_skipnext();
@@ -235,13 +246,13 @@ var_p_t map_resolve_fields(var_p_t base, var_p_t *parent) {
     int len = code_getstrlen();
     const char *key = (const char *)&prog_source[prog_ip];
     prog_ip += len;
-    field = hashmap_putc(base, key, len);
+    field = hashmap_putc_ic(base, key, len, for_write, field_cache_at(key));
     if (parent != NULL) {
       *parent = base;
     }
 
     // evaluate the next sub-element
-    field = map_resolve_fields(field, parent);
+    field = map_resolve_fields(field, parent, for_write);
   } else {
     field = base;
   }
@@ -263,14 +274,15 @@ var_p_t map_add_var(var_p_t base, const char *name, int value) {
 // Return the variable in base keyed by key, if not found then creates
 // an empty variable that will be returned in a further call
 //
-void map_get_value(var_p_t base, var_p_t var_key, var_p_t *result) {
+void map_get_value(var_p_t base, var_p_t var_key, var_p_t *result, int for_write) {
   if (base->type == V_ARRAY && v_asize(base)) {
     // convert the non-empty array to a map
     var_t *clone = v_clone(base);
 
     hashmap_create(base, 0);
     for (int i = 0; i < v_asize(clone); i++) {
-      const var_t *element = v_elem(clone, i);
+      var_t tmp;
+      const var_t *element = v_elem_read(clone, i, &tmp);
       var_p_t key = v_new();
       v_setint(key, i);
       var_p_t value = hashmap_putv(base, key);
@@ -291,7 +303,10 @@ void map_get_value(var_p_t base, var_p_t var_key, var_p_t *result) {
   }
 
   v_tostr(var_key);
-  *result = hashmap_put(base, var_key->v.p.ptr, v_strlen(var_key));
+  *result = for_write ? NULL : hashmap_getn(base, var_key->v.p.ptr, v_strlen(var_key));
+  if (*result == NULL) {
+    *result = hashmap_put(base, var_key->v.p.ptr, v_strlen(var_key));
+  }
 }
 
 //
@@ -316,14 +331,45 @@ void map_set(var_p_t dest, const var_p_t src) {
     cb.var = dest;
     hashmap_create(dest, src->v.m.count);
     hashmap_foreach(src, map_set_cb, &cb);
-    dest->v.m.count = src->v.m.count;
     dest->v.m.id = src->v.m.id;
     dest->v.m.lib_id = -1;
     dest->v.m.cls_id = -1;
   }
 }
 
+//
+// Share the structure with dest until either side is modified
+//
+void map_share(var_p_t dest, const var_p_t src) {
+  if (dest != src && src->type == V_MAP) {
+    hashmap_share(dest, src);
+    dest->v.m.id = src->v.m.id;
+    dest->v.m.lib_id = -1;
+    dest->v.m.cls_id = -1;
+  }
+}
+
+//
+// Replace shared data with a private copy. returns whether a copy was made
+//
+int map_unshare(var_p_t var_p) {
+  int result = 0;
+  if (var_p->type == V_MAP && hashmap_is_shared(var_p)) {
+    var_t shared = *var_p;
+    uint8_t const_flag = var_p->const_flag;
+    var_p->type = V_INT;
+    map_set(var_p, &shared);
+    var_p->const_flag = const_flag;
+    var_p->v.m.lib_id = shared.v.m.lib_id;
+    var_p->v.m.cls_id = shared.v.m.cls_id;
+    hashmap_destroy(&shared);
+    result = 1;
+  }
+  return result;
+}
+
 void map_set_int(var_p_t base, const char *name, var_int_t n) {
+  v_unshare(base);
   var_p_t var = map_get(base, name);
   if (var != NULL) {
     v_setint(var, n);
@@ -333,55 +379,62 @@ void map_set_int(var_p_t base, const char *name, var_int_t n) {
 }
 
 //
-// Helper for map_to_str
+// Appends text to the writer, growing or flushing the buffer as needed
 //
-int map_to_str_cb(hashmap_cb *cb, var_p_t v_key, var_p_t v_var) {
-  char *key = v_str(v_key);
-  char *value = v_str(v_var);
-  int required = strlen(cb->buffer) + strlen(key) + strlen(value) + BUFFER_PADDING;
-  if (required >= cb->count) {
-    cb->count = required + BUFFER_GROW_SIZE;
-    cb->buffer = realloc(cb->buffer, cb->count);
+void json_append(JsonWriter *writer, const char *text, uint32_t len) {
+  if (writer->length + len >= writer->size) {
+    if (writer->stream && writer->length) {
+      pv_write(writer->buffer, writer->method, writer->handle);
+      writer->length = 0;
+    }
+    while (writer->length + len >= writer->size) {
+      writer->size *= 2;
+      writer->buffer = realloc(writer->buffer, writer->size);
+    }
   }
+  memcpy(writer->buffer + writer->length, text, len);
+  writer->length += len;
+  writer->buffer[writer->length] = '\0';
+}
+
+static inline void json_append_char(JsonWriter *writer, char ch) {
+  json_append(writer, &ch, 1);
+}
+
+//
+// Writes the key/value pair of the map
+//
+int json_write_map_cb(hashmap_cb *cb, var_p_t v_key, var_p_t v_var) {
+  JsonWriter *writer = (JsonWriter *)cb;
   if (!cb->start) {
-    strcat(cb->buffer, ",");
+    json_append_char(writer, ',');
   }
   cb->start = 0;
-  strcat(cb->buffer, "\"");
-  strcat(cb->buffer, key);
-  strcat(cb->buffer, "\"");
-  strcat(cb->buffer, ":");
-  if (v_var->type == V_STR) {
-    strcat(cb->buffer, "\"");
-  }
-  strcat(cb->buffer, value);
-  if (v_var->type == V_STR) {
-    strcat(cb->buffer, "\"");
-  }
-  free(key);
-  free(value);
+  json_append_char(writer, '"');
+  json_write_var(writer, v_key, 0);
+  json_append(writer, "\":", 2);
+  json_write_var(writer, v_var, 1);
   return 0;
 }
 
 //
-// Print the array element, growing the buffer as needed
+// Writes the map variable
 //
-void array_append_elem(hashmap_cb *cb, var_t *elem) {
-  char *value = v_str(elem);
-  int required = strlen(cb->buffer) + strlen(value) + BUFFER_PADDING;
-  if (required >= cb->count) {
-    cb->count = required + BUFFER_GROW_SIZE;
-    cb->buffer = realloc(cb->buffer, cb->count);
-  }
-  strcat(cb->buffer, value);
-  free(value);
+void json_write_map(JsonWriter *writer, var_p_t var) {
+  int start = writer->cb.start;
+  writer->cb.start = 1;
+  json_append_char(writer, '{');
+  hashmap_foreach(var, json_write_map_cb, &writer->cb);
+  json_append_char(writer, '}');
+  writer->cb.start = start;
 }
 
 //
-// print the array variable
+// Writes the array variable, the rows of a 2D array are separated with ';'
 //
-void array_to_str(hashmap_cb *cb, var_t *var) {
-  strcpy(cb->buffer, "[");
+void json_write_array(JsonWriter *writer, var_p_t var) {
+  var_t tmp;
+  json_append_char(writer, '[');
   if (v_maxdim(var) == 2) {
     // NxN
     int rows = ABS(v_ubound(var, 0) - v_lbound(var, 0)) + 1;
@@ -390,45 +443,90 @@ void array_to_str(hashmap_cb *cb, var_t *var) {
     for (int i = 0; i < rows; i++) {
       for (int j = 0; j < cols; j++) {
         int pos = i * cols + j;
-        var_t *elem = v_elem(var, pos);
-        array_append_elem(cb, elem);
+        json_write_var(writer, v_elem_read(var, pos, &tmp), 0);
         if (j != cols - 1) {
-          strcat(cb->buffer, ",");
+          json_append_char(writer, ',');
         }
       }
       if (i != rows - 1) {
-        strcat(cb->buffer, ";");
+        json_append_char(writer, ';');
       }
     }
   } else {
     for (int i = 0; i < v_asize(var); i++) {
-      var_t *elem = v_elem(var, i);
-      array_append_elem(cb, elem);
+      json_write_var(writer, v_elem_read(var, i, &tmp), 0);
       if (i != v_asize(var) - 1) {
-        strcat(cb->buffer, ",");
+        json_append_char(writer, ',');
       }
     }
   }
-  strcat(cb->buffer, "]");
+  json_append_char(writer, ']');
 }
 
 //
-// Return the contents of the structure as a string
+// Writes the variable, strings are quoted when held in a map
 //
-char *map_to_str(const var_p_t var_p) {
-  hashmap_cb cb;
-  cb.count = BUFFER_GROW_SIZE;
-  cb.buffer = malloc(cb.count);
+void json_write_var(JsonWriter *writer, var_p_t var, int quote) {
+  char buf[JSON_NUM_SIZE];
+  switch (var->type) {
+  case V_INT:
+    ltostr(var->v.i, buf);
+    json_append(writer, buf, strlen(buf));
+    break;
+  case V_NUM:
+    ftostr(var->v.n, buf);
+    json_append(writer, buf, strlen(buf));
+    break;
+  case V_STR:
+    if (quote) {
+      json_append_char(writer, '"');
+    }
+    json_append(writer, var->v.p.ptr, strlen(var->v.p.ptr));
+    if (quote) {
+      json_append_char(writer, '"');
+    }
+    break;
+  case V_ARRAY:
+    json_write_array(writer, var);
+    break;
+  case V_MAP:
+    json_write_map(writer, var);
+    break;
+  case V_FUNC:
+  case V_PTR:
+    json_append(writer, "func", 4);
+    break;
+  case V_NIL:
+    json_append(writer, SB_KW_NONE_STR, strlen(SB_KW_NONE_STR));
+    break;
+  default:
+    break;
+  }
+}
 
+void json_write(JsonWriter *writer, const var_p_t var_p, int stream, int method, intptr_t handle) {
+  writer->size = JSON_WRITE_SIZE;
+  writer->buffer = malloc(writer->size);
+  writer->buffer[0] = '\0';
+  writer->length = 0;
+  writer->stream = stream;
+  writer->method = method;
+  writer->handle = handle;
+  writer->cb.start = 1;
   if (var_p->type == V_MAP) {
-    cb.start = 1;
-    strcpy(cb.buffer, "{");
-    hashmap_foreach(var_p, map_to_str_cb, &cb);
-    strcat(cb.buffer, "}");
+    json_write_map(writer, var_p);
   } else if (var_p->type == V_ARRAY) {
-    array_to_str(&cb, var_p);
+    json_write_array(writer, var_p);
   }
-  return cb.buffer;
+}
+
+//
+// Return the contents of the structure as a string
+//
+char *map_to_str(const var_p_t var_p) {
+  JsonWriter writer;
+  json_write(&writer, var_p, 0, 0, 0);
+  return writer.buffer;
 }
 
 //
@@ -436,9 +534,12 @@ char *map_to_str(const var_p_t var_p) {
 //
 void map_write(const var_p_t var_p, int method, intptr_t handle) {
   if (var_p->type == V_MAP || var_p->type == V_ARRAY) {
-    char *buffer = map_to_str(var_p);
-    pv_write(buffer, method, handle);
-    free(buffer);
+    JsonWriter writer;
+    json_write(&writer, var_p, 1, method, handle);
+    if (writer.length) {
+      pv_write(writer.buffer, method, handle);
+    }
+    free(writer.buffer);
   }
 }
 
@@ -516,10 +617,103 @@ void map_build_array(var_p_t dest, ArrayNode *node_next, int rows, int cols) {
 }
 
 //
-// Creates an array variable
+// Returns the next character without consuming it, reading the
+// next chunk from the file once the text is consumed
+//
+int json_peek(JsonReader *reader) {
+  if (reader->pos == reader->length) {
+    if (reader->handle == -1 || reader->unread == 0) {
+      return JSON_END;
+    }
+    uint32_t len = reader->unread < JSON_READ_SIZE ? reader->unread : JSON_READ_SIZE;
+    dev_fread(reader->handle, (byte *)reader->chunk, len);
+    if (prog_error) {
+      return JSON_END;
+    }
+    reader->offset += reader->length;
+    reader->unread -= len;
+    reader->text = reader->chunk;
+    reader->length = len;
+    reader->pos = 0;
+  }
+  char ch = reader->text[reader->pos];
+  return ch == '\0' ? JSON_END : (unsigned char)ch;
+}
+
+static inline int json_position(JsonReader *reader) {
+  return reader->offset + reader->pos;
+}
+
+//
+// Skips white space and any of the given separators
+//
+int json_skip(JsonReader *reader, const char *seps) {
+  int ch = json_peek(reader);
+  while (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' ||
+         (ch != JSON_END && strchr(seps, ch) != NULL)) {
+    reader->pos++;
+    ch = json_peek(reader);
+  }
+  return ch;
+}
+
+static inline void json_token_add(JsonReader *reader, char ch) {
+  if (reader->token_len + 1 == reader->token_size) {
+    reader->token_size *= 2;
+    reader->token = realloc(reader->token, reader->token_size);
+  }
+  // keep terminated for atof()
+  reader->token[reader->token_len++] = ch;
+  reader->token[reader->token_len] = '\0';
+}
+
+//
+// Reads the text between quotes into the token. escaped characters are
+// kept as written
+//
+void json_read_string(JsonReader *reader) {
+  reader->token_len = 0;
+  reader->token[0] = '\0';
+  reader->pos++;
+  for (int ch = json_peek(reader); !prog_error; ch = json_peek(reader)) {
+    if (ch == JSON_END) {
+      err_array();
+      break;
+    }
+    reader->pos++;
+    if (ch == '"') {
+      break;
+    }
+    json_token_add(reader, ch);
+    if (ch == '\\' && json_peek(reader) != JSON_END) {
+      json_token_add(reader, reader->text[reader->pos++]);
+    }
+  }
+}
+
+//
+// Reads an unquoted value into the token
+//
+void json_read_primitive(JsonReader *reader) {
+  reader->token_len = 0;
+  reader->token[0] = '\0';
+  for (int ch = json_peek(reader); ch != JSON_END && !prog_error; ch = json_peek(reader)) {
+    if (ch == ':' || ch == '\t' || ch == '\r' || ch == '\n' ||
+        ch == ' ' || ch == ',' || ch == ']' || ch == '}') {
+      break;
+    } else if (ch < 32 || ch >= 127) {
+      err_array();
+    } else {
+      json_token_add(reader, ch);
+      reader->pos++;
+    }
+  }
+}
+
+//
+// Creates an array variable, a primitive containing ';' starts a new row
 //
-int map_create_array(var_p_t dest, JsonTokens *json, int end_position, int index) {
-  int i = index;
+void json_read_array(JsonReader *reader, var_p_t dest) {
   int rows = 0;
   int cols = 0;
   int curcol = 0;
@@ -528,16 +722,24 @@ int map_create_array(var_p_t dest, JsonTokens *json, int end_position, int index
   list.head = NULL;
   list.tail = NULL;
 
-  while (i < json->num_tokens && !prog_error) {
-    jsmntok_t token = json->tokens[i];
-    if (token.start > end_position) {
+  reader->pos++;
+  while (!prog_error) {
+    int ch = json_skip(reader, ",");
+    if (ch == ']') {
+      reader->pos++;
+      break;
+    } else if (ch == JSON_END || ch == '}' || ch == ':') {
+      err_array();
       break;
     }
     var_t *elem = map_array_list_add(&list, rows, curcol++);
-    int len = token.end - token.start;
-    const char *str = json->js + token.start;
-    const char *delim = memchr(str, ';', len);
-    if (token.type == JSMN_PRIMITIVE && (delim != NULL || json->tokens[0].type == JSMN_ARRAY)) {
+    if (ch == '{' || ch == '[' || ch == '"') {
+      json_read_value(reader, elem);
+    } else {
+      json_read_primitive(reader);
+      const char *str = reader->token;
+      int len = reader->token_len;
+      const char *delim = memchr(str, ';', len);
       if (delim != NULL) {
         if ((delim - str) > 0) {
           map_set_primative(elem, str, delim - str);
@@ -563,101 +765,132 @@ int map_create_array(var_p_t dest, JsonTokens *json, int end_position, int index
           }
         }
       } else {
-        map_set_primative(elem, json->js + token.start, token.end - token.start);
+        map_set_primative(elem, str, len);
       }
-      i++;
-    } else {
-      i = map_read_next_token(elem, json, i);
     }
     if (curcol > cols) {
       cols = curcol;
     }
   }
   map_build_array(dest, list.head, rows + 1, cols);
-  return i;
 }
 
 //
 // Creates a map variable
 //
-int map_create(var_p_t dest, JsonTokens *json, int end_position, int index) {
+void json_read_map(JsonReader *reader, var_p_t dest) {
   hashmap_create(dest, 0);
-  int i = index;
-  while (i < json->num_tokens && !prog_error) {
-    jsmntok_t token = json->tokens[i];
-    if (token.start > end_position) {
+  reader->pos++;
+  while (!prog_error) {
+    int position = json_position(reader);
+    int ch = json_skip(reader, ",");
+    if (ch == '}') {
+      reader->pos++;
+      break;
+    } else if (ch == JSON_END || ch == ']') {
+      err_array();
       break;
-    } else if (token.type == JSMN_STRING || token.type == JSMN_PRIMITIVE) {
+    } else if (ch == '{' || ch == '[' || ch == ':') {
+      // error near end of previous token
+      err_json(position);
+      break;
+    }
+    if (ch == '"') {
+      json_read_string(reader);
+    } else {
+      json_read_primitive(reader);
+    }
+    if (!prog_error) {
       var_p_t key = v_new();
-      map_set_primative(key, json->js + token.start, token.end - token.start);
+      map_set_primative(key, reader->token, reader->token_len);
       var_p_t value = hashmap_putv(dest, key);
-      i = map_read_next_token(value, json, i + 1);
-    } else {
-      int position = token.start;
-      if (i > 0) {
-        // error near end of previous token
-        position = json->tokens[i - 1].start;
+      ch = json_skip(reader, ",:");
+      if (ch == '}' || ch == ']' || ch == JSON_END) {
+        err_json(position);
+      } else {
+        json_read_value(reader, value);
       }
-      err_json(position);
-      break;
     }
   }
-  return i;
 }
 
 //
-// Process the next token
+// Process the next value
 //
-int map_read_next_token(var_p_t dest, JsonTokens *json, int index) {
-  int next;
-  jsmntok_t token = json->tokens[index];
-  switch (token.type) {
-  case JSMN_OBJECT:
-    next = map_create(dest, json, token.end, index + 1);
+void json_read_value(JsonReader *reader, var_p_t dest) {
+  switch (json_skip(reader, ",:")) {
+  case '{':
+    json_read_map(reader, dest);
     break;
-  case JSMN_ARRAY:
-    next = map_create_array(dest, json, token.end, index + 1);
+  case '[':
+    json_read_array(reader, dest);
     break;
-  case JSMN_PRIMITIVE:
-    map_set_primative(dest, json->js + token.start, token.end - token.start);
-    next = index + 1;
+  case '"':
+    json_read_string(reader);
+    if (!prog_error) {
+      v_setstrn(dest, reader->token, reader->token_len);
+    }
     break;
-  case JSMN_STRING:
-    v_setstrn(dest, json->js + token.start, token.end - token.start);
-    next = index + 1;
+  case ']':
+  case '}':
+  case JSON_END:
+    err_array();
     break;
   default:
-    next = -1;
+    json_read_primitive(reader);
+    if (!prog_error) {
+      map_set_primative(dest, reader->token, reader->token_len);
+    }
     break;
   }
-  return next;
 }
 
-void map_parse_str(const char *js, size_t len, var_p_t dest) {
-  int num_tokens = TOKEN_GROW_SIZE;
-  jsmntok_t *tokens = malloc(sizeof(jsmntok_t) * num_tokens);
-  int result;
-  jsmn_parser parser;
-
-  jsmn_init(&parser);
-  for (result = jsmn_parse(&parser, js, len, tokens, num_tokens);
-       result == JSMN_ERROR_NOMEM;
-       result = jsmn_parse(&parser, js, len, tokens, num_tokens)) {
-    num_tokens += TOKEN_GROW_SIZE;
-    tokens = realloc(tokens, sizeof(jsmntok_t) * num_tokens);
-  }
-  if (result < 0) {
-    err_array();
-  } else if (result > 0) {
+//
+// Reads the first value from the text or file into dest
+//
+void json_read(JsonReader *reader, var_p_t dest) {
+  reader->token_size = JSON_TOKEN_SIZE;
+  reader->token = malloc(reader->token_size);
+  reader->token_len = 0;
+  reader->offset = 0;
+  reader->pos = 0;
+  int ch = json_skip(reader, ",:");
+  if (ch != JSON_END) {
     v_init(dest);
-
-    JsonTokens json;
-    json.tokens = tokens;
-    json.js = js;
-    json.num_tokens = parser.toknext;
-    map_read_next_token(dest, &json, 0);
+    json_read_value(reader, dest);
+    if ((ch == '{' || ch == '[') && !prog_error && json_skip(reader, "") != JSON_END) {
+      // text follows the object or array. other text, such as "x:1", is
+      // read leniently as the leading primitive
+      err_json(json_position(reader));
+    }
   }
-  free(tokens);
+  free(reader->token);
+}
+
+void map_parse_str(const char *js, size_t len, var_p_t dest) {
+  JsonReader reader;
+  reader.text = js;
+  reader.length = len;
+  reader.handle = -1;
+  reader.unread = 0;
+  reader.chunk = NULL;
+  json_read(&reader, dest);
+}
+
+//
+// Reads JSON from the open file into dest
+//
+void map_read_json(var_p_t dest, int handle, uint32_t length) {
+  JsonReader reader;
+  reader.text = NULL;
+  reader.length = 0;
+  reader.handle = handle;
+  reader.unread = length;
+  reader.chunk = malloc(JSON_READ_SIZE);
+  v_free(dest);
+  v_init(dest);
+  json_read(&reader, dest);
+  free(reader.chunk);
 }
 
 //
@@ -108,6 +108,53 @@ int sblib_func_getname(int index, char *func_name);
  */
 int sblib_func_exec(int index, int param_count, slib_par_t *params, var_t *retval);
 
+/**
+ * @ingroup modlib
+ *
+ * returns the fast-call signature of the function 'index', or NULL when
+ * the function is called with sblib_func_exec(). The signature is the
+ * result type followed by the type of each parameter, 'i' for a 64bit
+ * integer (slib_arg_t.i) and 'n' for a double (slib_arg_t.n). For example
+ * "nnn" is a function of two doubles returning a double.
+ *
+ * functions with a signature are always called with sblib_func_fastcall()
+ * or sblib_func_batch(), the arguments are converted to the given types
+ * and the number of arguments must match.
+ *
+ * @param index the function's index
+ * @return the signature
+ */
+const char *sblib_func_signature(int index);
+
+/**
+ * @ingroup modlib
+ *
+ * executes a function that has a fast-call signature
+ *
+ * @param index the function's index
+ * @param param_count the number of the parameters
+ * @param params the parameter values
+ * @param retval receives the result
+ * @return non-zero on success
+ */
+int sblib_func_fastcall(int index, int param_count, const slib_arg_t *params, slib_arg_t *retval);
+
+/**
+ * @ingroup modlib
+ *
+ * optional, executes a fast-call function having one parameter for each
+ * element of an array. Called when the function is given an array, the
+ * results are returned in an array of the same shape. Without this,
+ * sblib_func_fastcall() is called for each element.
+ *
+ * @param index the function's index
+ * @param count the number of elements
+ * @param params the parameter value for each element
+ * @param retval receives the result for each element
+ * @return non-zero on success
+ */
+int sblib_func_batch(int index, uint32_t count, const slib_arg_t *params, slib_arg_t *retval);
+
 /**
  * @ingroup modlib
  *
@@ -236,6 +236,19 @@ void osd_setpixel(int x, int y);
  */
 long osd_getpixel(int x, int y);
 
+/**
+ * @ingroup lgraf
+ *
+ * Reads a row of pixels, each as returned by osd_getpixel().
+ *
+ * @param x the first x position
+ * @param y the y position
+ * @param width the number of pixels
+ * @param colors receives the colors
+ * @return non-zero on success, zero when the driver uses osd_getpixel() only
+ */
+int osd_getrow(int x, int y, int width, long *colors);
+
 /**
  * @ingroup lgraf
  *
@@ -42,6 +42,21 @@ typedef long long int var_int_t;
 #define V_FUNC      7 /**< variable type, object method                @ingroup var */
 #define V_NIL       8 /**< variable type, null value                   @ingroup var */
 
+/*
+ * Array - element storage
+ */
+#define V_PACK_NONE  0 /**< array storage, var_t elements                  @ingroup var */
+#define V_PACK_INT   1 /**< array storage, contiguous var_int_t elements   @ingroup var */
+#define V_PACK_NUM   2 /**< array storage, contiguous var_num_t elements   @ingroup var */
+#define V_PACK_MASK  3 /**< array storage, mask of the element type        @ingroup var */
+#define V_PACK_TYPED 4 /**< array storage flag, numbers are converted (DIM AS) @ingroup var */
+
+/*
+ * V_PACK_TYPED is a storage hint rather than a type constraint. storing a
+ * value which is not a number into a typed array converts it to var_t
+ * elements (see v_unpack), after which values are no longer converted
+ */
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -56,6 +71,12 @@ typedef struct {
   uint8_t byref;
 } slib_par_t;
 
+// a fast-call parameter or result, see sblib_func_fastcall()
+typedef union {
+  var_int_t i;
+  var_num_t n;
+} slib_arg_t;
+
 // signature for module callback/virtual functions
 typedef int (*callback) (struct var_s *self, int param_count, slib_par_t *params, struct var_s *retval);
 
@@ -104,7 +125,10 @@ typedef struct var_s {
     struct {
       char *ptr;
       uint32_t length;
+      // 0 when borrowed, 1 when allocated, 2 when allocated with spare capacity
       uint8_t owner;
+      // the allocated size when owner is 2
+      uint32_t capacity;
     } p;
 
     // array
@@ -134,6 +158,12 @@ typedef struct var_s {
 
   // whether held in pooled memory
   uint8_t pooled;
+
+  // whether held inside the data of an array or map
+  uint8_t contained;
+
+  // element storage when an array, see V_PACK_INT
+  uint8_t packed;
 } var_t;
 
 typedef var_t *var_p_t;
@@ -240,6 +270,52 @@ void v_set(var_t *dest, const var_t *src);
  */
 void v_move(var_t *dest, const var_t *src);
 
+/**
+ * @ingroup var
+ *
+ * array and map data is shared between variables by v_set() and only
+ * copied when one of the holders is about to modify it. gives the
+ * variable a private copy of its data when that data is shared.
+ *
+ * @param var the variable
+ */
+void v_unshare(var_t *var);
+
+/**
+ * @ingroup var
+ *
+ * creates a one dimensional array of zeros held as contiguous numbers rather
+ * than var_t elements. the elements are read with v_elem_read() and written
+ * with v_elem_move()
+ *
+ * @param var the variable
+ * @param size the number of elements
+ * @param packed V_PACK_INT or V_PACK_NUM, optionally with V_PACK_TYPED
+ */
+void v_new_packed(var_t *var, uint32_t size, uint8_t packed);
+
+/**
+ * @ingroup var
+ *
+ * converts a packed array into var_t elements. required before using
+ * v_elem() on an array which may be packed
+ *
+ * @param var the variable
+ */
+void v_unpack(var_t *var);
+
+/**
+ * @ingroup var
+ *
+ * assigning: array[index] = value, taking ownership of value. a packed
+ * array is unpacked when the value does not match the element type
+ *
+ * @param array the array
+ * @param index zero-based element index
+ * @param value the new value
+ */
+void v_elem_move(var_t *array, uint32_t index, var_t *value);
+
 /**
  * @ingroup var
  *
@@ -381,6 +457,18 @@ void v_setstrn(var_t *var, const char *string, int len);
  */
 void v_strcat(var_t *var, const char *string);
 
+/**
+ * @ingroup var
+ *
+ * concate len characters of string to variable 'var'. the buffer grows
+ * geometrically so that repeated appends are amortized O(1)
+ *
+ * @param var is the variable
+ * @param string is the string
+ * @param len is the number of characters to append
+ */
+void v_strcatn(var_t *var, const char *string, int len);
+
 /**
  * @ingroup var
  *
@@ -426,10 +514,36 @@ void v_input2var(const char *str, var_t *var);
 /**
  *< returns the var_t pointer of the element i
  * on the array x. i is a zero-based, one dim, index.
+ * the array must not be packed, see v_unpack()
  * @ingroup var
 */
 #define v_elem(var, i) &((var)->v.a.data[i])
 
+/**
+ * < the element storage of the array (x), V_PACK_NONE for var_t elements
+ * @ingroup var
+ */
+#define v_packed(x) ((x)->packed & V_PACK_MASK)
+
+/**
+ * < the elements of the packed V_PACK_INT array (x)
+ * @ingroup var
+ */
+#define v_ints(x) ((var_int_t *)(x)->v.a.data)
+
+/**
+ * < the elements of the packed V_PACK_NUM array (x)
+ * @ingroup var
+ */
+#define v_nums(x) ((var_num_t *)(x)->v.a.data)
+
+/**
+ * < the size in bytes of each element of the array (x)
+ * @ingroup var
+ */
+#define v_elem_size(x) (v_packed(x) == V_PACK_INT ? sizeof(var_int_t) : \
+                        v_packed(x) == V_PACK_NUM ? sizeof(var_num_t) : sizeof(var_t))
+
 /**
  * < the number of the elements of the array (x)
  * @ingroup var
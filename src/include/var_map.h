@@ -27,17 +27,20 @@ int map_get_int(var_p_t base, const char *name, int def);
 const char *map_get_str(var_p_t base, const char *name);
 var_p_t map_get(var_p_t base, const char *name);
 var_p_t map_elem_key(const var_p_t var_p, int index);
-var_p_t map_resolve_fields(var_p_t base, var_p_t *parent);
+var_p_t map_resolve_fields(var_p_t base, var_p_t *parent, int for_write);
 var_p_t map_add_var(var_p_t base, const char *name, int value);
 void map_init(var_p_t map);
 void map_free(var_p_t var_p);
-void map_get_value(var_p_t base, var_p_t key, var_p_t *result);
+void map_get_value(var_p_t base, var_p_t key, var_p_t *result, int for_write);
 void map_set(var_p_t dest, const var_p_t src);
+void map_share(var_p_t dest, const var_p_t src);
+int map_unshare(var_p_t var_p);
 void map_set_int(var_p_t base, const char *name, var_int_t n);
 void map_set_lib_id(var_p_t var_p, int lib_id);
 char *map_to_str(const var_p_t var_p);
 void map_write(const var_p_t var_p, int method, intptr_t handle);
 void map_parse_str(const char *js, size_t len, var_p_t dest);
+void map_read_json(var_p_t dest, int handle, uint32_t length);
 void map_from_str(var_p_t var_p);
 void map_from_codearray(var_p_t var_p);
 
@@ -476,6 +476,8 @@ struct proc_keyword_s proc_table[] = {
 #define LCN_ANTIALIAS           "ANTIALIAS"
 #define LCN_LOAD_MODULES        "LOAD MODULES"
 #define LCN_AUTOLOCAL           "AUTOLOCAL"
+#define LCN_PROFILE             "PROFILE"
+#define LCN_OPTIMISE            "OPTIMISE"
 #define LCN_AS_WRS              "AS "
 #define LCN_CONST               "CONST"
 
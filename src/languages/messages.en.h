@@ -57,6 +57,7 @@
 #define MSG_ARRAY_MIS_RP        "Array: Missing ')', (left side of expression)"
 #define MSG_ARRAY_MIS_LP        "Array: Missing '(', (left side of expression)"
 #define MSG_OPTION_ERR          "OPTION: Unrecognized option '%s'"
+#define MSG_DIM_TYPE_ERR        "DIM: Unrecognized type '%s', use INTEGER or REAL"
 #define MSG_IT_IS_KEYWORD       "%s: is keyword (left side of expression)"
 #define MSG_USE_DECL            "Use DECLARE with SUB or FUNC keyword"
 #define MSG_LET_MISSING_EQ      "LET/CONST/APPEND: Missing '='"
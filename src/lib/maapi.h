@@ -272,6 +272,17 @@ void maDestroyPlaceholder(MAHandle handle);
  */
 void maGetImageData(MAHandle image, void *dst, const MARect *srcRect, int scanlength);
 
+/**
+ * Copies a row of the image, each pixel as maGetImageData() returns for a 1x1 rectangle.
+ * Pixels outside the image are returned as 0.
+ * \param image The handle to the source image.
+ * \param dst The address of the destination array.
+ * \param x The first pixel of the row.
+ * \param y The row.
+ * \param width The number of pixels.
+ */
+void maGetPixelRow(MAHandle image, long *dst, int x, int y, int width);
+
 /**
  * Sets the current draw target.
  * The handle must be a drawable image or #HANDLE_SCREEN, which represents the back buffer.
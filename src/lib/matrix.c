@@ -26,101 +26,209 @@
 #include "common/sys.h"
 #include "common/blib_math.h"
 
-// creates a matrix of the given size
-var_num_t **mat_create(int row, int col) {
-  var_num_t **m = (var_num_t **)malloc(sizeof(var_num_t *) * row);
-  int i;
-  for (i = 0; i < row; i++) {
-    m[i] = (var_num_t *)malloc(sizeof(var_num_t) * col);
+// the product is calculated in blocks which fit the cpu caches
+#define MAT_BLOCK_ROWS  64
+#define MAT_BLOCK_INNER 128
+#define MAT_BLOCK_COLS  512
+
+#define MAT_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#if defined(__GNUC__) && !defined(__cplusplus)
+// a pair of elements with element alignment, maps onto SSE2 or NEON registers
+#define MAT_VECTOR
+typedef var_num_t mat_vec_t __attribute__((vector_size(2 * sizeof(var_num_t)), aligned(sizeof(var_num_t)), may_alias));
+#endif
+
+/*
+ * y[j] += alpha * x[j] for j in [from, to), the building block of each kernel
+ */
+static inline void mat_axpy(var_num_t *restrict y, const var_num_t *restrict x,
+                            var_num_t alpha, int from, int to) {
+  int j = from;
+#if defined(MAT_VECTOR)
+  const mat_vec_t valpha = {alpha, alpha};
+  for (; j + 4 <= to; j += 4) {
+    *(mat_vec_t *)&y[j] += valpha * *(const mat_vec_t *)&x[j];
+    *(mat_vec_t *)&y[j + 2] += valpha * *(const mat_vec_t *)&x[j + 2];
+  }
+#endif
+  for (; j < to; j++) {
+    y[j] += alpha * x[j];
   }
+}
 
-  return m;
+/*
+ * copies the block of b into strips of four columns, each strip holding the
+ * block rows one after another. columns beyond the matrix are zero
+ */
+static void mat_pack(var_num_t *panel, const var_num_t *b, int cols, int k0, int k1, int j0, int j1) {
+  int depth = k1 - k0;
+  for (int j = j0, s = 0; j < j1; j += 4, s++) {
+    var_num_t *strip = panel + (size_t)s * depth * 4;
+    for (int k = k0; k < k1; k++) {
+      const var_num_t *bk = b + (size_t)k * cols;
+      for (int t = 0; t < 4; t++) {
+        *strip++ = (j + t < j1) ? bk[j + t] : 0;
+      }
+    }
+  }
 }
 
-// free an allocated matrix
-void mat_free(var_num_t **m, int n) {
-  int i;
-  for (i = 0; i < n; i++) {
-    free(m[i]);
+/*
+ * adds the four column results of one row of c, skipping the padding columns
+ */
+static inline void mat_store(var_num_t *ci, var_num_t *sum, int width) {
+  for (int t = 0; t < width; t++) {
+    ci[t] += sum[t];
   }
-  free(m);
 }
 
-// fill the matrix with zero values
-void mat_fill(var_num_t **A, int row, int col) {
-  int i, j;
+/*
+ * c[i][j] += a[i][k] * b[k][j] for one block, using the packed block of b.
+ * four rows by four columns of c are held in registers while the inner
+ * dimension is walked
+ */
+static void mat_product_block(var_num_t *c, const var_num_t *a, const var_num_t *panel,
+                              int inner, int cols, int i0, int i1, int k0, int k1, int j0, int j1) {
+  int depth = k1 - k0;
+  for (int j = j0, s = 0; j < j1; j += 4, s++) {
+    const var_num_t *strip = panel + (size_t)s * depth * 4;
+    int width = MAT_MIN(4, j1 - j);
+    int i = i0;
+#if defined(MAT_VECTOR)
+    for (; i + 4 <= i1; i += 4) {
+      const var_num_t *a0 = a + (size_t)i * inner + k0;
+      const var_num_t *a1 = a0 + inner;
+      const var_num_t *a2 = a1 + inner;
+      const var_num_t *a3 = a2 + inner;
+      mat_vec_t c00 = {0, 0}, c01 = {0, 0};
+      mat_vec_t c10 = {0, 0}, c11 = {0, 0};
+      mat_vec_t c20 = {0, 0}, c21 = {0, 0};
+      mat_vec_t c30 = {0, 0}, c31 = {0, 0};
+      for (int k = 0; k < depth; k++) {
+        const mat_vec_t b0 = *(const mat_vec_t *)(strip + k * 4);
+        const mat_vec_t b1 = *(const mat_vec_t *)(strip + k * 4 + 2);
+        mat_vec_t av = {a0[k], a0[k]};
+        c00 += av * b0;
+        c01 += av * b1;
+        av = (mat_vec_t){a1[k], a1[k]};
+        c10 += av * b0;
+        c11 += av * b1;
+        av = (mat_vec_t){a2[k], a2[k]};
+        c20 += av * b0;
+        c21 += av * b1;
+        av = (mat_vec_t){a3[k], a3[k]};
+        c30 += av * b0;
+        c31 += av * b1;
+      }
+      var_num_t *ci = c + (size_t)i * cols + j;
+      var_num_t sum[4][4] = {
+        {c00[0], c00[1], c01[0], c01[1]},
+        {c10[0], c10[1], c11[0], c11[1]},
+        {c20[0], c20[1], c21[0], c21[1]},
+        {c30[0], c30[1], c31[0], c31[1]}
+      };
+      for (int r = 0; r < 4; r++) {
+        mat_store(ci + (size_t)r * cols, sum[r], width);
+      }
+    }
+#endif
+    for (; i < i1; i++) {
+      const var_num_t *ai = a + (size_t)i * inner + k0;
+      var_num_t sum[4] = {0, 0, 0, 0};
+      for (int k = 0; k < depth; k++) {
+        for (int t = 0; t < 4; t++) {
+          sum[t] += ai[k] * strip[k * 4 + t];
+        }
+      }
+      mat_store(c + (size_t)i * cols + j, sum, width);
+    }
+  }
+}
 
-  for (i = 0; i < row; i++) {
-    for (j = 0; j < col; j++) {
-      A[i][j] = 0.0;
+/*
+ * c = a x b, where a is rows x inner and b is inner x cols. all matrices are
+ * contiguous and row major. c must not overlap a or b
+ */
+void mat_product(var_num_t *c, const var_num_t *a, const var_num_t *b, int rows, int inner, int cols) {
+  int depth = MAT_MIN(MAT_BLOCK_INNER, inner);
+  int width = (MAT_MIN(MAT_BLOCK_COLS, cols) + 3) & ~3;
+  var_num_t *panel = (var_num_t *)malloc(sizeof(var_num_t) * depth * width);
+
+  memset(c, 0, sizeof(var_num_t) * rows * cols);
+  for (int j0 = 0; j0 < cols; j0 += MAT_BLOCK_COLS) {
+    int j1 = MAT_MIN(j0 + MAT_BLOCK_COLS, cols);
+    for (int k0 = 0; k0 < inner; k0 += MAT_BLOCK_INNER) {
+      int k1 = MAT_MIN(k0 + MAT_BLOCK_INNER, inner);
+      mat_pack(panel, b, cols, k0, k1, j0, j1);
+      for (int i0 = 0; i0 < rows; i0 += MAT_BLOCK_ROWS) {
+        int i1 = MAT_MIN(i0 + MAT_BLOCK_ROWS, rows);
+        mat_product_block(c, a, panel, inner, cols, i0, i1, k0, k1, j0, j1);
+      }
     }
   }
+  free(panel);
 }
 
 /*
  *-----------------------------------------------------------------------------
  *       funct:  mat_lu
  *       desct:  in-place LU decomposition with partial pivoting
- *       given:  !! A = square matrix (n x n) !ATTENTION! see commen
- *               P = permutation vector (n x 1)
- *       retrn:  number of permutation performed
+ *       given:  a = square matrix (n x n), contiguous and row major
+ *               pivot = row permutation vector (n)
+ *       retrn:  number of row exchanges performed
  *               -1 means suspected singular matrix
- *       comen:  A will be overwritten to be a LU-composite matrix
- *
- *       note:   the LU decomposed may NOT be equal to the LU of
- *               the orignal matrix a. But equal to the LU of the
- *               rows interchanged matrix.
+ *       comen:  a will be overwritten to be a LU-composite matrix of
+ *               the rows interchanged matrix. the rows are exchanged
+ *               in place, pivot[i] is the original row now at row i
  *-----------------------------------------------------------------------------
  */
-int mat_lu(var_num_t **A, var_num_t **P, int n) {
-  int i, j, k, maxi, tmp, p;
-  var_num_t c, c1;
+int mat_lu(var_num_t *a, int *pivot, int n) {
+  int p = 0;
 
-  for (p = 0, i = 0; i < n; i++) {
-    P[i][0] = i;
+  for (int i = 0; i < n; i++) {
+    pivot[i] = i;
   }
 
-  for (k = 0; k < n; k++) {
-    /*
-     * --- partial pivoting ---
-     */
-    for (i = k, maxi = k, c = 0.0; i < n; i++) {
-      c1 = fabsl(A[(int) P[i][0]][k]);
+  for (int k = 0; k < n; k++) {
+    // partial pivoting
+    int maxi = k;
+    var_num_t c = 0.0;
+    for (int i = k; i < n; i++) {
+      var_num_t c1 = fabs(a[(size_t)i * n + k]);
       if (c1 > c) {
         c = c1;
         maxi = i;
       }
     }
 
-    /*
-     * row exchange, update permutation vector
-     */
+    // row exchange, update permutation vector
     if (k != maxi) {
+      var_num_t *rk = a + (size_t)k * n;
+      var_num_t *rm = a + (size_t)maxi * n;
+      for (int j = 0; j < n; j++) {
+        var_num_t swp = rk[j];
+        rk[j] = rm[j];
+        rm[j] = swp;
+      }
+      int tmp = pivot[k];
+      pivot[k] = pivot[maxi];
+      pivot[maxi] = tmp;
       p++;
-      tmp = P[k][0];
-      P[k][0] = P[maxi][0];
-      P[maxi][0] = tmp;
     }
 
-    /*
-     * suspected singular matrix
-     */
-    if (A[(int) P[k][0]][k] == 0.0) {
+    // suspected singular matrix
+    const var_num_t *rk = a + (size_t)k * n;
+    if (rk[k] == 0.0) {
       return -1;
     }
 
-    for (i = k + 1; i < n; i++) {
-      /*
-       * --- calculate m(i,j) ---
-       */
-      A[(int) P[i][0]][k] = A[(int) P[i][0]][k] / A[(int) P[k][0]][k];
-
-      /*
-       * --- elimination ---
-       */
-      for (j = k + 1; j < n; j++) {
-        A[(int) P[i][0]][j] -= A[(int) P[i][0]][k] * A[(int) P[k][0]][j];
-      }
+    // calculate m(i,k) then eliminate along the contiguous row
+    for (int i = k + 1; i < n; i++) {
+      var_num_t *ri = a + (size_t)i * n;
+      var_num_t m = ri[k] / rk[k];
+      ri[k] = m;
+      mat_axpy(ri, rk, -m, k + 1, n);
     }
   }
 
@@ -129,82 +237,58 @@ int mat_lu(var_num_t **A, var_num_t **P, int n) {
 
 /*
  *-----------------------------------------------------------------------------
- *       funct:  mat_backsubs1
- *       desct:  back substitution
- *       given:  A = square matrix A (LU composite)
- *               !! B = column matrix B (attention!, see comen)
- *               !! X = place to put the result of X
- *               P = Permutation vector (after calling mat_lu)
- *               xcol = column of x to put the result
- *       retrn:  column matrix X (of AX = B)
- *       comen:  B will be overwritten
- *-----------------------------------------------------------------------------
- */
-var_num_t **mat_backsubs1(var_num_t **A, var_num_t **B, var_num_t **X, var_num_t **P, int xcol, int n) {
-  int i, j, k;
-  var_num_t sum;
-
-  for (k = 0; k < n; k++) {
-    for (i = k + 1; i < n; i++) {
-      B[(int) P[i][0]][0] -= A[(int) P[i][0]][k] * B[(int) P[k][0]][0];
-    }
-  }
-
-  X[n - 1][xcol] = B[(int) P[n - 1][0]][0] / A[(int) P[n - 1][0]][n - 1];
-  for (k = n - 2; k >= 0; k--) {
-    sum = 0.0;
-    for (j = k + 1; j < n; j++) {
-      sum += A[(int) P[k][0]][j] * X[j][xcol];
-    }
-    X[k][xcol] = (B[(int) P[k][0]][0] - sum) / A[(int) P[k][0]][k];
-  }
-
-  return X;
-}
-
-/*
- *-----------------------------------------------------------------------------
- *      funct:  mat_inv
+ *      funct:  mat_inverse
  *      desct:  find inverse of a matrix
  *      given:  a = square matrix a
- *      retrn:  square matrix Inverse(A)
- *              NULL = fails, singular matrix, or malloc() fails
+ *      retrn:  a is replaced with Inverse(A)
+ *              a is unchanged when the matrix is singular
+ *      comen:  solves LU X = P I one row at a time, so every inner loop
+ *              runs along contiguous rows of X
  *-----------------------------------------------------------------------------
  */
 void mat_inverse(var_num_t *a, const int n) {
-  var_num_t **A = mat_create(n, n);
-  var_num_t **B = mat_create(n, 1);
-  var_num_t **C = mat_create(n, n);
-  var_num_t **P = mat_create(n, 1);
+  size_t size = sizeof(var_num_t) * n * n;
+  var_num_t *lu = (var_num_t *)malloc(size);
+  var_num_t *x = (var_num_t *)calloc(1, size);
+  int *pivot = (int *)malloc(sizeof(int) * n);
 
-  int i, j;
+  memcpy(lu, a, size);
 
-  // copy input matrix to working buffer
-  for (i = 0; i < n; i++) {
-    for (j = 0; j < n; j++) {
-      A[i][j] = a[i * n + j];
+  // LU-decomposition, also check for singular matrix
+  if (mat_lu(lu, pivot, n) != -1) {
+    // x = P I
+    for (int i = 0; i < n; i++) {
+      x[(size_t)i * n + pivot[i]] = 1.0;
     }
-  }
 
-  // LU-decomposition, also check for singular matrix
-  if (mat_lu(A, P, n) != -1) {
-    for (i = 0; i < n; i++) {
-      mat_fill(B, n, 1);
-      B[i][0] = 1.0;
-      mat_backsubs1(A, B, C, P, i, n);
+    // forward substitution, L has a unit diagonal
+    for (int i = 1; i < n; i++) {
+      var_num_t *xi = x + (size_t)i * n;
+      const var_num_t *li = lu + (size_t)i * n;
+      for (int k = 0; k < i; k++) {
+        mat_axpy(xi, x + (size_t)k * n, -li[k], 0, n);
+      }
     }
 
-    // copy the result in C back to a
-    for (i = 0; i < n; i++) {
-      for (j = 0; j < n; j++) {
-        a[i * n + j] = C[i][j];
+    // back substitution
+    for (int i = n - 1; i >= 0; i--) {
+      var_num_t *xi = x + (size_t)i * n;
+      const var_num_t *ui = lu + (size_t)i * n;
+      for (int k = i + 1; k < n; k++) {
+        mat_axpy(xi, x + (size_t)k * n, -ui[k], 0, n);
+      }
+      const var_num_t d = 1.0 / ui[i];
+      for (int j = 0; j < n; j++) {
+        xi[j] *= d;
       }
     }
+
+    // copy the result back to a
+    memcpy(a, x, size);
   }
 
   // release memory
-  mat_free(P, n);
-  mat_free(C, n);
-  mat_free(B, n);
-  mat_free(A, n);
+  free(pivot);
+  free(x);
+  free(lu);
 }
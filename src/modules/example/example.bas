@@ -1,3 +1,6 @@
 import example as ex
 ex.libtest(1,2,3,4,5)
 print ex.libfunctest()
+print ex.hypot(3, 4)
+print ex.square(12)
+print ex.square([1, 2, 3])
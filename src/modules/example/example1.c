@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include "var.h"
 #include "module.h"
 
@@ -85,7 +86,7 @@ int sblib_proc_count(void) {
  * returns the number of the functions
  */
 int sblib_func_count(void) {
-  return 1;
+  return 3;
 }
 
 /**
@@ -109,10 +110,69 @@ int sblib_func_getname(int index, char *proc_name) {
   case 0:
     strcpy(proc_name, "LIBFUNCTEST");
     return 1; // success
+  case 1:
+    strcpy(proc_name, "HYPOT");
+    return 1; // success
+  case 2:
+    strcpy(proc_name, "SQUARE");
+    return 1; // success
   }
   return 0; // error
 }
 
+/**
+ * returns the fast-call signature of the 'index' function
+ *
+ * HYPOT takes two doubles and returns a double, SQUARE takes an integer
+ * and returns an integer. LIBFUNCTEST uses sblib_func_exec()
+ */
+const char *sblib_func_signature(int index) {
+  switch (index) {
+  case 1:
+    return "nnn";
+  case 2:
+    return "ii";
+  }
+  return NULL;
+}
+
+/**
+ * execute the 'index' fast-call function
+ */
+int sblib_func_fastcall(int index, int param_count, const slib_arg_t *params, slib_arg_t *retval) {
+  int success = 1;
+  switch (index) {
+  case 1:
+    retval->n = hypot(params[0].n, params[1].n);
+    break;
+  case 2:
+    retval->i = params[0].i * params[0].i;
+    break;
+  default:
+    success = 0;
+  }
+  return success;
+}
+
+/**
+ * execute the 'index' fast-call function for each element of an array,
+ * for example SQUARE([1, 2, 3])
+ */
+int sblib_func_batch(int index, uint32_t count, const slib_arg_t *params, slib_arg_t *retval) {
+  int success = 1;
+  switch (index) {
+  case 2:
+    for (uint32_t i = 0; i < count; i++) {
+      retval[i].i = params[i].i * params[i].i;
+    }
+    break;
+  default:
+    // HYPOT has two parameters so is not called with an array
+    success = 0;
+  }
+  return success;
+}
+
 /**
  * execute the 'index' procedure
  */
@@ -20,6 +20,7 @@ LOCAL_SRC_FILES  :=    \
     $(COMMON)/../lib/xpm.c       \
     $(COMMON)/../lib/str.c       \
     $(COMMON)/bc.c               \
+    $(COMMON)/bc_file.c          \
     $(COMMON)/blib.c             \
     $(COMMON)/blib_db.c          \
     $(COMMON)/blib_func.c        \
@@ -46,6 +47,7 @@ LOCAL_SRC_FILES  :=    \
     $(COMMON)/kw.c               \
     $(COMMON)/pfill.c            \
     $(COMMON)/plot.c             \
+    $(COMMON)/profile.c          \
     $(COMMON)/proc.c             \
     $(COMMON)/sberr.c            \
     $(COMMON)/scan.c             \
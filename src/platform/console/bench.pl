@@ -0,0 +1,124 @@
+#!/usr/bin/perl
+#
+# SmallBASIC benchmark runner, see "make bench"
+#
+# Runs each .bas program in the benchmark directory a number of times and
+# writes one tab separated line per program:
+#
+#   name runs median_ms p95_ms ops_per_sec peak_rss_kb [baseline_ms change_% status]
+#
+# each program prints "ops:<count>" and "rss:<FRE(-23)>" when it is done,
+# and takes an optional size from COMMAND, so that other scales can be timed
+# by hand, eg "sbasic maps.bas 1000000". programs in subdirectories, such as
+# window/ which needs the SDL or Android version, are not run.
+# with --baseline the median is compared with the saved results and the
+# exit status is 1 when any program is slower by more than --threshold
+# percent. --save writes the results for use as a baseline.
+#
+# This program is distributed under the terms of the GPL v2.0 or later
+# Download the GNU Public License (GPL) from www.gnu.org
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+use Time::HiRes qw(time);
+
+my $runs = 5;
+my $threshold = 10;
+my $baseline;
+my $save;
+my $filter = '';
+
+GetOptions('runs=i'      => \$runs,
+           'threshold=f' => \$threshold,
+           'baseline=s'  => \$baseline,
+           'save=s'      => \$save,
+           'filter=s'    => \$filter) && @ARGV == 2
+  or die "usage: bench.pl [--runs=n] [--threshold=pct] [--baseline=file] [--save=file] [--filter=re] sbasic dir\n";
+
+my ($sbasic, $dir) = @ARGV;
+
+sub percentile {
+  my ($p, @values) = @_;
+  my @sorted = sort { $a <=> $b } @values;
+  # nearest rank
+  my $rank = int($p / 100 * @sorted + 0.999999);
+  $rank = 1 if $rank < 1;
+  return $sorted[$rank - 1];
+}
+
+sub read_results {
+  my ($file) = @_;
+  my %results;
+  open(my $fh, '<', $file) or return %results;
+  while (<$fh>) {
+    next if /^#/;
+    my @fields = split /\t/;
+    $results{$fields[0]} = $fields[2] if @fields > 2;
+  }
+  close($fh);
+  return %results;
+}
+
+my %base = $baseline ? read_results($baseline) : ();
+my @header = qw(name runs median_ms p95_ms ops_per_sec peak_rss_kb);
+push(@header, qw(baseline_ms change_% status)) if %base;
+my @lines;
+my $failed = 0;
+
+opendir(my $dh, $dir) or die "cannot open $dir: $!\n";
+my @programs = sort grep { /\.bas$/ && /$filter/ } readdir($dh);
+closedir($dh);
+
+print '# ' . join("\t", @header) . "\n";
+foreach my $program (@programs) {
+  (my $name = $program) =~ s/\.bas$//;
+  my (@times, $ops, $rss);
+  for (my $i = 0; $i < $runs; $i++) {
+    my $start = time();
+    my $output = `"$sbasic" "$dir/$program" 2>&1`;
+    my $elapsed = (time() - $start) * 1000;
+    if ($? != 0 || $output !~ /^ops:\s*([\d.]+)/m) {
+      print STDERR "$name failed:\n$output";
+      $failed = 1;
+      @times = ();
+      last;
+    }
+    $ops = $1;
+    if ($output =~ /^rss:\s*(\d+)/m && (!defined($rss) || $1 > $rss)) {
+      $rss = $1;
+    }
+    push(@times, $elapsed);
+  }
+  next unless @times;
+
+  my $median = percentile(50, @times);
+  my @fields = ($name, $runs, sprintf("%.1f", $median),
+                sprintf("%.1f", percentile(95, @times)),
+                sprintf("%.0f", $median > 0 ? $ops * 1000 / $median : 0),
+                $rss // 0);
+  if (%base) {
+    if (defined($base{$name}) && $base{$name} > 0) {
+      my $change = ($median - $base{$name}) * 100 / $base{$name};
+      my $status = $change > $threshold ? 'REGRESSION' : 'ok';
+      $failed = 1 if $status ne 'ok';
+      push(@fields, $base{$name}, sprintf("%+.1f", $change), $status);
+    } else {
+      push(@fields, '-', '-', 'new');
+    }
+  }
+  push(@lines, [@fields[0..5]]);
+  print join("\t", @fields) . "\n";
+}
+
+if ($save) {
+  open(my $fh, '>', $save) or die "cannot write $save: $!\n";
+  print $fh '# ' . join("\t", @header[0..5]) . "\n";
+  foreach my $fields (@lines) {
+    print $fh join("\t", @$fields) . "\n";
+  }
+  close($fh);
+}
+
+exit($failed);
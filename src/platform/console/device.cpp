@@ -356,6 +356,13 @@ long osd_getpixel(int x, int y) {
   return result;
 }
 
+//
+// reading rows is not supported by the driver interface
+//
+int osd_getrow(int x, int y, int width, long *colors) {
+  return 0;
+}
+
 //
 // draw rectangle (parallelogram)
 //
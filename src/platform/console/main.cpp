@@ -33,6 +33,10 @@ static struct option OPTIONS[] = {
   {"decompile",      optional_argument, NULL, 's'},
   {"option",         optional_argument, NULL, 'o'},
   {"cmd",            optional_argument, NULL, 'c'},
+  {"dispatch",       required_argument, NULL, 'd'},
+  {"profile",        no_argument,       NULL, 'p'},
+  {"optimise",       optional_argument, NULL, 'O'},
+  {"cache",          optional_argument, NULL, 'C'},
   {"stdin",          optional_argument, NULL, '-'},
   {"help",           optional_argument, NULL, 'h'},
   {0, 0, 0, 0}
@@ -242,7 +246,7 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile, bool
   bool result = true;
   while (result) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "vkfxim:s:o:c:h::", OPTIONS, &option_index);
+    int c = getopt_long(argc, argv, "vkfxipm:s:o:c:d:O:C:h::", OPTIONS, &option_index);
     if (c == -1 && !option_index) {
       // no more options
       for (int i = 1; i < argc; i++) {
@@ -313,6 +317,29 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile, bool
     case 'i':
       *iterate = true;
       break;
+    case 'd':
+      // select the executor's opcode dispatch: 'switch' or 'threaded'
+      if (strcasecmp(optarg, "switch") == 0) {
+        opt_switch_dispatch = 1;
+      } else if (strcasecmp(optarg, "threaded") == 0) {
+        opt_switch_dispatch = 0;
+      } else {
+        fprintf(stderr, "unknown dispatch '%s', use 'switch' or 'threaded'\n", optarg);
+        result = false;
+      }
+      break;
+    case 'p':
+      // write file.prof and file.folded on exit
+      opt_profile = 1;
+      break;
+    case 'O':
+      // 0 to 2, see comp_optimise()
+      opt_optimise = optarg ? atoi(optarg) : 1;
+      break;
+    case 'C':
+      // compile cache directory, see bc_file.h
+      strlcpy(opt_cachepath, optarg ? optarg : "", sizeof(opt_cachepath));
+      break;
     default:
       show_help();
       result = false;
@@ -409,8 +436,15 @@ static void exit_handler(void) {
 //
 int main(int argc, char *argv[]) {
   opt_autolocal = 0;
+  opt_switch_dispatch = 0;
+  opt_profile = 0;
+  opt_optimise = 1;
   opt_command[0] = '\0';
   opt_modpath[0] = '\0';
+  opt_cachepath[0] = '\0';
+  if (getenv("SBASICCACHE")) {
+    strlcpy(opt_cachepath, getenv("SBASICCACHE"), sizeof(opt_cachepath));
+  }
   opt_file_permitted = 1;
   opt_ide = 0;
   opt_nosave = 1;
@@ -375,6 +375,10 @@ void maGetImageData(MAHandle maHandle, void *dst, const MARect *srcRect, int str
   appLog("maGetImageData not yet implemented");
 }
 
+void maGetPixelRow(MAHandle maHandle, long *dst, int x, int y, int width) {
+  memset(dst, 0, width * sizeof(long));
+}
+
 //
 // font
 //
@@ -49,6 +49,8 @@ void init() {
   opt_quiet = 1;
   opt_verbose = 0;
   opt_autolocal = 0;
+  opt_profile = 0;
+  opt_optimise = 1;
   os_graf_mx = 1024;
   os_graf_my = 768;
   os_graphics = 1;
@@ -845,6 +845,7 @@ bool initialise(int argc, char **argv) {
   opt_ide = IDE_INTERNAL;
   opt_interactive = true;
   opt_file_permitted = 1;
+  opt_optimise = 1;
   os_graphics = 1;
   opt_mute_audio = 0;
 
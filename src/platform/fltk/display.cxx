@@ -458,6 +458,29 @@ void maGetImageData(MAHandle maHandle, void *dst, const MARect *srcRect, int str
   canvas->getImageData((uint8_t *)dst, srcRect, stride);
 }
 
+void maGetPixelRow(MAHandle maHandle, long *dst, int x, int y, int width) {
+  if (width == 1) {
+    MARect rc = {x, y, 1, 1};
+    int data[1];
+    maGetImageData(maHandle, data, &rc, 1);
+    dst[0] = data[0];
+  } else if (width > 1) {
+    Canvas *canvas = (Canvas *)maHandle;
+    if (canvas == HANDLE_SCREEN) {
+      canvas = graphics->getScreen();
+    }
+    MARect rc = {x, y, width, 1};
+    uint8_t *image = new uint8_t[width * 4];
+    canvas->getImageData(image, &rc, width);
+    for (int i = 0; i < width; i++) {
+      // same as the single pixel value, without alpha
+      uint8_t *px = image + (i * 4);
+      dst[i] = (px[0] << 16) | (px[1] << 8) | px[2];
+    }
+    delete [] image;
+  }
+}
+
 MAHandle maSetDrawTarget(MAHandle maHandle) {
   return graphics->setDrawTarget(maHandle);
 }
@@ -808,19 +808,20 @@ void dumpVariables(socket_t socket) {
   for (int i = prog_stack_count - 1; !localScope && i > -1; i--) {
     stknode_t node = prog_stack[i];
     switch (node.type) {
-    case kwTYPE_CRVAR:
-      // local variable
-      net_printf(socket, "[%d] ", count++);
-      pv_writevar(tvar[node.x.vdvar.vid], PV_NET, socket);
-      net_print(socket, "\n");
-      break;
     case kwFUNC:
     case kwPROC:
       localScope = true;
       break;
     }
   }
-  if (!localScope) {
+  if (localScope) {
+    // parameters and local variables
+    for (uint32_t i = prog_frame_base; i < prog_frame_sp; i++) {
+      net_printf(socket, "[%d] ", count++);
+      pv_writevar(tvar[code_frame_slot(i)->vid], PV_NET, socket);
+      net_print(socket, "\n");
+    }
+  } else {
     for (unsigned i = SYSVAR_COUNT; i < prog_varcount; i++) {
       if (!v_isempty(tvar[i])) {
         net_printf(socket, "[%d] ", count++);
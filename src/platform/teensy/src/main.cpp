@@ -80,6 +80,8 @@ int sys_search_path(const char *path, const char *file, char *retbuf) {
 
 void setup() {
   opt_autolocal = 0;
+  opt_profile = 0;
+  opt_optimise = 1;
   opt_command[0] = '\0';
   opt_modpath[0] = '\0';
   opt_file_permitted = 0;
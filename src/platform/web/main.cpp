@@ -10,6 +10,7 @@
 
 #include <microhttpd.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -20,23 +21,118 @@
 #include "common/device.h"
 #include "platform/web/canvas.h"
 
-Canvas g_canvas;
-uint32_t g_start = 0;
+// state of the request being handled by the current worker thread
+thread_local Canvas g_canvas;
+thread_local uint32_t g_start = 0;
+thread_local MHD_Connection *g_connection;
+thread_local StringList g_cookies;
+thread_local String g_path;
+thread_local String g_data;
+
 uint32_t g_maxTime = 2000;
 bool g_graphicText = true;
 bool g_noExecute = false;
 bool g_json = false;
 char *execBas = nullptr;
-MHD_Connection *g_connection;
-StringList g_cookies;
-String g_path;
-String g_data;
+bool g_cache = true;
+uint32_t g_cacheHits = 0;
+uint32_t g_cacheMisses = 0;
+pthread_mutex_t g_cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+#define STATUS_URL "/_status"
+
+// the most programs held in the cache, the least recently used is discarded
+#define MAX_COMPILED 64
+
+// a file used by a compiled program
+struct CompiledDep {
+  CompiledDep(const char *path) :
+    _path(path),
+    _mtime(sys_filetime(path)) {
+  }
+
+  String _path;
+  time_t _mtime;
+};
+
+// compiled program, reused until the source or its units and include files change
+struct CompiledBas {
+  CompiledBas(const char *path) :
+    _path(path),
+    _mtime(0),
+    _used(0),
+    _bytecode(nullptr),
+    _size(0) {
+  }
+
+  virtual ~CompiledBas() {
+    free(_bytecode);
+  }
+
+  bool isCurrent() const {
+    bool result = _mtime == sys_filetime(_path);
+    List_each(CompiledDep *, it, _deps) {
+      if (!result) {
+        break;
+      }
+      result = (*it)->_mtime == sys_filetime((*it)->_path);
+    }
+    return result;
+  }
+
+  void update(time_t mtime, const byte *bytecode, const char **deps, int dep_count) {
+    _mtime = mtime;
+    _size = ((bc_head_t *)bytecode)->size;
+    _bytecode = (byte *)realloc(_bytecode, _size);
+    memcpy(_bytecode, bytecode, _size);
+    _deps.removeAll();
+    for (int i = 0; i < dep_count; i++) {
+      _deps.add(new CompiledDep(deps[i]));
+    }
+  }
+
+  String _path;
+  time_t _mtime;
+  uint32_t _used;
+  byte *_bytecode;
+  uint32_t _size;
+  List<CompiledDep *> _deps;
+};
+
+List<CompiledBas *> g_compiled;
+uint32_t g_compiledClock = 0;
+
+// command line settings, applied to the interpreter state of each worker thread
+struct Settings {
+  void save() {
+    strcpy(_command, opt_command);
+    strcpy(_modpath, opt_modpath);
+    _filePermitted = opt_file_permitted;
+    _verbose = opt_verbose;
+    _quiet = opt_quiet;
+    _width = os_graf_mx;
+    _height = os_graf_my;
+  }
+
+  void restore();
+
+  char _command[OPT_CMD_SZ];
+  char _modpath[OPT_MOD_SZ];
+  byte _filePermitted;
+  int _verbose;
+  byte _quiet;
+  int _width;
+  int _height;
+} g_settings;
 
 static struct option OPTIONS[] = {
   {"file-permitted", no_argument,       nullptr, 'f'},
   {"help",           no_argument,       nullptr, 'h'},
   {"json-content",   no_argument,       nullptr, 'j'},
   {"no-execute",     no_argument,       nullptr, 'x'},
+  {"no-cache",       no_argument,       nullptr, 'n'},
+  {"max-connections", optional_argument, nullptr, 'l'},
+  {"threads",        optional_argument, nullptr, 's'},
   {"verbose",        no_argument,       nullptr, 'v'},
   {"command",        optional_argument, nullptr, 'c'},
   {"exec-bas",       optional_argument, nullptr, 'i'},
@@ -62,10 +158,23 @@ void init() {
   opt_quiet = 1;
   opt_verbose = 0;
   opt_autolocal = 0;
+  opt_profile = 0;
+  opt_optimise = 1;
   os_graf_mx = 1024;
   os_graf_my = 768;
 }
 
+void Settings::restore() {
+  init();
+  strcpy(opt_command, _command);
+  strcpy(opt_modpath, _modpath);
+  opt_file_permitted = _filePermitted;
+  opt_verbose = _verbose;
+  opt_quiet = _quiet;
+  os_graf_mx = _width;
+  os_graf_my = _height;
+}
+
 void show_help() {
   fprintf(stdout,
           "SmallBASIC version %s - kw:%d, pc:%d, fc:%d, ae:%d I=%d N=%d\n\n",
@@ -99,13 +208,74 @@ void log(const char *format, ...) {
 
     char date[18];
     time_t t = time(nullptr);
-    struct tm *p = localtime(&t);
-    strftime(date, sizeof(date), "%Y%m%d %H:%M:%S", p);
+    struct tm tm;
+    strftime(date, sizeof(date), "%Y%m%d %H:%M:%S", localtime_r(&t, &tm));
     fprintf(stdout, "%s %s\n", date, buf);
     free(buf);
   }
 }
 
+CompiledBas *find_compiled(const char *file) {
+  CompiledBas *result = nullptr;
+  List_each(CompiledBas *, it, g_compiled) {
+    CompiledBas *next = (*it);
+    if (next->_path.equals(file, false)) {
+      result = next;
+      break;
+    }
+  }
+  return result;
+}
+
+// returns a copy of the cached bytecode when the source is unchanged
+byte *cache_get(const char *file) {
+  byte *result = nullptr;
+  pthread_mutex_lock(&g_cacheLock);
+  CompiledBas *compiled = find_compiled(file);
+  if (compiled != nullptr && compiled->isCurrent()) {
+    result = (byte *)malloc(compiled->_size);
+    memcpy(result, compiled->_bytecode, compiled->_size);
+    compiled->_used = ++g_compiledClock;
+    g_cacheHits++;
+  } else {
+    g_cacheMisses++;
+  }
+  pthread_mutex_unlock(&g_cacheLock);
+  return result;
+}
+
+// discard the least recently used program
+void cache_evict() {
+  CompiledBas **oldest = nullptr;
+  for (CompiledBas **it = g_compiled.begin(); it != g_compiled.end(); it++) {
+    if (oldest == nullptr || (*it)->_used < (*oldest)->_used) {
+      oldest = it;
+    }
+  }
+  if (oldest != nullptr) {
+    delete *oldest;
+    g_compiled.remove(oldest);
+  }
+}
+
+// remember the newly compiled bytecode
+void cache_put(const char *file, const byte *bytecode, const char **deps, int dep_count) {
+  pthread_mutex_lock(&g_cacheLock);
+  CompiledBas *compiled = find_compiled(file);
+  if (compiled == nullptr) {
+    if (g_compiled.size() >= MAX_COMPILED) {
+      cache_evict();
+    }
+    compiled = new CompiledBas(file);
+    g_compiled.add(compiled);
+  }
+  compiled->update(sys_filetime(file), bytecode, deps, dep_count);
+  compiled->_used = ++g_compiledClock;
+  pthread_mutex_unlock(&g_cacheLock);
+}
+
+sbasic_bc_cache_t g_bcCache = { cache_get, cache_put };
+
 // allow or deny access
 MHD_Result accept_cb(void *cls, const struct sockaddr *addr, socklen_t addrlen) {
   return MHD_YES;
@@ -119,24 +289,26 @@ MHD_Response *execute(MHD_Connection *connection, const char *bas) {
   const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT);
   const char *contentType = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE);
 
+  g_settings.restore();
   if (width != nullptr) {
     os_graf_mx = atoi(width);
   }
   if (height != nullptr) {
     os_graf_my = atoi(height);
   }
+  bool isGraphicText = g_graphicText;
   if (graphicText != nullptr) {
-    g_graphicText = atoi(graphicText) > 0;
+    isGraphicText = atoi(graphicText) > 0;
   }
   if (command != nullptr) {
-    strcpy(opt_command, command);
+    strlcpy(opt_command, command, sizeof(opt_command));
   }
 
   log("%s dim:%dX%d [accept=%s, content-type=%s]", bas, os_graf_mx, os_graf_my, accept, contentType);
   g_connection = connection;
   g_canvas.reset();
   g_start = dev_get_millisecond_count();
-  g_canvas.setGraphicText(g_graphicText);
+  g_canvas.setGraphicText(isGraphicText);
   g_canvas.setJSON(g_json || (accept && strncmp(accept, "application/json", 16) == 0));
   g_cookies.removeAll();
   sbasic_main(bas);
@@ -162,6 +334,22 @@ MHD_Response *serve_file(const char *path) {
   return response;
 }
 
+MHD_Response *get_status() {
+  uint32_t size = 0;
+  pthread_mutex_lock(&g_cacheLock);
+  List_each(CompiledBas *, it, g_compiled) {
+    size += (*it)->_size;
+  }
+  char buffer[128];
+  int len = snprintf(buffer, sizeof(buffer),
+                     "{\"cache\":%s,\"hits\":%u,\"misses\":%u,\"programs\":%d,\"bytes\":%u}",
+                     g_cache ? "true" : "false", g_cacheHits, g_cacheMisses, g_compiled.size(), size);
+  pthread_mutex_unlock(&g_cacheLock);
+  MHD_Response *response = MHD_create_response_from_buffer(len, (void *)buffer, MHD_RESPMEM_MUST_COPY);
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "application/json");
+  return response;
+}
+
 MHD_Response *get_response(MHD_Connection *connection, const char *path) {
   MHD_Response *response = nullptr;
   struct stat stbuf;
@@ -223,8 +411,11 @@ MHD_Result access_cb(void *cls,
   }
 
   MHD_Result result;
-  MHD_Response *response = get_response(connection, url + 1);
-  if (response != nullptr) {
+  MHD_Response *response;
+  if (strcmp(url, STATUS_URL) == 0) {
+    response = get_status();
+    result = MHD_queue_response(connection, MHD_HTTP_OK, response);
+  } else if ((response = get_response(connection, url + 1)) != nullptr) {
     int code = g_canvas.getPage().length() ? MHD_HTTP_OK : MHD_HTTP_NO_CONTENT;
     result = MHD_queue_response(connection, code, response);
   } else {
@@ -241,11 +432,13 @@ MHD_Result access_cb(void *cls,
 int main(int argc, char **argv) {
   init();
   int port = 8080;
+  int threads = 1;
+  int maxConnections = 0;
   char *runBas = nullptr;
 
   while (1) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "hvfxjp:t:m::r:w:e:c:g:i:", OPTIONS, &option_index);
+    int c = getopt_long(argc, argv, "hvfxjnp:t:m::r:w:e:c:g:i:l:s:", OPTIONS, &option_index);
     if (c == -1) {
       break;
     }
@@ -302,6 +495,15 @@ int main(int argc, char **argv) {
     case 'j':
       g_json = true;
       break;
+    case 'n':
+      g_cache = false;
+      break;
+    case 'l':
+      maxConnections = atoi(optarg);
+      break;
+    case 's':
+      threads = atoi(optarg);
+      break;
     default:
       show_help();
       exit(1);
@@ -309,16 +511,29 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (g_cache) {
+    sbasic_set_bc_cache(&g_bcCache);
+  }
+  g_settings.save();
+
   if (runBas != nullptr) {
     g_canvas.reset();
     g_start = dev_get_millisecond_count();
     sbasic_main(runBas);
     puts(g_canvas.getPage().c_str());
   } else {
-    fprintf(stdout, "Starting SmallBASIC web server on port:%d. Press return to exit.\n", port);
+    fprintf(stdout, "Starting SmallBASIC web server on port:%d threads:%d. Press return to exit.\n", port, threads);
+    // each worker thread runs its requests in its own interpreter. with
+    // --max-connections, further connections are refused until one closes
+    MHD_OptionItem options[] = {
+      {MHD_OPTION_THREAD_POOL_SIZE, threads > 1 ? threads : 0, nullptr},
+      {maxConnections > 0 ? MHD_OPTION_CONNECTION_LIMIT : MHD_OPTION_END, maxConnections, nullptr},
+      {MHD_OPTION_END, 0, nullptr}
+    };
     MHD_Daemon *d = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, port,
                                      &accept_cb, nullptr,
-                                     &access_cb, nullptr, MHD_OPTION_END);
+                                     &access_cb, nullptr,
+                                     MHD_OPTION_ARRAY, options, MHD_OPTION_END);
     if (d == nullptr) {
       fprintf(stderr, "startup failed\n");
       return 1;
@@ -480,6 +695,13 @@ const char *dev_getenv_n(int n) {
 }
 
 void dev_delay(uint32_t ms) {
+  // never sleep beyond the time allowed for the request
+  uint32_t elapsed = dev_get_millisecond_count() - g_start;
+  if (elapsed >= g_maxTime) {
+    ms = 0;
+  } else if (ms > g_maxTime - elapsed) {
+    ms = g_maxTime - elapsed;
+  }
   usleep(1000 * ms);
 }
 
@@ -493,6 +715,7 @@ int osd_getx() { return 0; }
 int osd_gety() { return 0; }
 int osd_textheight(const char *str) { return 1; }
 long osd_getpixel(int x, int y) { return 0;}
+int osd_getrow(int x, int y, int width, long *colors) { return 0; }
 void osd_beep() {}
 void osd_clear_sound_queue() {}
 void osd_refresh() {}
@@ -55,6 +55,7 @@ struct AnsiWidget {
   int  getFontSize() const { return _fontSize; }
   FormInput *getNextField(FormInput *field) { return _back->getNextField(field); }
   int  getPixel(int x, int y) { return _back->getPixel(x, y); }
+  bool getPixelRow(int x, int y, int width, long *colors) { return _back->getPixelRow(x, y, width, colors); }
   int  getScreenId(bool back);
   int  getScreenWidth()  { return _back->_width; }
   void getScroll(int &x, int &y) { _back->getScroll(x, y); }
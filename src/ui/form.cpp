@@ -272,7 +272,8 @@ extern "C" void v_create_form(var_p_t var) {
       var_p_t inputs = map_get(arg, FORM_INPUTS);
       if (inputs != nullptr && inputs->type == V_ARRAY) {
         for (unsigned i = 0; i < v_asize(inputs); i++) {
-          var_p_t elem = v_elem(inputs, i);
+          var_t tmp;
+          var_p_t elem = v_elem_read(inputs, i, &tmp);
           if (elem->type == V_MAP) {
             hasInputs = true;
           }
@@ -288,7 +289,8 @@ extern "C" void v_create_form(var_p_t var) {
     unsigned i_focus = v_focus != nullptr ? v_getint(v_focus) : -1;
     var_p_t inputs = map_get(var, FORM_INPUTS);
     for (unsigned i = 0; inputs != nullptr && i < v_asize(inputs); i++) {
-      var_p_t elem = v_elem(inputs, i);
+      var_t tmp;
+      var_p_t elem = v_elem_read(inputs, i, &tmp);
       if (elem->type == V_MAP) {
         FormInput *widget = create_input(elem);
         if (widget != nullptr) {
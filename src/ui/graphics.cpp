@@ -11,6 +11,9 @@
 #include "ui/graphics.h"
 #include "ui/utils.h"
 #include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "common/smbas.h"
 #include "common/device.h"
@@ -33,47 +36,149 @@ inline double fpart(double x) {
 #define _SWAP(a, b) \
   { __typeof__(a) tmp; tmp = a; (a) = b; (b) = tmp; }
 
+// returns the codepoint starting at str[i] and advances i. bytes that do
+// not begin a valid UTF-8 sequence are taken as Latin-1, as before
+static inline uint32_t next_codepoint(const char *str, int len, int &i) {
+  uint8_t ch = str[i++];
+  if (ch >= 0xc2 && ch <= 0xf4) {
+    int extra = ch >= 0xf0 ? 3 : ch >= 0xe0 ? 2 : 1;
+    if (i + extra <= len) {
+      uint32_t codepoint = ch & (0x3f >> extra);
+      int j = 0;
+      while (j < extra && (str[i + j] & 0xc0) == 0x80) {
+        codepoint = (codepoint << 6) | (str[i + j] & 0x3f);
+        j++;
+      }
+      static const uint32_t minimum[] = {0, 0x80, 0x800, 0x10000};
+      if (j == extra && codepoint >= minimum[extra] && codepoint <= 0x10ffff &&
+          (codepoint < 0xd800 || codepoint > 0xdfff)) {
+        i += extra;
+        return codepoint;
+      }
+    }
+  }
+  return ch;
+}
+
 Font::Font(FT_Face face, int size, bool italic) :
-  _face(face) {
+  _size(size),
+  _refs(0),
+  _italic(italic),
+  _face(face),
+  _next(nullptr),
+  _atlas(nullptr),
+  _atlasCount(0),
+  _atlasSize(ATLAS_MIN_SIZE),
+  _shelfX(0),
+  _shelfY(0),
+  _shelfH(0) {
   FT_Set_Pixel_Sizes(face, 0, size);
   _spacing = 1 + (FT_MulFix(_face->height, _face->size->metrics.x_scale) / 64);
   _h = (FT_MulFix(_face->ascender, _face->size->metrics.x_scale) / 64) +
        (FT_MulFix(_face->descender, _face->size->metrics.x_scale) / 64);
-  FT_Matrix  matrix;
-  if (italic) {
+  while (_atlasSize < size * 2) {
+    _atlasSize *= 2;
+  }
+}
+
+Font::~Font() {
+  for (auto & page : _pages) {
+    free(page);
+  }
+  for (int i = 0; i < _atlasCount; i++) {
+    free(_atlas[i]);
+  }
+  free(_atlas);
+}
+
+void Font::getBitmap(const Glyph *glyph, FT_Bitmap *bitmap) const {
+  bitmap->width = glyph->_width;
+  bitmap->rows = glyph->_rows;
+  bitmap->pitch = _atlasSize;
+  bitmap->buffer = _atlas[glyph->_atlas] + (glyph->_y * _atlasSize) + glyph->_x;
+}
+
+Glyph *Font::loadGlyph(uint32_t codepoint) {
+  Glyph *&page = _pages[codepoint / GLYPH_PAGE_SIZE];
+  if (page == nullptr) {
+    page = (Glyph *)calloc(GLYPH_PAGE_SIZE, sizeof(Glyph));
+  }
+  Glyph *glyph = &page[codepoint % GLYPH_PAGE_SIZE];
+  glyph->_loaded = true;
+
+  // the face is shared by fonts of other sizes
+  if (_face->size->metrics.x_ppem != _size) {
+    FT_Set_Pixel_Sizes(_face, 0, _size);
+  }
+
+  FT_Glyph slot;
+  FT_Error error = FT_Load_Glyph(_face, FT_Get_Char_Index(_face, codepoint), FT_LOAD_TARGET_LIGHT);
+  if (error) {
+    trace("Failed to load %d", codepoint);
+  }
+  error = FT_Get_Glyph(_face->glyph, &slot);
+  if (error) {
+    trace("Failed to get glyph %d", codepoint);
+    return glyph;
+  }
+  if (_italic) {
+    FT_Matrix matrix;
     matrix.xx = 0x10000L;
     matrix.xy = 0.12 * 0x10000L;
     matrix.yx = 0;
     matrix.yy = 0x10000L;
+    FT_Glyph_Transform(slot, &matrix, nullptr);
+  }
+  FT_Vector origin;
+  origin.x = 0;
+  origin.y = 0;
+  error = FT_Glyph_To_Bitmap(&slot, FT_RENDER_MODE_LIGHT, &origin, 1);
+  if (error) {
+    trace("Failed to get bitmap %d", codepoint);
+  } else {
+    auto bitmapGlyph = (FT_BitmapGlyph)slot;
+    glyph->_left = bitmapGlyph->left;
+    glyph->_top = bitmapGlyph->top;
+    pack(glyph, &bitmapGlyph->bitmap);
   }
+  glyph->_w = (int)(_face->glyph->metrics.horiAdvance / 64);
+  FT_Done_Glyph(slot);
+  return glyph;
+}
 
-  for (int i = 0; i < MAX_GLYPHS; i++) {
-    FT_UInt slot = FT_Get_Char_Index(face, i);
-    FT_Error error = FT_Load_Glyph(face, slot, FT_LOAD_TARGET_LIGHT);
-    if (error) {
-      trace("Failed to load %d", i);
-    }
-    error = FT_Get_Glyph(face->glyph, &_glyph[i]._slot);
-    if (error) {
-      trace("Failed to get glyph %d", i);
-    }
-    if (italic) {
-      FT_Glyph_Transform(_glyph[i]._slot, &matrix, nullptr );
-    }
-    FT_Vector origin;
-    origin.x = 0;
-    origin.y = 0;
-    error = FT_Glyph_To_Bitmap(&_glyph[i]._slot, FT_RENDER_MODE_LIGHT, &origin, 1);
-    if (error) {
-      trace("Failed to get bitmap %d", i);
-    }
-    _glyph[i]._w = (int)(face->glyph->metrics.horiAdvance / 64);
+// copies the bitmap to the end of the current shelf, starting a new
+// shelf or atlas page when there is no room
+void Font::pack(Glyph *glyph, const FT_Bitmap *bitmap) {
+  int width = bitmap->width;
+  int rows = bitmap->rows;
+  if (width == 0 || rows == 0 || width > _atlasSize || rows > _atlasSize) {
+    return;
   }
-}
+  if (_shelfX + width > _atlasSize) {
+    _shelfX = 0;
+    _shelfY += _shelfH;
+    _shelfH = 0;
+  }
+  if (_atlasCount == 0 || _shelfY + rows > _atlasSize) {
+    _atlas = (uint8_t **)realloc(_atlas, sizeof(uint8_t *) * (_atlasCount + 1));
+    _atlas[_atlasCount++] = (uint8_t *)calloc(_atlasSize, _atlasSize);
+    _shelfX = 0;
+    _shelfY = 0;
+    _shelfH = 0;
+  }
+  glyph->_atlas = _atlasCount - 1;
+  glyph->_x = _shelfX;
+  glyph->_y = _shelfY;
+  glyph->_width = width;
+  glyph->_rows = rows;
 
-Font::~Font() {
-  for (auto & i : _glyph) {
-    FT_Done_Glyph(i._slot);
+  uint8_t *dst = _atlas[glyph->_atlas] + (_shelfY * _atlasSize) + _shelfX;
+  for (int y = 0; y < rows; y++) {
+    memcpy(dst + (y * _atlasSize), bitmap->buffer + (y * bitmap->pitch), width);
+  }
+  _shelfX += width;
+  if (rows > _shelfH) {
+    _shelfH = rows;
   }
 }
 
@@ -83,27 +188,50 @@ Font::~Font() {
 Graphics::Graphics() :
   _screen(nullptr),
   _drawTarget(nullptr),
-  _font(nullptr) {
+  _font(nullptr),
+  _fonts(nullptr) {
   graphics = this;
 }
 
 Graphics::~Graphics() {
   logEntered();
 
+  while (_fonts) {
+    Font *next = _fonts->_next;
+    delete _fonts;
+    _fonts = next;
+  }
   FT_Done_FreeType(_fontLibrary);
   delete _screen;
   graphics = nullptr;
   _screen = nullptr;
 }
 
+//
+// returns the cached font for the style and size, for example when ANSI
+// codes switch between bold and normal text
+//
 Font *Graphics::createFont(int style, int size) {
-  Font *result;
   bool italic = (style & FONT_STYLE_ITALIC);
-  if (style & FONT_STYLE_BOLD) {
-    result = new Font(_fontFaceB, size, italic);
-  } else {
-    result = new Font(_fontFace, size, italic);
-  }
+  FT_Face face = (style & FONT_STYLE_BOLD) ? _fontFaceB : _fontFace;
+  Font *prev = nullptr;
+  Font *result = _fonts;
+  while (result && (result->_face != face || result->_size != size || result->_italic != italic)) {
+    prev = result;
+    result = result->_next;
+  }
+  if (result == nullptr) {
+    result = new Font(face, size, italic);
+    result->_next = _fonts;
+    _fonts = result;
+    evictFonts();
+  } else if (prev != nullptr) {
+    // move to the front
+    prev->_next = result->_next;
+    result->_next = _fonts;
+    _fonts = result;
+  }
+  result->_refs++;
   return result;
 }
 
@@ -111,7 +239,23 @@ void Graphics::deleteFont(Font *font) {
   if (font == _font) {
     _font = nullptr;
   }
-  delete font;
+  // kept in the cache for reuse
+  font->_refs--;
+}
+
+// removes the least recently used fonts that are no longer in use
+void Graphics::evictFonts() {
+  int count = 0;
+  Font **link = &_fonts;
+  while (*link) {
+    Font *font = *link;
+    if (++count > FONT_CACHE_SIZE && font->_refs == 0) {
+      *link = font->_next;
+      delete font;
+    } else {
+      link = &font->_next;
+    }
+  }
 }
 
 void Graphics::drawArc(int xc, int yc, double r, double start, double end, double aspect) {
@@ -224,7 +368,7 @@ void Graphics::drawLine(int startX, int startY, int endX, int endY) {
       if (x2 >= _drawTarget->_w) {
         x2 = _drawTarget->_w -1;
       }
-      if (startY >= 0 && startY < _drawTarget->_h) {
+      if (startY >= _drawTarget->y() && startY < _drawTarget->h()) {
         pixel_t *line = _drawTarget->getLine(startY);
         if (x1 < _drawTarget->x()) {
           x1 = _drawTarget->x();
@@ -272,45 +416,173 @@ void Graphics::drawLine(int startX, int startY, int endX, int endY) {
 }
 
 void Graphics::drawPixel(int posX, int posY) {
-  pixel_t *line = _drawTarget->getLine(posY);
-  line[posX] = _drawColor;
+  if (posX >= _drawTarget->x()
+      && posY >= _drawTarget->y()
+      && posX < _drawTarget->w()
+      && posY < _drawTarget->h()) {
+    pixel_t *line = _drawTarget->getLine(posY);
+    line[posX] = _drawColor;
+  }
+}
+
+//
+// drawRGB() kernels, each blends a row of image pixels into the drawing target.
+// image pixels and pixel_t have the same byte order, so with SSE2 the
+// pixels are handled as words, four at a time
+//
+#define BLEND_ALPHA_MASK 0xff000000
+
+// the existing per-pixel alpha blend d + (s - d) * a / 255
+static inline uint8_t blend_alpha(uint8_t s, uint8_t d, uint8_t a) {
+  return d + ((s - d) * a / 255);
+}
+
+#if defined(__SSE2__)
+// the alpha blend of two pixels unpacked to 16 bit channels, (s - d) * a / 255
+// is calculated on the absolute difference so the division truncates as in C
+static inline __m128i blend_alpha_epi16(__m128i s, __m128i d) {
+  __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i diff = _mm_sub_epi16(s, d);
+  __m128i neg = _mm_cmpgt_epi16(_mm_setzero_si128(), diff);
+  __m128i abs = _mm_sub_epi16(_mm_xor_si128(diff, neg), neg);
+  __m128i n = _mm_mullo_epi16(abs, a);
+  // n / 255 for n <= 255 * 255
+  __m128i q = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(n, _mm_set1_epi16(1)), _mm_srli_epi16(n, 8)), 8);
+  return _mm_add_epi16(d, _mm_sub_epi16(_mm_xor_si128(q, neg), neg));
+}
+
+static inline __m128i blend_alpha_4(__m128i s, __m128i d) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = blend_alpha_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+  __m128i hi = blend_alpha_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+  return _mm_packus_epi16(lo, hi);
+}
+
+// op * s + (1 - op) * d for one pixel unpacked to 32 bit channels
+static inline __m128i blend_opacity_epi32(__m128i s, __m128i d, __m128 op, __m128 op1) {
+  __m128 fs = _mm_cvtepi32_ps(s);
+  __m128 fd = _mm_cvtepi32_ps(d);
+  return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(op, fs), _mm_mul_ps(op1, fd)));
+}
+
+static inline __m128i blend_opacity_epi16(__m128i s, __m128i d, __m128 op, __m128 op1) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = blend_opacity_epi32(_mm_unpacklo_epi16(s, zero), _mm_unpacklo_epi16(d, zero), op, op1);
+  __m128i hi = blend_opacity_epi32(_mm_unpackhi_epi16(s, zero), _mm_unpackhi_epi16(d, zero), op, op1);
+  return _mm_packs_epi32(lo, hi);
+}
+
+static inline __m128i blend_opacity_4(__m128i s, __m128i d, __m128 op, __m128 op1) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = blend_opacity_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), op, op1);
+  __m128i hi = blend_opacity_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), op, op1);
+  return _mm_packus_epi16(lo, hi);
+}
+#endif
+
+// blends using the alpha of each image pixel
+static void blend_row_alpha(pixel_t *line, const uint8_t *image, int width) {
+  int x = 0;
+#if defined(__SSE2__)
+  const __m128i alpha = _mm_set1_epi32(BLEND_ALPHA_MASK);
+  for (; x + 4 <= width; x += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(image + x * 4));
+    int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alpha), alpha));
+    __m128i *dst = (__m128i *)(line + x);
+    if (opaque == 0xffff) {
+      _mm_storeu_si128(dst, s);
+    } else {
+      __m128i d = _mm_loadu_si128(dst);
+      int clear = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alpha), _mm_setzero_si128()));
+      if (clear == 0xffff) {
+        _mm_storeu_si128(dst, _mm_or_si128(d, alpha));
+      } else {
+        _mm_storeu_si128(dst, _mm_or_si128(blend_alpha_4(s, d), alpha));
+      }
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    uint8_t a, r, g, b;
+    GET_IMAGE_ARGB(image, x * 4, a, r, g, b);
+    if (a == 255) {
+      line[x] = GET_RGB_PX(r, g, b);
+    } else if (a == 0) {
+      line[x] |= BLEND_ALPHA_MASK;
+    } else {
+      uint8_t dR, dG, dB;
+      GET_RGB(line[x], dR, dG, dB);
+      line[x] = GET_RGB_PX(blend_alpha(r, dR, a), blend_alpha(g, dG, a), blend_alpha(b, dB, a));
+    }
+  }
+}
+
+// blends image pixels with more than a quarter alpha using the given opacity,
+// other pixels using their alpha
+static void blend_row_opacity(pixel_t *line, const uint8_t *image, int width, float op) {
+  int x = 0;
+#if defined(__SSE2__)
+  const __m128i alpha = _mm_set1_epi32(BLEND_ALPHA_MASK);
+  const __m128i quarter = _mm_set1_epi32(64);
+  const __m128 vop = _mm_set1_ps(op);
+  const __m128 vop1 = _mm_set1_ps(1 - op);
+  for (; x + 4 <= width; x += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(image + x * 4));
+    __m128i *dst = (__m128i *)(line + x);
+    __m128i d = _mm_loadu_si128(dst);
+    __m128i use_op = _mm_cmpgt_epi32(_mm_srli_epi32(s, 24), quarter);
+    int mask = _mm_movemask_epi8(use_op);
+    __m128i result;
+    if (mask == 0xffff) {
+      result = blend_opacity_4(s, d, vop, vop1);
+    } else if (mask == 0) {
+      result = blend_alpha_4(s, d);
+    } else {
+      result = _mm_or_si128(_mm_and_si128(use_op, blend_opacity_4(s, d, vop, vop1)),
+                            _mm_andnot_si128(use_op, blend_alpha_4(s, d)));
+    }
+    _mm_storeu_si128(dst, _mm_or_si128(result, alpha));
+  }
+#endif
+  for (; x < width; x++) {
+    uint8_t a, r, g, b;
+    GET_IMAGE_ARGB(image, x * 4, a, r, g, b);
+    uint8_t dR, dG, dB;
+    GET_RGB(line[x], dR, dG, dB);
+    if (a > 64) {
+      dR = (op * r) + ((1 - op) * dR);
+      dG = (op * g) + ((1 - op) * dG);
+      dB = (op * b) + ((1 - op) * dB);
+    } else {
+      dR = blend_alpha(r, dR, a);
+      dG = blend_alpha(g, dG, a);
+      dB = blend_alpha(b, dB, a);
+    }
+    line[x] = GET_RGB_PX(dR, dG, dB);
+  }
 }
 
 void Graphics::drawRGB(const MAPoint2d *dstPoint, const void *src,
                        const MARect *srcRect, int opacity, int stride) {
-  auto *image = (uint8_t *)src;
-  float op = opacity / 100.0f;
-  int top = srcRect->top;
-  int left = srcRect->left;
-  int width = srcRect->width;
-  int height = srcRect->height;
-
-  for (int y = 0; y < height; y += 1) {
-    int dY = dstPoint->y + y;
-    if (dY >= _drawTarget->y() &&
-        dY <  _drawTarget->h()) {
-      int imgPos = (left + ((y + top) * stride)) * 4;
-      pixel_t *line = _drawTarget->getLine(dY);
-      for (int x = 0; x < width; x += 1) {
-        int dX = dstPoint->x + x;
-        if (dX >= _drawTarget->x() &&
-            dX <  _drawTarget->w()) {
-          // get RGBA components
-          uint8_t a, r, g, b;
-          GET_IMAGE_ARGB(image, imgPos + x * 4, a, r, g, b);
-          uint8_t dR, dG, dB;
-          GET_RGB(line[dX], dR, dG, dB);
-          if (opacity > 0 && opacity < 100 && a > 64) {
-            dR = (op * r) + ((1 - op) * dR);
-            dG = (op * g) + ((1 - op) * dG);
-            dB = (op * b) + ((1 - op) * dB);
-          } else {
-            dR = dR + ((r - dR) * a / 255);
-            dG = dG + ((g - dG) * a / 255);
-            dB = dB + ((b - dB) * a / 255);
-          }
-          line[dX] = GET_RGB_PX(dR, dG, dB);
-        }
+  auto *image = (const uint8_t *)src;
+
+  // clip to the draw target once for the whole image
+  int x1 = MAX(dstPoint->x, _drawTarget->x());
+  int x2 = MIN(dstPoint->x + srcRect->width, _drawTarget->w());
+  int y1 = MAX(dstPoint->y, _drawTarget->y());
+  int y2 = MIN(dstPoint->y + srcRect->height, _drawTarget->h());
+  int width = x2 - x1;
+
+  if (width > 0) {
+    int left = srcRect->left + (x1 - dstPoint->x);
+    int top = srcRect->top - dstPoint->y;
+    for (int dY = y1; dY < y2; dY++) {
+      const uint8_t *row = image + (left + ((dY + top) * stride)) * 4;
+      pixel_t *line = _drawTarget->getLine(dY) + x1;
+      if (opacity > 0 && opacity < 100) {
+        blend_row_opacity(line, row, width, opacity / 100.0f);
+      } else {
+        blend_row_alpha(line, row, width);
       }
     }
   }
@@ -333,7 +605,7 @@ void Graphics::drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y) {
       pixel_t *line = _drawTarget->getLine(j);
       for (FT_Int i = x, p = 0; i < xMax; i++, p++) {
         if (i >= dtX && i < dtW) {
-          uint8_t a = bitmap->buffer[q * bitmap->width + p];
+          uint8_t a = bitmap->buffer[q * bitmap->pitch + p];
           if (a == 255) {
             line[i] = _drawColor;
           } else {
@@ -356,13 +628,16 @@ void Graphics::drawText(int left, int top, const char *str, int len) {
     FT_Vector pen;
     pen.x = left;
     pen.y = top + _font->_h + ((_font->_spacing - _font->_h) / 2);
-    for (int i = 0; i < len; i++) {
-      uint8_t ch = str[i];
-      auto glyph = (FT_BitmapGlyph)_font->_glyph[ch]._slot;
-      drawChar(&glyph->bitmap,
-               pen.x + glyph->left,
-               pen.y - glyph->top);
-      pen.x += _font->_glyph[ch]._w;
+    for (int i = 0; i < len;) {
+      Glyph *glyph = _font->getGlyph(next_codepoint(str, len, i));
+      if (glyph->_width) {
+        FT_Bitmap bitmap;
+        _font->getBitmap(glyph, &bitmap);
+        drawChar(&bitmap,
+                 pen.x + glyph->_left,
+                 pen.y - glyph->_top);
+      }
+      pen.x += glyph->_w;
     }
   }
 }
@@ -411,13 +686,37 @@ int Graphics::getPixel(Canvas *canvas, int posX, int posY) {
   return result;
 }
 
+void Graphics::getPixelRow(Canvas *canvas, long *dst, int posX, int posY, int width) {
+  if (canvas == HANDLE_SCREEN) {
+    canvas = _screen;
+  }
+  if (canvas && posY > -1 && posY < canvas->_h - 1) {
+    pixel_t *line = canvas->getLine(posY);
+    for (int i = 0, x = posX; i < width; i++, x++) {
+      int result = 0;
+      if (x > -1 && x < canvas->_w) {
+        result = line[x];
+#if defined(PIXELFORMAT_RGBA8888)
+        uint8_t r, g, b;
+        GET_RGB(result, r, g, b);
+        result = v_get_argb_px(255, r, g, b);
+#endif
+      }
+      dst[i] = result;
+    }
+  } else {
+    for (int i = 0; i < width; i++) {
+      dst[i] = 0;
+    }
+  }
+}
+
 MAExtent Graphics::getTextSize(const char *str, int len) {
   int width = 0;
   int height = 0;
   if (_font) {
-    for (int i = 0; i < len; i++) {
-      uint8_t ch = str[i];
-      width += _font->_glyph[ch]._w;
+    for (int i = 0; i < len;) {
+      width += _font->getGlyph(next_codepoint(str, len, i))->_w;
     }
     height = _font->_spacing;
   }
@@ -467,7 +766,7 @@ void Graphics::aaLine(int x0, int y0, int x1, int y1) {
 
   // this will be used in the main loop
   int xpxl1 = (int)xend;
-  int ypxl1 = (int)yend;
+  int ypxl1 = (int)floor(yend);
 
   if (steep) {
     aaPlot(ypxl1,   xpxl1, 1 - fpart(yend) * xgap);
@@ -486,22 +785,22 @@ void Graphics::aaLine(int x0, int y0, int x1, int y1) {
   xgap = fpart(x1 + 0.5);
 
   int xpxl2 = (int)xend;
-  int ypxl2 = (int)yend;
+  int ypxl2 = (int)floor(yend);
 
   if (steep) {
     aaPlot(ypxl2  , xpxl2, 1 - fpart(yend) * xgap);
     aaPlot(ypxl2+1, xpxl2,  fpart(yend) * xgap);
     for (int x = xpxl1 + 1; x < xpxl2; x++) {
-      aaPlot((int)intery,   x, 1 - fpart(intery));
-      aaPlot((int)intery+1, x, fpart(intery));
+      aaPlot((int)floor(intery),   x, 1 - fpart(intery));
+      aaPlot((int)floor(intery)+1, x, fpart(intery));
       intery += gradient;
     }
   } else {
     aaPlot(xpxl2, ypxl2,  1 - fpart(yend) * xgap);
     aaPlot(xpxl2, ypxl2+1, fpart(yend) * xgap);
     for (int x = xpxl1 + 1; x < xpxl2; x++) {
-      aaPlot(x, (int)intery,   1 - fpart(intery));
-      aaPlot(x, (int)intery+1, fpart(intery));
+      aaPlot(x, (int)floor(intery),   1 - fpart(intery));
+      aaPlot(x, (int)floor(intery)+1, fpart(intery));
       intery += gradient;
     }
   }
@@ -693,6 +992,10 @@ void maGetImageData(MAHandle maHandle, void *dst,
   }
 }
 
+void maGetPixelRow(MAHandle maHandle, long *dst, int x, int y, int width) {
+  graphics->getPixelRow((Canvas *)maHandle, dst, x, y, width);
+}
+
 MAHandle maSetDrawTarget(MAHandle maHandle) {
   return graphics->setDrawTarget(maHandle);
 }
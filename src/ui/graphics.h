@@ -18,24 +18,58 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 
-#define MAX_GLYPHS 256
+#define GLYPH_PAGE_SIZE 256
+#define GLYPH_PAGES     (0x110000 / GLYPH_PAGE_SIZE)
+#define ATLAS_MIN_SIZE  256
+#define FONT_CACHE_SIZE 8
 
 using namespace strlib;
 
 namespace ui {
 
 struct Glyph {
-  FT_Glyph _slot;
-  int _w;
+  bool _loaded;
+  uint16_t _atlas;    // atlas page holding the bitmap
+  uint16_t _x, _y;    // bitmap position within the page
+  uint16_t _width;    // bitmap size, zero when blank
+  uint16_t _rows;
+  int16_t _left;      // bitmap offset from the pen position
+  int16_t _top;
+  int _w;             // advance width
 };
 
+//
+// a face at one size and style. glyphs are rasterized when first drawn
+// and packed into atlas pages, a shelf at a time
+//
 struct Font {
   Font(FT_Face face, int size, bool italic);
   virtual ~Font();
+
+  void getBitmap(const Glyph *glyph, FT_Bitmap *bitmap) const;
+  Glyph *getGlyph(uint32_t codepoint) {
+    Glyph *page = _pages[codepoint / GLYPH_PAGE_SIZE];
+    Glyph *glyph = page ? &page[codepoint % GLYPH_PAGE_SIZE] : nullptr;
+    return glyph && glyph->_loaded ? glyph : loadGlyph(codepoint);
+  }
+
   int _h;
   int _spacing;
+  int _size;
+  int _refs;
+  bool _italic;
   FT_Face _face;
-  Glyph _glyph[MAX_GLYPHS]{};
+  Font *_next;        // font cache, most recently used first
+
+private:
+  Glyph *loadGlyph(uint32_t codepoint);
+  void pack(Glyph *glyph, const FT_Bitmap *bitmap);
+
+  Glyph *_pages[GLYPH_PAGES]{};
+  uint8_t **_atlas;
+  int _atlasCount;
+  int _atlasSize;
+  int _shelfX, _shelfY, _shelfH;
 };
 
 struct Graphics {
@@ -59,6 +93,7 @@ struct Graphics {
   void getImageData(Canvas *canvas, uint8_t *image, 
                     const MARect *srcRect, int bytesPerLine);
   int  getPixel(Canvas *canvas, int x, int y);
+  void getPixelRow(Canvas *canvas, long *dst, int x, int y, int width);
   MAExtent getTextSize(const char *str, int len);
   int getHeight() { return _screen->_h; }
   int getWidth() { return _screen->_w; }
@@ -69,6 +104,7 @@ struct Graphics {
 
 protected:
   void drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y);
+  void evictFonts();
   void aaLine(int x0, int y0, int x1, int y1);
   void aaPlot(int x, int y, double c);
   void aaPlotX8(int xc, int yc, int x, int y, double c, bool fill);
@@ -82,6 +118,7 @@ protected:
   Canvas *_screen;
   Canvas *_drawTarget;
   Font *_font;
+  Font *_fonts;
   pixel_t _drawColor{};
 };
 
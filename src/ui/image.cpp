@@ -336,7 +336,8 @@ ImageBuffer *load_image(var_t *var) {
       for (int x = 0; x < w; x++) {
         int pos = y * w + x;
         uint8_t a, r, g, b;
-        v_get_argb(v_getint(v_elem(var, pos)), a, r, g, b);
+        var_t tmp;
+        v_get_argb(v_getint(v_elem_read(var, pos, &tmp)), a, r, g, b);
         SET_IMAGE_ARGB(imageData, yoffs + (x * 4), a, r, g, b);
       }
     }
@@ -791,6 +792,7 @@ extern "C" void v_create_image(var_p_t var) {
       file.type = ft_stream;
       image = load_image(&file);
     } else if (arg.type == V_ARRAY && v_asize(&arg) > 0 && !prog_error) {
+      v_unpack(&arg);
       var_p_t elem0 = v_elem(&arg, 0);
       if (elem0->type == V_STR) {
         // Img = Image(PixmapData)
@@ -88,6 +88,24 @@ int get_color(var_p_t value, int def) {
   return result;
 }
 
+// draws text laid out at one column per byte. bytes outside ASCII are drawn
+// one at a time, rather than as the UTF-8 character they might begin
+void draw_bytes(int x, int y, const char *str, int length, int charWidth) {
+  int start = 0;
+  for (int i = 0; i < length; i++) {
+    if ((unsigned char)str[i] >= 0x80) {
+      if (i > start) {
+        maDrawText(x + start * charWidth, y, str + start, i - start);
+      }
+      maDrawText(x + i * charWidth, y, str + i, 1);
+      start = i + 1;
+    }
+  }
+  if (length > start) {
+    maDrawText(x + start * charWidth, y, str + start, length - start);
+  }
+}
+
 int lerp(int c0, int c1, float weight) {
   int result;
   if (weight <= 0) {
@@ -247,13 +265,13 @@ void FormInput::drawText(const char *caption, int dx, int dy, int sw, int chw) {
     if (strWidth > width) {
       int len = width / chw;
       if (len > 0) {
-        maDrawText(dx, dy, caption, len - 1);
+        draw_bytes(dx, dy, caption, len - 1, chw);
         if (caption[len - 1] != ' ') {
           maDrawText(dx + ((len - 1) * chw), dy, "~", 1);
         }
       }
     } else if (strWidth) {
-      maDrawText(dx, dy, caption, strlen(caption));
+      draw_bytes(dx, dy, caption, strlen(caption), chw);
     }
   }
 }
@@ -282,11 +300,16 @@ void FormInput::setHelpTextColor() const {
 var_p_t FormInput::getField(var_p_t form) const {
   var_p_t result = nullptr;
   if (form->type == V_MAP) {
+    // the widget state is written back into the field
+    v_unshare(form);
     var_p_t inputs = map_get(form, FORM_INPUTS);
     if (inputs != nullptr && inputs->type == V_ARRAY) {
+      v_unshare(inputs);
+      v_unpack(inputs);
       for (unsigned i = 0; i < v_asize(inputs) && !result; i++) {
         var_p_t elem = v_elem(inputs, i);
         if (elem->type == V_MAP && (_id == map_get_int(elem, FORM_INPUT_ID, -1))) {
+          v_unshare(elem);
           result = elem;
         }
       }
@@ -558,7 +581,7 @@ void FormLineInput::draw(int x, int y, int w, int h, int chw) {
     setHelpTextColor();
     drawText(_help.c_str(), x + (chw * 0), y, w, chw);
   } else {
-    maDrawText(x, y, _buffer + _scroll, len);
+    draw_bytes(x, y, _buffer + _scroll, len, chw);
     if (_mark != _point && _mark != -1) {
       int chars = abs(_mark - _point);
       int start = MIN(_mark, _point);
@@ -567,7 +590,7 @@ void FormLineInput::draw(int x, int y, int w, int h, int chw) {
       setTextColor();
       maFillRect(px, y, width, _height);
       maSetColor(_bg);
-      maDrawText(px, y, _buffer + _scroll + start, chars);
+      draw_bytes(px, y, _buffer + _scroll + start, chars, chw);
     } else if (hasFocus()) {
       int px = x + (_point * chw);
       maFillRect(px, y, chw, _height);
@@ -834,7 +857,8 @@ void ListModel::create(var_t *v) {
 // construct from an array of values
 void ListModel::fromArray(var_t *v) {
   for (unsigned i = 0; i < v_asize(v); i++) {
-    var_t *el_p = v_elem(v, i);
+    var_t tmp;
+    var_t *el_p = v_elem_read(v, i, &tmp);
     if (el_p->type == V_STR) {
       _list.add(new strlib::String((const char *)el_p->v.p.ptr));
     } else if (el_p->type == V_INT) {
@@ -931,6 +955,7 @@ void FormList::updateForm(var_p_t form) {
   const char *selected = getText();
 
   // set the form value
+  v_unshare(form);
   var_p_t value = map_get(form, FORM_VALUE);
   if (value == nullptr) {
     value = map_add_var(form, FORM_VALUE, 0);
@@ -1213,7 +1238,7 @@ void MenuButton::draw(int x, int y, int w, int h, int chw) {
     int textY = y + (_height - charHeight) / 2;
 
     maSetColor(_pressed ? _fg : _bg);
-    maDrawText(x + 4, textY, _label.c_str(), len);
+    draw_bytes(x + 4, textY, _label.c_str(), len, chw);
     if (!_pressed && _index > 0 && _index % 2 == 0) {
       maSetColor(0x3b3a36);
       maLine(x + 2, y, x + LINE_W, y);
@@ -75,6 +75,7 @@ namespace form_ui {
 
 void set_input_defaults(int fg, int bg);
 int get_color(var_p_t value, int def);
+void draw_bytes(int x, int y, const char *str, int length, int charWidth);
 
 struct IFormWidgetListModel {
   virtual ~IFormWidgetListModel() = default;
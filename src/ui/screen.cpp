@@ -6,6 +6,9 @@
 // Download the GNU Public License (GPL) from www.gnu.org
 //
 
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 
 #include "ui/screen.h"
@@ -14,6 +17,7 @@
 #define SCROLL_IND 4
 #define MAX_HEIGHT 10000
 #define TEXT_ROWS 1000
+#define SCROLLBACK_PAGES 20
 
 // for hit testing menu button press
 #if defined(_ANDROID)
@@ -30,6 +34,11 @@
       rect->_y <= _scrollY + _height) \
     rect->draw(_x + rect->_x, _y + rect->_y - _scrollY, w(), h(), _charWidth)
 
+// repeats the following drawing statements for each part of the
+// GraphicScreen image holding the rows top..bottom, see nextBand()
+#define DRAW_BANDS(top, bottom) \
+  for (int band = nextBand(0, top, bottom); band != -1; band = nextBand(band + 1, top, bottom))
+
 int compareZIndex(const void *p1, const void *p2) {
   auto **i1 = (ImageDisplay **)p1;
   auto **i2 = (ImageDisplay **)p2;
@@ -333,8 +342,10 @@ int Screen::print(const char *p, int lineHeight, bool allChars) {
   int w = _width - 1;
 
   // print further non-control, non-null characters
-  // up to the width of the line
-  while (p[numChars] > 31) {
+  // up to the width of the line. bytes outside ASCII are
+  // printed one at a time, as one column each, whether or
+  // not char is signed
+  while ((unsigned char)p[numChars] > 31 && (unsigned char)p[numChars] < 0x80) {
     cx += _charWidth;
     if (allChars || _curX + cx < w) {
       numChars++;
@@ -487,6 +498,12 @@ void Screen::updateInputs(var_p_t form, bool setVars) {
 //
 // Graphics and text based screen with limited scrollback support
 //
+// The image grows with the output until it holds _pages screens, then
+// becomes a ring buffer: logical row y is stored at image row
+// (y + _imageTop) % _imageHeight, and scrolling moves _imageTop rather
+// than copying the image. The number of pages may be set with the
+// SBASICSCROLLBACK environment variable
+//
 GraphicScreen::GraphicScreen(int width, int height, int fontSize) :
   Screen(0, 0, width, height, fontSize),
   _image(0),
@@ -496,9 +513,18 @@ GraphicScreen::GraphicScreen(int width, int height, int fontSize) :
   _italic(false),
   _imageWidth(width),
   _imageHeight(height),
+  _imageTop(0),
+  _imageLimit(height),
+  _pages(SCROLLBACK_PAGES),
+  _bandY(0),
   _curYSaved(0),
   _curXSaved(0),
   _tabSize(40) {  // tab size in pixels (160/32 = 5)
+  const char *pages = getenv("SBASICSCROLLBACK");
+  if (pages != nullptr && atoi(pages) > 0) {
+    _pages = MIN(atoi(pages), SCROLLBACK_PAGES);
+  }
+  _imageLimit = _pages * height;
 }
 
 GraphicScreen::~GraphicScreen() {
@@ -533,25 +559,21 @@ void GraphicScreen::clear() {
   drawInto(true);
   maSetColor(_bg);
   maFillRect(0, 0, _imageWidth, _imageHeight);
+  _imageTop = 0;
   Screen::clear();
 }
 
 void GraphicScreen::drawArc(int xc, int yc, double r, double start, double end, double aspect) {
   drawInto();
-  maArc(xc, yc, r, start, end, aspect);
+  int ry = (int)(r * fabs(aspect)) + 1;
+  DRAW_BANDS(yc - ry, yc + ry) {
+    maArc(xc, yc + _bandY, r, start, end, aspect);
+  }
 }
 
 void GraphicScreen::drawBase(bool vscroll, bool update) {
-  MARect srcRect;
-  MAPoint2d dstPoint;
-  srcRect.left = 0;
-  srcRect.top = _scrollY;
-  srcRect.width = _width;
-  srcRect.height = _height;
-  dstPoint.x = _x;
-  dstPoint.y = _y;
   MAHandle currentHandle = maSetDrawTarget(HANDLE_SCREEN);
-  maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+  copyRows(_scrollY, _height, _x, _y, _width);
 
   drawOverlay(vscroll);
   _dirty = 0;
@@ -563,12 +585,17 @@ void GraphicScreen::drawBase(bool vscroll, bool update) {
 
 void GraphicScreen::drawEllipse(int xc, int yc, int rx, int ry, int fill) {
   drawInto();
-  maEllipse(xc, yc, rx, ry, fill);
+  DRAW_BANDS(yc - ry - 1, yc + ry + 1) {
+    maEllipse(xc, yc + _bandY, rx, ry, fill);
+  }
 }
 
 void GraphicScreen::drawImage(ImageDisplay &image) {
   drawInto();
-  image.draw(image._x, image._y, image._width, image._height, 0);
+  // the image position may be mapped by WINDOW, so draw into every band
+  DRAW_BANDS(INT_MIN, INT_MAX) {
+    image.draw(image._x, image._y + _bandY, image._width, image._height, 0);
+  }
 }
 
 void GraphicScreen::drawInto(bool background) {
@@ -578,20 +605,101 @@ void GraphicScreen::drawInto(bool background) {
 
 void GraphicScreen::drawLine(int x1, int y1, int x2, int y2) {
   drawInto();
-  maLine(x1, y1, x2, y2);
+  DRAW_BANDS(MIN(y1, y2), MAX(y1, y2)) {
+    maLine(x1, y1 + _bandY, x2, y2 + _bandY);
+  }
 }
 
 void GraphicScreen::drawRect(int x1, int y1, int x2, int y2) {
   drawInto();
-  maLine(x1, y1, x2, y1); // top
-  maLine(x1, y2, x2, y2); // bottom
-  maLine(x1, y1, x1, y2); // left
-  maLine(x2, y1, x2, y2); // right
+  DRAW_BANDS(MIN(y1, y2), MAX(y1, y2)) {
+    maLine(x1, y1 + _bandY, x2, y1 + _bandY); // top
+    maLine(x1, y2 + _bandY, x2, y2 + _bandY); // bottom
+    maLine(x1, y1 + _bandY, x1, y2 + _bandY); // left
+    maLine(x2, y1 + _bandY, x2, y2 + _bandY); // right
+  }
 }
 
 void GraphicScreen::drawRectFilled(int x1, int y1, int x2, int y2) {
   drawInto();
-  maFillRect(x1, y1, x2 - x1, y2 - y1);
+  fillRect(x1, y1, x2 - x1, y2 - y1);
+}
+
+// fills the rectangle at the logical rows y..y + h of the image
+void GraphicScreen::fillRect(int x, int y, int w, int h) {
+  int top = MAX(y, 0);
+  int bottom = MIN(y + h, _imageHeight);
+  while (top < bottom) {
+    int row = ringY(top);
+    int rows = MIN(bottom - top, _imageHeight - row);
+    maFillRect(x, row, w, rows);
+    top += rows;
+  }
+}
+
+// copies the logical rows top..top + height of the image to the draw target
+void GraphicScreen::copyRows(int top, int height, int dstX, int dstY, int width) {
+  MARect srcRect;
+  MAPoint2d dstPoint;
+  if (top < 0) {
+    dstY -= top;
+    height += top;
+    top = 0;
+  }
+  height = MIN(height, _imageHeight - top);
+  srcRect.left = 0;
+  srcRect.width = width;
+  dstPoint.x = dstX;
+  while (height > 0) {
+    int row = ringY(top);
+    int rows = MIN(height, _imageHeight - row);
+    srcRect.top = row;
+    srcRect.height = rows;
+    dstPoint.y = dstY;
+    maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+    top += rows;
+    dstY += rows;
+    height -= rows;
+  }
+}
+
+// returns the image row holding the logical row y
+int GraphicScreen::ringY(int y) const {
+  int result = y;
+  if (y >= 0 && y < _imageHeight) {
+    result += _imageTop;
+    if (result >= _imageHeight) {
+      result -= _imageHeight;
+    }
+  }
+  return result;
+}
+
+// selects the next band, from the given band, of the image holding any
+// of the logical rows top..bottom. Once the image has wrapped, band 0
+// holds the rows stored from _imageTop to the end of the image and band 1
+// the rows stored from the start of the image. The band is clipped and
+// drawn with the rows offset by _bandY. Returns -1 when done.
+int GraphicScreen::nextBand(int band, int top, int bottom) {
+  int split = _imageHeight - _imageTop;
+  int result = -1;
+  if (_imageTop == 0) {
+    if (band == 0) {
+      _bandY = 0;
+      result = 0;
+    }
+  } else if (band == 0 && top < split) {
+    maSetClipRect(0, _imageTop, _imageWidth, split);
+    _bandY = _imageTop;
+    result = 0;
+  } else if (band <= 1 && bottom >= split) {
+    maSetClipRect(0, 0, _imageWidth, _imageTop);
+    _bandY = -split;
+    result = 1;
+  } else {
+    maSetClipRect(0, 0, _imageWidth, _imageHeight);
+  }
+  return result;
 }
 
 // returns the color of the pixel at the given xy location
@@ -609,70 +717,61 @@ int GraphicScreen::getPixel(int x, int y) {
     drawBase(false);
     maGetImageData(HANDLE_SCREEN, &data, &rc, 1);
   } else {
+    rc.top = ringY(y);
     maGetImageData(_image, &data, &rc, 1);
   }
   return -(data[0] & 0x00FFFFFF);
 }
 
-// extend the image to allow for additional content on the newline
-void GraphicScreen::imageAppend(MAHandle newImage) {
-  MARect srcRect;
-  MAPoint2d dstPoint;
-
-  srcRect.left = 0;
-  srcRect.top = 0;
-  srcRect.width = _imageWidth;
-  srcRect.height = _imageHeight;
-  dstPoint.x = 0;
-  dstPoint.y = 0;
-
-  maSetDrawTarget(newImage);
-  maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
-
-  // clear the new segment
-  maSetColor(_bg);
-  maFillRect(0, _imageHeight, _imageWidth, _imageHeight + _height);
-  _imageHeight += _height;
-
-  // cleanup the old image
-  maDestroyPlaceholder(_image);
-  _image = newImage;
+// returns the colors of a row of pixels as getPixel() would
+bool GraphicScreen::getPixelRow(int x, int y, int width, long *colors) {
+  bool result = (x >= 0 && y >= 0);
+  if (result) {
+    maGetPixelRow(_image, colors, x, ringY(y), width);
+    for (int i = 0; i < width; i++) {
+      colors[i] = -(colors[i] & 0x00FFFFFF);
+    }
+  }
+  return result;
 }
 
-// scroll back the image to allow for additioal content on the newline
-void GraphicScreen::imageScroll() {
+// extend the image to allow for additional content on the newline
+bool GraphicScreen::imageAppend(int newHeight) {
+  bool result = false;
   MAHandle newImage = maCreatePlaceholder();
-  int newHeight = _imageHeight;
-  if (maCreateDrawableImage(newImage, _imageWidth, newHeight) == RES_OK) {
-    MARect srcRect;
-    MAPoint2d dstPoint;
-    int scrollBack = _height;
-    int copiedHeight = _imageHeight - scrollBack;
-
-    srcRect.left = 0;
-    srcRect.top = scrollBack;
-    srcRect.width = _imageWidth;
-    srcRect.height = copiedHeight;
-    dstPoint.x = 0;
-    dstPoint.y = 0;
-
+  if (newHeight > _imageHeight &&
+      maCreateDrawableImage(newImage, _imageWidth, newHeight) == RES_OK) {
     maSetDrawTarget(newImage);
-    maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+    copyRows(0, _imageHeight, 0, 0, _imageWidth);
 
     // clear the new segment
     maSetColor(_bg);
-    maFillRect(0, copiedHeight, _imageWidth, scrollBack);
+    maFillRect(0, _imageHeight, _imageWidth, newHeight - _imageHeight);
+    _imageHeight = newHeight;
+    _imageTop = 0;
 
     // cleanup the old image
     maDestroyPlaceholder(_image);
     _image = newImage;
-    _scrollY -= scrollBack;
-    _curY -= scrollBack;
+    result = true;
   } else {
-    // unable to create duplicate
     maDestroyPlaceholder(newImage);
-    clear();
   }
+  return result;
+}
+
+// scroll back the image to allow for additional content on the newline.
+// the rows holding the oldest content are reused for the new rows
+void GraphicScreen::imageScroll(int scrollBack) {
+  scrollBack = MIN(scrollBack, _imageHeight);
+  _imageTop = (_imageTop + scrollBack) % _imageHeight;
+
+  // clear the new segment
+  maSetDrawTarget(_image);
+  maSetColor(_bg);
+  fillRect(0, _imageHeight - scrollBack, _imageWidth, scrollBack);
+  _scrollY -= scrollBack;
+  _curY -= scrollBack;
 }
 
 // handles the \n character
@@ -684,16 +783,11 @@ void GraphicScreen::newLine(int lineHeight) {
     int offset = _curY + (lineHeight * 2);
     if (offset >= _height) {
       if (offset >= _imageHeight) {
-        // extend the base image by another page size
-        MAHandle newImage = maCreatePlaceholder();
-        int newHeight = _imageHeight + _height;
-        if (maCreateDrawableImage(newImage, _imageWidth, newHeight) != RES_OK) {
+        // double the base image up to the scrollback limit
+        int newHeight = MIN(MAX(_imageHeight * 2, offset + 1), _imageLimit);
+        if (_imageTop != 0 || newHeight <= offset || !imageAppend(newHeight)) {
           // maximum image size reached
-          maDestroyPlaceholder(newImage);
-          imageScroll();
-          lineHeight = 0;
-        } else {
-          imageAppend(newImage);
+          imageScroll(offset - _imageHeight + 1);
         }
       }
       _scrollY += lineHeight;
@@ -715,14 +809,16 @@ int GraphicScreen::print(const char *p, int lineHeight, bool allChars) {
 
   // erase the background
   maSetColor(_invert ? _fg : _bg);
-  maFillRect(cx, _curY, _curX-cx, lineHeight);
+  fillRect(cx, _curY, _curX-cx, lineHeight);
 
   // draw the text buffer
   maSetColor(_invert ? _bg : _fg);
-  maDrawText(cx, _curY, p, numChars);
-
-  if (_underline) {
-    maLine(cx, _curY + lineHeight - 2, _curX, _curY + lineHeight - 2);
+  DRAW_BANDS(_curY, _curY + lineHeight) {
+    int y = _curY + _bandY;
+    maDrawText(cx, y, p, numChars);
+    if (_underline) {
+      maLine(cx, y + lineHeight - 2, _curX, y + lineHeight - 2);
+    }
   }
 
   return numChars;
@@ -746,24 +842,15 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
   bool fullscreen = ((_width - _x) == oldWidth && (_height - _y) == oldHeight);
   if (fullscreen && (newWidth > _imageWidth || newHeight > _imageHeight)) {
     // screen is larger than existing virtual size
-    MARect srcRect;
-    MAPoint2d dstPoint;
     MAHandle newImage = maCreatePlaceholder();
     int newImageWidth = MAX(newWidth, _imageWidth);
     int newImageHeight = MAX(newHeight, _imageHeight);
 
-    srcRect.left = 0;
-    srcRect.top = 0;
-    srcRect.width = MIN(_imageWidth, newImageWidth);
-    srcRect.height = MIN(_imageHeight, newImageHeight);
-    dstPoint.x = 0;
-    dstPoint.y = 0;
-
     if (maCreateDrawableImage(newImage, newImageWidth, newImageHeight) == RES_OK) {
       maSetDrawTarget(newImage);
       maSetColor(_bg);
       maFillRect(0, 0, newImageWidth, newImageHeight);
-      maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+      copyRows(0, _imageHeight, 0, 0, _imageWidth);
       maDestroyPlaceholder(_image);
     } else {
       // cannot resize - alert and abort
@@ -774,6 +861,7 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
     _image = newImage;
     _imageWidth = newImageWidth;
     _imageHeight = newImageHeight;
+    _imageTop = 0;
 
     if (_curY >= _imageHeight) {
       _curY = _height - lineHeight;
@@ -785,6 +873,7 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
   _scrollY = 0;
   _width = newWidth;
   _height = newHeight;
+  _imageLimit = MAX(_pages * newHeight, _imageHeight);
   if (!fullscreen) {
     drawBase(false);
   }
@@ -800,7 +889,7 @@ bool GraphicScreen::setGraphicsRendition(const char c, int escValue, int lineHei
   switch (c) {
   case 'K':
     maSetColor(_bg);            // \e[K - clear to eol
-    maFillRect(_curX, _curY, _width - _curX, lineHeight);
+    fillRect(_curX, _curY, _width - _curX, lineHeight);
     break;
   case 'G':                    // move to column
     _curX = escValue * _charWidth;
@@ -912,7 +1001,7 @@ bool GraphicScreen::setGraphicsRendition(const char c, int escValue, int lineHei
 void GraphicScreen::setPixel(int x, int y, int c) {
   drawInto();
   maSetColor(ansiToMosync(c));
-  maPlot(x, y);
+  maPlot(x, ringY(y));
 }
 
 struct LineShape : Shape {
@@ -41,6 +41,7 @@ struct Screen : public Shape {
   virtual void drawRectFilled(int x1, int y1, int x2, int y2) = 0;
   virtual void newLine(int lineHeight) = 0;
   virtual int  getPixel(int x, int y) = 0;
+  virtual bool getPixelRow(int x, int y, int width, long *colors) { return false; }
   virtual int  print(const char *p, int lineHeight, bool allChars=false);
   virtual bool setGraphicsRendition(const char c, int escValue, int lineHeight) = 0;
   virtual void setPixel(int x, int y, int c) = 0;
@@ -114,8 +115,13 @@ struct GraphicScreen : public Screen {
   void drawRect(int x1, int y1, int x2, int y2) override;
   void drawRectFilled(int x1, int y1, int x2, int y2) override;
   int  getPixel(int x, int y) override;
-  void imageScroll();
-  void imageAppend(MAHandle newImage);
+  bool getPixelRow(int x, int y, int width, long *colors) override;
+  void copyRows(int top, int height, int dstX, int dstY, int width);
+  void fillRect(int x, int y, int w, int h);
+  bool imageAppend(int newHeight);
+  void imageScroll(int scrollBack);
+  int  nextBand(int band, int top, int bottom);
+  int  ringY(int y) const;
   void newLine(int lineHeight) override;
   int  print(const char *p, int lineHeight, bool allChars=false) override;
   void reset(int fontSize) override;
@@ -133,6 +139,10 @@ struct GraphicScreen : public Screen {
   bool _italic;
   int _imageWidth;
   int _imageHeight;
+  int _imageTop;
+  int _imageLimit;
+  int _pages;
+  int _bandY;
   int _curYSaved;
   int _curXSaved;
   int _tabSize;
@@ -160,6 +160,8 @@ bool System::execute(const char *bas) {
   opt_base = 0;
   opt_usepcre = 0;
   opt_autolocal = 0;
+  opt_profile = 0;
+  opt_optimise = 1;
 
   _state = kRunState;
   setWindowTitle(bas);
@@ -1386,6 +1388,10 @@ long osd_getpixel(int x, int y) {
   return g_system->getOutput()->getPixel(x, y);
 }
 
+int osd_getrow(int x, int y, int width, long *colors) {
+  return g_system->getOutput()->getPixelRow(x, y, width, colors);
+}
+
 int osd_getx(void) {
   return g_system->getOutput()->getX();
 }
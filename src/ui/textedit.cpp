@@ -642,7 +642,7 @@ void TextEditInput::draw(int x, int y, int w, int h, int chw) {
           if (begin > 0) {
             // initial non-selected chars
             maSetColor(_theme->_color);
-            maDrawText(x + baseX, y + baseY, _buf._buffer + i, begin);
+            draw_bytes(x + baseX, y + baseY, _buf._buffer + i, begin, _charWidth);
             baseX += begin * _charWidth;
           } else if (begin < 0) {
             // started on previous row
@@ -660,14 +660,14 @@ void TextEditInput::draw(int x, int y, int w, int h, int chw) {
           maSetColor(_theme->_selection_background);
           maFillRect(x + baseX, y + baseY, count * _charWidth, _charHeight);
           maSetColor(_theme->_selection_color);
-          maDrawText(x + baseX, y + baseY, _buf._buffer + i + begin, count);
+          draw_bytes(x + baseX, y + baseY, _buf._buffer + i + begin, count, _charWidth);
 
           int end = numChars - (begin + count);
           if (end) {
             // trailing non-selected chars
             baseX += count * _charWidth;
             maSetColor(_theme->_color);
-            maDrawText(x + baseX, y + baseY, _buf._buffer + i + begin + count, end);
+            draw_bytes(x + baseX, y + baseY, _buf._buffer + i + begin + count, end, _charWidth);
           }
         } else {
           // draw empty row selection
@@ -682,7 +682,7 @@ void TextEditInput::draw(int x, int y, int w, int h, int chw) {
             drawText(x + _marginWidth, y + baseY, _buf._buffer + i, numChars, syntax);
           } else {
             maSetColor(_theme->_color);
-            maDrawText(x + _marginWidth, y + baseY, _buf._buffer + i, numChars);
+            draw_bytes(x + _marginWidth, y + baseY, _buf._buffer + i, numChars, _charWidth);
           }
         }
       }
@@ -814,7 +814,7 @@ void TextEditInput::drawText(int x, int y, const char *str, int length, SyntaxSt
     // draw the current segment
     if (count > 0) {
       setColor(state);
-      maDrawText(x, y, str + offs, count);
+      draw_bytes(x, y, str + offs, count, _charWidth);
       offs += count;
       x += (count * _charWidth);
     }
@@ -822,7 +822,7 @@ void TextEditInput::drawText(int x, int y, const char *str, int length, SyntaxSt
     // draw the next segment
     if (next > 0) {
       setColor(nextState);
-      maDrawText(x, y, str + offs, next);
+      draw_bytes(x, y, str + offs, next, _charWidth);
       state = kReset;
       offs += next;
       x += (next * _charWidth);